@@ -512,15 +512,28 @@ void Terminal::OnKeyEvent(const Asgaard::KeyEvent& key)
 
 void Terminal::OnResized(enum SurfaceEdges, int width, int height)
 {
+    // the compositor holds back further sizes until this one is committed, so the
+    // new size must always be committed, even if nothing has to be reallocated
+    if (width == m_buffer->Width() && height == m_buffer->Height()) {
+        ApplyChanges();
+        return;
+    }
+
     // calculate new metrics
     auto rows = ((height - ALUMNI_MARGIN_TOP) / m_font->GetFontHeight()) - 1;
     auto cols = (width - (ALUMNI_MARGIN_LEFT + ALUMNI_MARGIN_RIGHT)) / m_font->GetFontWidth();
 
+    // the pool is sized for the screen, grow it in place if the window spans more
+    auto bufferSize = static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * 4;
+    if (bufferSize > m_memory->Size()) {
+        m_memory->Resize(bufferSize);
+    }
+
     // create a new buffer object of the requested size
     auto buffer = Asgaard::MemoryBuffer::Create(this, m_memory, 0, width,
         height, Asgaard::PixelFormat::X8B8G8R8, Asgaard::MemoryBuffer::Flags::NONE);
     
-    PrepareBuffer(m_buffer);
+    PrepareBuffer(buffer);
     if (rows != m_rows || cols != m_cellWidth) {
         // update stored metrics
         m_rows = rows;
@@ -529,12 +542,14 @@ void Terminal::OnResized(enum SurfaceEdges, int width, int height)
         // clear lines
         m_lines.clear();
         for (int i = 0; i < m_rows; i++) {
-            auto line = std::make_unique<TerminalLine>(m_font, i, m_cellWidth);
+            m_lines.push_back(std::make_unique<TerminalLine>(m_font, i, m_cellWidth));
         }
         ScrollToLine(m_historyIndex, m_historyIndex == static_cast<int>(m_history.size()));
     }
     Redraw(buffer);
     SetBuffer(buffer);
+    MarkDamaged(Asgaard::Rectangle(0, 0, width, height));
+    ApplyChanges();
     m_buffer->Destroy();
     m_buffer = buffer;
 }
@@ -0,0 +1,46 @@
+# FindOSMesa - attempts to locate the Mesa off-screen rendering library.
+#
+# This module defines the following variables (on success):
+# OSMESA_INCLUDE_DIR - where to find GL/osmesa.h
+# OSMESA_LIBRARY - the name of the library
+# OSMESA_FOUND - if the library was successfully located
+#
+# It is trying a few standard installation locations, but can be customized
+# with the following variables:
+# OSMESA_ROOT - root directory of a mesa installation
+# This variable can either be a cmake or environment
+# variable.
+#=============================================================================
+# default search dirs
+
+SET(_osmesa_HEADER_SEARCH_DIRS
+"/usr/include"
+"/usr/local/include"
+"${CMAKE_SOURCE_DIR}/includes" )
+set(_osmesa_LIB_SEARCH_DIRS
+"/usr/lib"
+"/usr/local/lib"
+"${CMAKE_SOURCE_DIR}/lib" )
+
+# check environment variable
+SET(_osmesa_ENV_ROOT_DIR "$ENV{OSMESA_ROOT}")
+IF(NOT OSMESA_ROOT AND _osmesa_ENV_ROOT_DIR)
+	SET(OSMESA_ROOT "${_osmesa_ENV_ROOT_DIR}")
+ENDIF(NOT OSMESA_ROOT AND _osmesa_ENV_ROOT_DIR)
+
+# put user specified location at beginning of search
+IF(OSMESA_ROOT)
+	list( INSERT _osmesa_HEADER_SEARCH_DIRS 0 "${OSMESA_ROOT}/include" )
+	list( INSERT _osmesa_LIB_SEARCH_DIRS 0 "${OSMESA_ROOT}/lib" )
+ENDIF(OSMESA_ROOT)
+
+# Search for the header
+FIND_PATH(OSMESA_INCLUDE_DIR "GL/osmesa.h"
+PATHS ${_osmesa_HEADER_SEARCH_DIRS} )
+
+# Search for the library
+FIND_LIBRARY(OSMESA_LIBRARY NAMES OSMesa osmesa
+PATHS ${_osmesa_LIB_SEARCH_DIRS} )
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(OSMesa DEFAULT_MSG
+OSMESA_LIBRARY OSMESA_INCLUDE_DIR)
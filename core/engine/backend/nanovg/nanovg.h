@@ -384,6 +384,9 @@ int nvgCreateImageAs(NVGcontext* ctx, int w, int h, int type, int imageFlags, co
 // Updates image data specified by image handle.
 void nvgUpdateImage(NVGcontext* ctx, int image, const unsigned char* data);
 
+// Updates a part of the image, data points to the data of the entire image.
+void nvgUpdateImageRegion(NVGcontext* ctx, int image, int x, int y, int w, int h, const unsigned char* data);
+
 // Returns the dimensions of a created image.
 void nvgImageSize(NVGcontext* ctx, int image, int* w, int* h);
 
@@ -624,7 +627,8 @@ enum NVGtexture {
 	NVG_TEXTURE_BGRA = 0x04,
 	NVG_TEXTURE_BRGX = 0x05,
 	NVG_TEXTURE_ARGB = 0x06,
-	NVG_TEXTURE_ABGR = 0x07
+	NVG_TEXTURE_ABGR = 0x07,
+	NVG_TEXTURE_RGB565 = 0x08
 };
 
 struct NVGscissor {
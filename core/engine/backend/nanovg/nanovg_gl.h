@@ -32,6 +32,9 @@ enum NVGcreateFlags {
 	NVG_STENCIL_STROKES	= 1<<1,
 	// Flag indicating that additional debug checks are done.
 	NVG_DEBUG 			= 1<<2,
+	// Flag indicating that the output should be ordered dithered, used when rendering into
+	// 16 bit (RGB565) render targets to hide the banding of gradients and shadows.
+	NVG_DITHER			= 1<<3,
 };
 
 #if defined NANOVG_GL2_IMPLEMENTATION
@@ -505,6 +508,7 @@ static int glnvg__renderCreate(void* uptr)
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
 	int align = 4;
+	char opts[128];
 
 	// TODO: mediump float may not be enough for GLES2 in iOS.
 	// see the following discussion: https://github.com/memononen/nanovg/issues/46
@@ -621,6 +625,30 @@ static int glnvg__renderCreate(void* uptr)
 		"	return min(1.0, (1.0-abs(ftcoord.x*2.0-1.0))*strokeMult) * min(1.0, ftcoord.y);\n"
 		"}\n"
 		"#endif\n"
+		"// The texture data is uploaded in its own byte order, so the channels are reordered and\n"
+		"// the alpha is resolved when sampling. texType is the alpha mode (0 premultiplied,\n"
+		"// 1 straight, 2 alpha only, 3 opaque) plus 4 times the channel order.\n"
+		"vec4 texLayout(vec4 color) {\n"
+		"	int order = texType / 4;\n"
+		"	int alpha = texType - order * 4;\n"
+		"	if (order == 1) color = color.zyxw;\n"
+		"	else if (order == 2) color = color.yzwx;\n"
+		"	else if (order == 3) color = color.wzyx;\n"
+		"	if (alpha == 1) color = vec4(color.xyz*color.w,color.w);\n"
+		"	else if (alpha == 2) color = vec4(color.x);\n"
+		"	else if (alpha == 3) color = vec4(color.xyz,1.0);\n"
+		"	return color;\n"
+		"}\n"
+		"#ifdef DITHER\n"
+		"// Ordered 4x4 bayer threshold in [0..1), computed so it also works without arrays.\n"
+		"float bayer2(vec2 a) {\n"
+		"	a = floor(a);\n"
+		"	return fract(dot(a, vec2(0.5, a.y * 0.75)));\n"
+		"}\n"
+		"float bayer4(vec2 a) {\n"
+		"	return bayer2(0.5 * a) * 0.25 + bayer2(a);\n"
+		"}\n"
+		"#endif\n"
 		"\n"
 		"void main(void) {\n"
 		"   vec4 result;\n"
@@ -647,8 +675,7 @@ static int glnvg__renderCreate(void* uptr)
 		"#else\n"
 		"		vec4 color = texture2D(tex, pt);\n"
 		"#endif\n"
-		"		if (texType == 1) color = vec4(color.xyz*color.w,color.w);"
-		"		if (texType == 2) color = vec4(color.x);"
+		"		color = texLayout(color);\n"
 		"		// Apply color tint and alpha.\n"
 		"		color *= innerCol;\n"
 		"		// Combine alpha\n"
@@ -662,11 +689,15 @@ static int glnvg__renderCreate(void* uptr)
 		"#else\n"
 		"		vec4 color = texture2D(tex, ftcoord);\n"
 		"#endif\n"
-		"		if (texType == 1) color = vec4(color.xyz*color.w,color.w);"
-		"		if (texType == 2) color = vec4(color.x);"
+		"		color = texLayout(color);\n"
 		"		color *= scissor;\n"
 		"		result = color * innerCol;\n"
 		"	}\n"
+		"#ifdef DITHER\n"
+		"	// Spread the quantization error of the 5/6/5 bit channels, scaled by alpha as the\n"
+		"	// result is premultiplied.\n"
+		"	result.rgb += (bayer4(gl_FragCoord.xy) + 1.0/32.0 - 0.5) * DITHER * result.a;\n"
+		"#endif\n"
 		"#ifdef NANOVG_GL3\n"
 		"	outColor = result;\n"
 		"#else\n"
@@ -676,13 +707,13 @@ static int glnvg__renderCreate(void* uptr)
 
 	glnvg__checkError(gl, "init");
 
-	if (gl->flags & NVG_ANTIALIAS) {
-		if (glnvg__createShader(&gl->shader, "shader", shaderHeader, "#define EDGE_AA 1\n", fillVertShader, fillFragShader) == 0)
-			return 0;
-	} else {
-		if (glnvg__createShader(&gl->shader, "shader", shaderHeader, NULL, fillVertShader, fillFragShader) == 0)
-			return 0;
-	}
+	opts[0] = '\0';
+	if (gl->flags & NVG_ANTIALIAS)
+		strcat(opts, "#define EDGE_AA 1\n");
+	if (gl->flags & NVG_DITHER)
+		strcat(opts, "#define DITHER vec3(1.0/31.0, 1.0/63.0, 1.0/31.0)\n");
+	if (glnvg__createShader(&gl->shader, "shader", shaderHeader, opts[0] ? opts : NULL, fillVertShader, fillFragShader) == 0)
+		return 0;
 
 	glnvg__checkError(gl, "uniform locations");
 	glnvg__getUniforms(&gl->shader);
@@ -708,6 +739,38 @@ static int glnvg__renderCreate(void* uptr)
 	return 1;
 }
 
+static int glnvg__textureBytesPerPixel(int type)
+{
+	if (type == NVG_TEXTURE_ALPHA)
+		return 1;
+	else if (type == NVG_TEXTURE_RGB565)
+		return 2;
+	return 4;
+}
+
+// Resolves the texType of the fragment shader, see texLayout. 32 bit textures are stored in the
+// byte order of their data, and the channel order is undone when sampling.
+static int glnvg__textureLayout(GLNVGtexture* tex)
+{
+	int order = 0;
+	int alpha;
+
+	if (tex->type == NVG_TEXTURE_BGRA || tex->type == NVG_TEXTURE_BRGX)
+		order = 1;
+	else if (tex->type == NVG_TEXTURE_ARGB)
+		order = 2;
+	else if (tex->type == NVG_TEXTURE_ABGR)
+		order = 3;
+
+	if (tex->type == NVG_TEXTURE_ALPHA)
+		alpha = 2;
+	else if (tex->type == NVG_TEXTURE_RGBX || tex->type == NVG_TEXTURE_BRGX || tex->type == NVG_TEXTURE_RGB565)
+		alpha = 3;
+	else
+		alpha = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
+	return alpha + order * 4;
+}
+
 static int glnvg__renderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data)
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
@@ -719,7 +782,7 @@ static int glnvg__renderCreateTexture(void* uptr, int type, int w, int h, int im
     if (imageFlags & NVG_IMAGE_STREAMING) {
         glGenBuffers(1, &tex->pbo);
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tex->pbo);
-        glBufferData(GL_PIXEL_UNPACK_BUFFER, w * h, data, GL_STREAM_DRAW);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, w * h * glnvg__textureBytesPerPixel(type), data, GL_STREAM_DRAW);
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
     }
 #endif
@@ -761,12 +824,10 @@ static int glnvg__renderCreateTexture(void* uptr, int type, int w, int h, int im
 	}
 #endif
 
-	if (type == NVG_TEXTURE_RGBA)
+	if (glnvg__textureBytesPerPixel(type) == 4)
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-	else if (type == NVG_TEXTURE_RGBX)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_INT_8_8_8_8, data);
-	else if (type == NVG_TEXTURE_BRGX)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_BGR, w, h, 0, GL_BGR, GL_UNSIGNED_INT_8_8_8_8, data);
+	else if (type == NVG_TEXTURE_RGB565)
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, data);
 	else
 #if defined(NANOVG_GLES2) || defined (NANOVG_GL2)
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, w, h, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
@@ -855,21 +916,15 @@ static int glnvg__renderUpdateTexture(void* uptr, int image, int x, int y, int w
 	glPixelStorei(GL_UNPACK_SKIP_ROWS, y);
 #else
 	// No support for all of skip, need to update a whole row at a time.
-	if (tex->type == NVG_TEXTURE_RGBA || tex->type == NVG_TEXTURE_RGBX ||
-		tex->type == NVG_TEXTURE_BRGX)
-		data += y*tex->width*4;
-	else
-		data += y*tex->width;
+	data += y*tex->width*glnvg__textureBytesPerPixel(tex->type);
 	x = 0;
 	w = tex->width;
 #endif
 
-	if (tex->type == NVG_TEXTURE_RGBA)
+	if (glnvg__textureBytesPerPixel(tex->type) == 4)
 		glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,h, GL_RGBA, GL_UNSIGNED_BYTE, data);
-	else if (tex->type == NVG_TEXTURE_RGBX)
-		glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,h, GL_RGB, GL_UNSIGNED_INT_8_8_8_8, data);
-	else if (tex->type == NVG_TEXTURE_BRGX)
-		glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,h, GL_BGR, GL_UNSIGNED_INT_8_8_8_8, data);
+	else if (tex->type == NVG_TEXTURE_RGB565)
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,h, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, data);
 	else
 #if defined(NANOVG_GLES2) || defined(NANOVG_GL2)
 		glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,h, GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
@@ -975,19 +1030,9 @@ static int glnvg__convertPaint(GLNVGcontext* gl, GLNVGfragUniforms* frag, NVGpai
 		frag->type = NSVG_SHADER_FILLIMG;
 
 		#if NANOVG_GL_USE_UNIFORMBUFFER
-		if (tex->type == NVG_TEXTURE_RGBA)
-			frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
-		else if (tex->type == NVG_TEXTURE_RGBX || tex->type == NVG_TEXTURE_BRGX)
-			frag->texType = 0;
-		else
-			frag->texType = 2;
+		frag->texType = glnvg__textureLayout(tex);
 		#else
-		if (tex->type == NVG_TEXTURE_RGBA)
-			frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0.0f : 1.0f;
-		else if (tex->type == NVG_TEXTURE_RGBX || tex->type == NVG_TEXTURE_BRGX)
-			frag->texType = 0.0f;
-		else
-			frag->texType = 2.0f;
+		frag->texType = (float)glnvg__textureLayout(tex);
 		#endif
 //		printf("frag->texType = %d\n", frag->texType);
 	} else {
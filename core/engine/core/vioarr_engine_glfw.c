@@ -30,31 +30,32 @@
 #include <GLFW/glfw3.h>
 
 #include "../vioarr_manager.h"
+#include "../vioarr_memory.h"
+#include "../vioarr_objects.h"
+#include "../vioarr_outputs.h"
+#include "../vioarr_quota.h"
+#include "../vioarr_governor.h"
+#include "../vioarr_textures.h"
 #include "../vioarr_engine.h"
 #include "../vioarr_renderer.h"
 #include "../vioarr_screen.h"
 #include "../vioarr_utils.h"
-#include <stdatomic.h>
-#include <time.h>
+#include <threads.h>
+
+#define ENGINE_EVENT_TIMEOUT 0.1 // seconds
 
 struct startup_sync_context {
     mtx_t lock;
     cnd_t signal;
     int   ready;
-};
-
-struct render_sync_context {
-    atomic_uint update;
-    clock_t last_update;
+    int   status;
 };
 
 static int vioarr_engine_setup_screens(void);
 static int vioarr_engine_update(void*);
 
-static vioarr_screen_t*            primary_screen;
 static thrd_t                      screen_thread;
 static struct startup_sync_context startup_context;
-static struct render_sync_context  render_sync;
 
 int vioarr_engine_initialize(void)
 {
@@ -62,20 +63,25 @@ int vioarr_engine_initialize(void)
 
     // initialize systems
     vioarr_manager_initialize();
+    vioarr_objects_initialize();
+    vioarr_textures_initialize();
+    vioarr_quota_initialize();
+    vioarr_governor_initialize();
+    if (vioarr_memory_initialize()) {
+        vioarr_utils_error(VISTR("[vioarr] [initialize] failed to initialize memory pools"));
+        return -1;
+    }
     
     // initialize the startup context that synchronizes
     // the startup sequence. 
     mtx_init(&startup_context.lock, mtx_plain);
     cnd_init(&startup_context.signal);
-    startup_context.ready = 0;
-
-    // initialize the rendering sync context that controls
-    // how often we render
-    atomic_init(&render_sync.update, 0);
-    render_sync.last_update = 0;
+    startup_context.ready  = 0;
+    startup_context.status = 0;
 
-    // create the renderer thread and allow it to initialize before ending engine init
-    vioarr_utils_trace(VISTR("[vioarr] [initialize] creating renderer thread"));
+    // create the event thread and allow it to initialize before ending engine init, the
+    // screens are rendered by the output threads
+    vioarr_utils_trace(VISTR("[vioarr] [initialize] creating event thread"));
     status = thrd_create(&screen_thread, vioarr_engine_update, NULL);
     if (status != thrd_success) {
         return status;
@@ -87,61 +93,80 @@ int vioarr_engine_initialize(void)
         cnd_wait(&startup_context.signal, &startup_context.lock);
     }
     mtx_unlock(&startup_context.lock);
-    return 0;
+    return startup_context.status;
 }
 
 void vioarr_engine_request_redraw(void)
 {
-    atomic_store_explicit(&render_sync.update, 1, memory_order_relaxed);
+    vioarr_outputs_request_redraw();
 }
 
 int vioarr_engine_x_minimum(void)
 {
-    return vioarr_region_x(vioarr_screen_region(primary_screen));
+    int x1, y1, x2, y2;
+    vioarr_outputs_bounds(&x1, &y1, &x2, &y2);
+    return x1;
 }
 
 int vioarr_engine_x_maximum(void)
 {
-    return vioarr_region_width(vioarr_screen_region(primary_screen));
+    int x1, y1, x2, y2;
+    vioarr_outputs_bounds(&x1, &y1, &x2, &y2);
+    return x2;
 }
 
 int vioarr_engine_y_minimum(void)
 {
-    return vioarr_region_y(vioarr_screen_region(primary_screen));
+    int x1, y1, x2, y2;
+    vioarr_outputs_bounds(&x1, &y1, &x2, &y2);
+    return y1;
 }
 
 int vioarr_engine_y_maximum(void)
 {
-    return vioarr_region_height(vioarr_screen_region(primary_screen));
+    int x1, y1, x2, y2;
+    vioarr_outputs_bounds(&x1, &y1, &x2, &y2);
+    return y2;
 }
 
 static int vioarr_engine_setup_screens(void)
 {
-    // glfwGetMonitors
-    struct GLFWmonitor* primary;
+    struct GLFWmonitor** monitors;
+    int                  monitorCount;
+    int                  i;
     
     vioarr_utils_trace(VISTR("vioarr_engine_setup_screens quering screen information"));
-    primary = glfwGetPrimaryMonitor();
-    if (!primary) {
-        vioarr_utils_error(VISTR("vioarr_engine_setup_screens failed to get primary monitor information"));
+    monitors = glfwGetMonitors(&monitorCount);
+    if (!monitors || !monitorCount) {
+        vioarr_utils_error(VISTR("vioarr_engine_setup_screens failed to get monitor information"));
         return -1;
     }
     
-    vioarr_utils_trace(VISTR("[vioarr] [initialize] creating primary screen object"));
-    // Create the primary screen object. In the future we will support
-    // multiple displays and also listen for screen hotplugs
-    primary_screen = vioarr_screen_create(primary);
-    if (!primary_screen) {
-        vioarr_utils_error(VISTR("[vioarr] [initialize] failed to create primary screen object"));
-        return -1;
+    // create a screen for each of the monitors, the primary monitor is always the first
+    for (i = 0; i < monitorCount && i < VIOARR_MAX_OUTPUTS; i++) {
+        vioarr_screen_t* screen;
+
+        vioarr_utils_trace(VISTR("[vioarr] [initialize] creating screen object %i"), i);
+        screen = vioarr_screen_create(monitors[i]);
+        if (!screen) {
+            vioarr_utils_error(VISTR("[vioarr] [initialize] failed to create screen object %i"), i);
+            return -1;
+        }
+
+        // the render thread of the output makes the context current again
+        vioarr_screen_make_current(screen, 0);
+        if (vioarr_outputs_add(screen, 0)) {
+            return -1;
+        }
     }
     return 0;
 }
 
-static void signal_init_thread(void)
+static void signal_init_thread(int status)
 {
     mtx_lock(&startup_context.lock);
-    startup_context.ready = 1;
+    startup_context.ready  = 1;
+    startup_context.status = status;
     mtx_unlock(&startup_context.lock);
 
     cnd_signal(&startup_context.signal);
@@ -156,7 +181,7 @@ static int vioarr_engine_update(void* context)
     // Initialise GLFW
     if (!glfwInit()) {
         vioarr_utils_error(VISTR("Failed to initialize GLFW\n"));
-        signal_init_thread();
+        signal_init_thread(-1);
         return -1;
     }
 
@@ -172,25 +197,17 @@ static int vioarr_engine_update(void* context)
     status = vioarr_engine_setup_screens();
     if (status) {
         vioarr_utils_error(VISTR("vioarr_engine_update failed to initialize screens, code %i"), status);
-        signal_init_thread();
+        signal_init_thread(status);
         return status;
     }
     
     vioarr_utils_trace(VISTR("vioarr_engine_update started"));
-    signal_init_thread();
-    
-    double renderInterval = 1.0 / 120.0;
-    double nextFrameTimeout = renderInterval;
-    unsigned int shouldRender = 0;
-    while (vioarr_screen_valid(primary_screen)) {
-        // time to next frame
-        glfwWaitEventsTimeout(nextFrameTimeout);
-        shouldRender = atomic_exchange(&render_sync.update, 0);
-        if (!shouldRender) {
-            continue;
-        }
-        render_sync.last_update = clock();
-        vioarr_screen_frame(primary_screen);
+    signal_init_thread(0);
+
+    // the windows were created on this thread, so their input events must be processed
+    // here, while rendering is left to the output threads
+    while (vioarr_outputs_running()) {
+        glfwWaitEventsTimeout(ENGINE_EVENT_TIMEOUT);
     }
     return 0;
 }
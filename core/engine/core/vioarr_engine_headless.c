@@ -0,0 +1,228 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../vioarr_manager.h"
+#include "../vioarr_memory.h"
+#include "../vioarr_objects.h"
+#include "../vioarr_outputs.h"
+#include "../vioarr_quota.h"
+#include "../vioarr_governor.h"
+#include "../vioarr_textures.h"
+#include "../vioarr_engine.h"
+#include "../vioarr_renderer.h"
+#include "../vioarr_screen.h"
+#include "../vioarr_utils.h"
+#include <threads.h>
+
+#define HEADLESS_DEFAULT_WIDTH   1280
+#define HEADLESS_DEFAULT_HEIGHT  720
+#define HEADLESS_DEFAULT_REFRESH ENGINE_SCREEN_REFRESH_HZ
+#define HEADLESS_DEFAULT_FORMAT  "ARGB"
+#define HEADLESS_DEFAULT_DEVICE  "/dev/fb0"
+
+static int vioarr_engine_setup_screens(void);
+
+static video_output_t g_headlessOutputs[VIOARR_MAX_OUTPUTS];
+static int            g_headlessOutputCount;
+static int            g_continuous;
+
+/**
+ * Splits the next entry off a comma separated list, returns NULL at the end of the list.
+ */
+static char* __next_entry(char** list)
+{
+    char* entry = *list;
+    char* separator;
+
+    if (!entry || !*entry) {
+        return NULL;
+    }
+
+    separator = strchr(entry, ',');
+    if (separator) {
+        *separator = '\0';
+        *list = separator + 1;
+    }
+    else {
+        *list = NULL;
+    }
+    return entry;
+}
+
+static void __parse_mode(video_output_t* output, const char* mode)
+{
+    int width, height, refresh;
+    int count = sscanf(mode, "%ix%i@%i", &width, &height, &refresh);
+    if (count >= 2 && width > 0 && height > 0) {
+        output->width  = width;
+        output->height = height;
+        if (count == 3 && refresh >= 0) {
+            output->refresh_rate = refresh;
+        }
+    }
+    else {
+        vioarr_utils_error(VISTR("[__parse_mode] invalid VIOARR_HEADLESS_MODE %s, using defaults"), mode);
+    }
+}
+
+/**
+ * The headless outputs are configured from the environment:
+ * VIOARR_HEADLESS_MODE       <width>x<height>[@<refresh>], a refresh of 0 renders unthrottled. A comma
+ *                            separated list creates a screen per mode, placed left to right
+ * VIOARR_HEADLESS_FORMAT     the framebuffer format, see vioarr_screen_formats.c
+ * VIOARR_HEADLESS_CONTINUOUS render every frame even without damage, for benchmarking
+ * VIOARR_FBDEV_DEVICE        framebuffer builds only, the device, file or shm:<name> to present into. A
+ *                            comma separated list creates a screen per device
+ */
+static void __configure_outputs(void)
+{
+    const char* format     = getenv("VIOARR_HEADLESS_FORMAT");
+    const char* continuous = getenv("VIOARR_HEADLESS_CONTINUOUS");
+    char*       modes      = NULL;
+    char*       devices    = NULL;
+    char*       modeList;
+    char*       deviceList;
+    int         i;
+
+    // the entries are referenced by the outputs for the lifetime of the compositor
+    if (getenv("VIOARR_HEADLESS_MODE")) {
+        modes = strdup(getenv("VIOARR_HEADLESS_MODE"));
+    }
+#ifdef VIOARR_FBDEV
+    devices = strdup(getenv("VIOARR_FBDEV_DEVICE") ? getenv("VIOARR_FBDEV_DEVICE") : HEADLESS_DEFAULT_DEVICE);
+#endif
+
+    modeList   = modes;
+    deviceList = devices;
+    for (i = 0; i < VIOARR_MAX_OUTPUTS; i++) {
+        video_output_t* output = &g_headlessOutputs[i];
+        char*           mode   = __next_entry(&modeList);
+        char*           device = __next_entry(&deviceList);
+
+        // there is always at least one output, after that one per mode or device
+        if (i && !mode && !device) {
+            break;
+        }
+
+        output->width        = HEADLESS_DEFAULT_WIDTH;
+        output->height       = HEADLESS_DEFAULT_HEIGHT;
+        output->refresh_rate = HEADLESS_DEFAULT_REFRESH;
+        output->format       = format ? format : HEADLESS_DEFAULT_FORMAT;
+        output->device       = device;
+        if (mode) {
+            __parse_mode(output, mode);
+        }
+
+        g_headlessOutputCount++;
+    }
+
+    g_continuous = continuous && atoi(continuous) != 0;
+}
+
+int vioarr_engine_initialize(void)
+{
+    // initialize systems
+    vioarr_manager_initialize();
+    vioarr_objects_initialize();
+    vioarr_textures_initialize();
+    vioarr_quota_initialize();
+    vioarr_governor_initialize();
+    if (vioarr_memory_initialize()) {
+        vioarr_utils_error(VISTR("[vioarr] [initialize] failed to initialize memory pools"));
+        return -1;
+    }
+    __configure_outputs();
+
+    // the screens are created here, each of them is then rendered by its own thread
+    vioarr_utils_trace(VISTR("[vioarr] [initialize] initializing screens"));
+    return vioarr_engine_setup_screens();
+}
+
+void vioarr_engine_request_redraw(void)
+{
+    vioarr_outputs_request_redraw();
+}
+
+int vioarr_engine_x_minimum(void)
+{
+    int x1, y1, x2, y2;
+    vioarr_outputs_bounds(&x1, &y1, &x2, &y2);
+    return x1;
+}
+
+int vioarr_engine_x_maximum(void)
+{
+    int x1, y1, x2, y2;
+    vioarr_outputs_bounds(&x1, &y1, &x2, &y2);
+    return x2;
+}
+
+int vioarr_engine_y_minimum(void)
+{
+    int x1, y1, x2, y2;
+    vioarr_outputs_bounds(&x1, &y1, &x2, &y2);
+    return y1;
+}
+
+int vioarr_engine_y_maximum(void)
+{
+    int x1, y1, x2, y2;
+    vioarr_outputs_bounds(&x1, &y1, &x2, &y2);
+    return y2;
+}
+
+static int vioarr_engine_setup_screens(void)
+{
+    int x = 0;
+    int i;
+
+    for (i = 0; i < g_headlessOutputCount; i++) {
+        vioarr_screen_t* screen;
+
+        // screens are placed left to right, the mode of a framebuffer device can differ
+        // from the configured one so the actual width of the screen is used
+        g_headlessOutputs[i].x = x;
+        g_headlessOutputs[i].y = 0;
+
+        vioarr_utils_trace(VISTR("[vioarr] [initialize] creating headless screen object %i"), i);
+        screen = vioarr_screen_create(&g_headlessOutputs[i]);
+        if (!screen) {
+            vioarr_utils_error(VISTR("[vioarr] [initialize] failed to create headless screen object %i"), i);
+            return -1;
+        }
+        x += vioarr_region_width(vioarr_screen_region(screen));
+
+        // the render thread of the output makes the context current again
+        vioarr_screen_make_current(screen, 0);
+        if (vioarr_outputs_add(screen, g_continuous)) {
+            return -1;
+        }
+    }
+    return 0;
+}
@@ -25,101 +25,75 @@
 #include <ddk/video.h>
 #include <os/mollenos.h>
 #include "../vioarr_manager.h"
+#include "../vioarr_memory.h"
+#include "../vioarr_objects.h"
+#include "../vioarr_outputs.h"
+#include "../vioarr_quota.h"
+#include "../vioarr_governor.h"
+#include "../vioarr_textures.h"
 #include "../vioarr_engine.h"
 #include "../vioarr_renderer.h"
 #include "../vioarr_screen.h"
 #include "../vioarr_utils.h"
-#include <time.h>
-#include <threads.h>
-
-struct startup_sync_context {
-    mtx_t lock;
-    cnd_t signal;
-    int   ready;
-};
-
-struct render_sync_context {
-    mtx_t lock;
-    cnd_t signal;
-    int   should_render;
-};
 
 static int vioarr_engine_setup_screens(void);
-static int vioarr_engine_update(void*);
-
-static vioarr_screen_t*            primary_screen;
-static thrd_t                      screen_thread;
-static struct startup_sync_context startup_context;
-static struct render_sync_context  render_sync;
 
 int vioarr_engine_initialize(void)
 {
-    int status;
-    
     // initialize systems
     vioarr_manager_initialize();
-    
-    // initialize the startup context that synchronizes
-    // the startup sequence. 
-    mtx_init(&startup_context.lock, mtx_plain);
-    cnd_init(&startup_context.signal);
-    startup_context.ready = 0;
-
-    // initialize the rendering sync context that controls
-    // how often we render, and initialize the should_render to true
-    mtx_init(&render_sync.lock, mtx_plain);
-    cnd_init(&render_sync.signal);
-    render_sync.should_render = 1;
-
-    // create the renderer thread and allow it to initialize before ending engine init
-    vioarr_utils_trace(VISTR("[vioarr] [initialize] creating renderer thread"));
-    status = thrd_create(&screen_thread, vioarr_engine_update, NULL);
-    if (status != thrd_success) {
-        return status;
+    vioarr_objects_initialize();
+    vioarr_textures_initialize();
+    vioarr_quota_initialize();
+    vioarr_governor_initialize();
+    if (vioarr_memory_initialize()) {
+        vioarr_utils_error(VISTR("[vioarr] [initialize] failed to initialize memory pools"));
+        return -1;
     }
 
-    // wait for startup sequence to finish
-    mtx_lock(&startup_context.lock);
-    while (!startup_context.ready) {
-        cnd_wait(&startup_context.signal, &startup_context.lock);
-    }
-    mtx_unlock(&startup_context.lock);
-    return 0;
+    // the screens are created here, each of them is then rendered by its own thread
+    vioarr_utils_trace(VISTR("[vioarr] [initialize] initializing screens"));
+    return vioarr_engine_setup_screens();
 }
 
 void vioarr_engine_request_redraw(void)
 {
-    mtx_lock(&render_sync.lock);
-    render_sync.should_render = 1;
-    mtx_unlock(&render_sync.lock);
-
-    cnd_signal(&render_sync.signal);
+    vioarr_outputs_request_redraw();
 }
 
 int vioarr_engine_x_minimum(void)
 {
-    return vioarr_region_x(vioarr_screen_region(primary_screen));
+    int x1, y1, x2, y2;
+    vioarr_outputs_bounds(&x1, &y1, &x2, &y2);
+    return x1;
 }
 
 int vioarr_engine_x_maximum(void)
 {
-    return vioarr_region_width(vioarr_screen_region(primary_screen));
+    int x1, y1, x2, y2;
+    vioarr_outputs_bounds(&x1, &y1, &x2, &y2);
+    return x2;
 }
 
 int vioarr_engine_y_minimum(void)
 {
-    return vioarr_region_y(vioarr_screen_region(primary_screen));
+    int x1, y1, x2, y2;
+    vioarr_outputs_bounds(&x1, &y1, &x2, &y2);
+    return y1;
 }
 
 int vioarr_engine_y_maximum(void)
 {
-    return vioarr_region_height(vioarr_screen_region(primary_screen));
+    int x1, y1, x2, y2;
+    vioarr_outputs_bounds(&x1, &y1, &x2, &y2);
+    return y2;
 }
 
 static int vioarr_engine_setup_screens(void)
 {
-    video_output_t video;
-    OsStatus_t     osStatus;
+    vioarr_screen_t* screen;
+    video_output_t   video;
+    OsStatus_t       osStatus;
     
     vioarr_utils_trace(VISTR("[vioarr] [initialize] quering screen information"));
     // Get screens available from OS.
@@ -131,58 +105,15 @@ static int vioarr_engine_setup_screens(void)
     }
     
     vioarr_utils_trace(VISTR("[vioarr] [initialize] creating primary screen object"));
-    // Create the primary screen object. In the future we will support
-    // multiple displays and also listen for screen hotplugs
-    primary_screen = vioarr_screen_create(&video);
-    if (!primary_screen) {
+    // The OS only reports the boot display for now, once it can report more the
+    // additional displays are simply added as outputs as well
+    screen = vioarr_screen_create(&video);
+    if (!screen) {
         vioarr_utils_error(VISTR("[vioarr] [initialize] failed to create primary screen object"));
         return -1;
     }
-    return 0;
-}
 
-static void signal_init_thread(void)
-{
-    mtx_lock(&startup_context.lock);
-    startup_context.ready = 1;
-    mtx_unlock(&startup_context.lock);
-
-    cnd_signal(&startup_context.signal);
-}
-
-static int vioarr_engine_update(void* context)
-{
-    clock_t lastUpdate, diffMs;
-    int     status;
-
-    (void)context;
-
-    vioarr_utils_trace(VISTR("vioarr_engine_update initializing screens"));
-    status = vioarr_engine_setup_screens();
-    if (status) {
-        vioarr_utils_error(VISTR("vioarr_engine_update failed to initialize screens, code %i"), status);
-        signal_init_thread();
-        return status;
-    }
-    
-    vioarr_utils_trace(VISTR("vioarr_engine_update started"));
-    signal_init_thread();
-    
-    lastUpdate = 0;
-    while (1) {
-        mtx_lock(&render_sync.lock);
-        while (!render_sync.should_render) {
-            cnd_wait(&render_sync.signal, &render_sync.lock);
-        }
-        render_sync.should_render = 0;
-        mtx_unlock(&render_sync.lock);
-
-        diffMs = (clock() - lastUpdate) / (CLOCKS_PER_SEC / 1000);
-        if (diffMs < ENGINE_SCREEN_REFRESH_MS) {
-            thrd_sleepex(ENGINE_SCREEN_REFRESH_MS - (diffMs % ENGINE_SCREEN_REFRESH_MS));
-        }
-        lastUpdate = clock();
-        
-        vioarr_screen_frame(primary_screen);
-    }
+    // the render thread of the output makes the context current again
+    vioarr_screen_make_current(screen, 0);
+    return vioarr_outputs_add(screen, 0);
 }
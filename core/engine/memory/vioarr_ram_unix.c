@@ -22,56 +22,400 @@
  *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
  */
 
+#define _GNU_SOURCE
 #include "../vioarr_memory.h"
 #include "../vioarr_objects.h"
-#include <sys/types.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
+#include "../vioarr_peer.h"
+#include "../vioarr_quota.h"
+#include "../vioarr_utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <stdlib.h>
-#include <sys/stat.h>
 #include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/**
+ * Pools are memfds created by the clients. The protocol cannot carry file descriptors, so they are
+ * handed to the compositor over a separate local socket with SCM_RIGHTS before the pool is created.
+ * The handle of a pool is the pid of the client and the descriptor number in the client, the pid is
+ * checked against the credentials of the socket the descriptor arrived on, and against the process
+ * of the client creating the pool.
+ * Every descriptor is acknowledged with a status once it is stored, and the client waits for that
+ * before creating the pool, so the create handler never has to wait for a descriptor to arrive.
+ */
+#define MEMORY_SOCKET_PATH      "/tmp/vi-mem"
+#define MEMORY_MAX_CONNECTIONS  64
+#define MEMORY_MAX_HANDOFFS     64
+#define MEMORY_PID_CONNECTIONS  2   // connections a single process may keep open
+#define MEMORY_PID_HANDOFFS     8   // descriptors a single process may have waiting for a pool
+#define MEMORY_HANDOFF_EXPIRY   10  // seconds a descriptor is kept that no pool was created for
+
+/**
+ * Every pool reserves address space up front so it can grow in place, buffers keep pointers into
+ * the pool. The reservation is aligned to huge pages so huge page backed pools can be mapped.
+ */
+#define MEMORY_POOL_RESERVE     (256 * 1024 * 1024)
+#define MEMORY_HUGEPAGE_SIZE    (2 * 1024 * 1024)
+#define MEMORY_ALIGN(size, alignment) (((size) + ((alignment) - 1)) & ~((size_t)(alignment) - 1))
 
 typedef struct vioarr_memory_pool {
     int          client;
     uint32_t     id;
     _Atomic(int) references;
-    key_t        pool_key;
-    int          shm_fd;
-    void*        memory;
+    mhandle_t    handle;
+    int          fd;
+    void*        reservation;
+    size_t       reserved;
+    void*        memory;  // start of the mapping, aligned inside the reservation
     size_t       size;
 } vioarr_memory_pool_t;
 
-int vioarr_memory_create_pool(int client, uint32_t id, key_t handle, size_t size, vioarr_memory_pool_t** poolOut)
+typedef struct vioarr_memory_handoff {
+    mhandle_t handle;
+    int       fd;
+    time_t    received;
+} vioarr_memory_handoff_t;
+
+static struct {
+    int                     socket;
+    mtx_t                   lock;
+    int                     count;
+    vioarr_memory_handoff_t handoffs[MEMORY_MAX_HANDOFFS];
+} g_memory;
+
+static int __memory_listener(void* context);
+
+int vioarr_memory_initialize(void)
+{
+    struct sockaddr_un addr = { 0 };
+    thrd_t             thread;
+
+    mtx_init(&g_memory.lock, mtx_plain);
+
+    g_memory.socket = socket(AF_LOCAL, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (g_memory.socket < 0) {
+        vioarr_utils_error(VISTR("[vioarr_memory_initialize] failed to create memory socket %i"), errno);
+        return -1;
+    }
+
+    // delete any preexisting file
+    unlink(MEMORY_SOCKET_PATH);
+
+    addr.sun_family = AF_LOCAL;
+    strncpy(addr.sun_path, MEMORY_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    if (bind(g_memory.socket, (struct sockaddr*)&addr, sizeof(addr)) ||
+        listen(g_memory.socket, 16)) {
+        vioarr_utils_error(VISTR("[vioarr_memory_initialize] failed to listen on memory socket %i"), errno);
+        close(g_memory.socket);
+        return -1;
+    }
+
+    if (thrd_create(&thread, __memory_listener, NULL) != thrd_success) {
+        close(g_memory.socket);
+        return -1;
+    }
+    thrd_detach(thread);
+    return 0;
+}
+
+/**
+ * Stores a descriptor until the pool is created. A full table never evicts descriptors of other
+ * processes, and a single process can only have a few descriptors waiting, so one process cannot
+ * flood the table and make the pools of others fail.
+ */
+static int __add_handoff(mhandle_t handle, int fd)
+{
+    time_t now   = time(NULL);
+    int    owned = 0;
+    int    i;
+
+    mtx_lock(&g_memory.lock);
+
+    // descriptors no pool was created for are dropped after a while
+    for (i = 0; i < g_memory.count; i++) {
+        if ((now - g_memory.handoffs[i].received) > MEMORY_HANDOFF_EXPIRY) {
+            close(g_memory.handoffs[i].fd);
+            memmove(&g_memory.handoffs[i], &g_memory.handoffs[i + 1],
+                sizeof(vioarr_memory_handoff_t) * (g_memory.count - i - 1));
+            g_memory.count--;
+            i--;
+        }
+        else if ((g_memory.handoffs[i].handle >> 32) == (handle >> 32)) {
+            owned++;
+        }
+    }
+
+    if (owned == MEMORY_PID_HANDOFFS || g_memory.count == MEMORY_MAX_HANDOFFS) {
+        mtx_unlock(&g_memory.lock);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    g_memory.handoffs[g_memory.count].handle   = handle;
+    g_memory.handoffs[g_memory.count].fd       = fd;
+    g_memory.handoffs[g_memory.count].received = now;
+    g_memory.count++;
+    mtx_unlock(&g_memory.lock);
+    return 0;
+}
+
+/**
+ * Takes the descriptor handed off for the handle. The client waits for the descriptor to be
+ * acknowledged before it creates the pool, so a descriptor that is not here is an error.
+ */
+static int __take_handoff(mhandle_t handle)
+{
+    int fd = -1;
+    int i;
+
+    mtx_lock(&g_memory.lock);
+    for (i = 0; i < g_memory.count; i++) {
+        if (g_memory.handoffs[i].handle == handle) {
+            fd = g_memory.handoffs[i].fd;
+            memmove(&g_memory.handoffs[i], &g_memory.handoffs[i + 1],
+                sizeof(vioarr_memory_handoff_t) * (g_memory.count - i - 1));
+            g_memory.count--;
+            break;
+        }
+    }
+    mtx_unlock(&g_memory.lock);
+    return fd;
+}
+
+/**
+ * Receives a single descriptor from a client connection and acknowledges it with the status of the
+ * handoff. Returns -1 if the connection was closed.
+ */
+static int __receive_handoff(int connection)
+{
+    char            control[CMSG_SPACE(sizeof(int))];
+    struct msghdr   message = { 0 };
+    struct iovec    iov;
+    struct cmsghdr* cmsg;
+    struct ucred    credentials;
+    socklen_t       length = sizeof(credentials);
+    mhandle_t       handle;
+    ssize_t         bytesRead;
+    int32_t         status = EINVAL;
+    int             fd;
+
+    iov.iov_base = &handle;
+    iov.iov_len  = sizeof(handle);
+    message.msg_iov        = &iov;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control;
+    message.msg_controllen = sizeof(control);
+
+    bytesRead = recvmsg(connection, &message, MSG_CMSG_CLOEXEC);
+    if (bytesRead <= 0) {
+        return -1;
+    }
+
+    cmsg = CMSG_FIRSTHDR(&message);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+        // the handle must name a descriptor of the process that sent it
+        if (bytesRead != sizeof(handle) ||
+            getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &credentials, &length) ||
+            (pid_t)(handle >> 32) != credentials.pid) {
+            vioarr_utils_error(VISTR("[__receive_handoff] rejected memory descriptor"));
+            close(fd);
+        }
+        else if (__add_handoff(handle, fd)) {
+            status = errno;
+            close(fd);
+        }
+        else {
+            status = 0;
+        }
+    }
+
+    // the client is blocked on the status, a client that does not read it loses the connection
+    if (send(connection, &status, sizeof(status), MSG_NOSIGNAL | MSG_DONTWAIT) != sizeof(status)) {
+        return -1;
+    }
+    return 0;
+}
+
+static pid_t __connection_pid(int connection)
 {
-    vioarr_memory_pool_t*  pool;
+    struct ucred credentials;
+    socklen_t    length = sizeof(credentials);
+
+    if (getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &credentials, &length)) {
+        return -1;
+    }
+    return credentials.pid;
+}
+
+static int __memory_listener(void* context)
+{
+    struct pollfd fds[1 + MEMORY_MAX_CONNECTIONS];
+    pid_t         pids[1 + MEMORY_MAX_CONNECTIONS];
+    int           count = 1;
+    int           i;
+    (void)context;
+
+    fds[0].fd     = g_memory.socket;
+    fds[0].events = POLLIN;
+    while (1) {
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            vioarr_utils_error(VISTR("[__memory_listener] poll failed %i"), errno);
+            break;
+        }
+
+        for (i = 1; i < count; i++) {
+            if (fds[i].revents && __receive_handoff(fds[i].fd)) {
+                close(fds[i].fd);
+                count--;
+                fds[i]    = fds[count];
+                pids[i--] = pids[count];
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int   connection = accept4(g_memory.socket, NULL, NULL, SOCK_CLOEXEC);
+            pid_t pid;
+            int   owned = 0;
+            if (connection < 0) {
+                continue;
+            }
+
+            // clients share a single connection, so a process opening many is not well-behaved
+            pid = __connection_pid(connection);
+            for (i = 1; i < count; i++) {
+                owned += pids[i] == pid;
+            }
+
+            if (pid < 0 || owned == MEMORY_PID_CONNECTIONS || count == 1 + MEMORY_MAX_CONNECTIONS) {
+                close(connection);
+            }
+            else {
+                fds[count].fd      = connection;
+                fds[count].events  = POLLIN;
+                fds[count].revents = 0;
+                pids[count]        = pid;
+                count++;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Maps the pool memory into its reservation, this is also used to grow the mapping as the
+ * memory is mapped at the same address again.
+ */
+static int __map_pool(vioarr_memory_pool_t* pool, size_t size)
+{
+    struct stat stats;
+    size_t      length = MEMORY_ALIGN(size, MEMORY_HUGEPAGE_SIZE);
+
+    if (fstat(pool->fd, &stats) || (size_t)stats.st_size < size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (length > pool->reserved - ((uintptr_t)pool->memory - (uintptr_t)pool->reservation)) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (mmap(pool->memory, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+            pool->fd, 0) == MAP_FAILED) {
+        return -1;
+    }
+
+    // screen-sized pools benefit from transparent huge pages, if the system has them enabled for
+    // shared memory. Pools that are backed by huge pages already just ignore it
+    if (length >= MEMORY_HUGEPAGE_SIZE) {
+        madvise(pool->memory, length, MADV_HUGEPAGE);
+    }
+    pool->size = size;
+    return 0;
+}
+
+int vioarr_memory_create_pool(int client, uint32_t id, mhandle_t handle, size_t size, vioarr_memory_pool_t** poolOut)
+{
+    vioarr_memory_pool_t* pool;
+    int                   seals;
+    int                   fd;
     
     if (!size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // only the process that handed off the descriptor may create a pool from it, otherwise any
+    // client could guess the handle of another process and map its memory
+    if (vioarr_peer_pid(client) != (int)(handle >> 32)) {
+        vioarr_utils_error(VISTR("[vioarr_memory_create_pool] client %i does not own handle 0x%llx"),
+            client, (unsigned long long)handle);
+        errno = EPERM;
+        return -1;
+    }
+
+    fd = __take_handoff(handle);
+    if (fd < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    if (vioarr_quota_check(client, VIOARR_QUOTA_MEMORY, size)) {
+        close(fd);
+        return -1;
+    }
+
+    // the client must not be able to shrink the memory underneath the buffers
+    seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || !(seals & F_SEAL_SHRINK)) {
+        close(fd);
+        errno = EPERM;
         return -1;
     }
     
     pool = malloc(sizeof(vioarr_memory_pool_t));
     if (!pool) {
+        close(fd);
         return -1;
     }
 
     pool->client     = client;
     pool->id         = id;
     pool->references = ATOMIC_VAR_INIT(1);
-    pool->pool_key   = handle;
-    pool->size       = size;
+    pool->handle     = handle;
+    pool->fd         = fd;
+    pool->reserved   = MEMORY_ALIGN(size > (MEMORY_POOL_RESERVE / 2) ? size * 2 : MEMORY_POOL_RESERVE,
+        MEMORY_HUGEPAGE_SIZE) + MEMORY_HUGEPAGE_SIZE;
 
-    pool->shm_fd = shmget(handle, size, /* IPC_CREAT | */ S_IRUSR | S_IWUSR);
-    if (pool->shm_fd == -1) {
+    pool->reservation = mmap(NULL, pool->reserved, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (pool->reservation == MAP_FAILED) {
+        close(fd);
         free(pool);
         return -1;
     }
+    pool->memory = (void*)MEMORY_ALIGN((uintptr_t)pool->reservation, MEMORY_HUGEPAGE_SIZE);
 
-    pool->memory = shmat(pool->shm_fd, 0, 0);
-    if (pool->memory == (void*)(-1)) {
+    if (__map_pool(pool, size)) {
+        munmap(pool->reservation, pool->reserved);
+        close(fd);
         free(pool);
         return -1;
     }
 
+    vioarr_quota_charge(client, VIOARR_QUOTA_MEMORY, size);
     *poolOut = pool;
     return 0;
 }
@@ -102,13 +446,43 @@ int vioarr_memory_destroy_pool(vioarr_memory_pool_t* pool)
     references = atomic_fetch_sub(&pool->references, 1);
     if (references == 1) {
         vioarr_objects_remove_object(pool->client, pool->id);
-        shmdt(pool->memory);
-        shmctl(pool->shm_fd, IPC_RMID, 0);
+        vioarr_quota_release(pool->client, VIOARR_QUOTA_MEMORY, pool->size);
+        munmap(pool->reservation, pool->reserved);
+        close(pool->fd);
         free(pool);
     }
     return 0;
 }
 
+/**
+ * Grows the pool in place, the client must have grown the memory before. Pools cannot shrink
+ * as buffers may still reference any part of them.
+ */
+int vioarr_memory_pool_resize(vioarr_memory_pool_t* pool, size_t size)
+{
+    size_t previousSize;
+
+    if (!pool) {
+        return -1;
+    }
+
+    if (size < pool->size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (vioarr_quota_check(pool->client, VIOARR_QUOTA_MEMORY, size - pool->size)) {
+        return -1;
+    }
+
+    previousSize = pool->size;
+    if (__map_pool(pool, size)) {
+        return -1;
+    }
+    vioarr_quota_charge(pool->client, VIOARR_QUOTA_MEMORY, size - previousSize);
+    return 0;
+}
+
 uint32_t vioarr_memory_pool_id(vioarr_memory_pool_t* pool)
 {
     if (!pool) {
@@ -117,12 +491,12 @@ uint32_t vioarr_memory_pool_id(vioarr_memory_pool_t* pool)
     return pool->id;
 }
 
-key_t vioarr_memory_pool_handle(vioarr_memory_pool_t* pool)
+mhandle_t vioarr_memory_pool_handle(vioarr_memory_pool_t* pool)
 {
     if (!pool) {
         return 0;
     }
-    return pool->pool_key;
+    return pool->handle;
 }
 
 void* vioarr_memory_pool_data(vioarr_memory_pool_t* pool, int index, size_t size)
@@ -24,8 +24,10 @@
 
 #include "../vioarr_memory.h"
 #include "../vioarr_objects.h"
+#include "../vioarr_quota.h"
 #include <os/dmabuf.h>
 #include <os/mollenos.h>
+#include <errno.h>
 #include <stdlib.h>
 
 typedef struct vioarr_memory_pool {
@@ -35,6 +37,11 @@ typedef struct vioarr_memory_pool {
     struct dma_attachment attachment;
 } vioarr_memory_pool_t;
 
+int vioarr_memory_initialize(void)
+{
+    return 0;
+}
+
 int vioarr_memory_create_pool(int client, uint32_t id, UUId_t handle, size_t size, vioarr_memory_pool_t** poolOut)
 {
     vioarr_memory_pool_t*  pool;
@@ -55,6 +62,13 @@ int vioarr_memory_create_pool(int client, uint32_t id, UUId_t handle, size_t siz
         OsStatusToErrno(osStatus);
         return -1;
     }
+
+    // the entire buffer is mapped, regardless of the size the client asked for
+    if (vioarr_quota_check(client, VIOARR_QUOTA_MEMORY, pool->attachment.length)) {
+        dma_detach(&pool->attachment);
+        free(pool);
+        return -1;
+    }
     
     osStatus = dma_attachment_map(&pool->attachment, 0);
     if (osStatus != OsSuccess) {
@@ -67,6 +81,7 @@ int vioarr_memory_create_pool(int client, uint32_t id, UUId_t handle, size_t siz
     pool->client     = client;
     pool->id         = id;
     pool->references = ATOMIC_VAR_INIT(1);
+    vioarr_quota_charge(client, VIOARR_QUOTA_MEMORY, pool->attachment.length);
     
     *poolOut = pool;
     return 0;
@@ -98,6 +113,7 @@ int vioarr_memory_destroy_pool(vioarr_memory_pool_t* pool)
     references = atomic_fetch_sub(&pool->references, 1);
     if (references == 1) {
         vioarr_objects_remove_object(pool->client, pool->id);
+        vioarr_quota_release(pool->client, VIOARR_QUOTA_MEMORY, pool->attachment.length);
         dma_attachment_unmap(&pool->attachment);
         dma_detach(&pool->attachment);
         free(pool);
@@ -105,6 +121,15 @@ int vioarr_memory_destroy_pool(vioarr_memory_pool_t* pool)
     return 0;
 }
 
+int vioarr_memory_pool_resize(vioarr_memory_pool_t* pool, size_t size)
+{
+    // dma buffers are created with a fixed capacity
+    (void)pool;
+    (void)size;
+    errno = ENOTSUP;
+    return -1;
+}
+
 uint32_t vioarr_memory_pool_id(vioarr_memory_pool_t* pool)
 {
     if (!pool) {
@@ -134,7 +134,7 @@ vioarr_screen_t* vioarr_screen_create(video_output_t* video)
     screen->backbuffer_size = video->Width * video->Height * 4;
     screen->backbuffer      = aligned_alloc(32, screen->backbuffer_size);
     if (!screen->backbuffer) {
-        free(screen->dimensions);
+        vioarr_region_destroy(screen->dimensions);
         free(screen);
         return NULL;
     }
@@ -169,7 +169,7 @@ vioarr_screen_t* vioarr_screen_create(video_output_t* video)
     vioarr_utils_trace(VISTR("[vioarr] [screen] [create] initializing renderer"));
     screen->renderer = vioarr_renderer_create(screen);
     if (!screen->renderer) {
-        free(screen->dimensions);
+        vioarr_region_destroy(screen->dimensions);
         free(screen->backbuffer);
         free(screen);
         return NULL;
@@ -0,0 +1,484 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#include <glad.h>
+#include <GL/osmesa.h>
+#include "../vioarr_cursor.h"
+#include "../vioarr_damage.h"
+#include "../vioarr_renderer.h"
+#include "../vioarr_screen.h"
+#include "../vioarr_utils.h"
+#include "../vioarr_objects.h"
+#include "vioarr_screen_formats.h"
+#include "wm_screen_service_server.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define FBDEV_SHM_PREFIX "shm:"
+
+/**
+ * The framebuffer screen renders through OSMesa into memory like the headless screen, and
+ * presents the damaged part of each frame into a memory mapped target. The target is either
+ * a framebuffer device (/dev/fb0), whose mode and format are used as is, or a plain file or
+ * shm segment (shm:<name>) which is sized from the configured mode.
+ */
+typedef struct vioarr_screen {
+    uint32_t                      id;
+    OSMesaContext                 context;
+    void*                         backbuffer;
+    size_t                        backbuffer_size;
+    const vioarr_screen_format_t* format;
+    int                           refresh_rate;
+    vioarr_region_t*              dimensions;
+    vioarr_renderer_t*            renderer;
+    vioarr_cursor_t*              cursor;
+
+    int                           fd;
+    uint8_t*                      framebuffer;
+    size_t                        framebuffer_size;
+    size_t                        visible_offset; // start of the visible area, devices can be panned
+    uint8_t*                      visible;
+    int                           stride;
+} vioarr_screen_t;
+
+static void __destroy_screen(vioarr_screen_t* screen)
+{
+    if (screen->context) {
+        OSMesaDestroyContext(screen->context);
+    }
+
+    if (screen->framebuffer) {
+        munmap(screen->framebuffer, screen->framebuffer_size);
+    }
+
+    if (screen->fd >= 0) {
+        close(screen->fd);
+    }
+
+    if (screen->dimensions) {
+        vioarr_region_destroy(screen->dimensions);
+    }
+    vioarr_cursor_destroy(screen->cursor);
+    free(screen->backbuffer);
+    free(screen);
+}
+
+static int __open_target(const char* device)
+{
+    int fd;
+
+    if (!strncmp(device, FBDEV_SHM_PREFIX, strlen(FBDEV_SHM_PREFIX))) {
+        return shm_open(device + strlen(FBDEV_SHM_PREFIX), O_RDWR | O_CREAT, 0644);
+    }
+
+    fd = open(device, O_RDWR);
+    if (fd < 0 && errno == ENOENT) {
+        fd = open(device, O_RDWR | O_CREAT, 0644);
+    }
+    return fd;
+}
+
+static int __setup_fbdev(vioarr_screen_t* screen, video_output_t* video)
+{
+    struct fb_var_screeninfo vinfo;
+    struct fb_fix_screeninfo finfo;
+    int                      positions[4];
+
+    if (ioctl(screen->fd, FBIOGET_VSCREENINFO, &vinfo) || ioctl(screen->fd, FBIOGET_FSCREENINFO, &finfo)) {
+        vioarr_utils_error(VISTR("[vioarr] [screen] [fbdev] failed to query %s, code %i"), video->device, errno);
+        return -1;
+    }
+
+    // framebuffers without an alpha channel still pad 32 bit pixels in the upper byte
+    positions[0] = (int)vinfo.red.offset;
+    positions[1] = (int)vinfo.green.offset;
+    positions[2] = (int)vinfo.blue.offset;
+    positions[3] = vinfo.transp.length ? (int)vinfo.transp.offset : (vinfo.bits_per_pixel == 32 ? 24 : 0);
+
+    screen->format = vioarr_screen_format_find((int)vinfo.bits_per_pixel, positions);
+    if (!screen->format) {
+        return -1;
+    }
+
+    // a console or the previous owner of the device may have left the display panned, so it is
+    // panned back to the start. Drivers that can't pan are presented at the offset instead.
+    if (vinfo.xoffset || vinfo.yoffset) {
+        vinfo.xoffset = 0;
+        vinfo.yoffset = 0;
+        if (ioctl(screen->fd, FBIOPAN_DISPLAY, &vinfo) && ioctl(screen->fd, FBIOGET_VSCREENINFO, &vinfo)) {
+            vioarr_utils_error(VISTR("[vioarr] [screen] [fbdev] failed to query %s, code %i"), video->device, errno);
+            return -1;
+        }
+    }
+
+    video->width             = (int)vinfo.xres;
+    video->height            = (int)vinfo.yres;
+    screen->stride           = (int)finfo.line_length;
+    screen->framebuffer_size = finfo.smem_len;
+    screen->visible_offset   = ((size_t)vinfo.yoffset * finfo.line_length) +
+        ((size_t)vinfo.xoffset * (vinfo.bits_per_pixel / 8));
+    if (screen->visible_offset + ((size_t)finfo.line_length * vinfo.yres) > screen->framebuffer_size) {
+        vioarr_utils_error(VISTR("[vioarr] [screen] [fbdev] visible area of %s is outside the framebuffer"), video->device);
+        return -1;
+    }
+    return 0;
+}
+
+static int __setup_file(vioarr_screen_t* screen, video_output_t* video)
+{
+    screen->format = vioarr_screen_format_by_name(video->format);
+    if (!screen->format) {
+        vioarr_utils_error(VISTR("[vioarr] [screen] [fbdev] unsupported format %s"),
+            video->format ? video->format : "(null)");
+        return -1;
+    }
+
+    screen->stride           = video->width * screen->format->bytes_per_pixel;
+    screen->framebuffer_size = (size_t)screen->stride * video->height;
+    if (ftruncate(screen->fd, (off_t)screen->framebuffer_size)) {
+        vioarr_utils_error(VISTR("[vioarr] [screen] [fbdev] failed to size %s, code %i"), video->device, errno);
+        return -1;
+    }
+    return 0;
+}
+
+static int __map_target(vioarr_screen_t* screen, video_output_t* video)
+{
+    struct stat st;
+    int         status;
+
+    screen->fd = __open_target(video->device);
+    if (screen->fd < 0) {
+        vioarr_utils_error(VISTR("[vioarr] [screen] [fbdev] failed to open %s, code %i"), video->device, errno);
+        return -1;
+    }
+
+    if (fstat(screen->fd, &st)) {
+        return -1;
+    }
+
+    status = S_ISCHR(st.st_mode) ? __setup_fbdev(screen, video) : __setup_file(screen, video);
+    if (status) {
+        return status;
+    }
+
+    screen->framebuffer = mmap(NULL, screen->framebuffer_size, PROT_READ | PROT_WRITE, MAP_SHARED, screen->fd, 0);
+    if (screen->framebuffer == MAP_FAILED) {
+        vioarr_utils_error(VISTR("[vioarr] [screen] [fbdev] failed to map %s, code %i"), video->device, errno);
+        screen->framebuffer = NULL;
+        return -1;
+    }
+    screen->visible = screen->framebuffer + screen->visible_offset;
+    return 0;
+}
+
+vioarr_screen_t* vioarr_screen_create(video_output_t* video)
+{
+    vioarr_screen_t* screen;
+    int attributes[100], n = 0;
+    int status;
+
+    if (!video || !video->device) {
+        return NULL;
+    }
+
+    screen = malloc(sizeof(vioarr_screen_t));
+    if (!screen) {
+        return NULL;
+    }
+    memset(screen, 0, sizeof(vioarr_screen_t));
+    screen->fd           = -1;
+    screen->refresh_rate = video->refresh_rate;
+
+    vioarr_utils_trace(VISTR("[vioarr] [screen] [create] mapping %s"), video->device);
+    if (__map_target(screen, video) || video->width <= 0 || video->height <= 0) {
+        __destroy_screen(screen);
+        return NULL;
+    }
+
+    attributes[n++] = OSMESA_FORMAT;
+    attributes[n++] = screen->format->osmesa_format;
+    attributes[n++] = OSMESA_DEPTH_BITS;
+    attributes[n++] = 24;
+    attributes[n++] = OSMESA_STENCIL_BITS;
+    attributes[n++] = 8;
+    attributes[n++] = OSMESA_ACCUM_BITS;
+    attributes[n++] = 0;
+    attributes[n++] = OSMESA_PROFILE;
+    attributes[n++] = OSMESA_CORE_PROFILE;
+    attributes[n++] = OSMESA_CONTEXT_MAJOR_VERSION;
+    attributes[n++] = 3;
+    attributes[n++] = OSMESA_CONTEXT_MINOR_VERSION;
+    attributes[n++] = 3;
+    attributes[n++] = 0;
+    
+    vioarr_utils_trace(VISTR("[vioarr] [screen] [create] creating os_mesa context, version 3.3"));
+    screen->context = OSMesaCreateContextAttribs(&attributes[0], NULL);
+    if (!screen->context) {
+        __destroy_screen(screen);
+        return NULL;
+    }
+    
+    vioarr_utils_trace(VISTR("[vioarr] [screen] [create] allocating screen resources"));
+    screen->dimensions = vioarr_region_create();
+    if (!screen->dimensions) {
+        __destroy_screen(screen);
+        return NULL;
+    }
+    vioarr_region_add(screen->dimensions, video->x, video->y, video->width, video->height);
+    
+    // aligned_alloc requires the size to be a multiple of the alignment
+    screen->backbuffer_size = (size_t)video->width * video->height * screen->format->bytes_per_pixel;
+    screen->backbuffer_size = (screen->backbuffer_size + 31) & ~(size_t)31;
+    screen->backbuffer      = aligned_alloc(32, screen->backbuffer_size);
+    if (!screen->backbuffer) {
+        __destroy_screen(screen);
+        return NULL;
+    }
+    
+    status = OSMesaMakeCurrent(screen->context, screen->backbuffer, screen->format->gl_type,
+        video->width, video->height);
+    if (status == GL_FALSE) {
+        vioarr_utils_error(VISTR("[vioarr] [screen] [create] failed to set the os_mesa context"));
+        __destroy_screen(screen);
+        return NULL;
+    }
+    
+    vioarr_utils_trace(VISTR("[vioarr] [screen] [create] loading gl extensions"));
+    status = gladLoadGLLoader((GLADloadproc)OSMesaGetProcAddress, 3, 3);
+    if (!status) {
+        vioarr_utils_error(VISTR("[vioarr] [screen] [create] failed to load gl extensions, code %i"), status);
+        __destroy_screen(screen);
+        return NULL;
+    }
+    
+    vioarr_utils_trace(VISTR("[vioarr] [screen] [create] initializing renderer"));
+    screen->renderer = vioarr_renderer_create(screen, video->width, video->height,
+        vioarr_screen_format_renderer_flags(screen->format));
+    if (!screen->renderer) {
+        __destroy_screen(screen);
+        return NULL;
+    }
+
+    // the backbuffer keeps the composed frame, so the cursor is blended on present instead
+    // and moving it does not require the frame to be rendered again
+    screen->cursor = vioarr_cursor_create(screen->format);
+    vioarr_renderer_set_cursor_plane(screen->renderer, screen->cursor);
+    
+    vioarr_utils_trace(VISTR("[vioarr] [screen] [create] framebuffer screen %ix%i (%s), stride %i"),
+        video->width, video->height, screen->format->text, screen->stride);
+    screen->id = vioarr_objects_create_server_object(screen, WM_OBJECT_TYPE_SCREEN);
+    return screen;
+}
+
+void vioarr_screen_set_scale(vioarr_screen_t* screen, int scale)
+{
+    if (!screen) {
+        return;
+    }
+    vioarr_renderer_set_scale(screen->renderer, scale);
+}
+
+void vioarr_screen_set_transform(vioarr_screen_t* screen, enum wm_transform transform)
+{
+    // do nothing
+}
+
+vioarr_region_t* vioarr_screen_region(vioarr_screen_t* screen)
+{
+    if (!screen) {
+        return NULL;
+    }
+    return screen->dimensions;
+}
+
+int vioarr_screen_scale(vioarr_screen_t* screen)
+{
+    if (!screen) {
+        return 1;
+    }
+    return vioarr_renderer_scale(screen->renderer);
+}
+
+enum wm_transform vioarr_screen_transform(vioarr_screen_t* screen)
+{
+    return WM_TRANSFORM_NO_TRANSFORM;
+}
+
+vioarr_renderer_t* vioarr_screen_renderer(vioarr_screen_t* screen)
+{
+    if (!screen) {
+        return NULL;
+    }
+    return screen->renderer;
+}
+
+int vioarr_screen_publish_modes(vioarr_screen_t* screen, int client)
+{
+    if (!screen) {
+        return -1;
+    }
+    
+    return wm_screen_event_mode_single(vioarr_get_server_handle(), client, screen->id,
+        WM_MODE_ATTRIBUTES_CURRENT | WM_MODE_ATTRIBUTES_PREFERRED,
+        vioarr_region_width(screen->dimensions),
+        vioarr_region_height(screen->dimensions), screen->refresh_rate);
+}
+
+int vioarr_screen_refresh_rate(vioarr_screen_t* screen)
+{
+    if (!screen) {
+        return 0;
+    }
+    return screen->refresh_rate;
+}
+
+int vioarr_screen_make_current(vioarr_screen_t* screen, int current)
+{
+    GLboolean status;
+
+    if (!screen) {
+        return -1;
+    }
+
+    if (current) {
+        status = OSMesaMakeCurrent(screen->context, screen->backbuffer, screen->format->gl_type,
+            vioarr_region_width(screen->dimensions), vioarr_region_height(screen->dimensions));
+    }
+    else {
+        status = OSMesaMakeCurrent(NULL, NULL, 0, 0, 0);
+    }
+    return status == GL_FALSE ? -1 : 0;
+}
+
+int vioarr_screen_valid(vioarr_screen_t* screen)
+{
+    return screen != NULL;
+}
+
+/**
+ * Copies a single row span into the framebuffer. Framebuffer memory is usually mapped write
+ * combined, so the bulk of the span is written with non-temporal stores that do not pollute
+ * the cache, which requires the destination to be 16 byte aligned.
+ */
+static inline void __copy_span(uint8_t* destination, const uint8_t* source, size_t length)
+{
+#if defined(__SSE2__)
+    size_t head = (16 - ((uintptr_t)destination & 15)) & 15;
+    if (head > length) {
+        head = length;
+    }
+
+    memcpy(destination, source, head);
+    destination += head;
+    source      += head;
+    length      -= head;
+
+    while (length >= 64) {
+        __m128i r0 = _mm_loadu_si128((const __m128i*)(source + 0));
+        __m128i r1 = _mm_loadu_si128((const __m128i*)(source + 16));
+        __m128i r2 = _mm_loadu_si128((const __m128i*)(source + 32));
+        __m128i r3 = _mm_loadu_si128((const __m128i*)(source + 48));
+        _mm_stream_si128((__m128i*)(destination + 0), r0);
+        _mm_stream_si128((__m128i*)(destination + 16), r1);
+        _mm_stream_si128((__m128i*)(destination + 32), r2);
+        _mm_stream_si128((__m128i*)(destination + 48), r3);
+        destination += 64;
+        source      += 64;
+        length      -= 64;
+    }
+
+    while (length >= 16) {
+        _mm_stream_si128((__m128i*)destination, _mm_loadu_si128((const __m128i*)source));
+        destination += 16;
+        source      += 16;
+        length      -= 16;
+    }
+#endif
+    memcpy(destination, source, length);
+}
+
+static void __present(vioarr_screen_t* screen, vioarr_drawlist_rect_t* damage)
+{
+    int      height       = vioarr_region_height(screen->dimensions);
+    int      bpp          = screen->format->bytes_per_pixel;
+    size_t   sourceStride = (size_t)vioarr_region_width(screen->dimensions) * bpp;
+    size_t   length       = (size_t)damage->width * bpp;
+    int      y;
+
+    // the backbuffer is rendered bottom up, so the rows are flipped while copying
+    for (y = damage->y; y < damage->y + damage->height; y++) {
+        const uint8_t* source      = (const uint8_t*)screen->backbuffer + ((size_t)(height - 1 - y) * sourceStride) +
+            ((size_t)damage->x * bpp);
+        uint8_t*       destination = screen->visible + ((size_t)y * screen->stride) + ((size_t)damage->x * bpp);
+        __copy_span(destination, source, length);
+    }
+
+#if defined(__SSE2__)
+    _mm_sfence();
+#endif
+}
+
+void vioarr_screen_frame(vioarr_screen_t* screen)
+{
+    vioarr_drawlist_rect_t damage;
+    vioarr_damage_t        rects;
+    int                    damaged;
+    int                    cursor;
+    int                    i;
+
+    vioarr_renderer_render(screen->renderer);
+    glFinish();
+    vioarr_renderer_finished(screen->renderer);
+
+    // the cursor is taken off the framebuffer before the damage is copied over it, and is
+    // then blended on top of the new content
+    damaged = vioarr_renderer_damage(screen->renderer, &damage);
+    cursor  = vioarr_cursor_begin(screen->cursor, screen->visible, screen->stride, damaged ? &damage : NULL);
+    if (damaged) {
+        // separate changes are copied on their own, so the area between them is left alone
+        vioarr_renderer_damage_rects(screen->renderer, &rects);
+        for (i = 0; i < rects.count; i++) {
+            __present(screen, &rects.rects[i]);
+        }
+    }
+
+    if (cursor) {
+        vioarr_cursor_end(screen->cursor, screen->visible, screen->stride,
+            vioarr_region_width(screen->dimensions), vioarr_region_height(screen->dimensions));
+    }
+}
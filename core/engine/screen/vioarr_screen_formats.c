@@ -0,0 +1,103 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#include <glad.h>
+#include <GL/osmesa.h>
+#include "vioarr_screen_formats.h"
+#include "../vioarr_renderer.h"
+#include "../vioarr_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const vioarr_screen_format_t g_supportedFormats[] = {
+     // R,  G,  B,  A     //R, G, B, A    // FORMAT [Reversed]
+    { {  0,  8, 16, 24 }, { 8, 8, 8, 8 }, OSMESA_RGBA,    GL_UNSIGNED_BYTE,          4, "ABGR" },
+    { {  8, 16, 24,  0 }, { 8, 8, 8, 8 }, OSMESA_ARGB,    GL_UNSIGNED_BYTE,          4, "BGRA" },
+    { { 16,  8,  0, 24 }, { 8, 8, 8, 8 }, OSMESA_BGRA,    GL_UNSIGNED_BYTE,          4, "ARGB" },
+    { { 16,  8,  0,  0 }, { 8, 8, 8, 0 }, OSMESA_BGR,     GL_UNSIGNED_BYTE,          3, "RGB" },
+    { {  0,  8, 16,  0 }, { 8, 8, 8, 0 }, OSMESA_RGB,     GL_UNSIGNED_BYTE,          3, "BGR" },
+    { {  0,  5, 11,  0 }, { 5, 6, 5, 0 }, OSMESA_RGB_565, GL_UNSIGNED_SHORT_5_6_5,   2, "BGR_565" },
+    { { 0 }, { 0 }, 0, 0, 0, NULL }
+};
+
+const vioarr_screen_format_t* vioarr_screen_format_find(int depth, const int colorPositions[4])
+{
+    int i = 0;
+
+    while (g_supportedFormats[i].text) {
+        const vioarr_screen_format_t* format = &g_supportedFormats[i];
+        int formatDepth = format->color_bits[0] + format->color_bits[1] +
+            format->color_bits[2] + format->color_bits[3];
+
+        if (depth == formatDepth &&
+            colorPositions[0] == format->color_positions[0] &&
+            colorPositions[1] == format->color_positions[1] &&
+            colorPositions[2] == format->color_positions[2] &&
+            colorPositions[3] == format->color_positions[3]) {
+            vioarr_utils_trace(VISTR("[vioarr_screen_format_find] found supported format %s"), format->text);
+            return format;
+        }
+        i++;
+    }
+
+    vioarr_utils_error(VISTR("[vioarr_screen_format_find] %i [%i,%i,%i,%i] UNSUPPORTED FORMAT"),
+        depth, colorPositions[0], colorPositions[1], colorPositions[2], colorPositions[3]);
+    return NULL;
+}
+
+const vioarr_screen_format_t* vioarr_screen_format_by_name(const char* text)
+{
+    int i = 0;
+
+    if (!text) {
+        return NULL;
+    }
+
+    while (g_supportedFormats[i].text) {
+        if (!strcmp(g_supportedFormats[i].text, text)) {
+            return &g_supportedFormats[i];
+        }
+        i++;
+    }
+    return NULL;
+}
+
+/**
+ * Formats with less than 8 bits per color channel band visibly on gradients and shadows, so
+ * they are rendered with ordered dithering unless VIOARR_DITHER is set to 0.
+ */
+unsigned int vioarr_screen_format_renderer_flags(const vioarr_screen_format_t* format)
+{
+    const char* dither = getenv("VIOARR_DITHER");
+
+    if (!format || (dither && !strcmp(dither, "0"))) {
+        return 0;
+    }
+
+    if (format->color_bits[0] < 8 || format->color_bits[1] < 8 || format->color_bits[2] < 8) {
+        return VIOARR_RENDERER_DITHER;
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#ifndef __VIOARR_SCREEN_FORMATS_H__
+#define __VIOARR_SCREEN_FORMATS_H__
+
+/**
+ * Describes a framebuffer pixel layout the compositor can render into through OSMesa.
+ * Positions and bits are listed as R, G, B, A where the alpha entries describe the
+ * reserved channel. The text is the reversed (little endian) name of the layout.
+ */
+typedef struct vioarr_screen_format {
+    int         color_positions[4];
+    int         color_bits[4];
+    int         osmesa_format;
+    int         gl_type;
+    int         bytes_per_pixel;
+    const char* text;
+} vioarr_screen_format_t;
+
+const vioarr_screen_format_t* vioarr_screen_format_find(int depth, const int colorPositions[4]);
+const vioarr_screen_format_t* vioarr_screen_format_by_name(const char* text);
+unsigned int                  vioarr_screen_format_renderer_flags(const vioarr_screen_format_t* format);
+
+#endif //!__VIOARR_SCREEN_FORMATS_H__
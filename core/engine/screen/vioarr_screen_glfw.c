@@ -30,12 +30,14 @@
 
 #include <glad.h>
 #include <GLFW/glfw3.h>
+#include "../vioarr_engine.h"
 #include "../vioarr_input.h"
 #include "../vioarr_renderer.h"
 #include "../vioarr_screen.h"
 #include "../vioarr_utils.h"
 #include "../vioarr_objects.h"
 #include "wm_screen_service_server.h"
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <keycodes.h>
 
@@ -51,6 +53,8 @@ typedef struct vioarr_screen {
     double             last_y;
 } vioarr_screen_t;
 
+static atomic_int g_inputRegistered = 0;
+
 // callbacks
 static void glfw_mouse_callback(GLFWwindow* window, double xpos, double ypos);
 static void glfw_scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
@@ -62,6 +66,7 @@ vioarr_screen_t* vioarr_screen_create(video_output_t* video)
     vioarr_screen_t*   screen;
     int                status;
     int                windowWidth, windowHeight, fbWidth, fbHeight;
+    int                monitorX, monitorY;
     const GLFWvidmode* currentMode;
 
     screen = malloc(sizeof(vioarr_screen_t));
@@ -93,8 +98,10 @@ vioarr_screen_t* vioarr_screen_create(video_output_t* video)
     
     glfwGetWindowSize(screen->context, &windowWidth, &windowHeight);
     glfwGetFramebufferSize(screen->context, &fbWidth, &fbHeight);
-    vioarr_utils_trace(VISTR("[vioarr] [screen] [create] screen [%i, %i]"), windowWidth, windowHeight);
-    vioarr_region_add(screen->dimensions, 0, 0, windowWidth, windowHeight);
+    glfwGetMonitorPos(video, &monitorX, &monitorY);
+    vioarr_utils_trace(VISTR("[vioarr] [screen] [create] screen [%i, %i] at [%i, %i]"),
+        windowWidth, windowHeight, monitorX, monitorY);
+    vioarr_region_add(screen->dimensions, monitorX, monitorY, windowWidth, windowHeight);
     
     glfwSetWindowUserPointer(screen->context, screen);
     glfwSetCursorPosCallback(screen->context, glfw_mouse_callback);
@@ -116,7 +123,7 @@ vioarr_screen_t* vioarr_screen_create(video_output_t* video)
     }
     
     vioarr_utils_trace(VISTR("[vioarr] [screen] [create] initializing renderer"));
-    screen->renderer = vioarr_renderer_create(screen, fbWidth, fbHeight);
+    screen->renderer = vioarr_renderer_create(screen, fbWidth, fbHeight, 0);
     if (!screen->renderer) {
         goto error;
     }
@@ -125,9 +132,11 @@ vioarr_screen_t* vioarr_screen_create(video_output_t* video)
     screen->first_mouse = 1;
     screen->monitor = video;
 
-    // create the default mouse and keyboard objects
-    vioarr_input_register(1, VIOARR_INPUT_POINTER);
-    vioarr_input_register(2, VIOARR_INPUT_KEYBOARD);
+    // create the default mouse and keyboard objects, they are shared by all screens
+    if (!atomic_exchange(&g_inputRegistered, 1)) {
+        vioarr_input_register(1, VIOARR_INPUT_POINTER);
+        vioarr_input_register(2, VIOARR_INPUT_KEYBOARD);
+    }
 
     return screen;
 
@@ -137,7 +146,7 @@ error:
     }
 
     if (screen->dimensions) {
-        free(screen->dimensions);
+        vioarr_region_destroy(screen->dimensions);
     }
 
     if (screen) {
@@ -239,6 +248,32 @@ int vioarr_screen_publish_modes(vioarr_screen_t* screen, int client)
     return 0;
 }
 
+int vioarr_screen_refresh_rate(vioarr_screen_t* screen)
+{
+    const GLFWvidmode* currentMode;
+
+    if (!screen) {
+        return 0;
+    }
+
+    currentMode = glfwGetVideoMode(screen->monitor);
+    return currentMode ? currentMode->refreshRate : ENGINE_SCREEN_REFRESH_HZ;
+}
+
+/**
+ * Each screen is rendered by its own thread, and a GL context can only be current on
+ * one thread at a time.
+ */
+int vioarr_screen_make_current(vioarr_screen_t* screen, int current)
+{
+    if (!screen) {
+        return -1;
+    }
+
+    glfwMakeContextCurrent(current ? screen->context : NULL);
+    return 0;
+}
+
 int vioarr_screen_valid(vioarr_screen_t* screen)
 {
     return screen != NULL && glfwWindowShouldClose(screen->context) == 0;
@@ -267,13 +302,13 @@ static void glfw_mouse_callback(GLFWwindow* window, double xpos, double ypos)
     screen->last_x = xpos;
     screen->last_y = ypos;
 
-    vioarr_input_axis_event(1, (int)xoffset, (int)yoffset);    
+    vioarr_input_axis_event(1, (int)xoffset, (int)yoffset, vioarr_utils_time_us());
 }
 
 static void glfw_scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     (void)window;
-    vioarr_input_scroll_event(1, (int)xoffset, (int)yoffset);
+    vioarr_input_scroll_event(1, (int)xoffset, (int)yoffset, vioarr_utils_time_us());
 }
 
 /**
@@ -408,7 +443,8 @@ static void glfw_mouse_key_callback(GLFWwindow* window, int button, int action,
     vioarr_input_button_event(1, 
         asgaardMButtonCodes[button], 
         convertModifiersToAsgaard(action, mods),
-        action == GLFW_RELEASE ? 0 : 1
+        action == GLFW_RELEASE ? 0 : 1,
+        vioarr_utils_time_us()
     );
 }
 
@@ -419,6 +455,7 @@ static void glfw_key_callback(GLFWwindow* window, int key, int scancode, int act
     vioarr_input_button_event(2, 
         asgaardKeyCodes[key], 
         convertModifiersToAsgaard(action, mods), 
-        action == GLFW_RELEASE ? 0 : 1
+        action == GLFW_RELEASE ? 0 : 1,
+        vioarr_utils_time_us()
     );
 }
@@ -16,50 +16,81 @@
  * along with this program.If not, see <http://www.gnu.org/licenses/>.
  *
  *
+ *
  * Vioarr - Vali Compositor
  * - Implements the default system compositor for Vali. It utilizies the gracht library
  *   for communication between compositor clients and the server. The server renders
  *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
  */
 
-#include <ddk/video.h>
-#include <glad/glad.h>
+#include <glad.h>
 #include <GL/osmesa.h>
 #include "../vioarr_renderer.h"
 #include "../vioarr_screen.h"
 #include "../vioarr_utils.h"
 #include "../vioarr_objects.h"
-#include "../../protocols/wm_screen_protocol_server.h"
+#include "vioarr_screen_formats.h"
+#include "wm_screen_service_server.h"
 #include <stdlib.h>
+#include <string.h>
 
-// Define a screen at 640*320*32 for headless environment
-#define SCREEN_DEPTH  32
-#define SCREEN_WIDTH  640
-#define SCREEN_HEIGHT 320
-
+/**
+ * The headless screen renders into memory through OSMesa without any display attached,
+ * which allows the compositor to run without a window system. The resolution, format
+ * and refresh rate are provided at runtime by the engine.
+ */
 typedef struct vioarr_screen {
-    uint32_t           id;
-    OSMesaContext      context;
-    void*              backbuffer;
-    size_t             backbuffer_size;
-    int                depth_bits;
-    vioarr_region_t*   dimensions;
-    vioarr_renderer_t* renderer;
+    uint32_t                      id;
+    OSMesaContext                 context;
+    void*                         backbuffer;
+    size_t                        backbuffer_size;
+    const vioarr_screen_format_t* format;
+    int                           refresh_rate;
+    vioarr_region_t*              dimensions;
+    vioarr_renderer_t*            renderer;
 } vioarr_screen_t;
 
+static void __destroy_screen(vioarr_screen_t* screen)
+{
+    if (screen->context) {
+        OSMesaDestroyContext(screen->context);
+    }
+
+    if (screen->dimensions) {
+        vioarr_region_destroy(screen->dimensions);
+    }
+    free(screen->backbuffer);
+    free(screen);
+}
+
 vioarr_screen_t* vioarr_screen_create(video_output_t* video)
 {
     vioarr_screen_t* screen;
     int attributes[100], n = 0;
     int status;
-    
+
+    if (!video || video->width <= 0 || video->height <= 0) {
+        vioarr_utils_error(VISTR("[vioarr] [screen] [create] invalid headless mode"));
+        return NULL;
+    }
+
     screen = malloc(sizeof(vioarr_screen_t));
     if (!screen) {
         return NULL;
     }
+    memset(screen, 0, sizeof(vioarr_screen_t));
+
+    screen->format = vioarr_screen_format_by_name(video->format);
+    if (!screen->format) {
+        vioarr_utils_error(VISTR("[vioarr] [screen] [create] unsupported headless format %s"),
+            video->format ? video->format : "(null)");
+        free(screen);
+        return NULL;
+    }
+    screen->refresh_rate = video->refresh_rate;
 
     attributes[n++] = OSMESA_FORMAT;
-    attributes[n++] = OSMESA_RGBA;
+    attributes[n++] = screen->format->osmesa_format;
     attributes[n++] = OSMESA_DEPTH_BITS;
     attributes[n++] = 24;
     attributes[n++] = OSMESA_STENCIL_BITS;
@@ -77,68 +108,66 @@ vioarr_screen_t* vioarr_screen_create(video_output_t* video)
     vioarr_utils_trace(VISTR("[vioarr] [screen] [create] creating os_mesa context, version 3.3"));
     screen->context = OSMesaCreateContextAttribs(&attributes[0], NULL);
     if (!screen->context) {
-        free(screen);
+        __destroy_screen(screen);
         return NULL;
     }
     
     vioarr_utils_trace(VISTR("[vioarr] [screen] [create] allocating screen resources"));
     screen->dimensions = vioarr_region_create();
     if (!screen->dimensions) {
-        OSMesaDestroyContext(screen->context);
-        free(screen);
+        __destroy_screen(screen);
         return NULL;
     }
+    vioarr_region_add(screen->dimensions, video->x, video->y, video->width, video->height);
     
-    screen->depth_bits = SCREEN_DEPTH;
-    vioarr_region_add(screen->dimensions, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-    
-    screen->backbuffer_size = SCREEN_WIDTH * SCREEN_HEIGHT * 4 * sizeof(GLubyte);
+    // aligned_alloc requires the size to be a multiple of the alignment
+    screen->backbuffer_size = (size_t)video->width * video->height * screen->format->bytes_per_pixel;
+    screen->backbuffer_size = (screen->backbuffer_size + 31) & ~(size_t)31;
     screen->backbuffer      = aligned_alloc(32, screen->backbuffer_size);
     if (!screen->backbuffer) {
-        OSMesaDestroyContext(screen->context);
-        free(screen->dimensions);
-        free(screen);
+        __destroy_screen(screen);
         return NULL;
     }
     
-    status = OSMesaMakeCurrent(screen->context, screen->backbuffer, GL_UNSIGNED_BYTE,
-        SCREEN_WIDTH, SCREEN_HEIGHT);
+    status = OSMesaMakeCurrent(screen->context, screen->backbuffer, screen->format->gl_type,
+        video->width, video->height);
     if (status == GL_FALSE) {
-        vioarr_utils_error(VISTR("[vioarr] [initialize] failed to set the os_mesa context"));
-        OSMesaDestroyContext(screen->context);
-        free(screen);
+        vioarr_utils_error(VISTR("[vioarr] [screen] [create] failed to set the os_mesa context"));
+        __destroy_screen(screen);
         return NULL;
     }
     
     vioarr_utils_trace(VISTR("[vioarr] [screen] [create] loading gl extensions"));
     status = gladLoadGLLoader((GLADloadproc)OSMesaGetProcAddress, 3, 3);
     if (!status) {
-        OSMesaDestroyContext(screen->context);
-        free(screen);
-        vioarr_utils_error(VISTR("[vioarr] [initialize] failed to load gl extensions, code %i"), status);
+        vioarr_utils_error(VISTR("[vioarr] [screen] [create] failed to load gl extensions, code %i"), status);
+        __destroy_screen(screen);
         return NULL;
     }
     
     vioarr_utils_trace(VISTR("[vioarr] [screen] [create] initializing renderer"));
-    screen->renderer = vioarr_renderer_create(screen);
+    screen->renderer = vioarr_renderer_create(screen, video->width, video->height,
+        vioarr_screen_format_renderer_flags(screen->format));
     if (!screen->renderer) {
-        OSMesaDestroyContext(screen->context);
-        free(screen->backbuffer);
-        free(screen->dimensions);
-        free(screen);
+        __destroy_screen(screen);
         return NULL;
     }
     
-    screen->id = vioarr_objects_create_server_object(screen, object_type_screen);
+    vioarr_utils_trace(VISTR("[vioarr] [screen] [create] headless screen %ix%i@%i (%s)"),
+        video->width, video->height, video->refresh_rate, screen->format->text);
+    screen->id = vioarr_objects_create_server_object(screen, WM_OBJECT_TYPE_SCREEN);
     return screen;
 }
 
 void vioarr_screen_set_scale(vioarr_screen_t* screen, int scale)
 {
-    // do nothing
+    if (!screen) {
+        return;
+    }
+    vioarr_renderer_set_scale(screen->renderer, scale);
 }
 
-void vioarr_screen_set_transform(vioarr_screen_t* screen, enum wm_screen_transform transform)
+void vioarr_screen_set_transform(vioarr_screen_t* screen, enum wm_transform transform)
 {
     // do nothing
 }
@@ -156,12 +185,12 @@ int vioarr_screen_scale(vioarr_screen_t* screen)
     if (!screen) {
         return 1;
     }
-    return 1;
+    return vioarr_renderer_scale(screen->renderer);
 }
 
-enum wm_screen_transform vioarr_screen_transform(vioarr_screen_t* screen)
+enum wm_transform vioarr_screen_transform(vioarr_screen_t* screen)
 {
-    return no_transform;
+    return WM_TRANSFORM_NO_TRANSFORM;
 }
 
 vioarr_renderer_t* vioarr_screen_renderer(vioarr_screen_t* screen)
@@ -178,13 +207,52 @@ int vioarr_screen_publish_modes(vioarr_screen_t* screen, int client)
         return -1;
     }
     
-    // One hardcoded format
-    return wm_screen_event_mode_single(client, screen->id, mode_current | mode_preferred,
-        SCREEN_WIDTH, SCREEN_HEIGHT, 60);
+    // the mode is fixed for the lifetime of the screen
+    return wm_screen_event_mode_single(vioarr_get_server_handle(), client, screen->id,
+        WM_MODE_ATTRIBUTES_CURRENT | WM_MODE_ATTRIBUTES_PREFERRED,
+        vioarr_region_width(screen->dimensions),
+        vioarr_region_height(screen->dimensions), screen->refresh_rate);
+}
+
+int vioarr_screen_refresh_rate(vioarr_screen_t* screen)
+{
+    if (!screen) {
+        return 0;
+    }
+    return screen->refresh_rate;
+}
+
+/**
+ * Each screen is rendered by its own thread, and the context can only be current on
+ * one thread at a time.
+ */
+int vioarr_screen_make_current(vioarr_screen_t* screen, int current)
+{
+    GLboolean status;
+
+    if (!screen) {
+        return -1;
+    }
+
+    if (current) {
+        status = OSMesaMakeCurrent(screen->context, screen->backbuffer, screen->format->gl_type,
+            vioarr_region_width(screen->dimensions), vioarr_region_height(screen->dimensions));
+    }
+    else {
+        status = OSMesaMakeCurrent(NULL, NULL, 0, 0, 0);
+    }
+    return status == GL_FALSE ? -1 : 0;
+}
+
+int vioarr_screen_valid(vioarr_screen_t* screen)
+{
+    return screen != NULL;
 }
 
 void vioarr_screen_frame(vioarr_screen_t* screen)
 {
     vioarr_renderer_render(screen->renderer);
-    // no present logic in headless
+    glFinish();
+    vioarr_renderer_finished(screen->renderer);
+    // no present logic in headless, the frame stays in the backbuffer
 }
@@ -27,10 +27,12 @@
 #include <ddk/video.h>
 #include <glad.h>
 #include <GL/osmesa.h>
+#include "../vioarr_engine.h"
 #include "../vioarr_renderer.h"
 #include "../vioarr_screen.h"
 #include "../vioarr_utils.h"
 #include "../vioarr_objects.h"
+#include "vioarr_screen_formats.h"
 #include "wm_screen_service_server.h"
 #include <stdlib.h>
 
@@ -53,61 +55,29 @@ void present_sse(  void* framebuffer, void* backbuffer, int rows, int rowLoops,
 void present_sse2( void* framebuffer, void* backbuffer, int rows, int rowLoops, int rowRemaining, int bytesPerScanline);
 
 typedef struct vioarr_screen {
-    uint32_t           id;
-    OSMesaContext      context;
-    void*              backbuffer;
-    size_t             backbuffer_size;
-    void*              framebuffer;
-    void*              framebuffer_end;
-    vioarr_region_t*   dimensions;
-    int                depth_bits;
-    int                stride;
-    vioarr_renderer_t* renderer;
+    uint32_t                      id;
+    const vioarr_screen_format_t* format;
+    OSMesaContext                 context;
+    void*                         backbuffer;
+    size_t                        backbuffer_size;
+    void*                         framebuffer;
+    void*                         framebuffer_end;
+    vioarr_region_t*              dimensions;
+    int                           depth_bits;
+    int                           stride;
+    vioarr_renderer_t*            renderer;
     
-    int                row_loops;
-    int                bytes_remaining;
-    void              (*present)(void*, void*, int, int, int, int);
+    int                           row_loops;
+    int                           bytes_remaining;
+    void                         (*present)(void*, void*, int, int, int, int);
 } vioarr_screen_t;
 
-static struct vioarr_screen_format {
-    int   color_positions[4];
-    int   color_bits[4];
-    int   osmesa_format;
-    char* text;
-} supportedFormats[] = {
-     // R,  G,  B,  A     //R, G, B, A    // FORMAT [Reversed]
-    { {  0,  8, 16, 24 }, { 8, 8, 8, 8 }, OSMESA_RGBA, "ABGR" },
-    { {  8, 16, 24,  0 }, { 8, 8, 8, 8 }, OSMESA_ARGB, "BGRA" },
-    { { 16,  8,  0, 24 }, { 8, 8, 8, 8 }, OSMESA_BGRA, "ARGB" },
-    { { 16,  8,  0,  0 }, { 8, 8, 8, 8 }, OSMESA_BGR, "RGB" },
-    { {  0,  8, 16,  0 }, { 5, 6, 5, 0 }, OSMESA_RGB, "BGR" },
-    { {  0,  5, 11,  0 }, { 5, 6, 5, 0 }, OSMESA_RGB_565, "BGR_565" },
-    { { 0 }, { 0 }, 0, NULL }
-};
-
-static int get_screen_format(video_output_t* video)
+static const vioarr_screen_format_t* get_screen_format(video_output_t* video)
 {
-    int i = 0;
-
-    while (supportedFormats[i].text) {
-        int depth = supportedFormats[i].color_bits[0] + supportedFormats[i].color_bits[1] +
-            supportedFormats[i].color_bits[2] + supportedFormats[i].color_bits[3];
-
-        if (video->Depth == depth) {
-            if (video->RedPosition      == supportedFormats[i].color_positions[0] &&
-                video->GreenPosition    == supportedFormats[i].color_positions[1] &&
-                video->BluePosition     == supportedFormats[i].color_positions[2] &&
-                video->ReservedPosition == supportedFormats[i].color_positions[3]) {
-                WARNING("[get_screen_format] found supported format %s", supportedFormats[i].text);
-                return supportedFormats[i].osmesa_format;
-            }
-        }
-
-        i++;
-    }
-
-    ERROR("[get_screen_format] %i [%i,%i,%i,%i] [0x%x,0x%x,0x%x,0x%x] UNSUPPORTED FORMAT");
-    return -1;
+    int positions[4] = {
+        video->RedPosition, video->GreenPosition, video->BluePosition, video->ReservedPosition
+    };
+    return vioarr_screen_format_find(video->Depth, positions);
 }
 
 vioarr_screen_t* vioarr_screen_create(video_output_t* video)
@@ -119,8 +89,8 @@ vioarr_screen_t* vioarr_screen_create(video_output_t* video)
     int status;
     int bytes_to_copy;
     int bytes_step;
-    int format = get_screen_format(video);
-    if (format < 0) {
+    const vioarr_screen_format_t* format = get_screen_format(video);
+    if (!format) {
         return NULL;
     }
 
@@ -129,8 +99,11 @@ vioarr_screen_t* vioarr_screen_create(video_output_t* video)
         return NULL;
     }
 
+    // the backbuffer is rendered in the format of the framebuffer, so 16 bit displays
+    // are composed and presented at 16 bit without any conversion
+    screen->format  = format;
     attributes[n++] = OSMESA_FORMAT;
-    attributes[n++] = format;
+    attributes[n++] = format->osmesa_format;
     attributes[n++] = OSMESA_DEPTH_BITS;
     attributes[n++] = 24;
     attributes[n++] = OSMESA_STENCIL_BITS;
@@ -164,11 +137,11 @@ vioarr_screen_t* vioarr_screen_create(video_output_t* video)
     screen->stride     = video->BytesPerScanline;
     vioarr_region_add(screen->dimensions, 0, 0, video->Width, video->Height);
     
-    screen->backbuffer_size = video->Width * video->Height * 4 * sizeof(GLubyte);
+    screen->backbuffer_size = video->Width * video->Height * format->bytes_per_pixel;
     screen->backbuffer      = aligned_alloc(32, screen->backbuffer_size);
     if (!screen->backbuffer) {
         OSMesaDestroyContext(screen->context);
-        free(screen->dimensions);
+        vioarr_region_destroy(screen->dimensions);
         free(screen);
         return NULL;
     }
@@ -177,12 +150,12 @@ vioarr_screen_t* vioarr_screen_create(video_output_t* video)
     screen->framebuffer_end = ((char*)screen->framebuffer + (video->BytesPerScanline * (video->Height - 1)));
     
     // Set the newly created context as current for now. We must have one pretty quickly
-    status = OSMesaMakeCurrent(screen->context, screen->backbuffer, GL_UNSIGNED_BYTE,
+    status = OSMesaMakeCurrent(screen->context, screen->backbuffer, format->gl_type,
         video->Width, video->Height);
     if (status == GL_FALSE) {
         vioarr_utils_error(VISTR("[vioarr] [initialize] failed to set the os_mesa context"));
         OSMesaDestroyContext(screen->context);
-        free(screen->dimensions);
+        vioarr_region_destroy(screen->dimensions);
         free(screen);
         return NULL;
     }
@@ -191,7 +164,7 @@ vioarr_screen_t* vioarr_screen_create(video_output_t* video)
     status = gladLoadGLLoader((GLADloadproc)OSMesaGetProcAddress, 3, 3);
     if (!status) {
         OSMesaDestroyContext(screen->context);
-        free(screen->dimensions);
+        vioarr_region_destroy(screen->dimensions);
         free(screen);
         vioarr_utils_error(VISTR("[vioarr] [initialize] failed to load gl extensions, code %i"), status);
         return NULL;
@@ -217,15 +190,16 @@ vioarr_screen_t* vioarr_screen_create(video_output_t* video)
         screen->present  = present_basic;
     }
     
-    bytes_to_copy           = video->Width * 4 * sizeof(GLubyte);
+    bytes_to_copy           = video->Width * format->bytes_per_pixel;
     screen->row_loops       = bytes_to_copy / bytes_step;
     screen->bytes_remaining = bytes_to_copy % bytes_step;
     
     vioarr_utils_trace(VISTR("[vioarr] [screen] [create] initializing renderer"));
-    screen->renderer = vioarr_renderer_create(screen, video->Width, video->Height);
+    screen->renderer = vioarr_renderer_create(screen, video->Width, video->Height,
+        vioarr_screen_format_renderer_flags(format));
     if (!screen->renderer) {
         OSMesaDestroyContext(screen->context);
-        free(screen->dimensions);
+        vioarr_region_destroy(screen->dimensions);
         free(screen->backbuffer);
         free(screen);
         return NULL;
@@ -300,11 +274,45 @@ int vioarr_screen_publish_modes(vioarr_screen_t* screen, int client)
         vioarr_region_height(screen->dimensions), 60);
 }
 
+int vioarr_screen_refresh_rate(vioarr_screen_t* screen)
+{
+    (void)screen;
+    return ENGINE_SCREEN_REFRESH_HZ;
+}
+
+/**
+ * Each screen is rendered by its own thread, and the context can only be current on
+ * one thread at a time.
+ */
+int vioarr_screen_make_current(vioarr_screen_t* screen, int current)
+{
+    GLboolean status;
+
+    if (!screen) {
+        return -1;
+    }
+
+    if (current) {
+        status = OSMesaMakeCurrent(screen->context, screen->backbuffer, screen->format->gl_type,
+            vioarr_region_width(screen->dimensions), vioarr_region_height(screen->dimensions));
+    }
+    else {
+        status = OSMesaMakeCurrent(NULL, NULL, 0, 0, 0);
+    }
+    return status == GL_FALSE ? -1 : 0;
+}
+
+int vioarr_screen_valid(vioarr_screen_t* screen)
+{
+    return screen != NULL;
+}
+
 void vioarr_screen_frame(vioarr_screen_t* screen)
 {
     ENTRY(VISTR("vioarr_screen_frame()"));
     vioarr_renderer_render(screen->renderer);
     glFinish();
+    vioarr_renderer_finished(screen->renderer);
 
 #ifndef VIOARR_TRACEMODE
 #ifdef  VIOARR_REVERSE_FB_BLIT
@@ -0,0 +1,158 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#include "vioarr_arena.h"
+#include "vioarr_utils.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT   16
+#define ARENA_ALIGN(size) (((size) + (ARENA_ALIGNMENT - 1)) & ~((size_t)ARENA_ALIGNMENT - 1))
+
+typedef struct vioarr_arena_chunk {
+    struct vioarr_arena_chunk* next;
+    size_t                     size;
+    size_t                     offset;
+} vioarr_arena_chunk_t;
+
+typedef struct vioarr_arena {
+    vioarr_arena_chunk_t* chunks; // current chunk is always the head
+    vioarr_arena_stats_t  stats;
+} vioarr_arena_t;
+
+static vioarr_arena_chunk_t* __create_chunk(size_t size)
+{
+    vioarr_arena_chunk_t* chunk = malloc(ARENA_ALIGN(sizeof(vioarr_arena_chunk_t)) + size);
+    if (!chunk) {
+        return NULL;
+    }
+
+    chunk->next   = NULL;
+    chunk->size   = size;
+    chunk->offset = 0;
+    return chunk;
+}
+
+static void __free_chunks(vioarr_arena_chunk_t* chunk)
+{
+    while (chunk) {
+        vioarr_arena_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+vioarr_arena_t* vioarr_arena_create(size_t size)
+{
+    vioarr_arena_t* arena;
+
+    arena = malloc(sizeof(vioarr_arena_t));
+    if (!arena) {
+        return NULL;
+    }
+
+    memset(arena, 0, sizeof(vioarr_arena_t));
+    arena->chunks = __create_chunk(ARENA_ALIGN(size));
+    if (!arena->chunks) {
+        free(arena);
+        return NULL;
+    }
+    arena->stats.capacity = arena->chunks->size;
+    return arena;
+}
+
+void vioarr_arena_destroy(vioarr_arena_t* arena)
+{
+    if (!arena) {
+        return;
+    }
+
+    __free_chunks(arena->chunks);
+    free(arena);
+}
+
+void* vioarr_arena_alloc(vioarr_arena_t* arena, size_t size)
+{
+    vioarr_arena_chunk_t* chunk;
+    void*                 memory;
+
+    if (!arena || !size) {
+        return NULL;
+    }
+
+    size  = ARENA_ALIGN(size);
+    chunk = arena->chunks;
+    if (chunk->offset + size > chunk->size) {
+        vioarr_arena_chunk_t* overflow = __create_chunk(size > chunk->size ? size : chunk->size);
+        if (!overflow) {
+            vioarr_utils_error(VISTR("[vioarr_arena_alloc] out of memory"));
+            return NULL;
+        }
+
+        overflow->next = chunk;
+        arena->chunks  = overflow;
+        arena->stats.capacity += overflow->size;
+        arena->stats.overflows++;
+        chunk = overflow;
+    }
+
+    memory = (uint8_t*)chunk + ARENA_ALIGN(sizeof(vioarr_arena_chunk_t)) + chunk->offset;
+    chunk->offset += size;
+
+    arena->stats.used += size;
+    if (arena->stats.used > arena->stats.peak) {
+        arena->stats.peak = arena->stats.used;
+    }
+    return memory;
+}
+
+void vioarr_arena_reset(vioarr_arena_t* arena)
+{
+    if (!arena) {
+        return;
+    }
+
+    // merge all chunks into one that can hold an entire frame
+    if (arena->chunks->next) {
+        vioarr_arena_chunk_t* chunk = __create_chunk(arena->stats.capacity);
+        if (chunk) {
+            __free_chunks(arena->chunks);
+            arena->chunks = chunk;
+        }
+    }
+
+    arena->chunks->offset = 0;
+    arena->stats.used     = 0;
+    arena->stats.resets++;
+}
+
+void vioarr_arena_stats(vioarr_arena_t* arena, vioarr_arena_stats_t* statsOut)
+{
+    if (!arena || !statsOut) {
+        return;
+    }
+    *statsOut = arena->stats;
+}
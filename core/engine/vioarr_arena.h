@@ -0,0 +1,53 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#ifndef __VIOARR_ARENA_H__
+#define __VIOARR_ARENA_H__
+
+#include <stddef.h>
+
+typedef struct vioarr_arena vioarr_arena_t;
+
+typedef struct vioarr_arena_stats {
+    size_t capacity;
+    size_t used;
+    size_t peak;
+    size_t resets;
+    size_t overflows;
+} vioarr_arena_stats_t;
+
+/**
+ * Bump allocator for transient per-frame data. Allocations are only valid until the
+ * next vioarr_arena_reset, and the arena is not thread-safe; it is meant to be owned by
+ * a single render thread. If a frame overflows the arena, the extra chunks are merged
+ * into one larger chunk on reset, so the steady state is a single allocation.
+ */
+vioarr_arena_t* vioarr_arena_create(size_t size);
+void            vioarr_arena_destroy(vioarr_arena_t*);
+void*           vioarr_arena_alloc(vioarr_arena_t*, size_t size);
+void            vioarr_arena_reset(vioarr_arena_t*);
+void            vioarr_arena_stats(vioarr_arena_t*, vioarr_arena_stats_t*);
+
+#endif //!__VIOARR_ARENA_H__
@@ -0,0 +1,449 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#ifdef VIOARR_BACKEND_NANOVG
+#include <glad.h>
+#endif
+
+#include "vioarr_blur.h"
+#include "vioarr_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BLUR_MAX_ITERATIONS 5
+
+typedef struct vioarr_blur_entry {
+    const void* key;
+    int         used;  // used since the last end of frame
+    int         x;
+    int         y;
+    int         width;
+    int         height;
+    int         radius;
+    int         iterations;
+#ifdef VIOARR_BACKEND_NANOVG
+    GLuint      textures[BLUR_MAX_ITERATIONS + 1]; // the copy at full size, then every downsample
+#endif
+} vioarr_blur_entry_t;
+
+typedef struct vioarr_blur {
+#ifdef VIOARR_BACKEND_NANOVG
+    GLuint               programs[2]; // downsample and upsample
+    GLint                locations[2][3];
+    GLuint               framebuffer;
+    GLuint               vertex_array;
+#endif
+    vioarr_blur_entry_t* entries;
+    int                  count;
+    int                  capacity;
+} vioarr_blur_t;
+
+enum {
+    BLUR_PROGRAM_DOWNSAMPLE,
+    BLUR_PROGRAM_UPSAMPLE
+};
+
+enum {
+    BLUR_LOC_TEXTURE,
+    BLUR_LOC_HALFPIXEL,
+    BLUR_LOC_OFFSET
+};
+
+#ifdef VIOARR_BACKEND_NANOVG
+// the quad covering the target is generated from the vertex ids, no buffers are needed
+static const char* g_vertexShader =
+    "#version 150 core\n"
+    "out vec2 uv;\n"
+    "void main(void) {\n"
+    "    uv = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));\n"
+    "    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+static const char* g_downsampleShader =
+    "#version 150 core\n"
+    "uniform sampler2D tex;\n"
+    "uniform vec2 halfpixel;\n"
+    "uniform float offset;\n"
+    "in vec2 uv;\n"
+    "out vec4 outColor;\n"
+    "void main(void) {\n"
+    "    vec4 sum = texture(tex, uv) * 4.0;\n"
+    "    sum += texture(tex, uv - halfpixel * offset);\n"
+    "    sum += texture(tex, uv + halfpixel * offset);\n"
+    "    sum += texture(tex, uv + vec2(halfpixel.x, -halfpixel.y) * offset);\n"
+    "    sum += texture(tex, uv - vec2(halfpixel.x, -halfpixel.y) * offset);\n"
+    "    outColor = sum / 8.0;\n"
+    "}\n";
+
+static const char* g_upsampleShader =
+    "#version 150 core\n"
+    "uniform sampler2D tex;\n"
+    "uniform vec2 halfpixel;\n"
+    "uniform float offset;\n"
+    "in vec2 uv;\n"
+    "out vec4 outColor;\n"
+    "void main(void) {\n"
+    "    vec4 sum = texture(tex, uv + vec2(-halfpixel.x * 2.0, 0.0) * offset);\n"
+    "    sum += texture(tex, uv + vec2(-halfpixel.x, halfpixel.y) * offset) * 2.0;\n"
+    "    sum += texture(tex, uv + vec2(0.0, halfpixel.y * 2.0) * offset);\n"
+    "    sum += texture(tex, uv + vec2(halfpixel.x, halfpixel.y) * offset) * 2.0;\n"
+    "    sum += texture(tex, uv + vec2(halfpixel.x * 2.0, 0.0) * offset);\n"
+    "    sum += texture(tex, uv + vec2(halfpixel.x, -halfpixel.y) * offset) * 2.0;\n"
+    "    sum += texture(tex, uv + vec2(0.0, -halfpixel.y * 2.0) * offset);\n"
+    "    sum += texture(tex, uv + vec2(-halfpixel.x, -halfpixel.y) * offset) * 2.0;\n"
+    "    outColor = sum / 12.0;\n"
+    "}\n";
+
+static GLuint __compile_shader(GLenum type, const char* source)
+{
+    GLuint shader = glCreateShader(type);
+    GLint  status;
+
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE) {
+        char log[512];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        vioarr_utils_error(VISTR("[vioarr_blur] failed to compile shader: %s"), log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+static GLuint __create_program(const char* fragmentSource, GLint* locations)
+{
+    GLuint vertex   = __compile_shader(GL_VERTEX_SHADER, g_vertexShader);
+    GLuint fragment = __compile_shader(GL_FRAGMENT_SHADER, fragmentSource);
+    GLuint program  = 0;
+    GLint  status;
+
+    if (vertex && fragment) {
+        program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        glBindFragDataLocation(program, 0, "outColor");
+        glLinkProgram(program);
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (status != GL_TRUE) {
+            vioarr_utils_error(VISTR("[vioarr_blur] failed to link program"));
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    if (vertex) {
+        glDeleteShader(vertex);
+    }
+    if (fragment) {
+        glDeleteShader(fragment);
+    }
+
+    if (program) {
+        locations[BLUR_LOC_TEXTURE]   = glGetUniformLocation(program, "tex");
+        locations[BLUR_LOC_HALFPIXEL] = glGetUniformLocation(program, "halfpixel");
+        locations[BLUR_LOC_OFFSET]    = glGetUniformLocation(program, "offset");
+    }
+    return program;
+}
+
+static void __destroy_textures(vioarr_blur_entry_t* entry)
+{
+    int i;
+
+    for (i = 0; i <= BLUR_MAX_ITERATIONS; i++) {
+        if (entry->textures[i]) {
+            glDeleteTextures(1, &entry->textures[i]);
+            entry->textures[i] = 0;
+        }
+    }
+}
+#endif
+
+vioarr_blur_t* vioarr_blur_create(void)
+{
+    vioarr_blur_t* blur;
+
+    blur = malloc(sizeof(vioarr_blur_t));
+    if (!blur) {
+        return NULL;
+    }
+    memset(blur, 0, sizeof(vioarr_blur_t));
+
+#ifdef VIOARR_BACKEND_NANOVG
+    blur->programs[BLUR_PROGRAM_DOWNSAMPLE] = __create_program(g_downsampleShader, &blur->locations[BLUR_PROGRAM_DOWNSAMPLE][0]);
+    blur->programs[BLUR_PROGRAM_UPSAMPLE]   = __create_program(g_upsampleShader, &blur->locations[BLUR_PROGRAM_UPSAMPLE][0]);
+    if (!blur->programs[BLUR_PROGRAM_DOWNSAMPLE] || !blur->programs[BLUR_PROGRAM_UPSAMPLE]) {
+        vioarr_blur_destroy(blur);
+        return NULL;
+    }
+
+    glGenFramebuffers(1, &blur->framebuffer);
+    glGenVertexArrays(1, &blur->vertex_array);
+#endif
+    return blur;
+}
+
+void vioarr_blur_destroy(vioarr_blur_t* blur)
+{
+    int i;
+
+    if (!blur) {
+        return;
+    }
+
+#ifdef VIOARR_BACKEND_NANOVG
+    for (i = 0; i < blur->count; i++) {
+        __destroy_textures(&blur->entries[i]);
+    }
+
+    for (i = 0; i < 2; i++) {
+        if (blur->programs[i]) {
+            glDeleteProgram(blur->programs[i]);
+        }
+    }
+
+    if (blur->framebuffer) {
+        glDeleteFramebuffers(1, &blur->framebuffer);
+    }
+    if (blur->vertex_array) {
+        glDeleteVertexArrays(1, &blur->vertex_array);
+    }
+#else
+    (void)i;
+#endif
+    free(blur->entries);
+    free(blur);
+}
+
+static vioarr_blur_entry_t* __get_entry(vioarr_blur_t* blur, const void* key)
+{
+    vioarr_blur_entry_t* entries;
+    int                  i;
+
+    for (i = 0; i < blur->count; i++) {
+        if (blur->entries[i].key == key) {
+            return &blur->entries[i];
+        }
+    }
+
+    if (blur->count == blur->capacity) {
+        int capacity = blur->capacity ? (blur->capacity * 2) : 4;
+        entries = realloc(blur->entries, sizeof(vioarr_blur_entry_t) * capacity);
+        if (!entries) {
+            return NULL;
+        }
+        blur->entries  = entries;
+        blur->capacity = capacity;
+    }
+
+    memset(&blur->entries[blur->count], 0, sizeof(vioarr_blur_entry_t));
+    blur->entries[blur->count].key = key;
+    return &blur->entries[blur->count++];
+}
+
+/**
+ * Every iteration halves the resolution, and the filters of the downsample and the upsample
+ * reach about one pixel of the level they sample each. So the blur spreads roughly offset * 2^(n+1)
+ * pixels, the number of iterations is chosen for the radius and the offset covers the rest.
+ */
+static float __get_passes(int radius, int width, int height, int* iterationsOut)
+{
+    int   iterations = 1;
+    float offset;
+
+    while (iterations < BLUR_MAX_ITERATIONS && (4 << iterations) <= radius &&
+        (width >> (iterations + 1)) > 0 && (height >> (iterations + 1)) > 0) {
+        iterations++;
+    }
+
+    offset = (float)radius / (float)(2 << iterations);
+    *iterationsOut = iterations;
+    return offset < 1.0f ? 1.0f : (offset > 3.0f ? 3.0f : offset);
+}
+
+#ifdef VIOARR_BACKEND_NANOVG
+static int __ensure_textures(vioarr_blur_entry_t* entry, int width, int height, int iterations)
+{
+    int i;
+
+    if (entry->textures[0] && entry->width == width && entry->height == height &&
+        entry->iterations == iterations) {
+        return 0;
+    }
+
+    __destroy_textures(entry);
+    for (i = 0; i <= iterations; i++) {
+        int levelWidth  = width >> i;
+        int levelHeight = height >> i;
+
+        glGenTextures(1, &entry->textures[i]);
+        if (!entry->textures[i]) {
+            __destroy_textures(entry);
+            return -1;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, entry->textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, levelWidth > 0 ? levelWidth : 1, levelHeight > 0 ? levelHeight : 1,
+            0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    entry->width      = width;
+    entry->height     = height;
+    entry->iterations = iterations;
+    return 0;
+}
+
+static void __render_pass(vioarr_blur_t* blur, int program, vioarr_blur_entry_t* entry, int source, int target)
+{
+    int sourceWidth  = entry->width >> source;
+    int sourceHeight = entry->height >> source;
+    int targetWidth  = entry->width >> target;
+    int targetHeight = entry->height >> target;
+
+    sourceWidth  = sourceWidth > 0 ? sourceWidth : 1;
+    sourceHeight = sourceHeight > 0 ? sourceHeight : 1;
+    targetWidth  = targetWidth > 0 ? targetWidth : 1;
+    targetHeight = targetHeight > 0 ? targetHeight : 1;
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, entry->textures[target], 0);
+    glViewport(0, 0, targetWidth, targetHeight);
+    glBindTexture(GL_TEXTURE_2D, entry->textures[source]);
+    glUniform2f(blur->locations[program][BLUR_LOC_HALFPIXEL], 0.5f / (float)sourceWidth, 0.5f / (float)sourceHeight);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+#endif
+
+unsigned int vioarr_blur_region(vioarr_blur_t* blur, const void* key, int x, int y, int width, int height,
+    int radius, int stale)
+{
+    vioarr_blur_entry_t* entry;
+    int                  iterations;
+    float                offset;
+#ifdef VIOARR_BACKEND_NANOVG
+    GLint                framebuffer;
+    GLint                viewport[4];
+    int                  i;
+#endif
+
+    if (!blur || width <= 0 || height <= 0 || radius <= 0) {
+        return 0;
+    }
+
+    entry = __get_entry(blur, key);
+    if (!entry) {
+        return 0;
+    }
+    entry->used = 1;
+
+    radius = radius > VIOARR_BLUR_MAX_RADIUS ? VIOARR_BLUR_MAX_RADIUS : radius;
+    offset = __get_passes(radius, width, height, &iterations);
+
+#ifdef VIOARR_BACKEND_NANOVG
+    // the content beneath did not change, so neither did the blur of it
+    if (!stale && entry->textures[0] && entry->x == x && entry->y == y && entry->width == width &&
+        entry->height == height && entry->radius == radius) {
+        return entry->textures[0];
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    if (__ensure_textures(entry, width, height, iterations)) {
+        vioarr_utils_error(VISTR("[vioarr_blur_region] failed to allocate textures"));
+        return 0;
+    }
+
+    // copy the content out before binding the blur framebuffer, the first level receives the
+    // result of the last upsample so the copy is only needed for the first downsample
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, &viewport[0]);
+    glBindTexture(GL_TEXTURE_2D, entry->textures[0]);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, x, y, width, height);
+
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_STENCIL_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glBindFramebuffer(GL_FRAMEBUFFER, blur->framebuffer);
+    glBindVertexArray(blur->vertex_array);
+
+    glUseProgram(blur->programs[BLUR_PROGRAM_DOWNSAMPLE]);
+    glUniform1i(blur->locations[BLUR_PROGRAM_DOWNSAMPLE][BLUR_LOC_TEXTURE], 0);
+    glUniform1f(blur->locations[BLUR_PROGRAM_DOWNSAMPLE][BLUR_LOC_OFFSET], offset);
+    for (i = 1; i <= iterations; i++) {
+        __render_pass(blur, BLUR_PROGRAM_DOWNSAMPLE, entry, i - 1, i);
+    }
+
+    glUseProgram(blur->programs[BLUR_PROGRAM_UPSAMPLE]);
+    glUniform1i(blur->locations[BLUR_PROGRAM_UPSAMPLE][BLUR_LOC_TEXTURE], 0);
+    glUniform1f(blur->locations[BLUR_PROGRAM_UPSAMPLE][BLUR_LOC_OFFSET], offset);
+    for (i = iterations; i > 0; i--) {
+        __render_pass(blur, BLUR_PROGRAM_UPSAMPLE, entry, i, i - 1);
+    }
+
+    // leave the state as the nvg context expects it between frames
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_BLEND);
+
+    entry->x      = x;
+    entry->y      = y;
+    entry->radius = radius;
+    return entry->textures[0];
+#else
+    (void)offset;
+    return 0;
+#endif
+}
+
+void vioarr_blur_end_frame(vioarr_blur_t* blur)
+{
+    int i = 0;
+
+    if (!blur) {
+        return;
+    }
+
+    while (i < blur->count) {
+        if (blur->entries[i].used) {
+            blur->entries[i++].used = 0;
+            continue;
+        }
+
+#ifdef VIOARR_BACKEND_NANOVG
+        __destroy_textures(&blur->entries[i]);
+#endif
+        blur->entries[i] = blur->entries[--blur->count];
+    }
+}
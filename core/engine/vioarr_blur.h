@@ -0,0 +1,58 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+
+#ifndef __VIOARR_BLUR_H__
+#define __VIOARR_BLUR_H__
+
+#define VIOARR_BLUR_MAX_RADIUS 64
+
+typedef struct vioarr_blur vioarr_blur_t;
+
+/**
+ * Backdrop blur for surfaces that ask for it. The content already composed under a surface is
+ * copied out of the framebuffer and blurred with a dual kawase blur, which downsamples the copy
+ * a few times and upsamples it again with a small filter at every step. The result is cached per
+ * key (the surface) and reused as long as the renderer does not mark it stale. Must be created
+ * and used with the context of the renderer current.
+ */
+vioarr_blur_t* vioarr_blur_create(void);
+void           vioarr_blur_destroy(vioarr_blur_t*);
+
+/**
+ * Retrieves the texture with the blurred content of the given framebuffer area, in pixels with
+ * the origin in the lower left corner. The framebuffer must be bound and contain everything that
+ * is beneath the area. Returns 0 if the content could not be blurred.
+ */
+unsigned int vioarr_blur_region(vioarr_blur_t*, const void* key, int x, int y, int width, int height,
+                                int radius, int stale);
+
+/**
+ * Releases the cached results that were not used since the last call, so blurs of surfaces that
+ * went away, or were not drawn, are not kept around.
+ */
+void vioarr_blur_end_frame(vioarr_blur_t*);
+
+#endif //!__VIOARR_BLUR_H__
@@ -24,6 +24,7 @@
 
 #include "vioarr_buffer.h"
 #include "vioarr_objects.h"
+#include "vioarr_slab.h"
 #include <stdatomic.h>
 #include <stdlib.h>
 
@@ -38,6 +39,19 @@ typedef struct vioarr_buffer {
     unsigned int          flags;
 } vioarr_buffer_t;
 
+static vioarr_slab_cache_t g_bufferCache = VIOARR_SLAB_CACHE_INIT("buffer", sizeof(vioarr_buffer_t), 64);
+
+// every format is sampled directly by the renderer, the list is ordered by preference
+static const enum wm_pixel_format g_supportedFormats[] = {
+    WM_PIXEL_FORMAT_A8B8G8R8,
+    WM_PIXEL_FORMAT_X8B8G8R8,
+    WM_PIXEL_FORMAT_A8R8G8B8,
+    WM_PIXEL_FORMAT_X8R8G8B8,
+    WM_PIXEL_FORMAT_R8G8B8A8,
+    WM_PIXEL_FORMAT_B8G8R8A8,
+    WM_PIXEL_FORMAT_R5G6B5
+};
+
 int vioarr_buffer_create(uint32_t id, vioarr_memory_pool_t* pool, int poolIndex,
     int width, int height, int stride, enum wm_pixel_format format,
     unsigned int flags, vioarr_buffer_t** bufferOut)
@@ -48,8 +62,13 @@ int vioarr_buffer_create(uint32_t id, vioarr_memory_pool_t* pool, int poolIndex,
     if (!pool || !bufferOut) {
         return -1;
     }
+
+    // the content is uploaded as tightly packed rows
+    if (width <= 0 || height <= 0 || stride != width * vioarr_buffer_bytes_per_pixel(format)) {
+        return -1;
+    }
     
-    buffer = malloc(sizeof(vioarr_buffer_t));
+    buffer = vioarr_slab_alloc(&g_bufferCache);
     if (!buffer) {
         return -1;
     }
@@ -64,7 +83,7 @@ int vioarr_buffer_create(uint32_t id, vioarr_memory_pool_t* pool, int poolIndex,
 
     buffer->data = vioarr_memory_pool_data(pool, poolIndex, height * stride);
     if (!buffer->data) {
-        free(buffer);
+        vioarr_slab_free(&g_bufferCache, buffer);
         return -1;
     }
     
@@ -99,7 +118,7 @@ int vioarr_buffer_destroy(vioarr_buffer_t* buffer)
     references = atomic_fetch_sub(&buffer->references, 1);
     if (references == 1) {
         // destroy logic
-        free(buffer);
+        vioarr_slab_free(&g_bufferCache, buffer);
     }
     return 0;
 }
@@ -151,3 +170,81 @@ int vioarr_buffer_flags(vioarr_buffer_t* buffer)
     }
     return buffer->flags;
 }
+
+static uint32_t __read_pixel(const uint8_t* data, enum wm_pixel_format format)
+{
+    uint32_t value;
+    uint32_t a, r, g, b;
+
+    if (format == WM_PIXEL_FORMAT_R5G6B5) {
+        value = (uint32_t)data[0] | ((uint32_t)data[1] << 8);
+        r     = (value >> 11) & 0x1F;
+        g     = (value >> 5) & 0x3F;
+        b     = value & 0x1F;
+        return 0xFF000000 | (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+    }
+
+    value = (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+    switch (format) {
+        case WM_PIXEL_FORMAT_A8B8G8R8: a = value >> 24; b = (value >> 16) & 0xFF; g = (value >> 8) & 0xFF; r = value & 0xFF; break;
+        case WM_PIXEL_FORMAT_X8R8G8B8: a = 0xFF; r = (value >> 16) & 0xFF; g = (value >> 8) & 0xFF; b = value & 0xFF; break;
+        case WM_PIXEL_FORMAT_X8B8G8R8: a = 0xFF; b = (value >> 16) & 0xFF; g = (value >> 8) & 0xFF; r = value & 0xFF; break;
+        case WM_PIXEL_FORMAT_R8G8B8A8: r = value >> 24; g = (value >> 16) & 0xFF; b = (value >> 8) & 0xFF; a = value & 0xFF; break;
+        case WM_PIXEL_FORMAT_B8G8R8A8: b = value >> 24; g = (value >> 16) & 0xFF; r = (value >> 8) & 0xFF; a = value & 0xFF; break;
+        default:                       a = value >> 24; r = (value >> 16) & 0xFF; g = (value >> 8) & 0xFF; b = value & 0xFF; break;
+    }
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+/**
+ * Converts the top left width x height pixels of the buffer into premultiplied 0xAARRGGBB
+ * pixels, for the few places that read client content on the cpu.
+ */
+void vioarr_buffer_read_pixels(vioarr_buffer_t* buffer, uint32_t* pixels, int width, int height, int pitch)
+{
+    int bpp;
+    int x, y;
+
+    if (!buffer || !pixels) {
+        return;
+    }
+
+    bpp = vioarr_buffer_bytes_per_pixel(buffer->format);
+    for (y = 0; y < height && y < buffer->height; y++) {
+        // flipped content is stored bottom up
+        int            row    = (buffer->flags & VIOARR_BUFFER_FLIP_Y) ? (buffer->height - 1 - y) : y;
+        const uint8_t* source = (const uint8_t*)buffer->data + ((size_t)row * buffer->width * bpp);
+        uint32_t*      target = pixels + ((size_t)y * pitch);
+
+        for (x = 0; x < width && x < buffer->width; x++) {
+            uint32_t pixel = __read_pixel(source + (x * bpp), buffer->format);
+            uint32_t a     = pixel >> 24;
+
+            if (!(buffer->flags & VIOARR_BUFFER_PREMULTIPLIED) && a != 0xFF) {
+                pixel = (a << 24) |
+                    ((((pixel >> 16) & 0xFF) * a / 255) << 16) |
+                    ((((pixel >> 8) & 0xFF) * a / 255) << 8) |
+                    ((pixel & 0xFF) * a / 255);
+            }
+            target[x] = pixel;
+        }
+    }
+}
+
+int vioarr_buffer_bytes_per_pixel(enum wm_pixel_format format)
+{
+    switch (format) {
+        case WM_PIXEL_FORMAT_R5G6B5: return 2;
+        default: return 4;
+    }
+}
+
+int vioarr_buffer_supported_formats(const enum wm_pixel_format** formatsOut)
+{
+    if (!formatsOut) {
+        return 0;
+    }
+
+    *formatsOut = &g_supportedFormats[0];
+    return (int)(sizeof(g_supportedFormats) / sizeof(g_supportedFormats[0]));
+}
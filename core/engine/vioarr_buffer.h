@@ -30,6 +30,9 @@
 
 typedef struct vioarr_buffer vioarr_buffer_t;
 
+#define VIOARR_BUFFER_FLIP_Y        0x1
+#define VIOARR_BUFFER_PREMULTIPLIED 0x2 // color channels are premultiplied with alpha
+
 int                  vioarr_buffer_create(uint32_t id, vioarr_memory_pool_t* pool, int poolIndex, int width, 
                                             int height, int stride, enum wm_pixel_format format, 
                                             unsigned int flags, vioarr_buffer_t** bufferOut);
@@ -41,5 +44,9 @@ int                  vioarr_buffer_height(vioarr_buffer_t*);
 void*                vioarr_buffer_data(vioarr_buffer_t*);
 enum wm_pixel_format vioarr_buffer_format(vioarr_buffer_t*);
 int                  vioarr_buffer_flags(vioarr_buffer_t*);
+void                 vioarr_buffer_read_pixels(vioarr_buffer_t*, uint32_t* pixels, int width, int height, int pitch);
+
+int                  vioarr_buffer_bytes_per_pixel(enum wm_pixel_format);
+int                  vioarr_buffer_supported_formats(const enum wm_pixel_format** formatsOut);
 
 #endif //!__VIOARR_BUFFER_H__
@@ -0,0 +1,586 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#ifdef VIOARR_BACKEND_NANOVG
+#include <glad.h>
+#endif
+
+#include "vioarr_buffer.h"
+#include "vioarr_capture.h"
+#include "vioarr_damage.h"
+#include "vioarr_outputs.h"
+#include "vioarr_renderer.h"
+#include "vioarr_screen.h"
+#include "vioarr_surface.h"
+#include "vioarr_utils.h"
+#include "wm_capture_service_server.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+typedef struct vioarr_capture_buffer {
+    vioarr_buffer_t*       buffer;
+    unsigned int           queued; // order the buffer was queued in, 0 while the client holds it
+    int                    full;   // the buffer has never been written
+    vioarr_damage_t        damage; // framebuffer areas that changed since the buffer was written
+} vioarr_capture_buffer_t;
+
+typedef struct vioarr_capture {
+    int                     client;
+    uint32_t                id;
+    vioarr_screen_t*        screen;
+    vioarr_surface_t*       surface;    // source of thumbnails, NULL for screen captures
+    unsigned int            serial;     // commits of the source the last thumbnail was drawn for
+    vioarr_capture_buffer_t* target;    // buffer the thumbnail is being drawn for
+    mtx_t                   lock;
+    atomic_int              destroyed;
+    uint64_t                interval;   // us
+    uint64_t                last_frame;
+    int                     started;    // the first frame, which is always complete, was delivered
+    unsigned int            queue_serial;
+    vioarr_damage_t         damage;     // framebuffer areas that changed since the last delivered frame
+    vioarr_capture_buffer_t buffers[VIOARR_CAPTURE_MAX_BUFFERS];
+    int                     buffer_count;
+    uint8_t*                scratch;
+    size_t                  scratch_size;
+#ifdef VIOARR_BACKEND_NANOVG
+    GLuint                  framebuffer; // target for downscaling, if the buffers are smaller
+    GLuint                  texture;
+    GLuint                  stencil;     // thumbnails are drawn by nanovg, which needs a stencil
+    int                     texture_width;
+    int                     texture_height;
+    GLint                   saved_framebuffer;
+    GLint                   saved_viewport[4];
+#endif
+} vioarr_capture_t;
+
+int vioarr_capture_create(int client, uint32_t id, vioarr_screen_t* screen, int interval, vioarr_capture_t** captureOut)
+{
+    vioarr_capture_t* capture;
+
+    if (!screen || interval < 0 || !captureOut) {
+        return -1;
+    }
+
+    capture = malloc(sizeof(vioarr_capture_t));
+    if (!capture) {
+        return -1;
+    }
+
+    memset(capture, 0, sizeof(vioarr_capture_t));
+    capture->client   = client;
+    capture->id       = id;
+    capture->screen   = screen;
+    capture->interval = (uint64_t)interval * 1000;
+    atomic_init(&capture->destroyed, 0);
+    mtx_init(&capture->lock, mtx_plain);
+
+    vioarr_renderer_add_capture(vioarr_screen_renderer(screen), capture);
+    *captureOut = capture;
+    return 0;
+}
+
+int vioarr_capture_create_thumbnail(int client, uint32_t id, vioarr_surface_t* surface, int interval,
+    vioarr_capture_t** captureOut)
+{
+    vioarr_capture_t* capture;
+
+    if (!surface || interval < 0 || !captureOut) {
+        return -1;
+    }
+
+    capture = malloc(sizeof(vioarr_capture_t));
+    if (!capture) {
+        return -1;
+    }
+
+    // thumbnails are drawn by the renderer of the screen the surface was created on, any
+    // renderer can draw the surface wherever it is positioned. The surface is valid for as long
+    // as the request creating the capture is handled, after that it is only used by the renderer,
+    // which releases it before the surface is freed. The first thumbnail is always drawn.
+    memset(capture, 0, sizeof(vioarr_capture_t));
+    capture->client   = client;
+    capture->id       = id;
+    capture->screen   = vioarr_surface_screen(surface);
+    capture->surface  = surface;
+    capture->interval = (uint64_t)interval * 1000;
+    atomic_init(&capture->destroyed, 0);
+    mtx_init(&capture->lock, mtx_plain);
+
+    vioarr_renderer_add_thumbnail(vioarr_screen_renderer(capture->screen), capture);
+    *captureOut = capture;
+    return 0;
+}
+
+/**
+ * The capture is used by the render thread of the screen, which also owns the framebuffer
+ * objects of it. So it is only marked here and released by the render thread with its next frame.
+ */
+void vioarr_capture_destroy(vioarr_capture_t* capture)
+{
+    if (!capture) {
+        return;
+    }
+
+    atomic_store(&capture->destroyed, 1);
+    vioarr_outputs_schedule_redraw(capture->screen, 0);
+}
+
+static int __is_supported_format(enum wm_pixel_format format)
+{
+    return format == WM_PIXEL_FORMAT_A8R8G8B8 || format == WM_PIXEL_FORMAT_X8R8G8B8 ||
+        format == WM_PIXEL_FORMAT_A8B8G8R8 || format == WM_PIXEL_FORMAT_X8B8G8R8;
+}
+
+int vioarr_capture_queue_buffer(vioarr_capture_t* capture, vioarr_buffer_t* buffer)
+{
+    vioarr_capture_buffer_t* entry = NULL;
+    int                      i;
+
+    if (!capture || !buffer || !__is_supported_format(vioarr_buffer_format(buffer))) {
+        return -1;
+    }
+
+    mtx_lock(&capture->lock);
+    for (i = 0; i < capture->buffer_count; i++) {
+        if (capture->buffers[i].buffer == buffer) {
+            entry = &capture->buffers[i];
+            break;
+        }
+    }
+
+    // new buffers stay with the capture until it is destroyed, as they must be kept up to date
+    if (!entry) {
+        if (capture->buffer_count == VIOARR_CAPTURE_MAX_BUFFERS || vioarr_buffer_acquire(buffer)) {
+            mtx_unlock(&capture->lock);
+            return -1;
+        }
+        entry = &capture->buffers[capture->buffer_count++];
+        memset(entry, 0, sizeof(vioarr_capture_buffer_t));
+        entry->buffer = buffer;
+        entry->full   = 1;
+    }
+
+    if (!entry->queued) {
+        entry->queued = ++capture->queue_serial;
+    }
+    mtx_unlock(&capture->lock);
+
+    // a frame may be waiting for the buffer
+    vioarr_outputs_schedule_redraw(capture->screen, 0);
+    return 0;
+}
+
+static void __free_capture(vioarr_capture_t* capture)
+{
+    int i;
+
+#ifdef VIOARR_BACKEND_NANOVG
+    if (capture->framebuffer) {
+        glDeleteFramebuffers(1, &capture->framebuffer);
+    }
+    if (capture->texture) {
+        glDeleteTextures(1, &capture->texture);
+    }
+    if (capture->stencil) {
+        glDeleteRenderbuffers(1, &capture->stencil);
+    }
+#endif
+
+    for (i = 0; i < capture->buffer_count; i++) {
+        vioarr_buffer_destroy(capture->buffers[i].buffer);
+    }
+    mtx_destroy(&capture->lock);
+    free(capture->scratch);
+    free(capture);
+}
+
+/**
+ * Maps an area of the framebuffer onto a buffer of another size, rounding outwards so the
+ * scaled area covers every pixel the original one touches.
+ */
+static void __scale_rect(const vioarr_drawlist_rect_t* rect, int width, int height,
+    int targetWidth, int targetHeight, vioarr_drawlist_rect_t* rectOut)
+{
+    int x1 = (rect->x * targetWidth) / width;
+    int y1 = (rect->y * targetHeight) / height;
+    int x2 = ((rect->x + rect->width) * targetWidth + width - 1) / width;
+    int y2 = ((rect->y + rect->height) * targetHeight + height - 1) / height;
+
+    x1 = x1 < 0 ? 0 : x1;
+    y1 = y1 < 0 ? 0 : y1;
+    x2 = x2 > targetWidth ? targetWidth : x2;
+    y2 = y2 > targetHeight ? targetHeight : y2;
+    rectOut->x      = x1;
+    rectOut->y      = y1;
+    rectOut->width  = x2 > x1 ? (x2 - x1) : 0;
+    rectOut->height = y2 > y1 ? (y2 - y1) : 0;
+}
+
+#ifdef VIOARR_BACKEND_NANOVG
+static int __ensure_target(vioarr_capture_t* capture, int width, int height)
+{
+    if (capture->texture && capture->texture_width == width && capture->texture_height == height) {
+        return 0;
+    }
+
+    if (!capture->framebuffer) {
+        glGenFramebuffers(1, &capture->framebuffer);
+    }
+    if (!capture->texture) {
+        glGenTextures(1, &capture->texture);
+    }
+    if (!capture->framebuffer || !capture->texture) {
+        return -1;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, capture->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, capture->framebuffer);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, capture->texture, 0);
+    if (capture->surface) {
+        if (!capture->stencil) {
+            glGenRenderbuffers(1, &capture->stencil);
+        }
+        glBindRenderbuffer(GL_RENDERBUFFER, capture->stencil);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_STENCIL_INDEX8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, capture->stencil);
+    }
+    capture->texture_width  = width;
+    capture->texture_height = height;
+    return 0;
+}
+#endif
+
+/**
+ * Reads an area (in buffer pixels) of the framebuffer into the buffer. Buffers of another size than
+ * the framebuffer are filled from a scaled copy, of which only the area is drawn.
+ */
+static int __read_area(vioarr_capture_t* capture, vioarr_buffer_t* buffer, const vioarr_drawlist_rect_t* area,
+    int width, int height)
+{
+    int                    bufferWidth  = vioarr_buffer_width(buffer);
+    int                    bufferHeight = vioarr_buffer_height(buffer);
+    uint8_t*               data         = vioarr_buffer_data(buffer);
+    size_t                 size;
+    int                    row;
+#ifdef VIOARR_BACKEND_NANOVG
+    GLint                  framebuffer;
+    GLint                  glY;
+#endif
+
+    if (!area->width || !area->height) {
+        return 0;
+    }
+
+    size = (size_t)area->width * (size_t)area->height * 4;
+    if (size > capture->scratch_size) {
+        uint8_t* scratch = realloc(capture->scratch, size);
+        if (!scratch) {
+            return -1;
+        }
+        capture->scratch      = scratch;
+        capture->scratch_size = size;
+    }
+
+#ifdef VIOARR_BACKEND_NANOVG
+    // the framebuffer has its origin in the lower left corner
+    glY = bufferHeight - (area->y + area->height);
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    if (bufferWidth != width || bufferHeight != height) {
+        if (__ensure_target(capture, bufferWidth, bufferHeight)) {
+            glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)framebuffer);
+            return -1;
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, capture->framebuffer);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(area->x, glY, area->width, area->height);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, bufferWidth, bufferHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glDisable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, capture->framebuffer);
+    }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(area->x, glY, area->width, area->height,
+        (vioarr_buffer_format(buffer) == WM_PIXEL_FORMAT_A8R8G8B8 || vioarr_buffer_format(buffer) == WM_PIXEL_FORMAT_X8R8G8B8) ?
+            GL_BGRA : GL_RGBA,
+        GL_UNSIGNED_BYTE, capture->scratch);
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)framebuffer);
+
+    // rows are read bottom up, which is how flipped buffers store them
+    for (row = 0; row < area->height; row++) {
+        int line = (vioarr_buffer_flags(buffer) & VIOARR_BUFFER_FLIP_Y) ?
+            (glY + row) : (bufferHeight - 1 - (glY + row));
+        memcpy(data + ((size_t)line * bufferWidth + area->x) * 4,
+            capture->scratch + (size_t)row * area->width * 4, (size_t)area->width * 4);
+    }
+    return 0;
+#else
+    (void)data;
+    (void)row;
+    (void)bufferWidth;
+    (void)bufferHeight;
+    (void)width;
+    (void)height;
+    return -1;
+#endif
+}
+
+/**
+ * Reads the areas of the framebuffer the buffer is missing into it, which is all of it if the
+ * buffer was never written.
+ */
+static int __read_buffer(vioarr_capture_t* capture, vioarr_capture_buffer_t* entry, int width, int height)
+{
+    vioarr_drawlist_rect_t full = { 0, 0, width, height };
+    vioarr_drawlist_rect_t area;
+    int                    i;
+
+    if (entry->full) {
+        __scale_rect(&full, width, height, vioarr_buffer_width(entry->buffer), vioarr_buffer_height(entry->buffer), &area);
+        return __read_area(capture, entry->buffer, &area, width, height);
+    }
+
+    for (i = 0; i < entry->damage.count; i++) {
+        __scale_rect(&entry->damage.rects[i], width, height,
+            vioarr_buffer_width(entry->buffer), vioarr_buffer_height(entry->buffer), &area);
+        if (__read_area(capture, entry->buffer, &area, width, height)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Sends the frame event for the buffer, the areas (in framebuffer pixels) are scaled to the buffer.
+ */
+static void __send_frame(vioarr_capture_t* capture, vioarr_buffer_t* buffer, uint64_t timestamp,
+    vioarr_damage_t* damage, int width, int height)
+{
+    struct wm_rect         rects[VIOARR_DAMAGE_MAX_RECTS];
+    vioarr_drawlist_rect_t area;
+    uint32_t               count = 0;
+    int                    i;
+
+    for (i = 0; i < damage->count; i++) {
+        __scale_rect(&damage->rects[i], width, height, vioarr_buffer_width(buffer), vioarr_buffer_height(buffer), &area);
+        if (area.width && area.height) {
+            rects[count].x      = area.x;
+            rects[count].y      = area.y;
+            rects[count].width  = area.width;
+            rects[count].height = area.height;
+            count++;
+        }
+    }
+
+    wm_capture_event_frame_single(vioarr_get_server_handle(), capture->client, capture->id,
+        vioarr_buffer_id(buffer), timestamp, &rects[0], count);
+}
+
+int vioarr_capture_frame(vioarr_capture_t* capture, vioarr_damage_t* damage, int width, int height)
+{
+    vioarr_capture_buffer_t* target = NULL;
+    uint64_t                 now;
+    int                      i;
+
+    if (!capture) {
+        return -1;
+    }
+
+    if (atomic_load(&capture->destroyed)) {
+        __free_capture(capture);
+        return -1;
+    }
+
+    mtx_lock(&capture->lock);
+    if (!capture->started) {
+        vioarr_damage_zero(&capture->damage);
+        vioarr_damage_add(&capture->damage, 0, 0, width, height);
+    }
+
+    // every buffer must catch up on all the changes since it was last written
+    vioarr_damage_merge(&capture->damage, damage);
+    for (i = 0; i < capture->buffer_count; i++) {
+        vioarr_damage_merge(&capture->buffers[i].damage, damage);
+        if (capture->buffers[i].queued && (!target || capture->buffers[i].queued < target->queued)) {
+            target = &capture->buffers[i];
+        }
+    }
+
+    if (vioarr_damage_is_zero(&capture->damage) || !target) {
+        goto exit;
+    }
+
+    // changes within the interval are held back, the output renders again once it has passed
+    now = vioarr_utils_time_us();
+    if (capture->started && (now - capture->last_frame) < capture->interval) {
+        vioarr_outputs_schedule_redraw(capture->screen, (unsigned int)(capture->interval - (now - capture->last_frame)));
+        goto exit;
+    }
+
+    if (__read_buffer(capture, target, width, height)) {
+        vioarr_utils_error(VISTR("[vioarr_capture_frame] failed to read the frame into buffer %u"),
+            vioarr_buffer_id(target->buffer));
+        goto exit;
+    }
+
+    __send_frame(capture, target->buffer, now, &capture->damage, width, height);
+    vioarr_damage_zero(&target->damage);
+    vioarr_damage_zero(&capture->damage);
+    target->queued       = 0;
+    target->full         = 0;
+    capture->started     = 1;
+    capture->last_frame  = now;
+
+exit:
+    mtx_unlock(&capture->lock);
+    return 0;
+}
+
+vioarr_surface_t* vioarr_capture_source(vioarr_capture_t* capture)
+{
+    if (!capture) {
+        return NULL;
+    }
+    return capture->surface;
+}
+
+void vioarr_capture_release_source(vioarr_capture_t* capture)
+{
+    if (!capture) {
+        return;
+    }
+
+    mtx_lock(&capture->lock);
+    capture->surface = NULL;
+    mtx_unlock(&capture->lock);
+}
+
+int vioarr_capture_begin_thumbnail(vioarr_capture_t* capture, unsigned int serial, int* widthOut, int* heightOut)
+{
+    vioarr_capture_buffer_t* target = NULL;
+    uint64_t                 now;
+    int                      status = 0;
+    int                      i;
+
+    if (!capture) {
+        return -1;
+    }
+
+    if (atomic_load(&capture->destroyed)) {
+        __free_capture(capture);
+        return -1;
+    }
+
+    mtx_lock(&capture->lock);
+    if (!capture->surface || (capture->started && serial == capture->serial)) {
+        goto exit;
+    }
+
+    for (i = 0; i < capture->buffer_count; i++) {
+        if (capture->buffers[i].queued && (!target || capture->buffers[i].queued < target->queued)) {
+            target = &capture->buffers[i];
+        }
+    }
+
+    if (!target) {
+        goto exit;
+    }
+
+    now = vioarr_utils_time_us();
+    if (capture->started && (now - capture->last_frame) < capture->interval) {
+        vioarr_outputs_schedule_redraw(capture->screen, (unsigned int)(capture->interval - (now - capture->last_frame)));
+        goto exit;
+    }
+
+#ifdef VIOARR_BACKEND_NANOVG
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &capture->saved_framebuffer);
+    glGetIntegerv(GL_VIEWPORT, &capture->saved_viewport[0]);
+    if (__ensure_target(capture, vioarr_buffer_width(target->buffer), vioarr_buffer_height(target->buffer))) {
+        vioarr_utils_error(VISTR("[vioarr_capture_begin_thumbnail] failed to create the thumbnail target"));
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)capture->saved_framebuffer);
+        goto exit;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, capture->framebuffer);
+    glViewport(0, 0, capture->texture_width, capture->texture_height);
+    capture->target = target;
+    capture->serial = serial;
+    *widthOut       = capture->texture_width;
+    *heightOut      = capture->texture_height;
+    status          = 1;
+#else
+    (void)widthOut;
+    (void)heightOut;
+#endif
+
+exit:
+    mtx_unlock(&capture->lock);
+    return status;
+}
+
+void vioarr_capture_end_thumbnail(vioarr_capture_t* capture)
+{
+    vioarr_capture_buffer_t* target;
+    int                      width;
+    int                      height;
+
+    if (!capture || !capture->target) {
+        return;
+    }
+
+    mtx_lock(&capture->lock);
+    target          = capture->target;
+    target->full    = 1;
+    capture->target = NULL;
+    width           = vioarr_buffer_width(target->buffer);
+    height          = vioarr_buffer_height(target->buffer);
+    if (!__read_buffer(capture, target, width, height)) {
+        capture->last_frame = vioarr_utils_time_us();
+        capture->started    = 1;
+        vioarr_damage_zero(&target->damage);
+        vioarr_damage_add(&target->damage, 0, 0, width, height);
+        __send_frame(capture, target->buffer, capture->last_frame, &target->damage, width, height);
+        target->queued = 0;
+        target->full   = 0;
+        vioarr_damage_zero(&target->damage);
+    }
+    else {
+        vioarr_utils_error(VISTR("[vioarr_capture_end_thumbnail] failed to read the thumbnail into buffer %u"),
+            vioarr_buffer_id(target->buffer));
+    }
+
+#ifdef VIOARR_BACKEND_NANOVG
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)capture->saved_framebuffer);
+    glViewport(capture->saved_viewport[0], capture->saved_viewport[1],
+        capture->saved_viewport[2], capture->saved_viewport[3]);
+#endif
+    mtx_unlock(&capture->lock);
+}
@@ -0,0 +1,76 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+
+#ifndef __VIOARR_CAPTURE_H__
+#define __VIOARR_CAPTURE_H__
+
+#include "vioarr_damage.h"
+#include <stdint.h>
+
+#define VIOARR_CAPTURE_MAX_BUFFERS 4
+
+typedef struct vioarr_capture vioarr_capture_t;
+typedef struct vioarr_screen  vioarr_screen_t;
+typedef struct vioarr_buffer  vioarr_buffer_t;
+typedef struct vioarr_surface vioarr_surface_t;
+
+/**
+ * A capture streams the composed frames of a screen into buffers queued by a client. When a
+ * frame is delivered only the area that changed since the buffer was last written is read back
+ * from the render target, scaled to the size of the buffer, and the frame event tells the client
+ * which areas changed since the previous frame. Frames are delivered at most once per interval,
+ * changes in between are merged into the next frame.
+ */
+int  vioarr_capture_create(int client, uint32_t id, vioarr_screen_t*, int interval, vioarr_capture_t** captureOut);
+
+/**
+ * Thumbnail captures stream a surface and its subsurfaces instead, scaled to fit the buffers.
+ * A new frame is drawn only when the surface or one of its subsurfaces was committed, and the
+ * entire buffer is written every time as the thumbnail is cheap to draw.
+ */
+int  vioarr_capture_create_thumbnail(int client, uint32_t id, vioarr_surface_t*, int interval, vioarr_capture_t** captureOut);
+void vioarr_capture_destroy(vioarr_capture_t*);
+int  vioarr_capture_queue_buffer(vioarr_capture_t*, vioarr_buffer_t*);
+
+/**
+ * Renderer side, called on the render thread of the screen after every frame with the areas of
+ * the framebuffer (in pixels, origin top left) that changed. Returns -1 once the capture was
+ * destroyed, it has then released its resources and must not be used anymore.
+ */
+int vioarr_capture_frame(vioarr_capture_t*, vioarr_damage_t* damage, int width, int height);
+
+/**
+ * Renderer side of thumbnails. Begin returns 1 if a thumbnail must be drawn for the given commit
+ * serial, in which case the target is bound with the size of the buffer and end must be called
+ * once it was drawn. Returns -1 once the capture was destroyed, like vioarr_capture_frame.
+ * The source is released by the renderer when the surface is freed.
+ */
+vioarr_surface_t* vioarr_capture_source(vioarr_capture_t*);
+void              vioarr_capture_release_source(vioarr_capture_t*);
+int               vioarr_capture_begin_thumbnail(vioarr_capture_t*, unsigned int serial, int* widthOut, int* heightOut);
+void              vioarr_capture_end_thumbnail(vioarr_capture_t*);
+
+#endif //!__VIOARR_CAPTURE_H__
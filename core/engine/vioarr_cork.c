@@ -0,0 +1,481 @@
+/* MollenOS
+ *
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+#include "vioarr_cork.h"
+#include "vioarr_utils.h"
+
+// clients touched by a corked thread, further clients are sent to immediately
+#define CORK_MAX_TOUCHED 64
+
+static _Thread_local int g_corkDepth = 0;
+static _Thread_local int g_corkTouched[CORK_MAX_TOUCHED];
+static _Thread_local int g_corkTouchedCount = 0;
+
+#if defined(__linux__)
+#include <errno.h>
+#include <gracht/link/link.h>
+#include <list.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// clients with a blocked socket the flusher waits on at once
+#define CORK_MAX_POLLED 64
+
+typedef struct vioarr_cork_client {
+    element_t                    header;
+    mtx_t                        lock;
+    struct gracht_server_client* client;
+    uint8_t*                     data;     // events not written yet, held back or not taken by the socket
+    size_t                       length;
+    size_t                       capacity;
+    uint64_t                     since;    // when the oldest of the events was held back
+    int                          blocked;  // the socket did not take everything, waiting for it to drain
+} vioarr_cork_client_t;
+
+static struct {
+    mtx_t                  lock;
+    list_t                 clients;
+    atomic_int             pending; // number of clients with events not written yet
+    int                    wakeup;  // eventfd of the flusher
+    link_send_client_fn    send_client;
+    link_destroy_client_fn destroy_client;
+} g_cork = { .clients = LIST_INIT, .wakeup = -1 };
+
+static void __wake_flusher(void)
+{
+    uint64_t value = 1;
+    if (g_cork.wakeup >= 0 && write(g_cork.wakeup, &value, sizeof(uint64_t)) < 0) {
+        vioarr_utils_error(VISTR("[vioarr_cork] failed to wake the flusher, errno %i"), errno);
+    }
+}
+
+// must be called with the lock of the client held, whenever the amount of data it holds changed
+static void __account(vioarr_cork_client_t* cork, size_t previousLength)
+{
+    if (!previousLength && cork->length) {
+        cork->since = vioarr_utils_time_us();
+        if (!atomic_fetch_add(&g_cork.pending, 1)) {
+            __wake_flusher();
+        }
+    }
+    else if (previousLength && !cork->length) {
+        cork->blocked = 0;
+        atomic_fetch_sub(&g_cork.pending, 1);
+    }
+}
+
+static int __reserve(vioarr_cork_client_t* cork, size_t length)
+{
+    size_t   capacity;
+    uint8_t* data;
+
+    if (cork->length + length <= cork->capacity) {
+        return 0;
+    }
+
+    capacity = cork->capacity ? cork->capacity * 2 : 4096;
+    while (capacity < cork->length + length) {
+        capacity *= 2;
+    }
+
+    data = realloc(cork->data, capacity);
+    if (!data) {
+        return -1;
+    }
+    cork->data     = data;
+    cork->capacity = capacity;
+    return 0;
+}
+
+static int __append(vioarr_cork_client_t* cork, const uint8_t* data, size_t length)
+{
+    size_t previousLength = cork->length;
+
+    if (__reserve(cork, length)) {
+        return -1;
+    }
+
+    memcpy(&cork->data[cork->length], data, length);
+    cork->length += length;
+    __account(cork, previousLength);
+    return 0;
+}
+
+/**
+ * A client that leaves this much unread is not going to catch up, its connection is shut down
+ * so it is disconnected like any other client that went away.
+ */
+static int __drop_client(vioarr_cork_client_t* cork)
+{
+    size_t previousLength = cork->length;
+
+    vioarr_utils_error(VISTR("[vioarr_cork] client %i is not reading its events, disconnecting it"),
+        cork->client->handle);
+    shutdown(cork->client->handle, SHUT_RDWR);
+    cork->length = 0;
+    __account(cork, previousLength);
+    errno = ENOBUFS;
+    return -1;
+}
+
+/**
+ * Writes the events of the client that were not written yet, followed by the message, without
+ * ever blocking. Whatever the socket does not take is kept in order, and written by the flusher
+ * once the socket can take more. Must be called with the lock of the client held.
+ */
+static int __flush(vioarr_cork_client_t* cork, struct gracht_buffer* message)
+{
+    struct iovec  iov[2];
+    struct msghdr header = { 0 };
+    size_t        previousLength = cork->length;
+    size_t        consumed;
+    ssize_t       written;
+    int           count = 0;
+
+    if (cork->length) {
+        iov[count].iov_base = cork->data;
+        iov[count].iov_len  = cork->length;
+        count++;
+    }
+
+    if (message) {
+        iov[count].iov_base = message->data;
+        iov[count].iov_len  = message->index;
+        count++;
+    }
+
+    if (!count) {
+        return 0;
+    }
+
+    header.msg_iov    = &iov[0];
+    header.msg_iovlen = count;
+    do {
+        written = sendmsg(cork->client->handle, &header, MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while (written < 0 && errno == EINTR);
+
+    if (written < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            cork->length = 0;
+            __account(cork, previousLength);
+            return -1;
+        }
+        written = 0;
+    }
+
+    // drop what was written of the held back events, and keep what is left of the message
+    consumed = (size_t)written < cork->length ? (size_t)written : cork->length;
+    if (consumed) {
+        memmove(cork->data, cork->data + consumed, cork->length - consumed);
+        cork->length -= consumed;
+        written      -= (ssize_t)consumed;
+    }
+    __account(cork, previousLength);
+
+    if (message && (size_t)written < message->index &&
+        __append(cork, (const uint8_t*)message->data + written, message->index - (size_t)written)) {
+        return -1;
+    }
+
+    if (cork->length) {
+        if (cork->length > VIOARR_CORK_MAX_PENDING) {
+            return __drop_client(cork);
+        }
+
+        if (!cork->blocked) {
+            cork->blocked = 1;
+            __wake_flusher();
+        }
+    }
+    return 0;
+}
+
+/**
+ * Looks up the cork state of the client and returns it locked, a new one is created if
+ * requested and none exists yet.
+ */
+static vioarr_cork_client_t* __get_locked(struct gracht_server_client* client, int create)
+{
+    vioarr_cork_client_t* cork;
+
+    mtx_lock(&g_cork.lock);
+    cork = list_find_value(&g_cork.clients, (void*)(intptr_t)client->handle);
+    if (!cork && create) {
+        cork = calloc(1, sizeof(vioarr_cork_client_t));
+        if (cork) {
+            mtx_init(&cork->lock, mtx_plain);
+            cork->client = client;
+            ELEMENT_INIT(&cork->header, (intptr_t)client->handle, cork);
+            list_append(&g_cork.clients, &cork->header);
+        }
+    }
+
+    if (cork) {
+        mtx_lock(&cork->lock);
+    }
+    mtx_unlock(&g_cork.lock);
+    return cork;
+}
+
+static int __touch(int handle)
+{
+    int i;
+    for (i = 0; i < g_corkTouchedCount; i++) {
+        if (g_corkTouched[i] == handle) {
+            return 0;
+        }
+    }
+
+    if (g_corkTouchedCount == CORK_MAX_TOUCHED) {
+        return -1;
+    }
+    g_corkTouched[g_corkTouchedCount++] = handle;
+    return 0;
+}
+
+static int __cork_send_client(struct gracht_server_client* client, struct gracht_buffer* message, unsigned int flags)
+{
+    vioarr_cork_client_t* cork;
+    int                   status;
+
+    // nothing is held back and nothing should be, which is the case for most input events
+    if (!g_corkDepth && !atomic_load(&g_cork.pending)) {
+        return g_cork.send_client(client, message, flags);
+    }
+
+    // clients with events that were not written yet are always tracked, so they are found here
+    cork = __get_locked(client, g_corkDepth);
+    if (!cork) {
+        return g_cork.send_client(client, message, flags);
+    }
+
+    // events sent outside a cork are written right away, after anything held back so the order
+    // is kept. So are events to a client that does not fit the touched list. A socket that did not
+    // take everything is not written to until the flusher finds it writable again.
+    if (cork->blocked) {
+        status = __append(cork, (const uint8_t*)message->data, message->index);
+        if (!status && cork->length > VIOARR_CORK_MAX_PENDING) {
+            status = __drop_client(cork);
+        }
+    }
+    else if (!g_corkDepth || (cork->length && vioarr_utils_time_us() - cork->since >= VIOARR_CORK_LATENCY) ||
+        cork->length + message->index > VIOARR_CORK_MAX_BYTES || __touch(client->handle) ||
+        __append(cork, (const uint8_t*)message->data, message->index)) {
+        status = __flush(cork, message);
+    }
+    else {
+        status = 0;
+    }
+    mtx_unlock(&cork->lock);
+    return status;
+}
+
+static void __cork_destroy_client(struct gracht_server_client* client)
+{
+    vioarr_cork_client_t* cork;
+
+    mtx_lock(&g_cork.lock);
+    cork = list_find_value(&g_cork.clients, (void*)(intptr_t)client->handle);
+    if (cork) {
+        list_remove(&g_cork.clients, &cork->header);
+
+        // wait for any flush in progress, events not written yet are lost with the client
+        mtx_lock(&cork->lock);
+        if (cork->length) {
+            atomic_fetch_sub(&g_cork.pending, 1);
+        }
+        mtx_unlock(&cork->lock);
+    }
+    mtx_unlock(&g_cork.lock);
+
+    if (cork) {
+        mtx_destroy(&cork->lock);
+        free(cork->data);
+        free(cork);
+    }
+    g_cork.destroy_client(client);
+}
+
+static void __flush_handle(int handle)
+{
+    vioarr_cork_client_t* cork;
+
+    mtx_lock(&g_cork.lock);
+    cork = list_find_value(&g_cork.clients, (void*)(intptr_t)handle);
+    if (cork) {
+        mtx_lock(&cork->lock);
+    }
+    mtx_unlock(&g_cork.lock);
+
+    if (cork) {
+        if (!cork->blocked && __flush(cork, NULL)) {
+            vioarr_utils_error(VISTR("[vioarr_cork] failed to flush events for client %i, errno %i"), handle, errno);
+        }
+        mtx_unlock(&cork->lock);
+    }
+}
+
+/**
+ * Writes the events of every client whose socket was blocked or that were held back for longer
+ * than the latency allows, even if the thread that holds them back is still corked. Returns the
+ * time until the next held back events are due, or -1 if none are, and collects the sockets that
+ * are still blocked.
+ */
+static int __flush_due(struct pollfd* fds, int* countInOut)
+{
+    uint64_t   now     = vioarr_utils_time_us();
+    int        timeout = -1;
+    element_t* i;
+
+    mtx_lock(&g_cork.lock);
+    _foreach(i, &g_cork.clients) {
+        vioarr_cork_client_t* cork = i->value;
+
+        mtx_lock(&cork->lock);
+        if (cork->length && (cork->blocked || now - cork->since >= VIOARR_CORK_LATENCY)) {
+            if (__flush(cork, NULL)) {
+                vioarr_utils_error(VISTR("[vioarr_cork] failed to flush events for client %i, errno %i"),
+                    cork->client->handle, errno);
+            }
+        }
+
+        if (cork->length) {
+            if (cork->blocked) {
+                if (*countInOut < 1 + CORK_MAX_POLLED) {
+                    fds[*countInOut].fd      = cork->client->handle;
+                    fds[*countInOut].events  = POLLOUT;
+                    fds[*countInOut].revents = 0;
+                    (*countInOut)++;
+                }
+                else {
+                    timeout = 1;
+                }
+            }
+            else {
+                int due = (int)((cork->since + VIOARR_CORK_LATENCY - now + 999) / 1000);
+                if (timeout < 0 || due < timeout) {
+                    timeout = due;
+                }
+            }
+        }
+        mtx_unlock(&cork->lock);
+    }
+    mtx_unlock(&g_cork.lock);
+    return timeout;
+}
+
+static int __flusher(void* context)
+{
+    struct pollfd fds[1 + CORK_MAX_POLLED];
+    uint64_t      value;
+    int           timeout = -1;
+    int           count;
+    (void)context;
+
+    while (1) {
+        fds[0].fd      = g_cork.wakeup;
+        fds[0].events  = POLLIN;
+        fds[0].revents = 0;
+        count          = 1;
+        if (atomic_load(&g_cork.pending)) {
+            timeout = __flush_due(&fds[0], &count);
+        }
+
+        if (poll(&fds[0], count, timeout) < 0 && errno != EINTR) {
+            vioarr_utils_error(VISTR("[vioarr_cork] flusher failed to poll, errno %i"), errno);
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            while (read(g_cork.wakeup, &value, sizeof(uint64_t)) > 0);
+        }
+        timeout = -1;
+    }
+    return 0;
+}
+
+int vioarr_cork_wrap(struct gracht_link* link)
+{
+    thrd_t thread;
+
+    if (!link) {
+        return -1;
+    }
+
+    // all links are wrapped with the same functions, and share the flusher
+    if (!g_cork.send_client) {
+        mtx_init(&g_cork.lock, mtx_plain);
+        atomic_init(&g_cork.pending, 0);
+        g_cork.send_client    = link->ops.send_client;
+        g_cork.destroy_client = link->ops.destroy_client;
+
+        g_cork.wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (g_cork.wakeup < 0 || thrd_create(&thread, __flusher, NULL) != thrd_success) {
+            vioarr_utils_error(VISTR("[vioarr_cork_wrap] failed to start the flusher"));
+            return -1;
+        }
+        thrd_detach(thread);
+    }
+
+    link->ops.send_client    = (link_send_client_fn)__cork_send_client;
+    link->ops.destroy_client = (link_destroy_client_fn)__cork_destroy_client;
+    return 0;
+}
+#else
+static void __flush_handle(int handle)
+{
+    (void)handle;
+}
+
+int vioarr_cork_wrap(struct gracht_link* link)
+{
+    (void)link;
+    return 0;
+}
+#endif
+
+void vioarr_cork_begin(void)
+{
+    g_corkDepth++;
+}
+
+void vioarr_cork_end(void)
+{
+    int i;
+
+    if (!g_corkDepth || --g_corkDepth) {
+        return;
+    }
+
+    for (i = 0; i < g_corkTouchedCount; i++) {
+        __flush_handle(g_corkTouched[i]);
+    }
+    g_corkTouchedCount = 0;
+}
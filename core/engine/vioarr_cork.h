@@ -0,0 +1,55 @@
+/* MollenOS
+ *
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+#ifndef __VIOARR_CORK_H__
+#define __VIOARR_CORK_H__
+
+struct gracht_link;
+
+/**
+ * Events sent by a thread while it is corked (during a frame or a dispatch cycle) are held
+ * back per client, and each client is flushed with a single write once the outermost cork
+ * is released. Events from threads that are not corked, like input, are sent right away and
+ * take anything held back for that client with them. Held back events are never kept for
+ * longer than VIOARR_CORK_LATENCY, a flusher thread writes them if the corked thread takes
+ * longer, or beyond VIOARR_CORK_MAX_BYTES per client.
+ *
+ * Writes never block. What the socket of a client does not take is kept in order, and the
+ * flusher writes it once the socket can take more. A client that leaves more than
+ * VIOARR_CORK_MAX_PENDING unread is disconnected.
+ */
+#define VIOARR_CORK_LATENCY     2000 // us
+#define VIOARR_CORK_MAX_BYTES   (64 * 1024)
+#define VIOARR_CORK_MAX_PENDING (4 * 1024 * 1024)
+
+/**
+ * vioarr_cork_wrap
+ * * Installs corking on a stream based socket link, must be called before the link is
+ * * added to the server. Links that are not wrapped send their events immediately.
+ */
+int  vioarr_cork_wrap(struct gracht_link* link);
+void vioarr_cork_begin(void);
+void vioarr_cork_end(void);
+
+#endif //!__VIOARR_CORK_H__
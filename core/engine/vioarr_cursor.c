@@ -0,0 +1,250 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#include "screen/vioarr_screen_formats.h"
+#include "vioarr_cursor.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct vioarr_cursor {
+    const vioarr_screen_format_t* format;
+    void*                         owner;
+    int                           width;
+    int                           height;
+    int                           visible;
+    int                           x;
+    int                           y;
+    int                           opacity; // 0-256
+    int                           dirty;   // image or position changed since the cursor was drawn
+
+    // the area of the target that currently shows the cursor, and the pixels beneath it
+    int                           shown;
+    vioarr_drawlist_rect_t        shown_rect;
+    uint8_t                       save_under[VIOARR_CURSOR_MAX_SIZE * VIOARR_CURSOR_MAX_SIZE * 4];
+    uint32_t                      pixels[VIOARR_CURSOR_MAX_SIZE * VIOARR_CURSOR_MAX_SIZE];
+} vioarr_cursor_t;
+
+vioarr_cursor_t* vioarr_cursor_create(const vioarr_screen_format_t* format)
+{
+    vioarr_cursor_t* cursor;
+
+    if (!format || format->bytes_per_pixel < 2 || format->bytes_per_pixel > 4) {
+        return NULL;
+    }
+
+    cursor = malloc(sizeof(vioarr_cursor_t));
+    if (!cursor) {
+        return NULL;
+    }
+
+    memset(cursor, 0, sizeof(vioarr_cursor_t));
+    cursor->format  = format;
+    cursor->opacity = 256;
+    return cursor;
+}
+
+void vioarr_cursor_destroy(vioarr_cursor_t* cursor)
+{
+    free(cursor);
+}
+
+uint32_t* vioarr_cursor_pixels(vioarr_cursor_t* cursor)
+{
+    if (!cursor) {
+        return NULL;
+    }
+    return &cursor->pixels[0];
+}
+
+void* vioarr_cursor_owner(vioarr_cursor_t* cursor)
+{
+    if (!cursor) {
+        return NULL;
+    }
+    return cursor->owner;
+}
+
+void vioarr_cursor_set_image(vioarr_cursor_t* cursor, void* owner, int width, int height)
+{
+    if (!cursor) {
+        return;
+    }
+
+    cursor->owner  = owner;
+    cursor->width  = width < VIOARR_CURSOR_MAX_SIZE ? width : VIOARR_CURSOR_MAX_SIZE;
+    cursor->height = height < VIOARR_CURSOR_MAX_SIZE ? height : VIOARR_CURSOR_MAX_SIZE;
+    cursor->dirty  = 1;
+}
+
+void vioarr_cursor_move(vioarr_cursor_t* cursor, int visible, int x, int y, float opacity)
+{
+    int alpha = (int)(opacity * 256.0f);
+
+    if (!cursor) {
+        return;
+    }
+
+    if (cursor->visible != visible || cursor->x != x || cursor->y != y || cursor->opacity != alpha) {
+        cursor->visible = visible;
+        cursor->x       = x;
+        cursor->y       = y;
+        cursor->opacity = alpha;
+        cursor->dirty   = 1;
+    }
+}
+
+static int __intersects(const vioarr_drawlist_rect_t* a, const vioarr_drawlist_rect_t* b)
+{
+    return a->x < (b->x + b->width) && (a->x + a->width) > b->x &&
+        a->y < (b->y + b->height) && (a->y + a->height) > b->y;
+}
+
+static void __copy_rect(uint8_t* target, int targetStride, const uint8_t* source, int sourceStride,
+    int rows, size_t length)
+{
+    int y;
+    for (y = 0; y < rows; y++) {
+        memcpy(target + ((size_t)y * targetStride), source + ((size_t)y * sourceStride), length);
+    }
+}
+
+int vioarr_cursor_begin(vioarr_cursor_t* cursor, uint8_t* target, int stride, const vioarr_drawlist_rect_t* damage)
+{
+    int bpp;
+    int redraw;
+
+    if (!cursor || !target) {
+        return 0;
+    }
+
+    redraw = cursor->dirty || (cursor->shown && damage && __intersects(&cursor->shown_rect, damage));
+    if (redraw && cursor->shown) {
+        bpp = cursor->format->bytes_per_pixel;
+        __copy_rect(target + ((size_t)cursor->shown_rect.y * stride) + ((size_t)cursor->shown_rect.x * bpp),
+            stride, &cursor->save_under[0], cursor->shown_rect.width * bpp,
+            cursor->shown_rect.height, (size_t)cursor->shown_rect.width * bpp);
+        cursor->shown = 0;
+    }
+    return redraw;
+}
+
+static inline uint32_t __load_pixel(const uint8_t* pixel, int bpp)
+{
+    uint32_t value = (uint32_t)pixel[0] | ((uint32_t)pixel[1] << 8);
+    if (bpp > 2) {
+        value |= (uint32_t)pixel[2] << 16;
+    }
+    if (bpp > 3) {
+        value |= (uint32_t)pixel[3] << 24;
+    }
+    return value;
+}
+
+static inline void __store_pixel(uint8_t* pixel, int bpp, uint32_t value)
+{
+    pixel[0] = value & 0xFF;
+    pixel[1] = (value >> 8) & 0xFF;
+    if (bpp > 2) {
+        pixel[2] = (value >> 16) & 0xFF;
+    }
+    if (bpp > 3) {
+        pixel[3] = (value >> 24) & 0xFF;
+    }
+}
+
+/**
+ * Blends a premultiplied cursor pixel over a target pixel of the screen format. Channels are
+ * widened to 8 bits for the blend, and the reserved channel of the target is left untouched.
+ */
+static uint32_t __blend_pixel(const vioarr_screen_format_t* format, uint32_t target, uint32_t source, int opacity)
+{
+    static const int shifts[3] = { 16, 8, 0 };
+    uint32_t         alpha     = ((source >> 24) * opacity) >> 8;
+    int              i;
+
+    for (i = 0; i < 3; i++) {
+        int      bits     = format->color_bits[i];
+        int      position = format->color_positions[i];
+        uint32_t mask     = (1u << bits) - 1;
+        uint32_t color    = (target >> position) & mask;
+        uint32_t cursor   = (((source >> shifts[i]) & 0xFF) * opacity) >> 8;
+
+        color  = (color << (8 - bits)) | (color >> (2 * bits - 8));
+        color  = cursor + ((color * (255 - alpha)) / 255);
+        target = (target & ~(mask << position)) | ((color >> (8 - bits)) << position);
+    }
+    return target;
+}
+
+void vioarr_cursor_end(vioarr_cursor_t* cursor, uint8_t* target, int stride, int width, int height)
+{
+    vioarr_drawlist_rect_t rect;
+    uint8_t                row[VIOARR_CURSOR_MAX_SIZE * 4];
+    int                    bpp;
+    int                    x, y;
+
+    if (!cursor || !target) {
+        return;
+    }
+
+    cursor->dirty = 0;
+    if (!cursor->visible || !cursor->width || !cursor->height || !cursor->opacity) {
+        return;
+    }
+
+    // clip the cursor against the target
+    rect.x      = cursor->x < 0 ? 0 : cursor->x;
+    rect.y      = cursor->y < 0 ? 0 : cursor->y;
+    rect.width  = ((cursor->x + cursor->width) > width ? width : (cursor->x + cursor->width)) - rect.x;
+    rect.height = ((cursor->y + cursor->height) > height ? height : (cursor->y + cursor->height)) - rect.y;
+    if (rect.width <= 0 || rect.height <= 0) {
+        return;
+    }
+
+    bpp = cursor->format->bytes_per_pixel;
+    target += ((size_t)rect.y * stride) + ((size_t)rect.x * bpp);
+
+    // save the pixels under the cursor before blending it, the blended rows are built in a
+    // local row so the target, which is usually write combined, is only written sequentially
+    __copy_rect(&cursor->save_under[0], rect.width * bpp, target, stride, rect.height, (size_t)rect.width * bpp);
+    for (y = 0; y < rect.height; y++) {
+        const uint8_t*  saved  = &cursor->save_under[(size_t)y * rect.width * bpp];
+        const uint32_t* source = &cursor->pixels[((size_t)(rect.y - cursor->y + y) * VIOARR_CURSOR_MAX_SIZE) + (rect.x - cursor->x)];
+
+        for (x = 0; x < rect.width; x++) {
+            uint32_t pixel = source[x];
+            if (!(pixel >> 24)) {
+                memcpy(&row[x * bpp], &saved[x * bpp], bpp);
+                continue;
+            }
+            __store_pixel(&row[x * bpp], bpp,
+                __blend_pixel(cursor->format, __load_pixel(&saved[x * bpp], bpp), pixel, cursor->opacity));
+        }
+        memcpy(target + ((size_t)y * stride), &row[0], (size_t)rect.width * bpp);
+    }
+
+    cursor->shown      = 1;
+    cursor->shown_rect = rect;
+}
@@ -0,0 +1,66 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#ifndef __VIOARR_CURSOR_H__
+#define __VIOARR_CURSOR_H__
+
+#include "vioarr_drawlist.h"
+#include <stdint.h>
+
+#define VIOARR_CURSOR_MAX_SIZE 64
+
+typedef struct vioarr_cursor        vioarr_cursor_t;
+typedef struct vioarr_screen_format vioarr_screen_format_t;
+
+/**
+ * The cursor plane keeps the cursor out of the composed frame. Screens that present by copying
+ * the frame into a target attach a plane to their renderer, which then hands the cursor image
+ * and position to the plane instead of drawing it. When presenting, the pixels under the cursor
+ * are saved before it is blended into the target, so moving the cursor over an unchanged frame
+ * only restores the old cursor rect and blends the new one.
+ */
+vioarr_cursor_t* vioarr_cursor_create(const vioarr_screen_format_t* format);
+void             vioarr_cursor_destroy(vioarr_cursor_t*);
+
+/**
+ * Renderer side. The image is written directly into the pixels of the plane, which are
+ * VIOARR_CURSOR_MAX_SIZE pixels wide, premultiplied 0xAARRGGBB. The owner identifies the
+ * surface the image was read from.
+ */
+uint32_t* vioarr_cursor_pixels(vioarr_cursor_t*);
+void*     vioarr_cursor_owner(vioarr_cursor_t*);
+void      vioarr_cursor_set_image(vioarr_cursor_t*, void* owner, int width, int height);
+void      vioarr_cursor_move(vioarr_cursor_t*, int visible, int x, int y, float opacity);
+
+/**
+ * Screen side, brackets the copy of the frame damage into the target. Begin takes the cursor
+ * off the target if it must be drawn again, which is the case when it changed or when the
+ * damage overlaps it, and returns whether end has to be called. Both run on the render
+ * thread of the screen, after the frame has been rendered.
+ */
+int  vioarr_cursor_begin(vioarr_cursor_t*, uint8_t* target, int stride, const vioarr_drawlist_rect_t* damage);
+void vioarr_cursor_end(vioarr_cursor_t*, uint8_t* target, int stride, int width, int height);
+
+#endif //!__VIOARR_CURSOR_H__
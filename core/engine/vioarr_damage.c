@@ -0,0 +1,185 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#include "vioarr_damage.h"
+
+static long long __area(const vioarr_drawlist_rect_t* rect)
+{
+    return (long long)rect->width * rect->height;
+}
+
+static void __union(vioarr_drawlist_rect_t* a, const vioarr_drawlist_rect_t* b, vioarr_drawlist_rect_t* out)
+{
+    int x1 = a->x < b->x ? a->x : b->x;
+    int y1 = a->y < b->y ? a->y : b->y;
+    int x2 = (a->x + a->width) > (b->x + b->width) ? (a->x + a->width) : (b->x + b->width);
+    int y2 = (a->y + a->height) > (b->y + b->height) ? (a->y + a->height) : (b->y + b->height);
+
+    out->x      = x1;
+    out->y      = y1;
+    out->width  = x2 - x1;
+    out->height = y2 - y1;
+}
+
+static int __contains(const vioarr_drawlist_rect_t* a, const vioarr_drawlist_rect_t* b)
+{
+    return b->x >= a->x && b->y >= a->y &&
+        (b->x + b->width) <= (a->x + a->width) &&
+        (b->y + b->height) <= (a->y + a->height);
+}
+
+static void __remove(vioarr_damage_t* damage, int index)
+{
+    damage->rects[index] = damage->rects[--damage->count];
+}
+
+void vioarr_damage_zero(vioarr_damage_t* damage)
+{
+    if (damage) {
+        damage->count = 0;
+    }
+}
+
+int vioarr_damage_is_zero(vioarr_damage_t* damage)
+{
+    return !damage || !damage->count;
+}
+
+/**
+ * Adds a rectangle to the damage. It is merged with the first rectangle the union of them
+ * covers no more than the two of them do on their own, and once the list is full it is merged
+ * with the rectangle that grows the least.
+ */
+void vioarr_damage_add(vioarr_damage_t* damage, int x, int y, int width, int height)
+{
+    vioarr_drawlist_rect_t rect = { x, y, width, height };
+    int                    best = -1;
+    long long              bestGrowth = 0;
+    int                    i;
+
+    if (!damage || width <= 0 || height <= 0) {
+        return;
+    }
+
+    for (i = 0; i < damage->count; i++) {
+        vioarr_drawlist_rect_t merged;
+        long long              growth;
+
+        if (__contains(&damage->rects[i], &rect)) {
+            return;
+        }
+
+        __union(&damage->rects[i], &rect, &merged);
+        growth = __area(&merged) - __area(&damage->rects[i]) - __area(&rect);
+        if (best < 0 || growth < bestGrowth) {
+            best       = i;
+            bestGrowth = growth;
+        }
+    }
+
+    // a merged rectangle can swallow others, so it is added again as the new rectangle
+    if (best >= 0 && (bestGrowth <= 0 || damage->count == VIOARR_DAMAGE_MAX_RECTS)) {
+        vioarr_drawlist_rect_t merged;
+
+        __union(&damage->rects[best], &rect, &merged);
+        __remove(damage, best);
+        vioarr_damage_add(damage, merged.x, merged.y, merged.width, merged.height);
+        return;
+    }
+
+    for (i = 0; i < damage->count;) {
+        if (__contains(&rect, &damage->rects[i])) {
+            __remove(damage, i);
+            continue;
+        }
+        i++;
+    }
+    damage->rects[damage->count++] = rect;
+}
+
+/**
+ * Limits all the rectangles to the given area, rectangles outside it are removed.
+ */
+void vioarr_damage_clip(vioarr_damage_t* damage, int x, int y, int width, int height)
+{
+    int i;
+
+    if (!damage) {
+        return;
+    }
+
+    for (i = 0; i < damage->count;) {
+        vioarr_drawlist_rect_t* rect = &damage->rects[i];
+        int                     x1   = rect->x > x ? rect->x : x;
+        int                     y1   = rect->y > y ? rect->y : y;
+        int                     x2   = (rect->x + rect->width) < (x + width) ? (rect->x + rect->width) : (x + width);
+        int                     y2   = (rect->y + rect->height) < (y + height) ? (rect->y + rect->height) : (y + height);
+
+        if (x2 <= x1 || y2 <= y1) {
+            __remove(damage, i);
+            continue;
+        }
+
+        rect->x      = x1;
+        rect->y      = y1;
+        rect->width  = x2 - x1;
+        rect->height = y2 - y1;
+        i++;
+    }
+}
+
+void vioarr_damage_merge(vioarr_damage_t* damage, vioarr_damage_t* other)
+{
+    int i;
+
+    if (!damage || !other) {
+        return;
+    }
+
+    for (i = 0; i < other->count; i++) {
+        vioarr_damage_add(damage, other->rects[i].x, other->rects[i].y,
+            other->rects[i].width, other->rects[i].height);
+    }
+}
+
+void vioarr_damage_bounds(vioarr_damage_t* damage, vioarr_drawlist_rect_t* boundsOut)
+{
+    vioarr_drawlist_rect_t bounds = { 0 };
+    int                    i;
+
+    if (!damage || !boundsOut) {
+        return;
+    }
+
+    for (i = 0; i < damage->count; i++) {
+        if (!i) {
+            bounds = damage->rects[0];
+        }
+        else {
+            __union(&bounds, &damage->rects[i], &bounds);
+        }
+    }
+    *boundsOut = bounds;
+}
@@ -0,0 +1,53 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#ifndef __VIOARR_DAMAGE_H__
+#define __VIOARR_DAMAGE_H__
+
+#include "vioarr_drawlist.h"
+
+/**
+ * The number of rectangles a damage list holds before rectangles are merged, which keeps
+ * the cost of partial uploads and copies bounded no matter how much a client invalidates.
+ */
+#define VIOARR_DAMAGE_MAX_RECTS 8
+
+/**
+ * A list of damaged rectangles. Overlapping rectangles and rectangles that are cheaper to
+ * handle as one are merged when added, so the list never covers much more than what was added.
+ */
+typedef struct vioarr_damage {
+    int                    count;
+    vioarr_drawlist_rect_t rects[VIOARR_DAMAGE_MAX_RECTS];
+} vioarr_damage_t;
+
+void vioarr_damage_zero(vioarr_damage_t*);
+int  vioarr_damage_is_zero(vioarr_damage_t*);
+void vioarr_damage_add(vioarr_damage_t*, int x, int y, int width, int height);
+void vioarr_damage_merge(vioarr_damage_t*, vioarr_damage_t* other);
+void vioarr_damage_clip(vioarr_damage_t*, int x, int y, int width, int height);
+void vioarr_damage_bounds(vioarr_damage_t*, vioarr_drawlist_rect_t* boundsOut);
+
+#endif //!__VIOARR_DAMAGE_H__
@@ -0,0 +1,349 @@
+/* MollenOS
+ *
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+#include "vioarr_cork.h"
+#include "vioarr_dispatch.h"
+#include "vioarr_quota.h"
+#include "vioarr_utils.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#define DISPATCH_QUEUE_SIZE 256
+#define DISPATCH_MAX_IODS   4096
+#define DISPATCH_MAX_PARKED 64
+
+// the events every connection is watched for, which is what the links register them with
+#define DISPATCH_CONNECTION_EVENTS (EPOLLIN | EPOLLRDHUP)
+
+#define IOD_UNKNOWN    0
+#define IOD_LISTENER   1
+#define IOD_CONNECTION 2
+
+typedef struct vioarr_dispatch_item {
+    int          iod;
+    unsigned int events;
+} vioarr_dispatch_item_t;
+
+// a connection that exceeded its message rate, and is not watched until the window is over
+typedef struct vioarr_dispatch_parked {
+    int      iod;
+    uint64_t until;
+} vioarr_dispatch_parked_t;
+
+typedef struct vioarr_dispatch_worker {
+    thrd_t                 thread;
+    mtx_t                  lock;
+    cnd_t                  signal;
+    int                    head;
+    int                    count;
+    vioarr_dispatch_item_t queue[DISPATCH_QUEUE_SIZE];
+} vioarr_dispatch_worker_t;
+
+static struct {
+    int                      event_iod;
+    vioarr_dispatch_fn       handler;
+    mtx_t                    handler_lock;
+    int                      worker_count;
+    vioarr_dispatch_worker_t workers[VIOARR_DISPATCH_MAX_WORKERS];
+    atomic_char              kinds[DISPATCH_MAX_IODS];
+    int                      timer_iod;
+    mtx_t                    parked_lock;
+    int                      parked_count;
+    vioarr_dispatch_parked_t parked[DISPATCH_MAX_PARKED];
+} g_dispatch;
+
+// set while the calling thread holds the handler lock, and while it gave it up to run in parallel
+static _Thread_local int g_dispatchHeld     = 0;
+static _Thread_local int g_dispatchReleased = 0;
+
+static void __handle(int iod, unsigned int events)
+{
+    // gracht does not promise that its server can be entered by several threads, so the requests
+    // are received and decoded one at a time. The handlers give up the lock for the work that does
+    // not need the message anymore, and the events sent while handling them are flushed to each
+    // client once the lock is released.
+    vioarr_cork_begin();
+    mtx_lock(&g_dispatch.handler_lock);
+    g_dispatchHeld = 1;
+    g_dispatch.handler(iod, events);
+    g_dispatchHeld = 0;
+    mtx_unlock(&g_dispatch.handler_lock);
+    vioarr_cork_end();
+}
+
+void vioarr_dispatch_parallel_begin(void)
+{
+    if (g_dispatchHeld) {
+        g_dispatchHeld     = 0;
+        g_dispatchReleased = 1;
+        mtx_unlock(&g_dispatch.handler_lock);
+    }
+}
+
+void vioarr_dispatch_parallel_end(void)
+{
+    if (g_dispatchReleased) {
+        mtx_lock(&g_dispatch.handler_lock);
+        g_dispatchReleased = 0;
+        g_dispatchHeld     = 1;
+    }
+}
+
+static int __iod_kind(int iod)
+{
+    socklen_t length    = sizeof(int);
+    int       accepting = 0;
+    int       kind;
+
+    if (iod >= 0 && iod < DISPATCH_MAX_IODS) {
+        kind = atomic_load(&g_dispatch.kinds[iod]);
+        if (kind != IOD_UNKNOWN) {
+            return kind;
+        }
+    }
+
+    // connections of the ring link are not sockets, and are never listening
+    if (!getsockopt(iod, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &length) && accepting) {
+        kind = IOD_LISTENER;
+    }
+    else {
+        kind = IOD_CONNECTION;
+    }
+
+    if (iod >= 0 && iod < DISPATCH_MAX_IODS) {
+        atomic_store(&g_dispatch.kinds[iod], (char)kind);
+    }
+    return kind;
+}
+
+static void __watch(int iod, unsigned int events)
+{
+    struct epoll_event event = { .events = events, .data.fd = iod };
+
+    // the connection may have been closed by the handler
+    if (epoll_ctl(g_dispatch.event_iod, EPOLL_CTL_MOD, iod, &event) && errno != ENOENT && errno != EBADF) {
+        vioarr_utils_error(VISTR("[vioarr_dispatch] failed to watch connection %i, errno %i"), iod, errno);
+    }
+}
+
+// must be called with the parked lock held
+static void __arm_parked_timer(void)
+{
+    struct itimerspec spec  = { 0 };
+    uint64_t          until = 0;
+    int               i;
+
+    for (i = 0; i < g_dispatch.parked_count; i++) {
+        if (!until || g_dispatch.parked[i].until < until) {
+            until = g_dispatch.parked[i].until;
+        }
+    }
+
+    // the timer uses the same clock as vioarr_utils_time_us, a zero time disarms it
+    spec.it_value.tv_sec  = (time_t)(until / 1000000);
+    spec.it_value.tv_nsec = (long)(until % 1000000) * 1000;
+    timerfd_settime(g_dispatch.timer_iod, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+static int __park(int iod, uint64_t until)
+{
+    if (g_dispatch.timer_iod < 0) {
+        return -1;
+    }
+
+    mtx_lock(&g_dispatch.parked_lock);
+    if (g_dispatch.parked_count == DISPATCH_MAX_PARKED) {
+        mtx_unlock(&g_dispatch.parked_lock);
+        return -1;
+    }
+
+    g_dispatch.parked[g_dispatch.parked_count++] = (vioarr_dispatch_parked_t) { iod, until };
+    __arm_parked_timer();
+    mtx_unlock(&g_dispatch.parked_lock);
+    return 0;
+}
+
+static void __unpark(int iod)
+{
+    int i;
+
+    mtx_lock(&g_dispatch.parked_lock);
+    for (i = 0; i < g_dispatch.parked_count; i++) {
+        if (g_dispatch.parked[i].iod == iod) {
+            g_dispatch.parked[i] = g_dispatch.parked[--g_dispatch.parked_count];
+            break;
+        }
+    }
+    mtx_unlock(&g_dispatch.parked_lock);
+}
+
+static void __resume_parked(void)
+{
+    uint64_t expirations;
+    uint64_t now = vioarr_utils_time_us();
+    int      i   = 0;
+
+    while (read(g_dispatch.timer_iod, &expirations, sizeof(uint64_t)) > 0);
+
+    mtx_lock(&g_dispatch.parked_lock);
+    while (i < g_dispatch.parked_count) {
+        if (g_dispatch.parked[i].until <= now) {
+            __watch(g_dispatch.parked[i].iod, DISPATCH_CONNECTION_EVENTS);
+            g_dispatch.parked[i] = g_dispatch.parked[--g_dispatch.parked_count];
+        }
+        else {
+            i++;
+        }
+    }
+    __arm_parked_timer();
+    mtx_unlock(&g_dispatch.parked_lock);
+}
+
+static int __worker(void* context)
+{
+    vioarr_dispatch_worker_t* worker = context;
+    vioarr_dispatch_item_t    item;
+
+    while (1) {
+        mtx_lock(&worker->lock);
+        while (!worker->count) {
+            cnd_wait(&worker->signal, &worker->lock);
+        }
+        item = worker->queue[worker->head];
+        worker->head = (worker->head + 1) % DISPATCH_QUEUE_SIZE;
+        worker->count--;
+        mtx_unlock(&worker->lock);
+
+        __handle(item.iod, item.events);
+
+        // the connection is only watched again once all of its requests are handled, unless
+        // the client disconnected while handling them. Clients that exceed their message rate
+        // are not read from again until their window is over.
+        if (item.iod >= DISPATCH_MAX_IODS || atomic_load(&g_dispatch.kinds[item.iod]) == IOD_CONNECTION) {
+            uint64_t until = vioarr_quota_throttled(item.iod);
+            if (!until || __park(item.iod, until)) {
+                __watch(item.iod, DISPATCH_CONNECTION_EVENTS);
+            }
+        }
+    }
+    return 0;
+}
+
+int vioarr_dispatch_initialize(int eventIod, vioarr_dispatch_fn handler)
+{
+    const char* workers = getenv("VIOARR_WORKERS");
+    int         i;
+
+    g_dispatch.event_iod    = eventIod;
+    g_dispatch.handler      = handler;
+    mtx_init(&g_dispatch.handler_lock, mtx_plain);
+    g_dispatch.worker_count = workers ? atoi(workers) : VIOARR_DISPATCH_DEFAULT_WORKERS;
+    if (g_dispatch.worker_count < 0) {
+        g_dispatch.worker_count = 0;
+    }
+    else if (g_dispatch.worker_count > VIOARR_DISPATCH_MAX_WORKERS) {
+        g_dispatch.worker_count = VIOARR_DISPATCH_MAX_WORKERS;
+    }
+
+    for (i = 0; i < DISPATCH_MAX_IODS; i++) {
+        atomic_init(&g_dispatch.kinds[i], IOD_UNKNOWN);
+    }
+
+    // connections that are throttled are watched again when the timer expires, without the
+    // timer they are never throttled
+    mtx_init(&g_dispatch.parked_lock, mtx_plain);
+    g_dispatch.parked_count = 0;
+    g_dispatch.timer_iod    = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (g_dispatch.timer_iod >= 0) {
+        struct epoll_event event = { .events = EPOLLIN, .data.fd = g_dispatch.timer_iod };
+        if (epoll_ctl(eventIod, EPOLL_CTL_ADD, g_dispatch.timer_iod, &event)) {
+            close(g_dispatch.timer_iod);
+            g_dispatch.timer_iod = -1;
+        }
+    }
+
+    for (i = 0; i < g_dispatch.worker_count; i++) {
+        vioarr_dispatch_worker_t* worker = &g_dispatch.workers[i];
+
+        mtx_init(&worker->lock, mtx_plain);
+        cnd_init(&worker->signal);
+        worker->head  = 0;
+        worker->count = 0;
+        if (thrd_create(&worker->thread, __worker, worker) != thrd_success) {
+            vioarr_utils_error(VISTR("[vioarr_dispatch_initialize] failed to start worker %i"), i);
+            return -1;
+        }
+    }
+
+    vioarr_utils_trace(VISTR("[vioarr_dispatch_initialize] dispatching requests on %i workers"), g_dispatch.worker_count);
+    return 0;
+}
+
+void vioarr_dispatch_event(int iod, unsigned int events)
+{
+    vioarr_dispatch_worker_t* worker;
+
+    if (iod == g_dispatch.timer_iod) {
+        __resume_parked();
+        return;
+    }
+
+    if (!g_dispatch.worker_count || __iod_kind(iod) == IOD_LISTENER) {
+        __handle(iod, events);
+        return;
+    }
+
+    // stop watching the connection until the worker is done with it, so there is never
+    // more than one queued item per connection
+    __watch(iod, 0);
+
+    worker = &g_dispatch.workers[(unsigned int)iod % (unsigned int)g_dispatch.worker_count];
+    mtx_lock(&worker->lock);
+    if (worker->count == DISPATCH_QUEUE_SIZE) {
+        mtx_unlock(&worker->lock);
+        __handle(iod, events);
+        if (__iod_kind(iod) == IOD_CONNECTION) {
+            __watch(iod, DISPATCH_CONNECTION_EVENTS);
+        }
+        return;
+    }
+
+    worker->queue[(worker->head + worker->count) % DISPATCH_QUEUE_SIZE] = (vioarr_dispatch_item_t) { iod, events };
+    worker->count++;
+    cnd_signal(&worker->signal);
+    mtx_unlock(&worker->lock);
+}
+
+void vioarr_dispatch_disconnect(int iod)
+{
+    if (iod >= 0 && iod < DISPATCH_MAX_IODS) {
+        atomic_store(&g_dispatch.kinds[iod], IOD_UNKNOWN);
+    }
+    __unpark(iod);
+}
@@ -0,0 +1,64 @@
+/* MollenOS
+ *
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+#ifndef __VIOARR_DISPATCH_H__
+#define __VIOARR_DISPATCH_H__
+
+/**
+ * Client connections are handled by a pool of workers. Each connection is always handled by
+ * the same worker, and it is not watched again until that worker is done with it, which keeps
+ * the requests of a client in order. The gracht server is not known to be reentrant, so the
+ * requests are received and decoded one at a time. The engine state has its own locks, so the
+ * handlers that do real work copy what they need from the message and run that work in parallel
+ * (vioarr_dispatch_parallel_begin/end), and the events sent while handling them are flushed to
+ * each client in parallel, so a client that is slow to read only delays itself. Handlers that
+ * use the objects of other clients stay serialized, as those clients may disconnect meanwhile.
+ * Listening connections are handled by the thread that waits for events. The number of workers
+ * is set by the VIOARR_WORKERS environment variable, 0 handles everything on the waiting thread.
+ * Connections of clients that exceed their message rate (vioarr_quota) are not watched again
+ * until the rest of the second has passed.
+ */
+#define VIOARR_DISPATCH_DEFAULT_WORKERS 4
+#define VIOARR_DISPATCH_MAX_WORKERS     16
+
+typedef void (*vioarr_dispatch_fn)(int iod, unsigned int events);
+
+int  vioarr_dispatch_initialize(int eventIod, vioarr_dispatch_fn handler);
+void vioarr_dispatch_event(int iod, unsigned int events);
+void vioarr_dispatch_disconnect(int iod);
+
+/**
+ * Lets the requests of other clients be handled while the calling handler works. Nothing that
+ * points into the message may be used between the two, including the message itself. Only the
+ * linux server dispatches on workers, elsewhere the requests are handled on a single thread.
+ */
+#if !defined(MOLLENOS) && !defined(_WIN32)
+void vioarr_dispatch_parallel_begin(void);
+void vioarr_dispatch_parallel_end(void);
+#else
+#define vioarr_dispatch_parallel_begin()
+#define vioarr_dispatch_parallel_end()
+#endif
+
+#endif //!__VIOARR_DISPATCH_H__
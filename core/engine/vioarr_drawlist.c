@@ -0,0 +1,221 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#include "vioarr_drawlist.h"
+#include "vioarr_manager.h"
+#include "vioarr_region.h"
+#include "vioarr_surface.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DRAWLIST_INITIAL_CAPACITY 32
+
+#define __RESIZE_ARRAY(array, capacity) do { \
+        void* resized = realloc(array, sizeof(*(array)) * (capacity)); \
+        if (!resized) return -1; \
+        (array) = resized; \
+    } while (0)
+
+static int __grow(vioarr_drawlist_t* drawList)
+{
+    int capacity = drawList->capacity ? (drawList->capacity * 2) : DRAWLIST_INITIAL_CAPACITY;
+
+    __RESIZE_ARRAY(drawList->surfaces, capacity);
+    __RESIZE_ARRAY(drawList->parents, capacity);
+    __RESIZE_ARRAY(drawList->levels, capacity);
+    __RESIZE_ARRAY(drawList->rects, capacity);
+    __RESIZE_ARRAY(drawList->clips, capacity);
+    __RESIZE_ARRAY(drawList->opacity, capacity);
+    __RESIZE_ARRAY(drawList->flags, capacity);
+    drawList->capacity = capacity;
+    return 0;
+}
+
+static inline void __intersect(vioarr_drawlist_rect_t* rect, vioarr_drawlist_rect_t* clip)
+{
+    int x1 = rect->x > clip->x ? rect->x : clip->x;
+    int y1 = rect->y > clip->y ? rect->y : clip->y;
+    int x2 = (rect->x + rect->width) < (clip->x + clip->width) ? (rect->x + rect->width) : (clip->x + clip->width);
+    int y2 = (rect->y + rect->height) < (clip->y + clip->height) ? (rect->y + rect->height) : (clip->y + clip->height);
+
+    rect->x      = x1;
+    rect->y      = y1;
+    rect->width  = x2 > x1 ? (x2 - x1) : 0;
+    rect->height = y2 > y1 ? (y2 - y1) : 0;
+}
+
+void vioarr_drawlist_construct(vioarr_drawlist_t* drawList)
+{
+    if (!drawList) {
+        return;
+    }
+    memset(drawList, 0, sizeof(vioarr_drawlist_t));
+}
+
+void vioarr_drawlist_destroy(vioarr_drawlist_t* drawList)
+{
+    if (!drawList) {
+        return;
+    }
+
+    free(drawList->surfaces);
+    free(drawList->parents);
+    free(drawList->levels);
+    free(drawList->rects);
+    free(drawList->clips);
+    free(drawList->opacity);
+    free(drawList->flags);
+    memset(drawList, 0, sizeof(vioarr_drawlist_t));
+}
+
+void vioarr_drawlist_reset(vioarr_drawlist_t* drawList)
+{
+    if (!drawList) {
+        return;
+    }
+    drawList->count = 0;
+    drawList->generation++;
+}
+
+/**
+ * Copies the entries and geometry of the source, the copy keeps the generation of the source
+ * so users of the copy can tell when the entries were rebuilt.
+ */
+int vioarr_drawlist_copy(vioarr_drawlist_t* drawList, vioarr_drawlist_t* source)
+{
+    if (!drawList || !source) {
+        return -1;
+    }
+
+    while (drawList->capacity < source->count) {
+        if (__grow(drawList)) {
+            return -1;
+        }
+    }
+
+    if (source->count) {
+        memcpy(drawList->surfaces, source->surfaces, sizeof(*source->surfaces) * source->count);
+        memcpy(drawList->parents, source->parents, sizeof(*source->parents) * source->count);
+        memcpy(drawList->levels, source->levels, sizeof(*source->levels) * source->count);
+        memcpy(drawList->rects, source->rects, sizeof(*source->rects) * source->count);
+        memcpy(drawList->clips, source->clips, sizeof(*source->clips) * source->count);
+        memcpy(drawList->opacity, source->opacity, sizeof(*source->opacity) * source->count);
+        memcpy(drawList->flags, source->flags, sizeof(*source->flags) * source->count);
+    }
+    drawList->count      = source->count;
+    drawList->generation = source->generation;
+    return 0;
+}
+
+int vioarr_drawlist_append(vioarr_drawlist_t* drawList, vioarr_surface_t* surface, int parent, int level)
+{
+    int index;
+
+    if (!drawList || !surface) {
+        return -1;
+    }
+
+    if (drawList->count == drawList->capacity && __grow(drawList)) {
+        return -1;
+    }
+
+    index = drawList->count++;
+    drawList->surfaces[index] = surface;
+    drawList->parents[index]  = parent;
+    drawList->levels[index]   = level;
+    drawList->opacity[index]  = 1.0f;
+    drawList->flags[index]    = (level == SURFACE_LEVELS - 1) ? VIOARR_DRAWLIST_CURSOR : 0;
+    memset(&drawList->rects[index], 0, sizeof(vioarr_drawlist_rect_t));
+    memset(&drawList->clips[index], 0, sizeof(vioarr_drawlist_rect_t));
+    return index;
+}
+
+/**
+ * Refreshes the geometry, visibility and texture of all entries. Parents are always
+ * placed before their children, which means a single forward pass is enough to resolve
+ * screen space positions and clips.
+ */
+void vioarr_drawlist_update(vioarr_drawlist_t* drawList)
+{
+    int i;
+
+    if (!drawList) {
+        return;
+    }
+
+    for (i = 0; i < drawList->count; i++) {
+        vioarr_region_t*        region = vioarr_surface_region(drawList->surfaces[i]);
+        vioarr_drawlist_rect_t* rect   = &drawList->rects[i];
+        int                     parent = drawList->parents[i];
+        unsigned int            flags  = drawList->flags[i] & ~VIOARR_DRAWLIST_VISIBLE;
+
+        rect->x      = vioarr_region_x(region);
+        rect->y      = vioarr_region_y(region);
+        rect->width  = vioarr_region_width(region);
+        rect->height = vioarr_region_height(region);
+        drawList->clips[i] = *rect;
+
+        if (parent >= 0) {
+            rect->x += drawList->rects[parent].x;
+            rect->y += drawList->rects[parent].y;
+            drawList->clips[i].x = rect->x;
+            drawList->clips[i].y = rect->y;
+            __intersect(&drawList->clips[i], &drawList->clips[parent]);
+        }
+
+        if (vioarr_surface_visible(drawList->surfaces[i]) &&
+            (parent < 0 || (drawList->flags[parent] & VIOARR_DRAWLIST_VISIBLE))) {
+            flags |= VIOARR_DRAWLIST_VISIBLE;
+        }
+
+        drawList->flags[i]    = flags;
+    }
+}
+
+/**
+ * Returns the index of the top-most visible entry that contains the given screen
+ * coordinate, ignoring the cursor level. Returns -1 if no entry was found.
+ */
+int vioarr_drawlist_at(vioarr_drawlist_t* drawList, int x, int y)
+{
+    int i;
+
+    if (!drawList) {
+        return -1;
+    }
+
+    for (i = drawList->count - 1; i >= 0; i--) {
+        vioarr_drawlist_rect_t* clip = &drawList->clips[i];
+        if ((drawList->flags[i] & (VIOARR_DRAWLIST_VISIBLE | VIOARR_DRAWLIST_CURSOR)) != VIOARR_DRAWLIST_VISIBLE) {
+            continue;
+        }
+
+        if (x >= clip->x && x < (clip->x + clip->width) &&
+            y >= clip->y && y < (clip->y + clip->height)) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,70 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#ifndef __VIOARR_DRAWLIST_H__
+#define __VIOARR_DRAWLIST_H__
+
+typedef struct vioarr_surface vioarr_surface_t;
+
+#define VIOARR_DRAWLIST_VISIBLE 0x1 // surface and all of its parents have content
+#define VIOARR_DRAWLIST_CURSOR  0x2 // entry lives on the cursor level
+
+typedef struct vioarr_drawlist_rect {
+    int x;
+    int y;
+    int width;
+    int height;
+} vioarr_drawlist_rect_t;
+
+/**
+ * The draw list is a flattened, z-ordered (back to front) view of all the registered
+ * surfaces and their subsurfaces. Each attribute is kept in its own array so passes
+ * that only need a few of them (hit-testing only needs clips and flags) can stream
+ * through contiguous memory. Entries are rebuilt only when the stacking or the hierarchy
+ * changes, while the geometry is refreshed in place by vioarr_drawlist_update.
+ * Children always follow their parent, so parents[i] < i for all subsurfaces.
+ */
+typedef struct vioarr_drawlist {
+    int                     count;
+    int                     capacity;
+    unsigned int            generation; // incremented every time the entries are rebuilt
+    vioarr_surface_t**      surfaces;
+    int*                    parents;  // index of parent entry, or -1 for root surfaces
+    int*                    levels;
+    vioarr_drawlist_rect_t* rects;    // desktop space, shared by all screens
+    vioarr_drawlist_rect_t* clips;    // rect clipped against all parents
+    float*                  opacity;
+    unsigned int*           flags;
+} vioarr_drawlist_t;
+
+void vioarr_drawlist_construct(vioarr_drawlist_t*);
+void vioarr_drawlist_destroy(vioarr_drawlist_t*);
+void vioarr_drawlist_reset(vioarr_drawlist_t*);
+int  vioarr_drawlist_copy(vioarr_drawlist_t*, vioarr_drawlist_t* source);
+int  vioarr_drawlist_append(vioarr_drawlist_t*, vioarr_surface_t*, int parent, int level);
+void vioarr_drawlist_update(vioarr_drawlist_t*);
+int  vioarr_drawlist_at(vioarr_drawlist_t*, int x, int y);
+
+#endif //!__VIOARR_DRAWLIST_H__
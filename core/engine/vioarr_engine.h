@@ -28,6 +28,9 @@
 #define ENGINE_SCREEN_REFRESH_HZ 60
 #define ENGINE_SCREEN_REFRESH_MS (1000 / ENGINE_SCREEN_REFRESH_HZ)
 
+// the maximum number of screens that can be composited at once
+#define VIOARR_MAX_OUTPUTS 8
+
 int  vioarr_engine_initialize(void);
 void vioarr_engine_request_redraw(void);
 
@@ -0,0 +1,174 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#include "vioarr_governor.h"
+#include "vioarr_utils.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+
+// the level is stepped down once the average has been over budget for this many frames in a
+// row, and stepped up once it has been below the headroom mark for this many frames. Stepping
+// up is much slower, so a level that barely fits is not toggled every few frames.
+#define GOVERNOR_DOWN_FRAMES 15
+#define GOVERNOR_UP_FRAMES   120
+#define GOVERNOR_HEADROOM    60 // percent of the budget
+
+typedef struct vioarr_governor_output {
+    atomic_int   level;
+    atomic_uint  budget;
+    atomic_uint  render_time;
+    atomic_uint  present_time;
+    atomic_uint  steps_down;
+    atomic_uint  steps_up;
+    unsigned int over;  // only touched by the render thread of the output
+    unsigned int under;
+} vioarr_governor_output_t;
+
+static vioarr_governor_output_t g_governor[VIOARR_MAX_OUTPUTS];
+static int                      g_governorEnabled = 1;
+
+static const char* g_levelNames[] = {
+    "full", "flat shadows", "no blur", "nearest filtering", "half rate"
+};
+
+void vioarr_governor_initialize(void)
+{
+    const char* enabled = getenv("VIOARR_GOVERNOR");
+    int         i;
+
+    for (i = 0; i < VIOARR_MAX_OUTPUTS; i++) {
+        atomic_init(&g_governor[i].level, VIOARR_GOVERNOR_FULL);
+        atomic_init(&g_governor[i].budget, 0);
+        atomic_init(&g_governor[i].render_time, 0);
+        atomic_init(&g_governor[i].present_time, 0);
+        atomic_init(&g_governor[i].steps_down, 0);
+        atomic_init(&g_governor[i].steps_up, 0);
+        g_governor[i].over  = 0;
+        g_governor[i].under = 0;
+    }
+
+    g_governorEnabled = !enabled || atoi(enabled) != 0;
+    vioarr_utils_trace(VISTR("[vioarr_governor_initialize] frame governor is %s"),
+        g_governorEnabled ? "enabled" : "disabled");
+}
+
+static void __set_level(vioarr_governor_output_t* governor, int output, int level, unsigned int renderTime, unsigned int budget)
+{
+    atomic_store(&governor->level, level);
+    governor->over  = 0;
+    governor->under = 0;
+    vioarr_utils_trace(VISTR("[vioarr_governor] output %i: %u us rendering per frame with a budget of %u us, quality is now %s"),
+        output, renderTime, budget, g_levelNames[level]);
+}
+
+static unsigned int __average(atomic_uint* average, unsigned int time)
+{
+    unsigned int value = atomic_load(average);
+    value = value ? (value - (value / 8) + (time / 8)) : time;
+    atomic_store(average, value);
+    return value;
+}
+
+/**
+ * Accounts a frame of the output, which took renderTime microseconds to render once the locks
+ * were taken and presentTime microseconds to present. Only the time spent rendering is governed,
+ * as that is what the levels change, presenting includes waiting for the display. Must only be
+ * called by the render thread of the output.
+ */
+void vioarr_governor_frame(int output, unsigned int budget, unsigned int renderTime, unsigned int presentTime)
+{
+    vioarr_governor_output_t* governor;
+    unsigned int              average;
+    int                       level;
+
+    if (output < 0 || output >= VIOARR_MAX_OUTPUTS) {
+        return;
+    }
+
+    // a single slow frame (an upload of a large surface) must not change the level, so
+    // the decisions are made on a moving average of the last frames
+    governor = &g_governor[output];
+    average  = __average(&governor->render_time, renderTime);
+    (void)__average(&governor->present_time, presentTime);
+    atomic_store(&governor->budget, budget);
+    if (!g_governorEnabled || !budget) {
+        return;
+    }
+
+    level = atomic_load(&governor->level);
+    if (average > budget) {
+        governor->under = 0;
+        if (++governor->over >= GOVERNOR_DOWN_FRAMES && level < VIOARR_GOVERNOR_LOWEST) {
+            atomic_fetch_add(&governor->steps_down, 1);
+            __set_level(governor, output, level + 1, average, budget);
+        }
+    }
+    else if (average < (budget / 100) * GOVERNOR_HEADROOM) {
+        governor->over = 0;
+        if (++governor->under >= GOVERNOR_UP_FRAMES && level > VIOARR_GOVERNOR_FULL) {
+            atomic_fetch_add(&governor->steps_up, 1);
+            __set_level(governor, output, level - 1, average, budget);
+        }
+    }
+    else {
+        governor->over  = 0;
+        governor->under = 0;
+    }
+}
+
+/**
+ * Retrieves the current level of the output, one of VIOARR_GOVERNOR_*.
+ */
+int vioarr_governor_level(int output)
+{
+    if (output < 0 || output >= VIOARR_MAX_OUTPUTS) {
+        return VIOARR_GOVERNOR_FULL;
+    }
+    return atomic_load(&g_governor[output].level);
+}
+
+void vioarr_governor_state(int output, vioarr_governor_state_t* stateOut)
+{
+    if (!stateOut) {
+        return;
+    }
+
+    if (output < 0 || output >= VIOARR_MAX_OUTPUTS) {
+        stateOut->level        = VIOARR_GOVERNOR_FULL;
+        stateOut->budget       = 0;
+        stateOut->render_time  = 0;
+        stateOut->present_time = 0;
+        stateOut->steps_down   = 0;
+        stateOut->steps_up     = 0;
+        return;
+    }
+
+    stateOut->level        = atomic_load(&g_governor[output].level);
+    stateOut->budget       = atomic_load(&g_governor[output].budget);
+    stateOut->render_time  = atomic_load(&g_governor[output].render_time);
+    stateOut->present_time = atomic_load(&g_governor[output].present_time);
+    stateOut->steps_down   = atomic_load(&g_governor[output].steps_down);
+    stateOut->steps_up     = atomic_load(&g_governor[output].steps_up);
+}
@@ -0,0 +1,64 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#ifndef __VIOARR_GOVERNOR_H__
+#define __VIOARR_GOVERNOR_H__
+
+#include "vioarr_engine.h"
+
+/**
+ * The governor keeps the frames of an output within their budget (the refresh interval of
+ * the output) by stepping down the costly parts of composition, one level at a time and in
+ * this order. Each level includes the ones before it. Levels are stepped back up once frames
+ * have had headroom for a while. It can be disabled at startup by setting the VIOARR_GOVERNOR
+ * environment variable to 0.
+ */
+#define VIOARR_GOVERNOR_FULL         0
+#define VIOARR_GOVERNOR_FLAT_SHADOWS 1 // drop shadows are drawn flat and close to the surface
+#define VIOARR_GOVERNOR_NO_BLUR      2 // backdrops of translucent surfaces are not blurred
+#define VIOARR_GOVERNOR_NEAREST      3 // scaled content is sampled without linear filtering
+#define VIOARR_GOVERNOR_HALF_RATE    4 // the output renders at half of its refresh rate
+#define VIOARR_GOVERNOR_LOWEST       VIOARR_GOVERNOR_HALF_RATE
+
+/**
+ * The budget of outputs that render as fast as possible, in microseconds.
+ */
+#define VIOARR_GOVERNOR_DEFAULT_BUDGET 16666
+
+typedef struct vioarr_governor_state {
+    int          level;
+    unsigned int budget;       // us
+    unsigned int render_time;  // us, average time spent rendering a frame once the locks were taken
+    unsigned int present_time; // us, average time spent presenting a frame, including waits for the display
+    unsigned int steps_down;
+    unsigned int steps_up;
+} vioarr_governor_state_t;
+
+void vioarr_governor_initialize(void);
+void vioarr_governor_frame(int output, unsigned int budget, unsigned int renderTime, unsigned int presentTime);
+int  vioarr_governor_level(int output);
+void vioarr_governor_state(int output, vioarr_governor_state_t* stateOut);
+
+#endif //!__VIOARR_GOVERNOR_H__
@@ -31,6 +31,7 @@
 #include "vioarr_objects.h"
 #include "vioarr_manager.h"
 #include "vioarr_region.h"
+#include "vioarr_slab.h"
 #include "vioarr_surface.h"
 #include "vioarr_utils.h"
 #include "wm_core_service.h"
@@ -45,6 +46,11 @@
 #define POINTER_MODE_MOVING    2
 #define POINTER_MODE_GRABBED   3
 
+// a report touches at most the surface left, the surface entered and the operating surface
+#define POINTER_FRAME_SURFACES 4
+
+static vioarr_slab_cache_t g_hookCache = VIOARR_SLAB_CACHE_INIT("keyboard_hook", sizeof(element_t), 16);
+
 typedef struct vioarr_input_source {
     element_t header;
     uint32_t  id;
@@ -61,6 +67,10 @@ typedef struct vioarr_input_source {
             int                  mode;
             enum wm_surface_edge edge;
             vioarr_surface_t*    op_surface;
+
+            // surfaces sent events during the current report, which are ended with a frame
+            vioarr_surface_t*    frame_surfaces[POINTER_FRAME_SURFACES];
+            int                  frame_count;
         } pointer;
         struct {
             list_t          hooks;
@@ -247,7 +257,7 @@ void hook_keyboard(vioarr_input_source_t* input, vioarr_surface_t* surface)
     }
 
     // hook us
-    i = malloc(sizeof(element_t));
+    i = vioarr_slab_alloc(&g_hookCache);
     if (!i) {
         vioarr_utils_error("hook_keyboard ran out of memory for hook element");
         return;
@@ -273,6 +283,53 @@ void vioarr_input_grab(vioarr_input_source_t* input, vioarr_surface_t* surface)
     }
 }
 
+static void __frame_target(vioarr_input_source_t* input, vioarr_surface_t* surface)
+{
+    int i;
+
+    for (i = 0; i < input->state.pointer.frame_count; i++) {
+        if (input->state.pointer.frame_surfaces[i] == surface) {
+            return;
+        }
+    }
+
+    if (input->state.pointer.frame_count < POINTER_FRAME_SURFACES) {
+        input->state.pointer.frame_surfaces[input->state.pointer.frame_count++] = surface;
+    }
+}
+
+static void __frame_forget(vioarr_input_source_t* input, vioarr_surface_t* surface)
+{
+    int i;
+
+    for (i = 0; i < input->state.pointer.frame_count; i++) {
+        if (input->state.pointer.frame_surfaces[i] == surface) {
+            input->state.pointer.frame_surfaces[i] =
+                input->state.pointer.frame_surfaces[--input->state.pointer.frame_count];
+            return;
+        }
+    }
+}
+
+/**
+ * Ends the report by sending the frame event to every surface that received pointer events
+ * during it, clients handle the events up to the frame as one batch.
+ */
+static void __frame_end(vioarr_input_source_t* input, uint64_t timestamp)
+{
+    int i;
+
+    for (i = 0; i < input->state.pointer.frame_count; i++) {
+        vioarr_surface_t* surface = input->state.pointer.frame_surfaces[i];
+        wm_pointer_event_frame_single(vioarr_get_server_handle(),
+            vioarr_surface_client(surface),
+            input->id,
+            vioarr_surface_id(surface),
+            timestamp);
+    }
+    input->state.pointer.frame_count = 0;
+}
+
 static void __clear_state(vioarr_input_source_t* input)
 {
     input->state.pointer.mode = POINTER_MODE_NORMAL;
@@ -310,6 +367,7 @@ void unhook_keyboard(vioarr_input_source_t* input, vioarr_surface_t* surface)
     vioarr_rwlock_w_lock(&input->state.keyboard.lock);
     list_remove(&input->state.keyboard.hooks, i);
     vioarr_rwlock_w_unlock(&input->state.keyboard.lock);
+    vioarr_slab_free(&g_hookCache, i);
 }
 
 void vioarr_input_ungrab(vioarr_input_source_t* input, vioarr_surface_t* surface)
@@ -334,6 +392,7 @@ void vioarr_input_on_surface_destroy(vioarr_surface_t* surface)
             if (input->state.pointer.op_surface == surface) {
                 __clear_state(input);
             }
+            __frame_forget(input, surface);
         }
         else if (input->type == VIOARR_INPUT_KEYBOARD) {
             unhook_keyboard(input, surface);
@@ -341,7 +400,7 @@ void vioarr_input_on_surface_destroy(vioarr_surface_t* surface)
     }
 }
 
-static void __normal_mode_motion(vioarr_input_source_t* source, int clampedX, int clampedY)
+static void __normal_mode_motion(vioarr_input_source_t* source, int clampedX, int clampedY, uint64_t timestamp)
 {
     vioarr_surface_t* currentSurface = source->state.pointer.op_surface;
     vioarr_surface_t* surfaceAfterMove;
@@ -369,6 +428,7 @@ static void __normal_mode_motion(vioarr_input_source_t* source, int clampedX, in
                 vioarr_surface_client(currentSurface),
                 source->id,
                 vioarr_surface_id(currentSurface));
+            __frame_target(source, currentSurface);
         }
         vioarr_utils_trace(VISTR("__normal_mode_motion next active surface %i:%u"),
             vioarr_surface_client(surfaceAfterMove), vioarr_surface_id(surfaceAfterMove));
@@ -389,6 +449,7 @@ static void __normal_mode_motion(vioarr_input_source_t* source, int clampedX, in
                 source->id,
                 vioarr_surface_id(surfaceAfterMove),
                 localX, localY);
+        __frame_target(source, surfaceAfterMove);
         sendUpdates = 0;
     }
 
@@ -402,23 +463,25 @@ static void __normal_mode_motion(vioarr_input_source_t* source, int clampedX, in
             vioarr_surface_client(surfaceAfterMove),
             source->id,
             vioarr_surface_id(surfaceAfterMove),
-            localX, localY);
+            localX, localY, timestamp);
+        __frame_target(source, surfaceAfterMove);
     }
 }
 
 static void __resize_mode_motion(vioarr_input_source_t* source, int clampedX, int clampedY)
 {
     vioarr_surface_t* currentSurface = source->state.pointer.op_surface;
-    vioarr_region_t*  region = vioarr_surface_region(currentSurface);
+    int               width, height;
     vioarr_utils_trace(VISTR("__resize_mode_motion()"));
 
     if (!clampedX && !clampedY) {
         return;
     }
 
-    vioarr_surface_resize(currentSurface,
-        vioarr_region_width(region) + clampedX,
-        vioarr_region_height(region) + clampedY,
+    // the surface keeps its size until the client commits the new one, so the motion is
+    // accumulated on the size that was requested last
+    vioarr_surface_configured_size(currentSurface, &width, &height);
+    vioarr_surface_resize(currentSurface, width + clampedX, height + clampedY,
         source->state.pointer.edge);
 
     source->state.pointer.x += clampedX;
@@ -445,7 +508,7 @@ static void __move_mode_motion(vioarr_input_source_t* source, int clampedX, int
     }
 }
 
-static void __grabbed_mode_motion(vioarr_input_source_t* source, int clampedX, int clampedY)
+static void __grabbed_mode_motion(vioarr_input_source_t* source, int clampedX, int clampedY, uint64_t timestamp)
 {
     vioarr_surface_t* currentSurface = source->state.pointer.op_surface;
     vioarr_utils_trace(VISTR("__grabbed_mode_motion()"));
@@ -459,10 +522,11 @@ static void __grabbed_mode_motion(vioarr_input_source_t* source, int clampedX, i
         vioarr_surface_client(currentSurface),
         source->id,
         vioarr_surface_id(currentSurface),
-        clampedX, clampedY);
+        clampedX, clampedY, timestamp);
+    __frame_target(source, currentSurface);
 }
 
-void vioarr_input_axis_event(UUId_t deviceId, int x, int y)
+void vioarr_input_axis_event(UUId_t deviceId, int x, int y, uint64_t timestamp)
 {
     vioarr_input_source_t* source = list_find_value(&g_inputDevices, (void*)(uintptr_t)deviceId);
     int                    clampedX = x;
@@ -475,12 +539,12 @@ void vioarr_input_axis_event(UUId_t deviceId, int x, int y)
 
     // clamp the axis values
     if (source->state.pointer.x + clampedX > vioarr_engine_x_maximum())      clampedX = vioarr_engine_x_maximum() - source->state.pointer.x;
-    else if (source->state.pointer.x + clampedX < vioarr_engine_x_minimum()) clampedX = source->state.pointer.x;
+    else if (source->state.pointer.x + clampedX < vioarr_engine_x_minimum()) clampedX = vioarr_engine_x_minimum() - source->state.pointer.x;
     if (source->state.pointer.y + clampedY > vioarr_engine_y_maximum())      clampedY = vioarr_engine_y_maximum() - source->state.pointer.y;
-    else if (source->state.pointer.y + clampedY < vioarr_engine_y_minimum()) clampedY = source->state.pointer.y;
+    else if (source->state.pointer.y + clampedY < vioarr_engine_y_minimum()) clampedY = vioarr_engine_y_minimum() - source->state.pointer.y;
 
     if (source->state.pointer.mode == POINTER_MODE_NORMAL) {
-        __normal_mode_motion(source, clampedX, clampedY);
+        __normal_mode_motion(source, clampedX, clampedY, timestamp);
     }
     else if (source->state.pointer.mode == POINTER_MODE_RESIZING) {
         __resize_mode_motion(source, clampedX, clampedY);
@@ -489,18 +553,38 @@ void vioarr_input_axis_event(UUId_t deviceId, int x, int y)
         __move_mode_motion(source, clampedX, clampedY);
     }
     else if (source->state.pointer.mode == POINTER_MODE_GRABBED) {
-        __grabbed_mode_motion(source, clampedX, clampedY);
+        __grabbed_mode_motion(source, clampedX, clampedY, timestamp);
     }
+    __frame_end(source, timestamp);
 }
 
-void vioarr_input_scroll_event(UUId_t deviceId, int horz, int vert)
+void vioarr_input_scroll_event(UUId_t deviceId, int horz, int vert, uint64_t timestamp)
 {
+    vioarr_input_source_t* source = list_find_value(&g_inputDevices, (void*)(uintptr_t)deviceId);
+    vioarr_surface_t*      currentSurface;
     vioarr_utils_trace(VISTR("vioarr_input_scroll_event(x=%i, y=%i)"), horz, vert);
-    (void)deviceId;
-    // todo
+
+    if (!source) {
+        return;
+    }
+
+    // scrolling goes to the surface under the pointer, and never while moving or resizing
+    currentSurface = source->state.pointer.op_surface;
+    if (!currentSurface || (source->state.pointer.mode != POINTER_MODE_NORMAL &&
+        source->state.pointer.mode != POINTER_MODE_GRABBED)) {
+        return;
+    }
+
+    wm_pointer_event_scroll_single(vioarr_get_server_handle(),
+        vioarr_surface_client(currentSurface),
+        source->id,
+        vioarr_surface_id(currentSurface),
+        horz, vert, timestamp);
+    __frame_target(source, currentSurface);
+    __frame_end(source, timestamp);
 }
 
-static void __normal_mode_click(vioarr_input_source_t* source, uint32_t button, uint8_t pressed)
+static void __normal_mode_click(vioarr_input_source_t* source, uint32_t button, uint8_t pressed, uint64_t timestamp)
 {
     vioarr_surface_t* clickedSurface = source->state.pointer.op_surface;
     int               localX, localY;
@@ -518,6 +602,7 @@ static void __normal_mode_click(vioarr_input_source_t* source, uint32_t button,
                 source->id,
                 vioarr_surface_id(clickedSurface),
                 localX, localY);
+            __frame_target(source, clickedSurface);
         }
     }
     vioarr_manager_focus_surface(clickedSurface);
@@ -529,23 +614,25 @@ static void __normal_mode_click(vioarr_input_source_t* source, uint32_t button,
             vioarr_surface_client(clickedSurface),
             source->id, 
             vioarr_surface_id(clickedSurface), 
-            button, pressed);
+            button, pressed, timestamp);
+        __frame_target(source, clickedSurface);
     }
 }
 
-static void vioarr_input_pointer_click(vioarr_input_source_t* source, uint32_t button, uint8_t pressed)
+static void vioarr_input_pointer_click(vioarr_input_source_t* source, uint32_t button, uint8_t pressed, uint64_t timestamp)
 {
     vioarr_utils_trace(VISTR("vioarr_input_pointer_click(button=%u, pressed=%u)"), button, pressed);
-    __normal_mode_click(source, button, pressed);
+    __normal_mode_click(source, button, pressed, timestamp);
     if (button == 0 /* LMB */ && !pressed) {
         if (source->state.pointer.mode == POINTER_MODE_MOVING ||
             source->state.pointer.mode == POINTER_MODE_RESIZING) {
             source->state.pointer.mode = POINTER_MODE_NORMAL;
         }
     }
+    __frame_end(source, timestamp);
 }
 
-void vioarr_input_button_event(UUId_t deviceId, uint32_t keycode, uint32_t modifiers, uint8_t pressed)
+void vioarr_input_button_event(UUId_t deviceId, uint32_t keycode, uint32_t modifiers, uint8_t pressed, uint64_t timestamp)
 {
     vioarr_utils_trace(VISTR("vioarr_input_button_event()"));
     vioarr_input_source_t* source = list_find_value(&g_inputDevices, (void*)(uintptr_t)deviceId);
@@ -557,7 +644,7 @@ void vioarr_input_button_event(UUId_t deviceId, uint32_t keycode, uint32_t modif
 
     if (source->type == VIOARR_INPUT_POINTER) {
         uint32_t button = keycode - (uint32_t)VKC_LBUTTON;
-        vioarr_input_pointer_click(source, button, pressed);
+        vioarr_input_pointer_click(source, button, pressed, timestamp);
     }
     else {
         // keyboard
@@ -572,7 +659,8 @@ void vioarr_input_button_event(UUId_t deviceId, uint32_t keycode, uint32_t modif
                 vioarr_surface_id(currentSurface),
                 keycode, 
                 modifiers,
-                pressed);
+                pressed,
+                timestamp);
         }
         
         // also notify hooks
@@ -584,7 +672,8 @@ void vioarr_input_button_event(UUId_t deviceId, uint32_t keycode, uint32_t modif
                     vioarr_surface_id(i->key),
                     keycode, 
                     modifiers,
-                    pressed);
+                    pressed,
+                    timestamp);
             }
         }
         vioarr_rwlock_r_unlock(&source->state.keyboard.lock);
@@ -22,39 +22,160 @@
  *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
  */
 
-#include <list.h>
+
+#include "vioarr_drawlist.h"
 #include "vioarr_manager.h"
 #include "vioarr_surface.h"
 #include "vioarr_utils.h"
+#include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 
+typedef struct vioarr_manager_level {
+    vioarr_surface_t** surfaces;
+    int                count;
+    int                capacity;
+} vioarr_manager_level_t;
+
+typedef struct vioarr_manager_visibility {
+    vioarr_surface_t* surface;
+    int               visible;
+} vioarr_manager_visibility_t;
+
 typedef struct vioarr_manager {
-    list_t            surfaces[SURFACE_LEVELS];
-    vioarr_rwlock_t   lock;
-    vioarr_surface_t* focused;
+    vioarr_manager_level_t levels[SURFACE_LEVELS];
+    vioarr_drawlist_t      draw_list;
+    atomic_int             draw_list_dirty;
+    vioarr_rwlock_t        lock;
+    vioarr_surface_t*      focused;
+
+    // commits that span a tree of surfaces are staged, and applied at the start of
+    // the next frame while no renderer picks up the state of the surfaces
+    mtx_t                  staged_lock;
+    vioarr_surface_t**     staged;
+    int                    staged_count;
+    int                    staged_capacity;
+
+    // visibility changes are reported by the render threads in the middle of a
+    // frame, so they are recorded and handled once the frame has been rendered
+    mtx_t                        visibility_lock;
+    vioarr_manager_visibility_t* visibility_changes;
+    int                          visibility_count;
+    int                          visibility_capacity;
 } vioarr_manager_t;
 
 static vioarr_manager_t g_manager;
 
-static void* __surface_key(vioarr_surface_t* surface)
+static int __level_index_of(vioarr_manager_level_t* level, vioarr_surface_t* surface)
 {
-    uint32_t surfaceId = vioarr_surface_id(surface);
-    surfaceId |= ((uint32_t)vioarr_surface_client(surface) << 16);
-    return (void*)(uintptr_t)surfaceId;
+    int i;
+    for (i = 0; i < level->count; i++) {
+        if (level->surfaces[i] == surface) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int __level_append(vioarr_manager_level_t* level, vioarr_surface_t* surface)
+{
+    if (level->count == level->capacity) {
+        int                capacity = level->capacity ? (level->capacity * 2) : 16;
+        vioarr_surface_t** surfaces = realloc(level->surfaces, sizeof(vioarr_surface_t*) * capacity);
+        if (!surfaces) {
+            return -1;
+        }
+        level->surfaces = surfaces;
+        level->capacity = capacity;
+    }
+
+    level->surfaces[level->count++] = surface;
+    return 0;
+}
+
+static int __level_remove(vioarr_manager_level_t* level, vioarr_surface_t* surface)
+{
+    int index = __level_index_of(level, surface);
+    if (index < 0) {
+        return -1;
+    }
+
+    memmove(&level->surfaces[index], &level->surfaces[index + 1],
+        sizeof(vioarr_surface_t*) * (level->count - index - 1));
+    level->count--;
+    return 0;
+}
+
+/**
+ * Raising a surface is just a matter of moving the following entries one
+ * slot down and putting the surface at the end of the level.
+ */
+static int __level_raise(vioarr_manager_level_t* level, vioarr_surface_t* surface)
+{
+    int index = __level_index_of(level, surface);
+    if (index < 0) {
+        return -1;
+    }
+
+    memmove(&level->surfaces[index], &level->surfaces[index + 1],
+        sizeof(vioarr_surface_t*) * (level->count - index - 1));
+    level->surfaces[level->count - 1] = surface;
+    return 0;
+}
+
+typedef struct vioarr_manager_walk_context {
+    int parent;
+    int level;
+} vioarr_manager_walk_context_t;
+
+static void __append_child(vioarr_surface_t* surface, void* context)
+{
+    vioarr_manager_walk_context_t* walkContext = context;
+    vioarr_manager_walk_context_t  childContext;
+
+    childContext.level  = walkContext->level;
+    childContext.parent = vioarr_drawlist_append(&g_manager.draw_list, surface, walkContext->parent, walkContext->level);
+    if (childContext.parent < 0) {
+        vioarr_utils_error(VISTR("[__append_child] out of memory"));
+        return;
+    }
+    vioarr_surface_enumerate_children(surface, __append_child, &childContext);
+}
+
+/**
+ * Must be called with the write lock held. The entries are only rebuilt when surfaces
+ * were restacked or the hierarchy changed, otherwise only the geometry is refreshed.
+ */
+static void __refresh_drawlist(void)
+{
+    int level;
+    int i;
+
+    if (atomic_exchange(&g_manager.draw_list_dirty, 0)) {
+        vioarr_drawlist_reset(&g_manager.draw_list);
+        for (level = 0; level < SURFACE_LEVELS; level++) {
+            for (i = 0; i < g_manager.levels[level].count; i++) {
+                vioarr_manager_walk_context_t context = { .parent = -1, .level = level };
+                __append_child(g_manager.levels[level].surfaces[i], &context);
+            }
+        }
+    }
+    vioarr_drawlist_update(&g_manager.draw_list);
 }
 
 static void __focus_top_surface(void)
 {
     vioarr_surface_t* surface = NULL;
+    int               i;
 
     // We only care about mid-level surfaces which contains all
     // the regular windows. So now we find the next surface to focus
     // (if any) and then go through the regular focus-change procedure
     vioarr_rwlock_r_lock(&g_manager.lock);
-    foreach_reverse(i, &g_manager.surfaces[1]) {
-        if (vioarr_surface_visible(i->value)) {
-            surface = i->value;
+    for (i = g_manager.levels[1].count - 1; i >= 0; i--) {
+        if (vioarr_surface_visible(g_manager.levels[1].surfaces[i])) {
+            surface = g_manager.levels[1].surfaces[i];
             break;
         }
     }
@@ -67,40 +188,45 @@ static void __focus_top_surface(void)
 
 void vioarr_manager_initialize(void)
 {
-    int i;
-
     vioarr_rwlock_init(&g_manager.lock);
-    for (i = 0; i < SURFACE_LEVELS; i++) {
-        list_construct(&g_manager.surfaces[i]);
-    }
+    mtx_init(&g_manager.staged_lock, mtx_plain);
+    mtx_init(&g_manager.visibility_lock, mtx_plain);
+    memset(&g_manager.levels[0], 0, sizeof(g_manager.levels));
+    vioarr_drawlist_construct(&g_manager.draw_list);
+    atomic_store(&g_manager.draw_list_dirty, 1);
     g_manager.focused = NULL;
+    g_manager.visibility_changes  = NULL;
+    g_manager.visibility_count    = 0;
+    g_manager.visibility_capacity = 0;
+    g_manager.staged          = NULL;
+    g_manager.staged_count    = 0;
+    g_manager.staged_capacity = 0;
 }
 
 void vioarr_manager_register_surface(vioarr_surface_t* surface)
 {
+    int status;
+
     if (!surface) {
         vioarr_utils_error(VISTR("[vioarr_manager_register_surface] null parameters"));
         return;
     }
 
-    element_t* element = malloc(sizeof(element_t));
-    if (!element) {
+    vioarr_rwlock_w_lock(&g_manager.lock);
+    status = __level_append(&g_manager.levels[vioarr_surface_level(surface)], surface);
+    vioarr_rwlock_w_unlock(&g_manager.lock);
+    if (status) {
         vioarr_utils_error(VISTR("[vioarr_manager_register_surface] out of memory"));
         return;
     }
-
-    ELEMENT_INIT(element, __surface_key(surface), surface);
-    
-    vioarr_rwlock_w_lock(&g_manager.lock);
-    list_append(&g_manager.surfaces[vioarr_surface_level(surface)], element);
-    vioarr_rwlock_w_unlock(&g_manager.lock);
+    vioarr_manager_on_hierarchy_change();
 }
 
 void vioarr_manager_unregister_surface(vioarr_surface_t* surface)
 {
-    element_t* element;
-    int        level;
-    int        focusTop = 0;
+    int level;
+    int focusTop = 0;
+    int i;
 
     if (!surface) {
         vioarr_utils_error(VISTR("[vioarr_renderer_register_surface] null parameters"));
@@ -109,18 +235,38 @@ void vioarr_manager_unregister_surface(vioarr_surface_t* surface)
 
     level = vioarr_surface_level(surface);
 
+    // the draw list is marked dirty under the lock, hit-tests that find it clean while holding
+    // the read lock can then rely on none of its surfaces being destroyed
     vioarr_rwlock_w_lock(&g_manager.lock);
-    element = list_find(&g_manager.surfaces[level], __surface_key(surface));
-    if (element) {
-        list_remove(&g_manager.surfaces[level], element);
-    }
+    __level_remove(&g_manager.levels[level], surface);
+    vioarr_manager_on_hierarchy_change();
 
     if (g_manager.focused == surface) {
         g_manager.focused = NULL;
         focusTop = 1;
     }
+
+    // staged commits are applied under the lock as well, so the surface is never applied once
+    // it has been unregistered
+    mtx_lock(&g_manager.staged_lock);
+    for (i = 0; i < g_manager.staged_count; i++) {
+        if (g_manager.staged[i] == surface) {
+            g_manager.staged[i] = g_manager.staged[--g_manager.staged_count];
+            break;
+        }
+    }
+    mtx_unlock(&g_manager.staged_lock);
     vioarr_rwlock_w_unlock(&g_manager.lock);
 
+    // drop any pending visibility notification, the surface is going away
+    mtx_lock(&g_manager.visibility_lock);
+    for (i = 0; i < g_manager.visibility_count; i++) {
+        if (g_manager.visibility_changes[i].surface == surface) {
+            g_manager.visibility_changes[i].surface = NULL;
+        }
+    }
+    mtx_unlock(&g_manager.visibility_lock);
+
     if (focusTop) {
         __focus_top_surface();
     }
@@ -128,10 +274,11 @@ void vioarr_manager_unregister_surface(vioarr_surface_t* surface)
 
 static void __change_surface_level(vioarr_surface_t* surface, int level, int newLevel)
 {
-    element_t* element = list_find(&g_manager.surfaces[level], __surface_key(surface));
-    if (element) {
-        list_remove(&g_manager.surfaces[level], element);
-        list_append(&g_manager.surfaces[newLevel], element);
+    if (!__level_remove(&g_manager.levels[level], surface)) {
+        if (__level_append(&g_manager.levels[newLevel], surface)) {
+            vioarr_utils_error(VISTR("[__change_surface_level] out of memory"));
+        }
+        vioarr_manager_on_hierarchy_change();
     }
 }
 
@@ -170,17 +317,122 @@ void vioarr_manager_change_level(vioarr_surface_t* surface, int level)
     }
 }
 
-void vioarr_manager_render_start(list_t** surfaceLevels)
+/**
+ * Invoked whenever the stacking or the surface tree changes in a way that requires
+ * the draw list entries to be rebuilt. The rebuild itself is deferred to the next
+ * user of the draw list.
+ */
+void vioarr_manager_on_hierarchy_change(void)
+{
+    atomic_store(&g_manager.draw_list_dirty, 1);
+}
+
+/**
+ * Commits that change several surfaces at once, like a parent applying the cached commits of its
+ * synchronized children, are staged by the surface and applied at the start of the next frame.
+ * The commit itself never waits for a frame, and no frame presents half of the tree.
+ */
+void vioarr_manager_stage_commit(vioarr_surface_t* surface)
+{
+    int i;
+
+    mtx_lock(&g_manager.staged_lock);
+    for (i = 0; i < g_manager.staged_count; i++) {
+        if (g_manager.staged[i] == surface) {
+            mtx_unlock(&g_manager.staged_lock);
+            return;
+        }
+    }
+
+    if (g_manager.staged_count == g_manager.staged_capacity) {
+        int                capacity = g_manager.staged_capacity ? (g_manager.staged_capacity * 2) : 8;
+        vioarr_surface_t** staged   = realloc(g_manager.staged, sizeof(vioarr_surface_t*) * capacity);
+        if (!staged) {
+            vioarr_utils_error(VISTR("[vioarr_manager_stage_commit] out of memory"));
+            mtx_unlock(&g_manager.staged_lock);
+            return;
+        }
+        g_manager.staged          = staged;
+        g_manager.staged_capacity = capacity;
+    }
+    g_manager.staged[g_manager.staged_count++] = surface;
+    mtx_unlock(&g_manager.staged_lock);
+}
+
+// must be called with the write lock held
+static void __apply_staged(void)
+{
+    int i;
+
+    mtx_lock(&g_manager.staged_lock);
+    for (i = 0; i < g_manager.staged_count; i++) {
+        vioarr_surface_apply_staged(g_manager.staged[i]);
+    }
+    g_manager.staged_count = 0;
+    mtx_unlock(&g_manager.staged_lock);
+}
+
+/**
+ * Applies the staged commits and copies the draw list into the one of the renderer, which renders
+ * the frame from its own copy so outputs compose their frames in parallel. The surfaces of the copy
+ * stay valid for the frame, as destroyed surfaces are freed by each renderer at the start of its
+ * next frame. A renderer that runs out of memory renders an empty frame. The read lock is held
+ * until vioarr_manager_render_updated, the renderer updates the surfaces for the frame meanwhile,
+ * so staged commits are never applied while a renderer is halfway through them.
+ */
+int vioarr_manager_render_start(vioarr_drawlist_t* drawList)
 {
+    int status;
+
+    vioarr_rwlock_w_lock(&g_manager.lock);
+    __apply_staged();
+    __refresh_drawlist();
+    status = vioarr_drawlist_copy(drawList, &g_manager.draw_list);
+    vioarr_rwlock_w_unlock(&g_manager.lock);
+
+    if (status) {
+        vioarr_utils_error(VISTR("[vioarr_manager_render_start] out of memory"));
+        drawList->count = 0;
+    }
     vioarr_rwlock_r_lock(&g_manager.lock);
-    if (surfaceLevels) *surfaceLevels = &g_manager.surfaces[0];
+    return status;
 }
 
-void vioarr_manager_render_end(void)
+void vioarr_manager_render_updated(void)
 {
     vioarr_rwlock_r_unlock(&g_manager.lock);
 }
 
+void vioarr_manager_render_end(void)
+{
+    vioarr_manager_visibility_t* changes;
+    int                          count;
+    int                          i;
+
+    mtx_lock(&g_manager.visibility_lock);
+    changes = g_manager.visibility_changes;
+    count   = g_manager.visibility_count;
+    g_manager.visibility_changes  = NULL;
+    g_manager.visibility_count    = 0;
+    g_manager.visibility_capacity = 0;
+    mtx_unlock(&g_manager.visibility_lock);
+
+    for (i = 0; i < count; i++) {
+        vioarr_surface_t* surface = changes[i].surface;
+        if (!surface) {
+            continue;
+        }
+
+        if (changes[i].visible) {
+            vioarr_manager_focus_surface(surface);
+        }
+        else if (vioarr_surface_parent(vioarr_manager_get_focused(), 1) == surface) {
+            __focus_top_surface();
+        }
+    }
+    free(changes);
+}
+
 vioarr_surface_t* vioarr_manager_get_focused(void)
 {
     vioarr_surface_t* front;
@@ -191,23 +443,31 @@ vioarr_surface_t* vioarr_manager_get_focused(void)
     return front;
 }
 
+/**
+ * Hit-tests against the draw list of the last frame, which matches what is shown on the screens.
+ * The list is only rebuilt here if the hierarchy changed since then, the geometry is refreshed by
+ * every frame. Otherwise the hit-test only needs the read lock.
+ */
 vioarr_surface_t* vioarr_manager_surface_at(int x, int y, int* localX, int* localY)
 {
     vioarr_surface_t* surfaceAt = NULL;
-    int               level;
+    int               index;
 
     vioarr_rwlock_r_lock(&g_manager.lock);
-    for (level = SURFACE_LEVELS - 2; level >= 0; level--) {
-        foreach_reverse(i, &g_manager.surfaces[level]) {
-            vioarr_surface_t* surface = vioarr_surface_at(i->value, x, y, localX, localY);
-            if (surface) {
-                surfaceAt = surface;
-                goto exit;
-            }
-        }
+    while (atomic_load(&g_manager.draw_list_dirty)) {
+        vioarr_rwlock_r_unlock(&g_manager.lock);
+        vioarr_rwlock_w_lock(&g_manager.lock);
+        __refresh_drawlist();
+        vioarr_rwlock_w_unlock(&g_manager.lock);
+        vioarr_rwlock_r_lock(&g_manager.lock);
     }
 
-exit:
+    index = vioarr_drawlist_at(&g_manager.draw_list, x, y);
+    if (index >= 0) {
+        surfaceAt = g_manager.draw_list.surfaces[index];
+        *localX   = x - g_manager.draw_list.rects[index].x;
+        *localY   = y - g_manager.draw_list.rects[index].y;
+    }
     vioarr_rwlock_r_unlock(&g_manager.lock);
     return surfaceAt;
 }
@@ -229,11 +489,9 @@ void vioarr_manager_focus_surface(vioarr_surface_t* surface)
         if (entering) {
             vioarr_surface_t* parent = vioarr_surface_parent(surface, 1);
             if (parent != vioarr_surface_parent(leaving, 1)) {
-                int        level   = vioarr_surface_level(parent);
-                element_t* element = list_find(&g_manager.surfaces[level], __surface_key(parent));
-                if (element) {
-                    list_remove(&g_manager.surfaces[level], element);
-                    list_append(&g_manager.surfaces[level], element);
+                int level = vioarr_surface_level(parent);
+                if (!__level_raise(&g_manager.levels[level], parent)) {
+                    vioarr_manager_on_hierarchy_change();
                 }
                 else {
                     g_manager.focused = NULL;
@@ -281,16 +539,26 @@ void vioarr_manager_request_focus(int client, vioarr_surface_t* surface)
  * When surfaces are shown, we want to grant them focus, and when they are hidden
  * we need to update the focused surface (if they are focused).
  * This function should only be invoked on root surfaces, as we do not act on subsurfaces
- * in this case
+ * in this case. The change is acted upon in vioarr_manager_render_end.
  */
 void vioarr_manager_on_surface_visiblity_change(vioarr_surface_t* surface, int visible)
 {
-    vioarr_rwlock_r_unlock(&g_manager.lock);
-    if (visible) {
-        vioarr_manager_focus_surface(surface);
-    }
-    else if (vioarr_surface_parent(g_manager.focused, 1) == surface) {
-        __focus_top_surface();
+    mtx_lock(&g_manager.visibility_lock);
+    if (g_manager.visibility_count == g_manager.visibility_capacity) {
+        int                          capacity = g_manager.visibility_capacity ? (g_manager.visibility_capacity * 2) : 8;
+        vioarr_manager_visibility_t* changes  = realloc(g_manager.visibility_changes,
+            sizeof(vioarr_manager_visibility_t) * capacity);
+        if (!changes) {
+            vioarr_utils_error(VISTR("[vioarr_manager_on_surface_visiblity_change] out of memory"));
+            mtx_unlock(&g_manager.visibility_lock);
+            return;
+        }
+        g_manager.visibility_changes  = changes;
+        g_manager.visibility_capacity = capacity;
     }
-    vioarr_rwlock_r_lock(&g_manager.lock);
+
+    g_manager.visibility_changes[g_manager.visibility_count].surface = surface;
+    g_manager.visibility_changes[g_manager.visibility_count].visible = visible;
+    g_manager.visibility_count++;
+    mtx_unlock(&g_manager.visibility_lock);
 }
@@ -34,14 +34,16 @@ typedef UUId_t mhandle_t;
 #elif defined(__linux__)
 #include <sys/types.h>
 #include <stdint.h>
-typedef key_t mhandle_t;
+typedef uint64_t mhandle_t; // pid of the owner in the upper 32 bits, memfd descriptor in the lower
 #endif
 
 typedef struct vioarr_memory_pool vioarr_memory_pool_t;
 
+int       vioarr_memory_initialize(void);
 int       vioarr_memory_create_pool(int, uint32_t, mhandle_t, size_t, vioarr_memory_pool_t**);
 int       vioarr_memory_pool_acquire(vioarr_memory_pool_t*);
 int       vioarr_memory_destroy_pool(vioarr_memory_pool_t*);
+int       vioarr_memory_pool_resize(vioarr_memory_pool_t*, size_t);
 uint32_t  vioarr_memory_pool_id(vioarr_memory_pool_t*);
 mhandle_t vioarr_memory_pool_handle(vioarr_memory_pool_t*);
 void*     vioarr_memory_pool_data(vioarr_memory_pool_t*, int, size_t);
@@ -23,8 +23,11 @@
  */
 
 #include "vioarr_buffer.h"
+#include "vioarr_capture.h"
 #include "vioarr_memory.h"
 #include "vioarr_objects.h"
+#include "vioarr_quota.h"
+#include "vioarr_slab.h"
 #include "vioarr_surface.h"
 #include "vioarr_utils.h"
 #include "wm_core_service_server.h"
@@ -46,17 +49,25 @@ typedef struct vioarr_object {
  
 static _Atomic(uint32_t) object_id = ATOMIC_VAR_INIT(SERVER_ID_START);
 static list_t            objects   = LIST_INIT;
+static vioarr_rwlock_t   objects_lock; // requests of different clients are handled in parallel
+
+static vioarr_slab_cache_t g_objectCache = VIOARR_SLAB_CACHE_INIT("object", sizeof(vioarr_object_t), 128);
  
 static uint32_t vioarr_utils_get_object_id(void)
 {
     return atomic_fetch_add(&object_id, 1);
 }
 
+void vioarr_objects_initialize(void)
+{
+    vioarr_rwlock_init(&objects_lock);
+}
+
 uint32_t vioarr_objects_create_client_object(int client, uint32_t id, void* object, enum wm_object_type type)
 {
     vioarr_object_t* resource;
     
-    resource = malloc(sizeof(vioarr_object_t));
+    resource = vioarr_slab_alloc(&g_objectCache);
     if (!resource) {
         return 0;
     }
@@ -69,8 +80,12 @@ uint32_t vioarr_objects_create_client_object(int client, uint32_t id, void* obje
     resource->handle    = 0;
     ELEMENT_INIT(&resource->link, (uintptr_t)resource->id, resource);
     
+    vioarr_rwlock_w_lock(&objects_lock);
     list_append(&objects, &resource->link);
+    vioarr_rwlock_w_unlock(&objects_lock);
 
+    // the quota is checked by the requests creating the objects, before anything is created
+    vioarr_quota_charge(client, VIOARR_QUOTA_OBJECTS, 1);
     return resource->global_id;
 }
 
@@ -78,7 +93,7 @@ uint32_t vioarr_objects_create_server_object(void* object, enum wm_object_type t
 {
     vioarr_object_t* resource;
     
-    resource = malloc(sizeof(vioarr_object_t));
+    resource = vioarr_slab_alloc(&g_objectCache);
     if (!resource) {
         return 0;
     }
@@ -90,7 +105,9 @@ uint32_t vioarr_objects_create_server_object(void* object, enum wm_object_type t
     resource->type      = type;
     resource->handle    = 0;
     ELEMENT_INIT(&resource->link, (uintptr_t)resource->id, resource);
+    vioarr_rwlock_w_lock(&objects_lock);
     list_append(&objects, &resource->link);
+    vioarr_rwlock_w_unlock(&objects_lock);
 
     // publish the object
     wm_core_event_object_all(vioarr_get_server_handle(), 
@@ -103,82 +120,152 @@ uint32_t vioarr_objects_create_server_object(void* object, enum wm_object_type t
     return resource->id;
 }
 
-// Returns the object that matches the id - either if the id is a global id
-// and matches or if the client and id matches
+// Returns the server object that matches the id, or the object of the client that
+// matches it. The objects lock must be held.
 static vioarr_object_t* get_object(int client, uint32_t id)
 {
     foreach(i, &objects) {
         vioarr_object_t* object = i->value;
         if ((id >= SERVER_ID_START && object->id == id) ||
-            (object->client == client && object->id == id) ||
-            (object->global_id != 0 && id == object->global_id)) {
+            (object->client == client && object->id == id)) {
             return object;
         }
     }
-    vioarr_utils_error(VISTR("[vioarr_objects_get_object] %i => %u object not found"), client, id);
     return NULL;
 }
 
-// Returns the object that matches the id - either if the id is a global id
-// and matches or if the client and id matches
+// Returns the server object that matches the id, or the object of the client that
+// matches it. Objects of other clients are only found by their global id through
+// vioarr_objects_get_global_object.
 void* vioarr_objects_get_object(int client, uint32_t id)
 {
-    vioarr_object_t* object = get_object(client, id);
-    if (!object){
-        return NULL;
+    vioarr_object_t* object;
+    void*            value = NULL;
+
+    vioarr_rwlock_r_lock(&objects_lock);
+    object = get_object(client, id);
+    if (object) {
+        value = object->object;
+    }
+    vioarr_rwlock_r_unlock(&objects_lock);
+
+    if (!object) {
+        vioarr_utils_error(VISTR("[vioarr_objects_get_object] %i => %u object not found"), client, id);
     }
-    return object->object;
+    return value;
+}
+
+// Like vioarr_objects_get_object, but the id may also be the global id of an object of the
+// given type owned by another client. Requests are handled one at a time (vioarr_dispatch), and
+// the objects of a client are only destroyed by its own requests or its disconnect, so the
+// object stays valid until the request is handled. It must not be kept beyond that.
+void* vioarr_objects_get_global_object(int client, uint32_t id, enum wm_object_type type)
+{
+    vioarr_object_t* object;
+    void*            value = NULL;
+
+    vioarr_rwlock_r_lock(&objects_lock);
+    object = get_object(client, id);
+    if (!object) {
+        foreach(i, &objects) {
+            vioarr_object_t* global = i->value;
+            if (global->global_id != 0 && global->global_id == id && global->type == type) {
+                object = global;
+                break;
+            }
+        }
+    }
+
+    if (object && object->type == type) {
+        value = object->object;
+    }
+    vioarr_rwlock_r_unlock(&objects_lock);
+
+    if (!value) {
+        vioarr_utils_error(VISTR("[vioarr_objects_get_global_object] %i => %u object not found"), client, id);
+    }
+    return value;
 }
 
 int vioarr_objects_remove_object(int client, uint32_t id)
 {
-    vioarr_object_t* object = get_object(client, id);
+    vioarr_object_t* object;
+
+    vioarr_rwlock_w_lock(&objects_lock);
+    object = get_object(client, id);
+    if (object) {
+        list_remove(&objects, &object->link);
+    }
+    vioarr_rwlock_w_unlock(&objects_lock);
+
     if (!object){
         return -1;
     }
     
-    list_remove(&objects, &object->link);
     if (id >= SERVER_ID_START) {
         wm_core_event_destroy_all(vioarr_get_server_handle(), id);
     }
-    free(object);
+    else if (object->client != -1) {
+        vioarr_quota_release(object->client, VIOARR_QUOTA_OBJECTS, 1);
+    }
+    vioarr_slab_free(&g_objectCache, object);
     return 0;
 }
 
 void vioarr_objects_remove_by_client(int client)
 {
     #define CLEANUP_TYPE(object_type, dctor) \
-        _foreach_nolink(i, &objects) { \
+        _foreach_nolink(i, &removed) { \
             vioarr_object_t* object = i->value; \
-            if (object->client == client) { \
-                element_t* next = i->next; \
-                if (object->type == object_type) { \
-                    dctor(object->object); \
-                } \
-                list_remove(&objects, i); \
-                free(i->value); \
-                i = next; \
-            } \
-            else { \
-                i = i->next; \
+            element_t*       next   = i->next; \
+            if (object->type == object_type) { \
+                list_remove(&removed, i); \
+                dctor(object->object); \
+                vioarr_slab_free(&g_objectCache, object); \
             } \
+            i = next; \
         }
 
+    list_t     removed = LIST_INIT;
+    element_t* i;
+
+    // The objects are unlinked first and destroyed once the lock is released, the destructors
+    // remove objects themselves (like the last reference of a pool), which are then not found.
+    vioarr_rwlock_w_lock(&objects_lock);
+    _foreach_nolink(i, &objects) {
+        vioarr_object_t* object = i->value;
+        element_t*       next   = i->next;
+        if (object->client == client) {
+            list_remove(&objects, i);
+            list_append(&removed, i);
+        }
+        i = next;
+    }
+    vioarr_rwlock_w_unlock(&objects_lock);
 
     // When we clean objects up due to disconnect, we want to go through
     // and make sure we up in this order:
     // surfaces
+    // captures
     // buffers
     // pools
-    element_t* i;
     CLEANUP_TYPE(WM_OBJECT_TYPE_SURFACE, vioarr_surface_destroy)
+    CLEANUP_TYPE(WM_OBJECT_TYPE_CAPTURE, vioarr_capture_destroy)
     CLEANUP_TYPE(WM_OBJECT_TYPE_BUFFER, vioarr_buffer_destroy)
     CLEANUP_TYPE(WM_OBJECT_TYPE_MEMORY_POOL, vioarr_memory_destroy_pool)
+
+    // anything left has nothing to destroy
+    _foreach_nolink(i, &removed) {
+        element_t* next = i->next;
+        vioarr_slab_free(&g_objectCache, i->value);
+        i = next;
+    }
 }
 
 // publishes all server objects
 void vioarr_objects_publish(int client)
 {
+    vioarr_rwlock_r_lock(&objects_lock);
     foreach(i, &objects) {
         vioarr_object_t* object = i->value;
         if (object->client == -1) {
@@ -190,4 +277,5 @@ void vioarr_objects_publish(int client)
             );
         }
     }
+    vioarr_rwlock_r_unlock(&objects_lock);
 }
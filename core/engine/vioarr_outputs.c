@@ -0,0 +1,357 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#include "vioarr_arena.h"
+#include "vioarr_governor.h"
+#include "vioarr_outputs.h"
+#include "vioarr_region.h"
+#include "vioarr_renderer.h"
+#include "vioarr_screen.h"
+#include "vioarr_slab.h"
+#include "vioarr_utils.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <threads.h>
+#include <time.h>
+
+#define OUTPUT_STATS_INTERVAL 5000 // ms
+
+struct frame_stats {
+    uint64_t     period_start;
+    uint64_t     render_time;
+    unsigned int frames;
+};
+
+typedef struct vioarr_output {
+    int              index;
+    vioarr_screen_t* screen;
+    thrd_t           thread;
+    mtx_t            lock;
+    cnd_t            signal;
+    int              should_render;
+    uint64_t         render_at;      // us, renders once this time has passed even without a request
+    int              continuous;
+    uint64_t         frame_interval; // us, 0 renders as fast as possible
+} vioarr_output_t;
+
+static vioarr_output_t g_outputs[VIOARR_MAX_OUTPUTS];
+static atomic_int      g_outputCount = 0;
+static atomic_int      g_outputsRunning = 0;
+
+static void __sleep_us(uint64_t us)
+{
+#if defined(MOLLENOS)
+    thrd_sleepex((size_t)(us / 1000));
+#else
+    struct timespec ts = {
+        .tv_sec  = (time_t)(us / 1000000),
+        .tv_nsec = (long)((us % 1000000) * 1000)
+    };
+    thrd_sleep(&ts, NULL);
+#endif
+}
+
+static void __update_stats(vioarr_output_t* output, struct frame_stats* stats, uint64_t frameStart, uint64_t frameEnd)
+{
+    vioarr_governor_state_t governor;
+    vioarr_arena_stats_t    arena;
+    uint64_t                elapsed;
+
+    stats->frames++;
+    stats->render_time += frameEnd - frameStart;
+
+    elapsed = frameEnd - stats->period_start;
+    if (elapsed >= (uint64_t)OUTPUT_STATS_INTERVAL * 1000) {
+        vioarr_governor_state(vioarr_renderer_output(vioarr_screen_renderer(output->screen)), &governor);
+        vioarr_utils_trace(VISTR("[vioarr_outputs] output %i: %u frames in %u ms, %u us per frame (%u us rendering, %u us presenting), quality level %i"),
+            output->index, stats->frames, (unsigned int)(elapsed / 1000),
+            (unsigned int)(stats->render_time / stats->frames), governor.render_time, governor.present_time,
+            governor.level);
+
+        vioarr_renderer_frame_stats(vioarr_screen_renderer(output->screen), &arena);
+        vioarr_utils_trace(VISTR("[vioarr_outputs] output %i: frame arena of %zu bytes, peak %zu, %zu overflows"),
+            output->index, arena.capacity, arena.peak, arena.overflows);
+
+        // the caches are shared by all outputs, so only the first one reports them
+        if (!output->index) {
+            vioarr_slab_trace_stats();
+        }
+        stats->period_start = frameEnd;
+        stats->render_time  = 0;
+        stats->frames       = 0;
+    }
+}
+
+static void __wait_for_redraw(vioarr_output_t* output)
+{
+    mtx_lock(&output->lock);
+    while (!output->should_render) {
+        struct timespec deadline;
+        uint64_t        now;
+        uint64_t        remaining;
+
+        if (!output->render_at) {
+            cnd_wait(&output->signal, &output->lock);
+            continue;
+        }
+
+        now = vioarr_utils_time_us();
+        if (now >= output->render_at) {
+            break;
+        }
+
+        // the condition waits on the calendar clock, the deadline is kept on the monotonic one
+        remaining = output->render_at - now;
+        timespec_get(&deadline, TIME_UTC);
+        deadline.tv_sec  += (time_t)(remaining / 1000000);
+        deadline.tv_nsec += (long)((remaining % 1000000) * 1000);
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        cnd_timedwait(&output->signal, &output->lock, &deadline);
+    }
+    output->should_render = 0;
+    output->render_at     = 0;
+    mtx_unlock(&output->lock);
+}
+
+static int __output_thread(void* context)
+{
+    vioarr_output_t*   output = context;
+    struct frame_stats stats  = { 0 };
+    uint64_t           lastUpdate = 0;
+    int                governed   = vioarr_renderer_output(vioarr_screen_renderer(output->screen));
+    unsigned int       budget;
+
+    if (vioarr_screen_make_current(output->screen, 1)) {
+        vioarr_utils_error(VISTR("[vioarr_outputs] output %i: failed to make the screen current"), output->index);
+        atomic_fetch_sub(&g_outputsRunning, 1);
+        return -1;
+    }
+
+    // rendering is measured once the renderer holds its locks and presenting until the screen
+    // is done with the frame, rendering that runs over its budget is stepped down by the governor
+    // on the following frames
+    budget = output->frame_interval ? (unsigned int)output->frame_interval : VIOARR_GOVERNOR_DEFAULT_BUDGET;
+    stats.period_start = vioarr_utils_time_us();
+    while (vioarr_screen_valid(output->screen)) {
+        uint64_t frameStart;
+        uint64_t frameEnd;
+        uint64_t renderStart;
+        uint64_t renderEnd;
+        uint64_t interval = output->frame_interval;
+
+        if (!output->continuous) {
+            __wait_for_redraw(output);
+        }
+
+        // at the lowest level the time between frames is left to the clients
+        if (vioarr_governor_level(governed) >= VIOARR_GOVERNOR_HALF_RATE) {
+            interval = (uint64_t)budget * 2;
+        }
+
+        frameStart = vioarr_utils_time_us();
+        if (interval && (frameStart - lastUpdate) < interval) {
+            __sleep_us(interval - (frameStart - lastUpdate));
+            frameStart = vioarr_utils_time_us();
+        }
+        lastUpdate = frameStart;
+
+        vioarr_screen_frame(output->screen);
+        frameEnd = vioarr_utils_time_us();
+        vioarr_renderer_frame_times(vioarr_screen_renderer(output->screen), &renderStart, &renderEnd);
+        vioarr_governor_frame(governed, budget, (unsigned int)(renderEnd - renderStart),
+            (unsigned int)(frameEnd - renderEnd));
+        __update_stats(output, &stats, frameStart, frameEnd);
+    }
+
+    vioarr_screen_make_current(output->screen, 0);
+    atomic_fetch_sub(&g_outputsRunning, 1);
+    return 0;
+}
+
+int vioarr_outputs_add(vioarr_screen_t* screen, int continuous)
+{
+    vioarr_output_t* output;
+    int              refreshRate;
+    int              index;
+
+    if (!screen) {
+        return -1;
+    }
+
+    // outputs are only added during startup, by the engine thread
+    index = atomic_load(&g_outputCount);
+    if (index == VIOARR_MAX_OUTPUTS) {
+        vioarr_utils_error(VISTR("[vioarr_outputs_add] no more than %i outputs are supported"), VIOARR_MAX_OUTPUTS);
+        return -1;
+    }
+
+    refreshRate = vioarr_screen_refresh_rate(screen);
+    output = &g_outputs[index];
+    output->index          = index;
+    output->screen         = screen;
+    output->should_render  = 1;
+    output->continuous     = continuous;
+    output->frame_interval = refreshRate > 0 ? (uint64_t)(1000000 / refreshRate) : 0;
+    mtx_init(&output->lock, mtx_plain);
+    cnd_init(&output->signal);
+
+    // publish the output before its thread starts, so redraw requests reach it
+    atomic_fetch_add(&g_outputsRunning, 1);
+    atomic_store(&g_outputCount, index + 1);
+    if (thrd_create(&output->thread, __output_thread, output) != thrd_success) {
+        vioarr_utils_error(VISTR("[vioarr_outputs_add] failed to create the render thread"));
+        atomic_fetch_sub(&g_outputsRunning, 1);
+        return -1;
+    }
+
+    vioarr_utils_trace(VISTR("[vioarr_outputs_add] output %i at %i Hz"), index, refreshRate);
+    return 0;
+}
+
+int vioarr_outputs_count(void)
+{
+    return atomic_load(&g_outputCount);
+}
+
+int vioarr_outputs_running(void)
+{
+    return atomic_load(&g_outputsRunning);
+}
+
+vioarr_screen_t* vioarr_outputs_screen(int index)
+{
+    if (index < 0 || index >= atomic_load(&g_outputCount)) {
+        return NULL;
+    }
+    return g_outputs[index].screen;
+}
+
+/**
+ * Retrieves the screen that contains the given point, points outside all screens
+ * belong to the first one.
+ */
+vioarr_screen_t* vioarr_outputs_screen_at(int x, int y)
+{
+    int count = atomic_load(&g_outputCount);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        vioarr_region_t* region = vioarr_screen_region(g_outputs[i].screen);
+        if (vioarr_region_contains(region, x, y)) {
+            return g_outputs[i].screen;
+        }
+    }
+    return vioarr_outputs_screen(0);
+}
+
+/**
+ * Retrieves the bounding box of all the screens in global coordinates.
+ */
+void vioarr_outputs_bounds(int* x1Out, int* y1Out, int* x2Out, int* y2Out)
+{
+    int count = atomic_load(&g_outputCount);
+    int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        vioarr_region_t* region = vioarr_screen_region(g_outputs[i].screen);
+        int              rx1    = vioarr_region_x(region);
+        int              ry1    = vioarr_region_y(region);
+        int              rx2    = rx1 + vioarr_region_width(region);
+        int              ry2    = ry1 + vioarr_region_height(region);
+
+        if (!i) {
+            x1 = rx1; y1 = ry1; x2 = rx2; y2 = ry2;
+            continue;
+        }
+
+        x1 = rx1 < x1 ? rx1 : x1;
+        y1 = ry1 < y1 ? ry1 : y1;
+        x2 = rx2 > x2 ? rx2 : x2;
+        y2 = ry2 > y2 ? ry2 : y2;
+    }
+
+    *x1Out = x1;
+    *y1Out = y1;
+    *x2Out = x2;
+    *y2Out = y2;
+}
+
+void vioarr_outputs_request_redraw(void)
+{
+    int count = atomic_load(&g_outputCount);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        mtx_lock(&g_outputs[i].lock);
+        g_outputs[i].should_render = 1;
+        mtx_unlock(&g_outputs[i].lock);
+        cnd_signal(&g_outputs[i].signal);
+    }
+}
+
+/**
+ * Makes the output of the screen render a frame once the delay has passed, unless it renders
+ * before that anyway. Used for work that is deferred to a later frame, like rate limited captures.
+ */
+void vioarr_outputs_schedule_redraw(vioarr_screen_t* screen, unsigned int delayUs)
+{
+    int count = atomic_load(&g_outputCount);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        uint64_t renderAt;
+
+        if (g_outputs[i].screen != screen) {
+            continue;
+        }
+
+        renderAt = vioarr_utils_time_us() + delayUs;
+        mtx_lock(&g_outputs[i].lock);
+        if (!g_outputs[i].render_at || renderAt < g_outputs[i].render_at) {
+            g_outputs[i].render_at = renderAt;
+        }
+        mtx_unlock(&g_outputs[i].lock);
+        cnd_signal(&g_outputs[i].signal);
+        break;
+    }
+}
+
+/**
+ * Surfaces can be presented on every output, so each renderer must release its
+ * resources of the surface before it can be freed.
+ */
+void vioarr_outputs_queue_cleanup(vioarr_surface_t* surface)
+{
+    int count = atomic_load(&g_outputCount);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        vioarr_renderer_queue_cleanup(vioarr_screen_renderer(g_outputs[i].screen), surface);
+    }
+}
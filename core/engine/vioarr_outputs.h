@@ -0,0 +1,50 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#ifndef __VIOARR_OUTPUTS_H__
+#define __VIOARR_OUTPUTS_H__
+
+#include "vioarr_engine.h"
+
+typedef struct vioarr_screen  vioarr_screen_t;
+typedef struct vioarr_surface vioarr_surface_t;
+
+/**
+ * Every output composites on its own thread at its own refresh rate, so a slow
+ * screen never holds back a faster one. Screens are handed to the outputs module
+ * once created, their rendering context must not be current on the calling thread.
+ * Continuous outputs render every frame even without anything changing.
+ */
+int              vioarr_outputs_add(vioarr_screen_t*, int continuous);
+int              vioarr_outputs_count(void);
+int              vioarr_outputs_running(void);
+vioarr_screen_t* vioarr_outputs_screen(int index);
+vioarr_screen_t* vioarr_outputs_screen_at(int x, int y);
+void             vioarr_outputs_bounds(int* x1Out, int* y1Out, int* x2Out, int* y2Out);
+void             vioarr_outputs_request_redraw(void);
+void             vioarr_outputs_schedule_redraw(vioarr_screen_t*, unsigned int delayUs);
+void             vioarr_outputs_queue_cleanup(vioarr_surface_t*);
+
+#endif //!__VIOARR_OUTPUTS_H__
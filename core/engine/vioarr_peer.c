@@ -0,0 +1,149 @@
+/* MollenOS
+ *
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#define _GNU_SOURCE
+
+#include "vioarr_peer.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+static atomic_int g_shellPid = ATOMIC_VAR_INIT(0);
+
+#if defined(__linux__)
+#include <gracht/link/link.h>
+#include <sys/socket.h>
+
+#define PEER_MAX_CLIENTS 4096
+#define PEER_MAX_LINKS   4
+
+typedef struct vioarr_peer_link {
+    struct gracht_link* link;
+    link_accept_fn      accept;
+    vioarr_peer_pid_fn  pid;
+} vioarr_peer_link_t;
+
+static atomic_int         g_pids[PEER_MAX_CLIENTS]; // 0 while the process is not known
+static vioarr_peer_link_t g_links[PEER_MAX_LINKS];
+static int                g_linkCount = 0;
+
+static int __peer_accept(struct gracht_link* link, struct gracht_server_client** clientOut)
+{
+    vioarr_peer_link_t* entry = NULL;
+    int                 status;
+    int                 i;
+
+    for (i = 0; i < g_linkCount; i++) {
+        if (g_links[i].link == link) {
+            entry = &g_links[i];
+            break;
+        }
+    }
+
+    if (!entry) {
+        return -1;
+    }
+
+    status = entry->accept(link, clientOut);
+    if (!status && (*clientOut)->handle >= 0 && (*clientOut)->handle < PEER_MAX_CLIENTS) {
+        int pid = entry->pid(*clientOut);
+        atomic_store(&g_pids[(*clientOut)->handle], pid > 0 ? pid : 0);
+    }
+    return status;
+}
+
+int vioarr_peer_wrap(struct gracht_link* link, vioarr_peer_pid_fn pidFn)
+{
+    // links are wrapped during startup, before any client can connect
+    if (!link || !pidFn || g_linkCount == PEER_MAX_LINKS) {
+        return -1;
+    }
+
+    g_links[g_linkCount++] = (vioarr_peer_link_t) { link, link->ops.accept, pidFn };
+    link->ops.accept = (link_accept_fn)__peer_accept;
+    return 0;
+}
+
+int vioarr_peer_socket_pid(struct gracht_server_client* client)
+{
+    struct ucred credentials;
+    socklen_t    length = sizeof(credentials);
+
+    if (!client || getsockopt(client->handle, SOL_SOCKET, SO_PEERCRED, &credentials, &length)) {
+        return -1;
+    }
+    return (int)credentials.pid;
+}
+
+int vioarr_peer_pid(int client)
+{
+    int pid = 0;
+    if (client >= 0 && client < PEER_MAX_CLIENTS) {
+        pid = atomic_load(&g_pids[client]);
+    }
+    return pid ? pid : -1;
+}
+
+void vioarr_peer_remove(int client)
+{
+    if (client >= 0 && client < PEER_MAX_CLIENTS) {
+        atomic_store(&g_pids[client], 0);
+    }
+}
+#else
+int vioarr_peer_wrap(struct gracht_link* link, vioarr_peer_pid_fn pidFn)
+{
+    (void)link;
+    (void)pidFn;
+    return 0;
+}
+
+int vioarr_peer_socket_pid(struct gracht_server_client* client)
+{
+    (void)client;
+    return -1;
+}
+
+int vioarr_peer_pid(int client)
+{
+    (void)client;
+    return -1;
+}
+
+void vioarr_peer_remove(int client)
+{
+    (void)client;
+}
+#endif
+
+void vioarr_peer_set_shell(int pid)
+{
+    atomic_store(&g_shellPid, pid);
+}
+
+int vioarr_peer_is_shell(int client)
+{
+    int shell = atomic_load(&g_shellPid);
+    return shell > 0 && vioarr_peer_pid(client) == shell;
+}
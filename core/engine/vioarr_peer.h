@@ -0,0 +1,52 @@
+/* MollenOS
+ *
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#ifndef __VIOARR_PEER_H__
+#define __VIOARR_PEER_H__
+
+struct gracht_link;
+struct gracht_server_client;
+
+/**
+ * Remembers the process behind every client connection on linux, which is what privileged
+ * requests and memory handed over out of band are matched against. The shell is the launcher
+ * process started by the compositor itself. Clients of links that are not wrapped, and every
+ * client on other platforms, have no known process and are never the shell.
+ */
+typedef int (*vioarr_peer_pid_fn)(struct gracht_server_client* client);
+
+/**
+ * vioarr_peer_wrap
+ * * Records the process of every client accepted on the link, must be called before the link is
+ * * added to the server. The function returns the process id of a newly accepted client.
+ */
+int  vioarr_peer_wrap(struct gracht_link* link, vioarr_peer_pid_fn pidFn);
+int  vioarr_peer_socket_pid(struct gracht_server_client* client);
+void vioarr_peer_set_shell(int pid);
+int  vioarr_peer_pid(int client);
+int  vioarr_peer_is_shell(int client);
+void vioarr_peer_remove(int client);
+
+#endif //!__VIOARR_PEER_H__
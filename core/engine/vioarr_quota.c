@@ -0,0 +1,360 @@
+/* MollenOS
+ *
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+#include "vioarr_quota.h"
+#include "vioarr_textures.h"
+#include "vioarr_utils.h"
+#include "wm_core_service_server.h"
+#include <stdlib.h>
+
+// messages are counted in windows of a second
+#define QUOTA_MESSAGE_WINDOW 1000000 // us
+
+typedef struct vioarr_quota_client {
+    int      client;
+    size_t   memory;
+    size_t   objects;
+    size_t   messages; // received in the current window
+    uint64_t window;   // start of the current window
+    int      reported; // whether the client was told it exceeded the rate in the current window
+} vioarr_quota_client_t;
+
+static struct {
+    mtx_t                  lock;
+    size_t                 limits[VIOARR_QUOTA_COUNT];
+    vioarr_quota_client_t* clients;
+    int                    client_count;
+    int                    client_capacity;
+} g_quota;
+
+static const char* g_resourceNames[VIOARR_QUOTA_COUNT] = {
+    "memory", "textures", "objects", "messages"
+};
+
+// must be called with the lock held
+static vioarr_quota_client_t* __get_client(int client, int create)
+{
+    int i;
+
+    for (i = 0; i < g_quota.client_count; i++) {
+        if (g_quota.clients[i].client == client) {
+            return &g_quota.clients[i];
+        }
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    if (g_quota.client_count == g_quota.client_capacity) {
+        int                    capacity = g_quota.client_capacity ? (g_quota.client_capacity * 2) : 16;
+        vioarr_quota_client_t* clients  = realloc(g_quota.clients, sizeof(vioarr_quota_client_t) * capacity);
+        if (!clients) {
+            return NULL;
+        }
+        g_quota.clients         = clients;
+        g_quota.client_capacity = capacity;
+    }
+
+    g_quota.clients[g_quota.client_count] = (vioarr_quota_client_t) { .client = client };
+    return &g_quota.clients[g_quota.client_count++];
+}
+
+// must be called with the lock held
+static size_t __usage(vioarr_quota_client_t* quota, int client, enum vioarr_quota_resource resource)
+{
+    switch (resource) {
+        case VIOARR_QUOTA_MEMORY:   return quota ? quota->memory : 0;
+        case VIOARR_QUOTA_TEXTURES: return vioarr_textures_client_usage(client, NULL);
+        case VIOARR_QUOTA_OBJECTS:  return quota ? quota->objects : 0;
+        case VIOARR_QUOTA_MESSAGES: {
+            if (!quota || vioarr_utils_time_us() - quota->window >= QUOTA_MESSAGE_WINDOW) {
+                return 0;
+            }
+            return quota->messages;
+        }
+        default:
+            return 0;
+    }
+}
+
+static size_t __read_limit(const char* name, size_t defaultLimit, size_t scale)
+{
+    const char* value = getenv(name);
+    if (!value) {
+        return defaultLimit;
+    }
+    return (size_t)strtoull(value, NULL, 10) * scale;
+}
+
+void vioarr_quota_initialize(void)
+{
+    mtx_init(&g_quota.lock, mtx_plain);
+    g_quota.clients         = NULL;
+    g_quota.client_count    = 0;
+    g_quota.client_capacity = 0;
+
+    g_quota.limits[VIOARR_QUOTA_MEMORY]   = __read_limit("VIOARR_QUOTA_MEMORY", VIOARR_QUOTA_MEMORY_DEFAULT, 1024 * 1024);
+    g_quota.limits[VIOARR_QUOTA_TEXTURES] = __read_limit("VIOARR_QUOTA_TEXTURES", VIOARR_QUOTA_TEXTURES_DEFAULT, 1024 * 1024);
+    g_quota.limits[VIOARR_QUOTA_OBJECTS]  = __read_limit("VIOARR_QUOTA_OBJECTS", VIOARR_QUOTA_OBJECTS_DEFAULT, 1);
+    g_quota.limits[VIOARR_QUOTA_MESSAGES] = __read_limit("VIOARR_QUOTA_MESSAGES", VIOARR_QUOTA_MESSAGES_DEFAULT, 1);
+    vioarr_utils_trace(VISTR("[vioarr_quota_initialize] memory=%zu, textures=%zu, objects=%zu, messages=%zu"),
+        g_quota.limits[VIOARR_QUOTA_MEMORY], g_quota.limits[VIOARR_QUOTA_TEXTURES],
+        g_quota.limits[VIOARR_QUOTA_OBJECTS], g_quota.limits[VIOARR_QUOTA_MESSAGES]);
+}
+
+void vioarr_quota_set_limit(enum vioarr_quota_resource resource, size_t limit)
+{
+    if (resource >= VIOARR_QUOTA_COUNT) {
+        return;
+    }
+
+    mtx_lock(&g_quota.lock);
+    g_quota.limits[resource] = limit;
+    mtx_unlock(&g_quota.lock);
+}
+
+/**
+ * Checks whether the client can take amount more of the resource. The requests of a client are
+ * never handled in parallel, so nothing is reserved between the check and the charge.
+ */
+int vioarr_quota_check(int client, enum vioarr_quota_resource resource, size_t amount)
+{
+    size_t usage;
+    size_t limit;
+
+    if (resource >= VIOARR_QUOTA_COUNT) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    mtx_lock(&g_quota.lock);
+    usage = __usage(__get_client(client, 0), client, resource);
+    limit = g_quota.limits[resource];
+    mtx_unlock(&g_quota.lock);
+
+    if (limit && (amount > limit || usage > limit - amount)) {
+        vioarr_utils_error(VISTR("[vioarr_quota] client %i exceeds its %s quota, %zu + %zu > %zu"),
+            client, g_resourceNames[resource], usage, amount, limit);
+        errno = EDQUOT;
+        return -1;
+    }
+    return 0;
+}
+
+void vioarr_quota_charge(int client, enum vioarr_quota_resource resource, size_t amount)
+{
+    vioarr_quota_client_t* quota;
+
+    mtx_lock(&g_quota.lock);
+    quota = __get_client(client, 1);
+    if (quota) {
+        if (resource == VIOARR_QUOTA_MEMORY) {
+            quota->memory += amount;
+        }
+        else if (resource == VIOARR_QUOTA_OBJECTS) {
+            quota->objects += amount;
+        }
+    }
+    mtx_unlock(&g_quota.lock);
+}
+
+void vioarr_quota_release(int client, enum vioarr_quota_resource resource, size_t amount)
+{
+    vioarr_quota_client_t* quota;
+    size_t*                usage = NULL;
+
+    mtx_lock(&g_quota.lock);
+    quota = __get_client(client, 0);
+    if (quota) {
+        if (resource == VIOARR_QUOTA_MEMORY) {
+            usage = &quota->memory;
+        }
+        else if (resource == VIOARR_QUOTA_OBJECTS) {
+            usage = &quota->objects;
+        }
+    }
+
+    // resources can outlive a client that disconnected, and the client id can be reused
+    if (usage) {
+        *usage = *usage > amount ? (*usage - amount) : 0;
+    }
+    mtx_unlock(&g_quota.lock);
+}
+
+void vioarr_quota_on_message(int client)
+{
+    vioarr_quota_client_t* quota;
+    uint64_t               now = vioarr_utils_time_us();
+
+    mtx_lock(&g_quota.lock);
+    quota = __get_client(client, 1);
+    if (quota) {
+        if (now - quota->window >= QUOTA_MESSAGE_WINDOW) {
+            quota->window   = now;
+            quota->messages = 0;
+            quota->reported = 0;
+        }
+        quota->messages++;
+    }
+    mtx_unlock(&g_quota.lock);
+}
+
+/**
+ * Returns the time (vioarr_utils_time_us) until which no more messages should be read from the
+ * client, or 0 if the client is within its message rate. The client is told once per window.
+ */
+uint64_t vioarr_quota_throttled(int client)
+{
+    vioarr_quota_client_t* quota;
+    uint64_t               until  = 0;
+    int                    report = 0;
+
+    mtx_lock(&g_quota.lock);
+    quota = __get_client(client, 0);
+    if (quota && g_quota.limits[VIOARR_QUOTA_MESSAGES] &&
+        __usage(quota, client, VIOARR_QUOTA_MESSAGES) > g_quota.limits[VIOARR_QUOTA_MESSAGES]) {
+        until  = quota->window + QUOTA_MESSAGE_WINDOW;
+        report = !quota->reported;
+        quota->reported = 1;
+    }
+    mtx_unlock(&g_quota.lock);
+
+    if (report) {
+        vioarr_utils_error(VISTR("[vioarr_quota] client %i exceeds its message rate"), client);
+        wm_core_event_error_single(vioarr_get_server_handle(), client, 0, EDQUOT, "wm_core: message rate exceeded");
+    }
+    return until;
+}
+
+void vioarr_quota_get_usage(int client, vioarr_quota_usage_t* usageOut)
+{
+    vioarr_quota_client_t* quota;
+    int                    i;
+
+    if (!usageOut) {
+        return;
+    }
+
+    mtx_lock(&g_quota.lock);
+    quota = __get_client(client, 0);
+    for (i = 0; i < VIOARR_QUOTA_COUNT; i++) {
+        usageOut->usage[i]  = __usage(quota, client, (enum vioarr_quota_resource)i);
+        usageOut->limits[i] = g_quota.limits[i];
+    }
+    mtx_unlock(&g_quota.lock);
+}
+
+void vioarr_quota_remove_client(int client)
+{
+    vioarr_quota_client_t* quota;
+
+    mtx_lock(&g_quota.lock);
+    quota = __get_client(client, 0);
+    if (quota) {
+        *quota = g_quota.clients[--g_quota.client_count];
+    }
+    mtx_unlock(&g_quota.lock);
+}
+
+#if defined(__linux__)
+#include <gracht/link/link.h>
+#include <stdatomic.h>
+
+#define QUOTA_MAX_CLIENTS 4096
+#define QUOTA_MAX_LINKS   4
+
+typedef struct vioarr_quota_link {
+    struct gracht_link* link;
+    link_accept_fn      accept;
+    link_recv_client_fn recv_client;
+} vioarr_quota_link_t;
+
+// the link each client was accepted on, as an index + 1 into g_links
+static atomic_int          g_clientLinks[QUOTA_MAX_CLIENTS];
+static vioarr_quota_link_t g_links[QUOTA_MAX_LINKS];
+static int                 g_linkCount = 0;
+
+static int __quota_accept(struct gracht_link* link, struct gracht_server_client** clientOut)
+{
+    int status;
+    int i;
+
+    for (i = 0; i < g_linkCount; i++) {
+        if (g_links[i].link == link) {
+            break;
+        }
+    }
+
+    if (i == g_linkCount) {
+        return -1;
+    }
+
+    status = g_links[i].accept(link, clientOut);
+    if (!status && (*clientOut)->handle >= 0 && (*clientOut)->handle < QUOTA_MAX_CLIENTS) {
+        atomic_store(&g_clientLinks[(*clientOut)->handle], i + 1);
+    }
+    return status;
+}
+
+static int __quota_recv_client(struct gracht_server_client* client, struct gracht_buffer* message, unsigned int flags)
+{
+    int index  = 0;
+    int status;
+
+    if (client->handle >= 0 && client->handle < QUOTA_MAX_CLIENTS) {
+        index = atomic_load(&g_clientLinks[client->handle]);
+    }
+
+    // clients are always accepted before anything is received from them
+    if (!index) {
+        return -1;
+    }
+
+    status = g_links[index - 1].recv_client(client, message, flags);
+    if (!status) {
+        vioarr_quota_on_message(client->handle);
+    }
+    return status;
+}
+
+int vioarr_quota_wrap(struct gracht_link* link)
+{
+    // links are wrapped during startup, before any client can connect
+    if (!link || g_linkCount == QUOTA_MAX_LINKS) {
+        return -1;
+    }
+
+    g_links[g_linkCount++] = (vioarr_quota_link_t) { link, link->ops.accept, link->ops.recv_client };
+    link->ops.accept      = (link_accept_fn)__quota_accept;
+    link->ops.recv_client = (link_recv_client_fn)__quota_recv_client;
+    return 0;
+}
+#else
+int vioarr_quota_wrap(struct gracht_link* link)
+{
+    (void)link;
+    return 0;
+}
+#endif
@@ -0,0 +1,82 @@
+/* MollenOS
+ *
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+#ifndef __VIOARR_QUOTA_H__
+#define __VIOARR_QUOTA_H__
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Every client is limited in the resources it can hold in the compositor, so a client that leaks
+ * or floods allocations fails its own requests instead of degrading the desktop. Requests that
+ * would exceed a limit fail with EDQUOT. The defaults can be overridden at startup with the
+ * VIOARR_QUOTA_MEMORY and VIOARR_QUOTA_TEXTURES (in megabytes), VIOARR_QUOTA_OBJECTS and
+ * VIOARR_QUOTA_MESSAGES (per second) environment variables, where 0 disables the limit.
+ */
+#define VIOARR_QUOTA_MEMORY_DEFAULT   (512 * 1024 * 1024)
+#define VIOARR_QUOTA_TEXTURES_DEFAULT (256 * 1024 * 1024)
+#define VIOARR_QUOTA_OBJECTS_DEFAULT  4096
+#define VIOARR_QUOTA_MESSAGES_DEFAULT 20000
+
+#ifndef EDQUOT
+#define EDQUOT ENOSPC
+#endif
+
+enum vioarr_quota_resource {
+    VIOARR_QUOTA_MEMORY,   // bytes of shared memory mapped from the client
+    VIOARR_QUOTA_TEXTURES, // bytes of textures holding the content of the client
+    VIOARR_QUOTA_OBJECTS,  // objects created by the client
+    VIOARR_QUOTA_MESSAGES, // requests received from the client during the last second
+
+    VIOARR_QUOTA_COUNT
+};
+
+typedef struct vioarr_quota_usage {
+    size_t usage[VIOARR_QUOTA_COUNT];
+    size_t limits[VIOARR_QUOTA_COUNT];
+} vioarr_quota_usage_t;
+
+struct gracht_link;
+
+void     vioarr_quota_initialize(void);
+void     vioarr_quota_set_limit(enum vioarr_quota_resource, size_t limit);
+int      vioarr_quota_check(int client, enum vioarr_quota_resource, size_t amount);
+void     vioarr_quota_charge(int client, enum vioarr_quota_resource, size_t amount);
+void     vioarr_quota_release(int client, enum vioarr_quota_resource, size_t amount);
+void     vioarr_quota_on_message(int client);
+uint64_t vioarr_quota_throttled(int client);
+void     vioarr_quota_get_usage(int client, vioarr_quota_usage_t* usageOut);
+void     vioarr_quota_remove_client(int client);
+
+/**
+ * vioarr_quota_wrap
+ * * Counts the messages received on a link, must be called before the link is added to the
+ * * server. Every link keeps its own receive function. Messages received on links that are not
+ * * wrapped are not limited.
+ */
+int vioarr_quota_wrap(struct gracht_link* link);
+
+#endif //!__VIOARR_QUOTA_H__
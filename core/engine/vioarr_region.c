@@ -23,6 +23,7 @@
  */
  
 #include "vioarr_region.h"
+#include "vioarr_slab.h"
 #include "vioarr_utils.h"
 #include <stdlib.h>
 
@@ -33,11 +34,13 @@ typedef struct vioarr_region {
     int height;
 } vioarr_region_t;
 
+static vioarr_slab_cache_t g_regionCache = VIOARR_SLAB_CACHE_INIT("region", sizeof(vioarr_region_t), 128);
+
 vioarr_region_t* vioarr_region_create(void)
 {
     vioarr_region_t* region;
     
-    region = malloc(sizeof(vioarr_region_t));
+    region = vioarr_slab_alloc(&g_regionCache);
     if (!region) {
         return NULL;
     }
@@ -46,6 +49,11 @@ vioarr_region_t* vioarr_region_create(void)
     return region;
 }
 
+void vioarr_region_destroy(vioarr_region_t* region)
+{
+    vioarr_slab_free(&g_regionCache, region);
+}
+
 void vioarr_region_zero(vioarr_region_t* region)
 {
     if (!region) {
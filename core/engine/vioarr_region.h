@@ -28,6 +28,7 @@
 typedef struct vioarr_region vioarr_region_t;
 
 vioarr_region_t* vioarr_region_create(void);
+void             vioarr_region_destroy(vioarr_region_t*);
 void             vioarr_region_zero(vioarr_region_t*);
 void             vioarr_region_copy(vioarr_region_t*, vioarr_region_t*);
 void             vioarr_region_set_position(vioarr_region_t*, int x, int y);
@@ -33,21 +33,37 @@
 #endif
 
 #include <list.h>
+#include "vioarr_arena.h"
+#include "vioarr_blur.h"
 #include "vioarr_buffer.h"
+#include "vioarr_capture.h"
+#include "vioarr_cork.h"
+#include "vioarr_cursor.h"
+#include "vioarr_damage.h"
+#include "vioarr_drawlist.h"
 #include "vioarr_engine.h"
+#include "vioarr_governor.h"
 #include "vioarr_renderer.h"
 #include "vioarr_screen.h"
 #include "vioarr_surface.h"
 #include "vioarr_manager.h"
+#include "vioarr_slab.h"
+#include "vioarr_textures.h"
 #include "vioarr_utils.h"
+#include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 
+#define RENDERER_FRAME_ARENA_SIZE (16 * 1024)
+
 typedef struct vioarr_renderer {
 #ifdef VIOARR_BACKEND_NANOVG
     vcontext_t*      context;
 #endif
     vioarr_screen_t* screen;
+    int              output;   // index of the output, selects the surface textures owned by this context
+    int              quality;  // governor level the last frame was rendered at
     int              width;
     int              height;
     int              scale;
@@ -55,30 +71,84 @@ typedef struct vioarr_renderer {
     float            pixel_ratio;
     mtx_t            lock;
     list_t           cleanup_list;
+    list_t           captures;
+    list_t           thumbnails;
+    vioarr_arena_t*  frame_arena;
+    vioarr_cursor_t* cursor;   // cursor plane of the screen, the cursor is drawn by the screen if set
+    vioarr_blur_t*   blur;     // backdrop blurs, NULL if they are not supported by the context
+    uint64_t         render_start; // us, when the last frame started rendering once the locks were taken
+    uint64_t         render_end;   // us, when the last frame was rendered, see vioarr_renderer_finished
+
+    // copy of the draw list of the manager taken at the start of every frame
+    vioarr_drawlist_t draw_list;
+
+    // damage tracking, the state of every draw list entry as presented in the last frame
+    vioarr_drawlist_rect_t  damage;      // bounds of damage_rects
+    vioarr_damage_t         damage_rects;
+    vioarr_drawlist_rect_t* last_bounds;
+    int*                    last_drawn;
+    float*                  last_opacity;
+    int                     last_count;
+    int                     last_capacity;
+    unsigned int            last_generation;
+    int                     full_damage;
 } vioarr_renderer_t;
 
-vioarr_renderer_t* vioarr_renderer_create(vioarr_screen_t* screen, int width, int height)
+static vioarr_slab_cache_t g_cleanupCache = VIOARR_SLAB_CACHE_INIT("renderer_cleanup", sizeof(element_t), 32);
+static atomic_int          g_rendererCount = 0;
+
+vioarr_renderer_t* vioarr_renderer_create(vioarr_screen_t* screen, int width, int height, unsigned int flags)
 {
     vioarr_renderer_t* renderer;
     int                screenWidth  = vioarr_region_width(vioarr_screen_region(screen));
+    int                output;
+#ifdef VIOARR_BACKEND_NANOVG
+    int                nvgFlags = NVG_STENCIL_STROKES | NVG_DEBUG;
+#endif
+
+    // every renderer has its own context, so surfaces keep a texture per renderer
+    output = atomic_fetch_add(&g_rendererCount, 1);
+    if (output >= VIOARR_MAX_OUTPUTS) {
+        vioarr_utils_error(VISTR("[vioarr_renderer_create] no more than %i renderers are supported"), VIOARR_MAX_OUTPUTS);
+        atomic_fetch_sub(&g_rendererCount, 1);
+        return NULL;
+    }
     
     renderer = (vioarr_renderer_t*)malloc(sizeof(vioarr_renderer_t));
     if (!renderer) {
         return NULL;
     }
 
+    memset(renderer, 0, sizeof(vioarr_renderer_t));
+    renderer->output      = output;
+    renderer->full_damage = 1;
+    renderer->frame_arena = vioarr_arena_create(RENDERER_FRAME_ARENA_SIZE);
+    if (!renderer->frame_arena) {
+        free(renderer);
+        return NULL;
+    }
+
 #ifdef VIOARR_BACKEND_NANOVG
     vioarr_utils_trace(VISTR("[vioarr_renderer_create] creating nvg context"));
 #ifdef __VIOARR_CONFIG_RENDERER_MSAA
-	renderer->context = nvgCreateGL3(NVG_ANTIALIAS | NVG_STENCIL_STROKES | NVG_DEBUG);
-#else
-	renderer->context = nvgCreateGL3(NVG_STENCIL_STROKES | NVG_DEBUG);
+    nvgFlags |= NVG_ANTIALIAS;
 #endif
+    if (flags & VIOARR_RENDERER_DITHER) {
+        nvgFlags |= NVG_DITHER;
+    }
+	renderer->context = nvgCreateGL3(nvgFlags);
     if (!renderer->context) {
         vioarr_utils_error(VISTR("[vioarr_renderer_create] failed to create the nvg context"));
+        vioarr_arena_destroy(renderer->frame_arena);
         free(renderer);
         return NULL;
     }
+
+    // surfaces without their backdrop blurred still look right, so this is not fatal
+    renderer->blur = vioarr_blur_create();
+    if (!renderer->blur) {
+        vioarr_utils_error(VISTR("[vioarr_renderer_create] backdrop blur is not available"));
+    }
 #endif
 
     renderer->screen      = screen;
@@ -88,11 +158,22 @@ vioarr_renderer_t* vioarr_renderer_create(vioarr_screen_t* screen, int width, in
     renderer->scale       = 1;
     renderer->rotation    = 0;
     mtx_init(&renderer->lock, mtx_plain);
+    vioarr_drawlist_construct(&renderer->draw_list);
     list_construct(&renderer->cleanup_list);
+    list_construct(&renderer->captures);
+    list_construct(&renderer->thumbnails);
     
     return renderer;
 }
 
+int vioarr_renderer_output(vioarr_renderer_t* renderer)
+{
+    if (!renderer) {
+        return -1;
+    }
+    return renderer->output;
+}
+
 void vioarr_renderer_set_scale(vioarr_renderer_t* renderer, int scale)
 {
     if (!renderer) {
@@ -127,38 +208,98 @@ int vioarr_renderer_rotation(vioarr_renderer_t* renderer)
     return renderer->rotation;
 }
 
-#ifdef VIOARR_BACKEND_NANOVG
-int get_nvg_format(vioarr_buffer_t* buffer)
+/**
+ * Attaches the cursor plane of the screen. The screen must keep the composed frame between
+ * presents, as frames where only the cursor changed are not rendered again.
+ */
+void vioarr_renderer_set_cursor_plane(vioarr_renderer_t* renderer, vioarr_cursor_t* cursor)
 {
-    switch (vioarr_buffer_format(buffer)) {
-        case WM_PIXEL_FORMAT_A8R8G8B8: return NVG_TEXTURE_RGBA;
-        case WM_PIXEL_FORMAT_A8B8G8R8: return NVG_TEXTURE_BGRA;
-        case WM_PIXEL_FORMAT_X8R8G8B8: return NVG_TEXTURE_RGBX;
-        case WM_PIXEL_FORMAT_X8B8G8R8: return -1;
-        case WM_PIXEL_FORMAT_R8G8B8A8: return NVG_TEXTURE_ARGB;
-        case WM_PIXEL_FORMAT_B8G8R8A8: return NVG_TEXTURE_ABGR;
+    if (!renderer) {
+        return;
     }
-    return -1;
+    renderer->cursor = cursor;
 }
 
-int get_nvg_flags(vioarr_buffer_t* buffer)
+/**
+ * Captures receive every frame of the renderer after it was composed, until they are destroyed.
+ */
+void vioarr_renderer_add_capture(vioarr_renderer_t* renderer, vioarr_capture_t* capture)
 {
-    unsigned int bufferFlags = vioarr_buffer_flags(buffer);
-    int          nvgFlags = 0;
+    element_t* item;
 
-    if (bufferFlags & 0x1) {
-        nvgFlags |= NVG_IMAGE_FLIPY;
+    if (!renderer || !capture) {
+        return;
     }
 
-    switch (vioarr_buffer_format(buffer)) {
-        case WM_PIXEL_FORMAT_X8R8G8B8: nvgFlags |= NVG_IMAGE_PREMULTIPLIED; break;
-        case WM_PIXEL_FORMAT_X8B8G8R8: nvgFlags |= NVG_IMAGE_PREMULTIPLIED; break;
-        default: break;
+    item = vioarr_slab_alloc(&g_cleanupCache);
+    if (!item) {
+        vioarr_utils_error(VISTR("[vioarr_renderer_add_capture] out of memory"));
+        return;
     }
+    item->key = NULL;
+    item->value = capture;
 
-    return nvgFlags;
+    mtx_lock(&renderer->lock);
+    list_append(&renderer->captures, item);
+    mtx_unlock(&renderer->lock);
+}
+
+/**
+ * Thumbnails are drawn by the renderer after its frame, whenever their source surface was committed.
+ */
+void vioarr_renderer_add_thumbnail(vioarr_renderer_t* renderer, vioarr_capture_t* capture)
+{
+    element_t* item;
+
+    if (!renderer || !capture) {
+        return;
+    }
+
+    item = vioarr_slab_alloc(&g_cleanupCache);
+    if (!item) {
+        vioarr_utils_error(VISTR("[vioarr_renderer_add_thumbnail] out of memory"));
+        return;
+    }
+    item->key = NULL;
+    item->value = capture;
+
+    mtx_lock(&renderer->lock);
+    list_append(&renderer->thumbnails, item);
+    mtx_unlock(&renderer->lock);
+}
+
+void vioarr_renderer_frame_stats(vioarr_renderer_t* renderer, vioarr_arena_stats_t* statsOut)
+{
+    if (!renderer) {
+        return;
+    }
+    vioarr_arena_stats(renderer->frame_arena, statsOut);
+}
+
+/**
+ * Screens that wait for the frame to be rendered before presenting it (glFinish) mark the end of
+ * rendering after the wait, everything the screen does after this is accounted as presenting.
+ */
+void vioarr_renderer_finished(vioarr_renderer_t* renderer)
+{
+    if (!renderer) {
+        return;
+    }
+    renderer->render_end = vioarr_utils_time_us();
+}
+
+/**
+ * Retrieves when the last frame started rendering after the locks were taken, and when rendering
+ * it ended, in microseconds. Must only be called by the thread rendering the frames.
+ */
+void vioarr_renderer_frame_times(vioarr_renderer_t* renderer, uint64_t* startOut, uint64_t* endOut)
+{
+    if (!renderer || !startOut || !endOut) {
+        return;
+    }
+    *startOut = renderer->render_start;
+    *endOut   = renderer->render_end;
 }
-#endif
 
 void vioarr_renderer_queue_cleanup(vioarr_renderer_t* renderer, vioarr_surface_t* surface)
 {
@@ -168,7 +309,11 @@ void vioarr_renderer_queue_cleanup(vioarr_renderer_t* renderer, vioarr_surface_t
         return;
     }
 
-    item = malloc(sizeof(element_t));
+    item = vioarr_slab_alloc(&g_cleanupCache);
+    if (!item) {
+        vioarr_utils_error(VISTR("[vioarr_renderer_queue_cleanup] out of memory"));
+        return;
+    }
     item->key = NULL;
     item->value = surface;
 
@@ -181,51 +326,735 @@ void vioarr_renderer_queue_cleanup(vioarr_renderer_t* renderer, vioarr_surface_t
 static void cleanup_entry(element_t* item, void* context)
 {
     vioarr_renderer_t* renderer = context;    
-    vioarr_surface_free(renderer->context, item->value);
-    free(item);
+    element_t*         i;
+
+    _foreach(i, &renderer->thumbnails) {
+        if (vioarr_capture_source(i->value) == item->value) {
+            vioarr_capture_release_source(i->value);
+        }
+    }
+
+    // the address may be reused by a new surface, which must not inherit the cursor image
+    if (renderer->cursor && vioarr_cursor_owner(renderer->cursor) == item->value) {
+        vioarr_cursor_set_image(renderer->cursor, NULL, 0, 0);
+    }
+    vioarr_surface_free(renderer->context, renderer->output, item->value);
+    vioarr_slab_free(&g_cleanupCache, item);
 }
 
-void vioarr_renderer_render(vioarr_renderer_t* renderer)
+static int __is_on_screen(vioarr_region_t* drawRegion, vioarr_drawlist_rect_t* rect)
 {
-    element_t*       i;
-    list_t*          surfaces;
-    vioarr_region_t* drawRegion = vioarr_screen_region(renderer->screen);
-    int              level;
-    
+    int x = vioarr_region_x(drawRegion);
+    int y = vioarr_region_y(drawRegion);
+    return rect->x < (x + vioarr_region_width(drawRegion)) && (rect->x + rect->width) > x &&
+        rect->y < (y + vioarr_region_height(drawRegion)) && (rect->y + rect->height) > y;
+}
+
+static int __intersects(vioarr_drawlist_rect_t* rect, vioarr_drawlist_rect_t* other)
+{
+    return rect->x < (other->x + other->width) && (rect->x + rect->width) > other->x &&
+        rect->y < (other->y + other->height) && (rect->y + rect->height) > other->y;
+}
+
+static int __is_contained(vioarr_drawlist_rect_t* outer, vioarr_drawlist_rect_t* inner)
+{
+    return inner->x >= outer->x && inner->y >= outer->y &&
+        (inner->x + inner->width) <= (outer->x + outer->width) &&
+        (inner->y + inner->height) <= (outer->y + outer->height);
+}
+
+/**
+ * Walks the draw list front to back and marks entries that are completely covered by an
+ * opaque entry in front of them as not drawn. Only the surface rect is considered, a drop
+ * shadow of a covered surface is not taken into account.
+ */
+static void __cull_occluded(vioarr_renderer_t* renderer, vioarr_drawlist_t* drawList, int* drawn)
+{
+    vioarr_drawlist_rect_t** occluders;
+    int                      occluderCount = 0;
+    int                      i, j;
+
+    occluders = vioarr_arena_alloc(renderer->frame_arena, sizeof(vioarr_drawlist_rect_t*) * drawList->count);
+    if (!occluders) {
+        return;
+    }
+
+    for (i = drawList->count - 1; i >= 0; i--) {
+        if (!drawn[i] || (drawList->flags[i] & VIOARR_DRAWLIST_CURSOR)) {
+            continue;
+        }
+
+        for (j = 0; j < occluderCount; j++) {
+            if (__is_contained(occluders[j], &drawList->rects[i])) {
+                drawn[i] = 0;
+                break;
+            }
+        }
+
+        if (drawn[i] && drawList->opacity[i] >= 1.0f && vioarr_surface_opaque(drawList->surfaces[i])) {
+            occluders[occluderCount++] = &drawList->clips[i];
+        }
+    }
+}
+
+typedef struct eviction_candidate {
+    vioarr_surface_t* surface;
+    unsigned int      last_presented;
+} eviction_candidate_t;
+
+static int __compare_last_presented(const void* lh, const void* rh)
+{
+    unsigned int left  = ((const eviction_candidate_t*)lh)->last_presented;
+    unsigned int right = ((const eviction_candidate_t*)rh)->last_presented;
+    return (left > right) - (left < right);
+}
+
+/**
+ * Evicts the textures of surfaces that have not been presented for a while, least recently
+ * presented first, until the texture memory is back under the budget.
+ */
+static void __evict_textures(vioarr_renderer_t* renderer, vioarr_drawlist_t* drawList)
+{
+    eviction_candidate_t* candidates;
+    unsigned int          frame = vioarr_textures_frame(renderer->output);
+    int                   candidateCount = 0;
+    int                   i;
+
+    candidates = vioarr_arena_alloc(renderer->frame_arena, sizeof(eviction_candidate_t) * drawList->count);
+    if (!candidates) {
+        return;
+    }
+
+    // only the textures owned by the context of this renderer can be evicted here
+    for (i = 0; i < drawList->count; i++) {
+        vioarr_surface_t* surface       = drawList->surfaces[i];
+        unsigned int      lastPresented = vioarr_surface_last_presented(surface, renderer->output);
+        if (vioarr_surface_texture_size(surface, renderer->output) &&
+            (frame - lastPresented) >= VIOARR_TEXTURE_EVICT_AGE) {
+            candidates[candidateCount].surface        = surface;
+            candidates[candidateCount].last_presented = lastPresented;
+            candidateCount++;
+        }
+    }
+
+    qsort(candidates, candidateCount, sizeof(eviction_candidate_t), __compare_last_presented);
+    for (i = 0; i < candidateCount && vioarr_textures_over_budget(); i++) {
+        vioarr_surface_evict(renderer->context, renderer->output, candidates[i].surface);
+    }
+}
+
+static void __union_rect(vioarr_drawlist_rect_t* rect, vioarr_drawlist_rect_t* other)
+{
+    int x1, y1, x2, y2;
+
+    if (!other->width || !other->height) {
+        return;
+    }
+
+    if (!rect->width || !rect->height) {
+        *rect = *other;
+        return;
+    }
+
+    x1 = rect->x < other->x ? rect->x : other->x;
+    y1 = rect->y < other->y ? rect->y : other->y;
+    x2 = (rect->x + rect->width) > (other->x + other->width) ? (rect->x + rect->width) : (other->x + other->width);
+    y2 = (rect->y + rect->height) > (other->y + other->height) ? (rect->y + rect->height) : (other->y + other->height);
+    rect->x      = x1;
+    rect->y      = y1;
+    rect->width  = x2 - x1;
+    rect->height = y2 - y1;
+}
+
+static int __ensure_damage_capacity(vioarr_renderer_t* renderer, int count)
+{
+    vioarr_drawlist_rect_t* bounds;
+    int*                    drawn;
+    float*                  opacity;
+
+    if (count <= renderer->last_capacity) {
+        return 0;
+    }
+
+    bounds  = realloc(renderer->last_bounds, sizeof(vioarr_drawlist_rect_t) * count);
+    if (bounds) {
+        renderer->last_bounds = bounds;
+    }
+    drawn   = realloc(renderer->last_drawn, sizeof(int) * count);
+    if (drawn) {
+        renderer->last_drawn = drawn;
+    }
+    opacity = realloc(renderer->last_opacity, sizeof(float) * count);
+    if (opacity) {
+        renderer->last_opacity = opacity;
+    }
+
+    if (!bounds || !drawn || !opacity) {
+        return -1;
+    }
+    renderer->last_capacity = count;
+    return 0;
+}
+
+/**
+ * Calculates the screen area that changed compared to the previous frame. Entries are compared
+ * by their index, so whenever the draw list has been rebuilt the entire screen is damaged.
+ * The blur of an entry is stale when anything beneath it changed, which is the damage of the
+ * entries before it, and the blurred area is damaged as a whole as the blur spreads the change.
+ */
+static void __add_damage(vioarr_drawlist_rect_t* damage, vioarr_damage_t* rects, vioarr_drawlist_rect_t* rect)
+{
+    __union_rect(damage, rect);
+    vioarr_damage_add(rects, rect->x, rect->y, rect->width, rect->height);
+}
+
+/**
+ * Surfaces that only had parts of their content changed damage just those parts, limited to
+ * the visible part of the entry.
+ */
+static void __add_surface_damage(vioarr_renderer_t* renderer, vioarr_drawlist_t* drawList, int entry,
+    vioarr_drawlist_rect_t* bounds, vioarr_drawlist_rect_t* damage, vioarr_damage_t* rects)
+{
+    vioarr_drawlist_rect_t* clip = &drawList->clips[entry];
+    vioarr_damage_t         surfaceDamage;
+    int                     i;
+
+    if (!vioarr_surface_damage(drawList->surfaces[entry], renderer->output, &surfaceDamage)) {
+        __add_damage(damage, rects, bounds);
+        return;
+    }
+
+    for (i = 0; i < surfaceDamage.count; i++) {
+        surfaceDamage.rects[i].x += drawList->rects[entry].x;
+        surfaceDamage.rects[i].y += drawList->rects[entry].y;
+    }
+    vioarr_damage_clip(&surfaceDamage, clip->x, clip->y, clip->width, clip->height);
+    for (i = 0; i < surfaceDamage.count; i++) {
+        __add_damage(damage, rects, &surfaceDamage.rects[i]);
+    }
+}
+
+static void __update_damage(vioarr_renderer_t* renderer, vioarr_region_t* drawRegion,
+    vioarr_drawlist_t* drawList, int* drawn, int* changed, int* blurs, int* stale)
+{
+    vioarr_drawlist_rect_t screen = {
+        vioarr_region_x(drawRegion), vioarr_region_y(drawRegion),
+        vioarr_region_width(drawRegion), vioarr_region_height(drawRegion)
+    };
+    vioarr_drawlist_rect_t damage = { 0 };
+    vioarr_damage_t        rects;
+    int                    fullDamage;
+    int                    i;
+
+    vioarr_damage_zero(&rects);
+
+    fullDamage = renderer->full_damage || !drawn || !changed ||
+        renderer->last_generation != drawList->generation ||
+        renderer->last_count != drawList->count ||
+        __ensure_damage_capacity(renderer, drawList->count);
+
+    for (i = 0; drawn && changed && i < drawList->count && renderer->last_capacity >= drawList->count; i++) {
+        vioarr_drawlist_rect_t bounds = { 0 };
+
+        if (drawn[i]) {
+            int margins[4];
+            vioarr_surface_margins(drawList->surfaces[i], margins);
+            bounds.x      = drawList->rects[i].x - margins[0];
+            bounds.y      = drawList->rects[i].y - margins[1];
+            bounds.width  = drawList->rects[i].width + margins[0] + margins[2];
+            bounds.height = drawList->rects[i].height + margins[1] + margins[3];
+        }
+
+        if (blurs && blurs[i] && drawn[i]) {
+            stale[i] = fullDamage || __intersects(&damage, &drawList->clips[i]);
+            if (stale[i]) {
+                __add_damage(&damage, &rects, &drawList->clips[i]);
+            }
+        }
+
+        if (!fullDamage) {
+            if (drawn[i] != renderer->last_drawn[i] ||
+                memcmp(&bounds, &renderer->last_bounds[i], sizeof(vioarr_drawlist_rect_t)) ||
+                drawList->opacity[i] != renderer->last_opacity[i]) {
+                __add_damage(&damage, &rects, &renderer->last_bounds[i]);
+                __add_damage(&damage, &rects, &bounds);
+            }
+            else if (changed[i]) {
+                __add_surface_damage(renderer, drawList, i, &bounds, &damage, &rects);
+            }
+        }
+
+        renderer->last_bounds[i]  = bounds;
+        renderer->last_drawn[i]   = drawn[i];
+        renderer->last_opacity[i] = drawList->opacity[i];
+    }
+
+    if (fullDamage) {
+        damage = screen;
+        vioarr_damage_zero(&rects);
+        vioarr_damage_add(&rects, screen.x, screen.y, screen.width, screen.height);
+    }
+    else if (damage.width && damage.height) {
+        int x2 = damage.x + damage.width;
+        int y2 = damage.y + damage.height;
+        damage.x      = damage.x < screen.x ? screen.x : damage.x;
+        damage.y      = damage.y < screen.y ? screen.y : damage.y;
+        x2            = x2 > (screen.x + screen.width) ? (screen.x + screen.width) : x2;
+        y2            = y2 > (screen.y + screen.height) ? (screen.y + screen.height) : y2;
+        damage.width  = x2 > damage.x ? (x2 - damage.x) : 0;
+        damage.height = y2 > damage.y ? (y2 - damage.y) : 0;
+    }
+
+    // the draw list is in global coordinates, the damage is reported relative to the screen
+    vioarr_damage_clip(&rects, screen.x, screen.y, screen.width, screen.height);
+    for (i = 0; i < rects.count; i++) {
+        rects.rects[i].x -= screen.x;
+        rects.rects[i].y -= screen.y;
+    }
+    damage.x -= screen.x;
+    damage.y -= screen.y;
+    renderer->damage          = damage;
+    renderer->damage_rects    = rects;
+    renderer->full_damage     = !drawn || !changed;
+    renderer->last_count      = drawList->count;
+    renderer->last_generation = drawList->generation;
+}
+
+/**
+ * Retrieves the screen area that changed in the last rendered frame, outputs that present the
+ * frame by copying it can limit the copy to this. Returns 0 if nothing changed.
+ */
+int vioarr_renderer_damage(vioarr_renderer_t* renderer, vioarr_drawlist_rect_t* damageOut)
+{
+    if (!renderer || !damageOut) {
+        return 0;
+    }
+
+    *damageOut = renderer->damage;
+    return renderer->damage.width > 0 && renderer->damage.height > 0;
+}
+
+/**
+ * Retrieves the screen area that changed in the last rendered frame as separate rectangles,
+ * which cover less than the bounds when unrelated parts of the screen changed.
+ */
+int vioarr_renderer_damage_rects(vioarr_renderer_t* renderer, vioarr_damage_t* damageOut)
+{
+    if (!renderer || !damageOut) {
+        return 0;
+    }
+
+    *damageOut = renderer->damage_rects;
+    return damageOut->count;
+}
+
+/**
+ * The cursor plane takes the first cursor entry that is a single surface without visuals
+ * outside of its bounds and fits the plane, anything else is drawn as part of the frame.
+ */
+static int __find_cursor_entry(vioarr_drawlist_t* drawList, int* drawn)
+{
+    int i;
+
+    for (i = 0; i < drawList->count; i++) {
+        vioarr_region_t* region;
+        int              margins[4];
+
+        if (!drawn[i] || !(drawList->flags[i] & VIOARR_DRAWLIST_CURSOR) || drawList->parents[i] >= 0) {
+            continue;
+        }
+
+        if ((i + 1) < drawList->count && drawList->parents[i + 1] == i) {
+            continue;
+        }
+
+        region = vioarr_surface_region(drawList->surfaces[i]);
+        vioarr_surface_margins(drawList->surfaces[i], margins);
+        if (vioarr_region_width(region) <= VIOARR_CURSOR_MAX_SIZE &&
+            vioarr_region_height(region) <= VIOARR_CURSOR_MAX_SIZE &&
+            !(margins[0] | margins[1] | margins[2] | margins[3])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void __update_cursor_plane(vioarr_renderer_t* renderer, vioarr_region_t* drawRegion,
+    vioarr_drawlist_t* drawList, int entry)
+{
+    vioarr_surface_t* surface;
+    int               width, height;
+    int               status;
+
+    if (entry < 0) {
+        vioarr_cursor_move(renderer->cursor, 0, 0, 0, 1.0f);
+        return;
+    }
+
+    surface = drawList->surfaces[entry];
+    status  = vioarr_surface_read_pixels(surface, renderer->output, vioarr_cursor_owner(renderer->cursor) != surface,
+        vioarr_cursor_pixels(renderer->cursor), VIOARR_CURSOR_MAX_SIZE, VIOARR_CURSOR_MAX_SIZE, &width, &height);
+    if (status == 1) {
+        vioarr_cursor_set_image(renderer->cursor, surface, width, height);
+    }
+
+    vioarr_cursor_move(renderer->cursor, status >= 0,
+        drawList->rects[entry].x - vioarr_region_x(drawRegion),
+        drawList->rects[entry].y - vioarr_region_y(drawRegion),
+        drawList->opacity[entry]);
+}
+
 #ifdef VIOARR_BACKEND_NANOVG
-    glViewport(0, 0, renderer->width, renderer->height);
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-    
-    mtx_lock(&renderer->lock);
-    nvgBeginFrame(renderer->context, 
-        vioarr_region_width(drawRegion), 
-        vioarr_region_height(drawRegion), 
+/**
+ * Draws the blurred content beneath the entry. Everything queued so far is flushed to the
+ * framebuffer so the blur can read it, after which a new frame is started on top. The image
+ * wrapping the blur texture can only be deleted once the frame is flushed, so it is returned.
+ */
+static int __render_backdrop(vioarr_renderer_t* renderer, vioarr_region_t* drawRegion,
+    vioarr_drawlist_t* drawList, int entry, int radius, int stale)
+{
+    vioarr_drawlist_rect_t* clip  = &drawList->clips[entry];
+    float                   ratio = renderer->pixel_ratio;
+    int                     x1, y1, x2, y2;
+    int                     fbX, fbY, fbWidth, fbHeight;
+    unsigned int            texture;
+    int                     image;
+    NVGpaint                paint;
+
+    // the blur is limited to the part of the entry on this screen, in framebuffer pixels
+    x1 = clip->x > vioarr_region_x(drawRegion) ? clip->x : vioarr_region_x(drawRegion);
+    y1 = clip->y > vioarr_region_y(drawRegion) ? clip->y : vioarr_region_y(drawRegion);
+    x2 = (clip->x + clip->width) < (vioarr_region_x(drawRegion) + vioarr_region_width(drawRegion)) ?
+        (clip->x + clip->width) : (vioarr_region_x(drawRegion) + vioarr_region_width(drawRegion));
+    y2 = (clip->y + clip->height) < (vioarr_region_y(drawRegion) + vioarr_region_height(drawRegion)) ?
+        (clip->y + clip->height) : (vioarr_region_y(drawRegion) + vioarr_region_height(drawRegion));
+    if (x2 <= x1 || y2 <= y1) {
+        return 0;
+    }
+
+    fbX      = (int)((float)(x1 - vioarr_region_x(drawRegion)) * ratio);
+    fbWidth  = (int)((float)(x2 - vioarr_region_x(drawRegion)) * ratio) - fbX;
+    fbY      = renderer->height - (int)((float)(y2 - vioarr_region_y(drawRegion)) * ratio);
+    fbHeight = renderer->height - (int)((float)(y1 - vioarr_region_y(drawRegion)) * ratio) - fbY;
+
+    nvgEndFrame(renderer->context);
+    texture = vioarr_blur_region(renderer->blur, drawList->surfaces[entry], fbX, fbY, fbWidth, fbHeight,
+        (int)((float)radius * ratio), stale);
+    nvgBeginFrame(renderer->context,
+        vioarr_region_width(drawRegion),
+        vioarr_region_height(drawRegion),
         renderer->pixel_ratio
     );
+    nvgTranslate(renderer->context, (float)-vioarr_region_x(drawRegion), (float)-vioarr_region_y(drawRegion));
+    if (!texture) {
+        return 0;
+    }
+
+    // the texture was read from the framebuffer, so its first row is the bottom of the area
+    image = nvglCreateImageFromHandleGL3(renderer->context, texture, fbWidth, fbHeight,
+        NVG_IMAGE_FLIPY | NVG_IMAGE_PREMULTIPLIED | NVG_IMAGE_NODELETE);
+    if (!image) {
+        return 0;
+    }
+
+    paint = nvgImagePattern(renderer->context, (float)x1, (float)y1, (float)(x2 - x1), (float)(y2 - y1),
+        0.0f, image, 1.0f);
+    nvgGlobalAlpha(renderer->context, drawList->opacity[entry]);
+    nvgBeginPath(renderer->context);
+    nvgRect(renderer->context, (float)x1, (float)y1, (float)(x2 - x1), (float)(y2 - y1));
+    nvgFillPaint(renderer->context, paint);
+    nvgFill(renderer->context);
+    return image;
+}
 #endif
 
-#ifdef VIOARR_BACKEND_BLEND2D
-    BLContextCore context;
-    blContextInitAs(&context, img, NULL);
+static void __update_captures(vioarr_renderer_t* renderer)
+{
+    vioarr_damage_t damage;
+    element_t*      i;
+    int             j;
+
+    // the damage is in screen coordinates, captures read back framebuffer pixels
+    vioarr_damage_zero(&damage);
+    for (j = 0; j < renderer->damage_rects.count; j++) {
+        vioarr_drawlist_rect_t* rect = &renderer->damage_rects.rects[j];
+        int                     x    = (int)((float)rect->x * renderer->pixel_ratio);
+        int                     y    = (int)((float)rect->y * renderer->pixel_ratio);
+        vioarr_damage_add(&damage, x, y,
+            (int)((float)(rect->x + rect->width) * renderer->pixel_ratio + 0.999f) - x,
+            (int)((float)(rect->y + rect->height) * renderer->pixel_ratio + 0.999f) - y);
+    }
+
+    _foreach_nolink(i, &renderer->captures) {
+        element_t* next = i->next;
+        if (vioarr_capture_frame(i->value, &damage, renderer->width, renderer->height)) {
+            list_remove(&renderer->captures, i);
+            vioarr_slab_free(&g_cleanupCache, i);
+        }
+        i = next;
+    }
+}
+
+/**
+ * Draws the thumbnail of the root entry and the subsurfaces following it, scaled to fit the
+ * target while keeping the aspect ratio. Entries that were not part of the frame are uploaded
+ * here, so thumbnails of covered or off-screen surfaces are drawn as well.
+ */
+static void __draw_thumbnail(vioarr_renderer_t* renderer, vioarr_drawlist_t* drawList, int root, int width, int height)
+{
+#ifdef VIOARR_BACKEND_NANOVG
+    vioarr_drawlist_rect_t* rect = &drawList->rects[root];
+    float                   scale;
+    int                     i;
+
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    if (!rect->width || !rect->height) {
+        return;
+    }
+
+    scale = (float)width / (float)rect->width;
+    if ((float)height / (float)rect->height < scale) {
+        scale = (float)height / (float)rect->height;
+    }
+
+    nvgBeginFrame(renderer->context, (float)width, (float)height, 1.0f);
+    nvgTranslate(renderer->context,
+        ((float)width - (float)rect->width * scale) * 0.5f,
+        ((float)height - (float)rect->height * scale) * 0.5f);
+    nvgScale(renderer->context, scale, scale);
+    nvgTranslate(renderer->context, (float)-rect->x, (float)-rect->y);
+    nvgScissor(renderer->context, (float)rect->x, (float)rect->y, (float)rect->width, (float)rect->height);
+    for (i = root; i < drawList->count && (i == root || drawList->parents[i] >= root); i++) {
+        vioarr_surface_prepare(renderer->context, renderer->output, drawList->surfaces[i]);
+        nvgGlobalAlpha(renderer->context, drawList->opacity[i]);
+        vioarr_surface_render(renderer->context, renderer->output, drawList->surfaces[i],
+            drawList->rects[i].x, drawList->rects[i].y);
+    }
+    nvgEndFrame(renderer->context);
 #endif
+}
+
+static void __update_thumbnails(vioarr_renderer_t* renderer, vioarr_drawlist_t* drawList)
+{
+    element_t* i;
+
+    _foreach_nolink(i, &renderer->thumbnails) {
+        element_t*        next    = i->next;
+        vioarr_surface_t* surface = vioarr_capture_source(i->value);
+        unsigned int      serial  = 0;
+        int               root    = -1;
+        int               width, height;
+        int               status;
+        int               j;
+
+        // commits of subsurfaces change the thumbnail as well
+        for (j = 0; surface && j < drawList->count; j++) {
+            if (root < 0 && drawList->surfaces[j] == surface) {
+                root = j;
+            }
+            else if (root >= 0 && drawList->parents[j] < root) {
+                break;
+            }
+
+            if (root >= 0) {
+                serial += vioarr_surface_commits(drawList->surfaces[j]);
+            }
+        }
+
+        status = vioarr_capture_begin_thumbnail(i->value, serial, &width, &height);
+        if (status < 0) {
+            list_remove(&renderer->thumbnails, i);
+            vioarr_slab_free(&g_cleanupCache, i);
+        }
+        else if (status > 0) {
+            if (root >= 0) {
+                __draw_thumbnail(renderer, drawList, root, width, height);
+            }
+            vioarr_capture_end_thumbnail(i->value);
+        }
+        i = next;
+    }
+}
+
+void vioarr_renderer_render(vioarr_renderer_t* renderer)
+{
+    vioarr_drawlist_t* drawList;
+    vioarr_region_t*   drawRegion = vioarr_screen_region(renderer->screen);
+    int*               drawn;
+    int*               changed;
+    int*               blurs = NULL;
+    int*               stale = NULL;
+    int*               images = NULL;
+    int                imageCount = 0;
+    int                cursorEntry = -1;
+    int                quality;
+    int                i;
+
+    // frame and release events of the frame are sent to each client in one go
+    vioarr_cork_begin();
+    mtx_lock(&renderer->lock);
 
     // cleanup all resources queued before starting
     list_clear(&renderer->cleanup_list, cleanup_entry, renderer);
+    vioarr_textures_next_frame(renderer->output);
+
+    // a changed quality changes how every surface is drawn
+    quality = vioarr_governor_level(renderer->output);
+    if (quality != renderer->quality) {
+        renderer->quality     = quality;
+        renderer->full_damage = 1;
+    }
+
+    // the draw list is ordered back to front with children following their parents, so
+    // a subsurface is only drawn if its parent was. Only root surfaces are culled against
+    // the screen, subsurfaces follow their parent. Surfaces are updated before anything is
+    // drawn so the occlusion pass sees the content that is about to be presented, and no
+    // commit of a tree of surfaces is applied while they are.
+    drawList = &renderer->draw_list;
+    vioarr_manager_render_start(drawList);
+    renderer->render_start = vioarr_utils_time_us();
+    drawn    = vioarr_arena_alloc(renderer->frame_arena, sizeof(int) * drawList->count);
+    for (i = 0; drawn && i < drawList->count; i++) {
+        int parent = drawList->parents[i];
+        if (parent >= 0) {
+            drawn[i] = drawn[parent];
+        }
+        else {
+            drawn[i] = __is_on_screen(drawRegion, &drawList->rects[i]);
+        }
+
+        if (drawn[i]) {
+            drawn[i] = vioarr_surface_update(renderer->context, renderer->output, drawList->surfaces[i]);
+        }
+    }
+    vioarr_manager_render_updated();
+
+    if (drawn) {
+        __cull_occluded(renderer, drawList, drawn);
+        if (renderer->cursor) {
+            cursorEntry = __find_cursor_entry(drawList, drawn);
+        }
+    }
+
+    // the content is uploaded before anything is drawn, so the damage of the frame is known
+    // up front. The cursor plane entry is not part of the frame and does not cause damage.
+    changed = vioarr_arena_alloc(renderer->frame_arena, sizeof(int) * drawList->count);
+    if (renderer->blur && quality < VIOARR_GOVERNOR_NO_BLUR) {
+        blurs  = vioarr_arena_alloc(renderer->frame_arena, sizeof(int) * drawList->count);
+        stale  = vioarr_arena_alloc(renderer->frame_arena, sizeof(int) * drawList->count);
+        images = vioarr_arena_alloc(renderer->frame_arena, sizeof(int) * drawList->count);
+        if (!stale || !images) {
+            blurs = NULL;
+        }
+    }
 
-    vioarr_manager_render_start(&surfaces);
-    for (level = 0; level < SURFACE_LEVELS; level++) {
-        _foreach(i, &surfaces[level]) {
-            vioarr_surface_t* surface = i->value;
-            if (vioarr_region_intersects(drawRegion, vioarr_surface_region(surface))) {
-                vioarr_surface_render(renderer->context, surface);
+    for (i = 0; drawn && i < drawList->count; i++) {
+        int parent = drawList->parents[i];
+        if (parent >= 0 && !drawn[parent]) {
+            drawn[i] = 0;
+        }
+
+        if (changed) {
+            changed[i] = 0;
+        }
+
+        if (blurs) {
+            blurs[i] = 0;
+            stale[i] = 0;
+        }
+
+        if (!drawn[i]) {
+            vioarr_surface_hide(drawList->surfaces[i], renderer->output);
+            continue;
+        }
+
+        if (i == cursorEntry) {
+            drawn[i] = 0;
+            continue;
+        }
+
+        if (vioarr_surface_prepare(renderer->context, renderer->output, drawList->surfaces[i]) && changed) {
+            changed[i] = 1;
+        }
+
+        // nothing shows through a surface that is entirely opaque
+        if (blurs && !(drawList->opacity[i] >= 1.0f && vioarr_surface_opaque(drawList->surfaces[i]))) {
+            blurs[i] = vioarr_surface_backdrop_blur(drawList->surfaces[i]);
+        }
+    }
+
+    if (renderer->cursor) {
+        __update_cursor_plane(renderer, drawRegion, drawList, cursorEntry);
+    }
+    __update_damage(renderer, drawRegion, drawList, drawn, changed, blurs, stale);
+
+    // screens with a cursor plane keep the composed frame, so it is only rendered again if
+    // something besides the cursor changed
+    if (!renderer->cursor || renderer->damage.width > 0) {
+#ifdef VIOARR_BACKEND_NANOVG
+        glViewport(0, 0, renderer->width, renderer->height);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+        nvgBeginFrame(renderer->context, 
+            vioarr_region_width(drawRegion), 
+            vioarr_region_height(drawRegion), 
+            renderer->pixel_ratio
+        );
+
+        // surfaces are positioned on the desktop, which this screen is a part of
+        nvgTranslate(renderer->context, (float)-vioarr_region_x(drawRegion), (float)-vioarr_region_y(drawRegion));
+#endif
+
+#ifdef VIOARR_BACKEND_BLEND2D
+        BLContextCore context;
+        blContextInitAs(&context, img, NULL);
+#endif
+
+        for (i = 0; drawn && i < drawList->count; i++) {
+            if (!drawn[i]) {
+                continue;
+            }
+
+#ifdef VIOARR_BACKEND_NANOVG
+            if (blurs && blurs[i]) {
+                images[imageCount] = __render_backdrop(renderer, drawRegion, drawList, i, blurs[i], stale[i]);
+                if (images[imageCount]) {
+                    imageCount++;
+                }
             }
+            nvgGlobalAlpha(renderer->context, drawList->opacity[i]);
+#endif
+            vioarr_surface_render(renderer->context, renderer->output, drawList->surfaces[i],
+                drawList->rects[i].x, drawList->rects[i].y);
         }
+
+#ifdef VIOARR_BACKEND_NANOVG
+        nvgEndFrame(renderer->context);
+        for (i = 0; i < imageCount; i++) {
+            nvgDeleteImage(renderer->context, images[i]);
+        }
+        vioarr_blur_end_frame(renderer->blur);
+#endif
     }
+
+    // the composed frame is still in the framebuffer, whether it was rendered again or not
+    if (list_count(&renderer->captures)) {
+        __update_captures(renderer);
+    }
+    if (list_count(&renderer->thumbnails)) {
+        __update_thumbnails(renderer, drawList);
+    }
+
+    if (vioarr_textures_over_budget()) {
+        __evict_textures(renderer, drawList);
+    }
+    renderer->render_end = vioarr_utils_time_us();
     vioarr_manager_render_end();
-    
-#ifdef VIOARR_BACKEND_NANOVG
-    nvgEndFrame(renderer->context);
     mtx_unlock(&renderer->lock);
-#endif
+    vioarr_cork_end();
+
+    // all transient data for this frame is released at once
+    vioarr_arena_reset(renderer->frame_arena);
 }
@@ -25,17 +25,33 @@
 #ifndef __VIOARR_RENDERER_H__
 #define __VIOARR_RENDERER_H__
 
+#include "vioarr_arena.h"
+#include "vioarr_drawlist.h"
 #include "vioarr_screen.h"
 
 typedef struct vioarr_renderer vioarr_renderer_t;
 typedef struct vioarr_surface  vioarr_surface_t;
+typedef struct vioarr_cursor   vioarr_cursor_t;
+typedef struct vioarr_capture  vioarr_capture_t;
+typedef struct vioarr_damage   vioarr_damage_t;
 
-vioarr_renderer_t* vioarr_renderer_create(vioarr_screen_t*, int width, int height);
+#define VIOARR_RENDERER_DITHER 0x1 // ordered dithering for 16 bit render targets
+
+vioarr_renderer_t* vioarr_renderer_create(vioarr_screen_t*, int width, int height, unsigned int flags);
+int                vioarr_renderer_output(vioarr_renderer_t*);
 void               vioarr_renderer_set_scale(vioarr_renderer_t*, int);
 void               vioarr_renderer_set_rotation(vioarr_renderer_t*, int);
 int                vioarr_renderer_scale(vioarr_renderer_t*);
 int                vioarr_renderer_rotation(vioarr_renderer_t*);
+void               vioarr_renderer_set_cursor_plane(vioarr_renderer_t*, vioarr_cursor_t*);
+void               vioarr_renderer_add_capture(vioarr_renderer_t*, vioarr_capture_t*);
+void               vioarr_renderer_add_thumbnail(vioarr_renderer_t*, vioarr_capture_t*);
+void               vioarr_renderer_frame_stats(vioarr_renderer_t*, vioarr_arena_stats_t*);
+void               vioarr_renderer_frame_times(vioarr_renderer_t*, uint64_t* startOut, uint64_t* endOut);
+void               vioarr_renderer_finished(vioarr_renderer_t*);
 void               vioarr_renderer_queue_cleanup(vioarr_renderer_t*, vioarr_surface_t*);
 void               vioarr_renderer_render(vioarr_renderer_t*);
+int                vioarr_renderer_damage(vioarr_renderer_t*, vioarr_drawlist_rect_t* damageOut);
+int                vioarr_renderer_damage_rects(vioarr_renderer_t*, vioarr_damage_t* damageOut);
 
 #endif //!__VIOARR_RENDERER_H__
@@ -25,7 +25,24 @@
 #ifndef __VIOARR_SCREEN_H__
 #define __VIOARR_SCREEN_H__
 
-#ifdef MOLLENOS
+#if defined(VIOARR_HEADLESS)
+/**
+ * Headless screens are not backed by any display, the mode they render at is
+ * chosen at runtime. The format is one of the names in vioarr_screen_formats.c.
+ * Framebuffer builds present into the device, file or shm segment instead, the
+ * mode of a framebuffer device overrides the one provided here. The position
+ * places the screen on the desktop.
+ */
+typedef struct vioarr_headless_output {
+    int         x;
+    int         y;
+    int         width;
+    int         height;
+    int         refresh_rate;
+    const char* format;
+    const char* device;
+} video_output_t;
+#elif defined(MOLLENOS)
 #include <ddk/video.h>
 typedef VideoDescriptor_t video_output_t;
 #elif defined(__linux__)
@@ -47,6 +64,8 @@ int                vioarr_screen_scale(vioarr_screen_t*);
 enum wm_transform  vioarr_screen_transform(vioarr_screen_t*);
 vioarr_renderer_t* vioarr_screen_renderer(vioarr_screen_t*);
 int                vioarr_screen_publish_modes(vioarr_screen_t*, int);
+int                vioarr_screen_refresh_rate(vioarr_screen_t*);
+int                vioarr_screen_make_current(vioarr_screen_t*, int current);
 int                vioarr_screen_valid(vioarr_screen_t*);
 void               vioarr_screen_frame(vioarr_screen_t*);
 
@@ -0,0 +1,182 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#include "vioarr_slab.h"
+#include "vioarr_utils.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#define SLAB_ALIGNMENT   16
+#define SLAB_ALIGN(size) (((size) + (SLAB_ALIGNMENT - 1)) & ~((size_t)SLAB_ALIGNMENT - 1))
+
+typedef struct vioarr_slab {
+    struct vioarr_slab* next;
+} vioarr_slab_t;
+
+typedef struct vioarr_slab_object {
+    struct vioarr_slab_object* next;
+} vioarr_slab_object_t;
+
+static atomic_flag          g_cachesLock = ATOMIC_FLAG_INIT;
+static vioarr_slab_cache_t* g_caches     = NULL;
+
+static inline void __lock(atomic_flag* lock)
+{
+    while (atomic_flag_test_and_set_explicit(lock, memory_order_acquire)) {
+        thrd_yield();
+    }
+}
+
+static inline void __unlock(atomic_flag* lock)
+{
+    atomic_flag_clear_explicit(lock, memory_order_release);
+}
+
+static inline size_t __object_size(vioarr_slab_cache_t* cache)
+{
+    size_t size = cache->object_size;
+    if (size < sizeof(vioarr_slab_object_t)) {
+        size = sizeof(vioarr_slab_object_t);
+    }
+    return SLAB_ALIGN(size);
+}
+
+// must be called without the cache lock held, the stats hold the caches lock while taking it
+static void __register_cache(vioarr_slab_cache_t* cache)
+{
+    __lock(&g_cachesLock);
+    if (!atomic_load(&cache->registered)) {
+        cache->next = g_caches;
+        g_caches    = cache;
+        atomic_store(&cache->registered, 1);
+    }
+    __unlock(&g_cachesLock);
+}
+
+// must be called with the cache lock held
+static int __grow_cache(vioarr_slab_cache_t* cache)
+{
+    size_t         objectSize = __object_size(cache);
+    size_t         count      = cache->objects_per_slab ? cache->objects_per_slab : 32;
+    vioarr_slab_t* slab;
+    uint8_t*       objects;
+    size_t         i;
+
+    slab = malloc(SLAB_ALIGN(sizeof(vioarr_slab_t)) + (objectSize * count));
+    if (!slab) {
+        return -1;
+    }
+
+    slab->next   = cache->slabs;
+    cache->slabs = slab;
+
+    // thread the new objects onto the free list
+    objects = (uint8_t*)slab + SLAB_ALIGN(sizeof(vioarr_slab_t));
+    for (i = 0; i < count; i++) {
+        vioarr_slab_object_t* object = (vioarr_slab_object_t*)(objects + (i * objectSize));
+        object->next        = cache->free_objects;
+        cache->free_objects = object;
+    }
+
+    cache->stats.slabs++;
+    cache->stats.objects_total += count;
+    return 0;
+}
+
+void* vioarr_slab_alloc(vioarr_slab_cache_t* cache)
+{
+    vioarr_slab_object_t* object = NULL;
+
+    if (!cache) {
+        return NULL;
+    }
+
+    if (!atomic_load(&cache->registered)) {
+        __register_cache(cache);
+    }
+
+    __lock(&cache->lock);
+    if (!cache->free_objects && __grow_cache(cache)) {
+        vioarr_utils_error(VISTR("[vioarr_slab_alloc] %s: out of memory"), cache->name);
+        goto exit;
+    }
+
+    object = cache->free_objects;
+    cache->free_objects = object->next;
+
+    cache->stats.allocations++;
+    cache->stats.objects_used++;
+    if (cache->stats.objects_used > cache->stats.objects_peak) {
+        cache->stats.objects_peak = cache->stats.objects_used;
+    }
+
+exit:
+    __unlock(&cache->lock);
+    return object;
+}
+
+void vioarr_slab_free(vioarr_slab_cache_t* cache, void* memory)
+{
+    vioarr_slab_object_t* object = memory;
+
+    if (!cache || !memory) {
+        return;
+    }
+
+    __lock(&cache->lock);
+    object->next        = cache->free_objects;
+    cache->free_objects = object;
+    cache->stats.frees++;
+    cache->stats.objects_used--;
+    __unlock(&cache->lock);
+}
+
+void vioarr_slab_stats(vioarr_slab_cache_t* cache, vioarr_slab_stats_t* statsOut)
+{
+    if (!cache || !statsOut) {
+        return;
+    }
+
+    __lock(&cache->lock);
+    *statsOut             = cache->stats;
+    statsOut->name        = cache->name;
+    statsOut->object_size = __object_size(cache);
+    __unlock(&cache->lock);
+}
+
+void vioarr_slab_trace_stats(void)
+{
+    vioarr_slab_cache_t* cache;
+
+    __lock(&g_cachesLock);
+    for (cache = g_caches; cache; cache = cache->next) {
+        vioarr_slab_stats_t stats;
+        vioarr_slab_stats(cache, &stats);
+        vioarr_utils_trace(VISTR("[vioarr_slab] %s: size=%zu, slabs=%zu, used=%zu/%zu, peak=%zu, allocs=%zu, frees=%zu"),
+            stats.name, stats.object_size, stats.slabs, stats.objects_used, stats.objects_total,
+            stats.objects_peak, stats.allocations, stats.frees);
+    }
+    __unlock(&g_cachesLock);
+}
@@ -0,0 +1,70 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#ifndef __VIOARR_SLAB_H__
+#define __VIOARR_SLAB_H__
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+typedef struct vioarr_slab_stats {
+    const char* name;
+    size_t      object_size;
+    size_t      slabs;
+    size_t      objects_total;
+    size_t      objects_used;
+    size_t      objects_peak;
+    size_t      allocations;
+    size_t      frees;
+} vioarr_slab_stats_t;
+
+/**
+ * A slab cache hands out fixed-size objects from larger slabs that are never returned
+ * to the system, freed objects are kept on a free list for reuse. Each cache has its own
+ * spinlock, so the protocol and render threads never contend on the system allocator
+ * for the hot engine types. Caches are meant to be defined statically with
+ * VIOARR_SLAB_CACHE_INIT and register themselves for statistics on first use.
+ */
+typedef struct vioarr_slab_cache {
+    const char*               name;
+    size_t                    object_size;
+    size_t                    objects_per_slab;
+    atomic_flag               lock;
+    void*                     free_objects;
+    void*                     slabs;
+    atomic_int                registered;
+    struct vioarr_slab_cache* next;
+    vioarr_slab_stats_t       stats;
+} vioarr_slab_cache_t;
+
+#define VIOARR_SLAB_CACHE_INIT(cacheName, objectSize, objectsPerSlab) \
+    { cacheName, objectSize, objectsPerSlab, ATOMIC_FLAG_INIT, NULL, NULL, ATOMIC_VAR_INIT(0), NULL, { 0 } }
+
+void* vioarr_slab_alloc(vioarr_slab_cache_t*);
+void  vioarr_slab_free(vioarr_slab_cache_t*, void*);
+void  vioarr_slab_stats(vioarr_slab_cache_t*, vioarr_slab_stats_t*);
+void  vioarr_slab_trace_stats(void);
+
+#endif //!__VIOARR_SLAB_H__
@@ -22,7 +22,9 @@
  *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
  */
 
+#include "vioarr_damage.h"
 #include "vioarr_engine.h"
+#include "vioarr_governor.h"
 #include "vioarr_surface.h"
 #include "vioarr_screen.h"
 #include "vioarr_region.h"
@@ -31,6 +33,9 @@
 #include "vioarr_objects.h"
 #include "vioarr_manager.h"
 #include "vioarr_input.h"
+#include "vioarr_outputs.h"
+#include "vioarr_slab.h"
+#include "vioarr_textures.h"
 #include "vioarr_utils.h"
 #include <stdlib.h>
 #include <stdatomic.h>
@@ -39,21 +44,96 @@
 #include "wm_surface_service_server.h"
 #include "wm_buffer_service_server.h"
 
+/**
+ * The number of buffers a client can have queued on a surface before the
+ * compositor gets to present them. Only the newest one is ever presented, so
+ * this allows clients to triple buffer without stalling on release events.
+ */
+#define SURFACE_MAX_PENDING_BUFFERS 3
+
 typedef struct vioarr_surface_properties {
     int corner_radius;
     int border_width;
     int border_color;
+    int buffer_scale;
+    int destination_width;  // 0 to use the surface size
+    int destination_height;
+    int backdrop_blur;      // radius of the blur of the content beneath, 0 for none
     
+    vioarr_region_t*       source;       // in surface coordinates, zero for the entire buffer
     vioarr_region_t*       input_region;
     vioarr_region_t*       drop_shadow;
     struct vioarr_surface* children;
 } vioarr_surface_properties_t;
 
+/**
+ * Every output renders with its own context, so the content is uploaded into a texture
+ * per output. A texture is stale when it was uploaded from an older serial of the content.
+ */
+typedef struct vioarr_surface_texture {
+    int          resource_id;
+    int          type;
+    int          flags;
+    size_t       size;
+    unsigned int serial;         // serial of the content in the texture, 0 if none
+    int          changed;
+    vioarr_damage_t damage;      // buffer pixels changed by the last uploads, zero if all of the surface changed
+    unsigned int last_presented; // frame of the output
+    unsigned int cpu_serial;     // serial of the content last read by the cpu, see vioarr_surface_read_pixels
+} vioarr_surface_texture_t;
+
 typedef struct vioarr_surface_backbuffer {
-    int              resource_id;
-    vioarr_buffer_t* content;
+    vioarr_buffer_t*         content;
+    unsigned int             serial;          // bumped whenever the content must be uploaded again
+    vioarr_damage_t          damage;          // buffer pixels changed since the previous serial, zero for all
+    atomic_uint              pending_uploads; // outputs that must upload the content before it is released
+    atomic_int               uploaded;
+    atomic_int               released;
+    atomic_uint              redraw_serial;   // serial the client was last asked to submit again
+    vioarr_surface_texture_t textures[VIOARR_MAX_OUTPUTS];
 } vioarr_surface_backbuffer_t;
 
+typedef struct vioarr_surface_size {
+    int                  width;
+    int                  height;
+    enum wm_surface_edge edges;
+    int                  apply; // resize the surface once committed, otherwise it was resized already
+} vioarr_surface_size_t;
+
+/**
+ * Sizes are sent to the client as configure events, and once a client acknowledges them the next
+ * configure is only sent after the previous one was acknowledged and committed. Sizes requested
+ * in the meantime replace each other, so a slow client only ever redraws for the newest size.
+ */
+typedef struct vioarr_surface_configure {
+    unsigned int          serial;    // serial of the last configure sent
+    unsigned int          acked;     // serial acknowledged by the client, completed by its next commit
+    int                   handshake; // set once the client acknowledges configures
+    int                   in_flight; // the last configure is not yet acknowledged and committed
+    int                   queued;    // next must be sent once the configure in flight completes
+    vioarr_surface_size_t sent;
+    vioarr_surface_size_t next;
+} vioarr_surface_configure_t;
+
+/**
+ * Synchronized subsurfaces stage their buffer and damage until they commit, the commit is then
+ * cached together with the pending properties and applied when the parent commits. Commits of a
+ * surface with children are cached the same way and staged with the manager, which applies them
+ * together with the cached commits of the children at the start of the next frame, so children
+ * never show up a frame apart from their parent. While a commit is cached, the state set after it
+ * is held back as well so it is not presented before the commit.
+ */
+typedef struct vioarr_surface_sync {
+    int              enabled;
+    int              has_buffer;    // a buffer was set since the last commit
+    vioarr_buffer_t* buffer;
+    vioarr_damage_t  dirt;
+    int              cached;        // a commit waits for the parent to commit
+    int              cached_has_buffer;
+    vioarr_buffer_t* cached_buffer;
+    vioarr_damage_t  cached_dirt;
+} vioarr_surface_sync_t;
+
 typedef struct vioarr_surface {
     int              client;
     uint32_t         id;
@@ -61,36 +141,66 @@ typedef struct vioarr_surface {
     int              visible;
     vioarr_rwlock_t  lock;
     atomic_int       frame_requested;
+    atomic_uint      commits;
     int              level;
 
     vioarr_region_t*       dimensions;
     vioarr_region_t*       dimensions_original;
     struct vioarr_surface* parent;
     struct vioarr_surface* link;
-    vioarr_region_t*       dirt;
+    vioarr_damage_t        dirt;
     
-    vioarr_surface_properties_t properties[2];
-
-    int                         swap_backbuffers;
-    int                         backbuffer_index;
-    vioarr_surface_backbuffer_t backbuffers[2];
+    vioarr_surface_properties_t properties[3];
+    vioarr_surface_configure_t  configure;
+    vioarr_surface_sync_t       sync;
+
+    vioarr_surface_backbuffer_t backbuffer;
+    atomic_uint                 presenting;   // outputs that presented the surface in their last frame
+    atomic_int                  cleanup_refs; // outputs that still have to release the surface
+    int                         pending_count;
+    vioarr_buffer_t*            pending[SURFACE_MAX_PENDING_BUFFERS];
 } vioarr_surface_t;
 
+static vioarr_slab_cache_t g_surfaceCache = VIOARR_SLAB_CACHE_INIT("surface", sizeof(vioarr_surface_t), 32);
+
 #define ACTIVE_PROPERTIES(surface)  surface->properties[0]
 #define PENDING_PROPERTIES(surface) surface->properties[1]
+#define CACHED_PROPERTIES(surface)  surface->properties[2]
 
-#define ACTIVE_BACKBUFFER(surface)  surface->backbuffers[surface->backbuffer_index]
-#define PENDING_BACKBUFFER(surface) surface->backbuffers[surface->backbuffer_index ^ 1]
+#define ACTIVE_BACKBUFFER(surface)  surface->backbuffer
+#define OUTPUT_TEXTURE(surface, output) surface->backbuffer.textures[output]
 
 static int  __initialize_surface_properties(vioarr_surface_properties_t* properties);
 static void __cleanup_surface_properties(vioarr_surface_properties_t* properties);
-static void __cleanup_surface_backbuffer(vcontext_t* context, vioarr_surface_backbuffer_t* backbuffer);
-static void __swap_properties(vioarr_surface_t* surface);
-static void __update_surface(vcontext_t* context, vioarr_surface_t* surface);
-static int  __swap_backbuffer(vcontext_t* context, vioarr_surface_t* surface);
-static void __refresh_content(vcontext_t* context, vioarr_surface_t* surface);
-static void __render_drop_shadow(vcontext_t* context, vioarr_surface_t* surface);
-static void __render_content(vcontext_t* context, vioarr_surface_t* surface);
+static void __cleanup_surface_backbuffer(vioarr_surface_t* surface);
+static void __destroy_texture(vcontext_t* context, vioarr_surface_t* surface, int output);
+static void __release_buffer(vioarr_surface_t* surface, vioarr_buffer_t* buffer);
+static void __invalidate_content(vioarr_surface_t* surface);
+static void __on_uploaded(vioarr_surface_t* surface, int output);
+static void __request_redraw(vioarr_surface_t* surface);
+static int  __upload_content(vcontext_t* context, vioarr_surface_t* surface, int output);
+static void __swap_properties(vioarr_surface_t* surface, vioarr_surface_properties_t* source);
+static int  __move_properties(vioarr_surface_properties_t* target, vioarr_surface_properties_t* source);
+static void __attach_buffer(vioarr_surface_t* surface, vioarr_buffer_t* content);
+static void __hold_buffer(vioarr_surface_t* surface, vioarr_buffer_t* content);
+static void __flush_held(vioarr_surface_t* surface);
+static void __cache_commit(vioarr_surface_t* surface);
+static unsigned int __apply_cached_commit(vioarr_surface_t* surface, vioarr_surface_size_t* sizeOut);
+static void __commit_children(vioarr_surface_t* surface);
+static int  __swap_backbuffer(vioarr_surface_t* surface);
+static void __refresh_content(vioarr_surface_t* surface);
+static void __take_dirt(vioarr_surface_t* surface);
+static void __render_drop_shadow(vcontext_t* context, vioarr_surface_t* surface, int output);
+static void __render_content(vcontext_t* context, vioarr_surface_t* surface, int output);
+static unsigned int __request_configure(vioarr_surface_t* surface, int width, int height, enum wm_surface_edge edges,
+                                        int apply, vioarr_surface_size_t* sizeOut);
+static unsigned int __complete_configure(vioarr_surface_t* surface, vioarr_surface_size_t* sizeOut);
+static void         __send_configure(vioarr_surface_t* surface, unsigned int serial, vioarr_surface_size_t* size);
+static int  __get_viewport(vioarr_surface_t* surface, float* dstOut, float* srcOut);
+#ifdef VIOARR_BACKEND_NANOVG
+static int  __nvg_type(vioarr_buffer_t* buffer);
+static int  __nvg_flags(vioarr_surface_t* surface, vioarr_buffer_t* buffer, int output);
+#endif
 static void __remove_child(vioarr_surface_t* surface, vioarr_surface_t* child);
 static void __make_orphan(vioarr_surface_t* surface);
 
@@ -107,6 +217,35 @@ static inline vioarr_region_t* __get_active_region(vioarr_surface_t* surface)
     return surface->dimensions;
 }
 
+static inline int __is_synchronized(vioarr_surface_t* surface)
+{
+    return surface->sync.enabled && surface->parent;
+}
+
+/**
+ * The state of a surface is held back while it waits for a commit to be applied, either for the
+ * commit of the parent or for the staged commit of the surface itself.
+ */
+static inline int __is_deferred(vioarr_surface_t* surface)
+{
+    return __is_synchronized(surface) || surface->sync.cached;
+}
+
+/**
+ * Commits of surfaces with children are staged, see vioarr_surface_sync_t. Commits that follow a
+ * staged commit are staged as well, so they are merged into it. Must be called with the lock held.
+ */
+static inline int __stages_commit(vioarr_surface_t* surface)
+{
+    return !__is_synchronized(surface) && (surface->sync.cached ||
+        ACTIVE_PROPERTIES(surface).children != NULL || PENDING_PROPERTIES(surface).children != NULL);
+}
+
+static inline vioarr_damage_t* __get_dirt(vioarr_surface_t* surface)
+{
+    return __is_deferred(surface) ? &surface->sync.dirt : &surface->dirt;
+}
+
 static inline void __restore_region(vioarr_surface_t* surface)
 {
     if (surface->dimensions_original) {
@@ -124,7 +263,7 @@ int vioarr_surface_create(int client, uint32_t id, vioarr_screen_t* screen, int
         return -1;
     }
     
-    surface = malloc(sizeof(vioarr_surface_t));
+    surface = vioarr_slab_alloc(&g_surfaceCache);
     if (!surface) {
         return -1;
     }
@@ -138,21 +277,17 @@ int vioarr_surface_create(int client, uint32_t id, vioarr_screen_t* screen, int
 
     surface->dimensions = vioarr_region_create();
     if (!surface->dimensions) {
-        free(surface);
+        vioarr_slab_free(&g_surfaceCache, surface);
         return -1;
     }
     vioarr_region_add(surface->dimensions, 0, 0, width, height);
     vioarr_region_set_position(surface->dimensions, x, y);
 
-    surface->dirt = vioarr_region_create();
-    if (!surface->dirt) {
-        free(surface->dimensions);
-        free(surface);
-        return -1;
-    }
+    vioarr_damage_zero(&surface->dirt);
     
     if (__initialize_surface_properties(&surface->properties[0]) ||
-        __initialize_surface_properties(&surface->properties[1])) {
+        __initialize_surface_properties(&surface->properties[1]) ||
+        __initialize_surface_properties(&surface->properties[2])) {
         vioarr_surface_destroy(surface);
         return -1;
     }
@@ -161,30 +296,51 @@ int vioarr_surface_create(int client, uint32_t id, vioarr_screen_t* screen, int
     return 0;
 }
 
-void vioarr_surface_free(vcontext_t* context, vioarr_surface_t* surface)
+/**
+ * Called by every output once it no longer references the surface, the texture of the output
+ * is released and the last output to do so frees the surface.
+ */
+void vioarr_surface_free(vcontext_t* context, int output, vioarr_surface_t* surface)
 {
     vioarr_surface_t* itr;
+    int               i;
 
     if (!surface) {
         return;
     }
 
-    // if we have children, go through them and promote them to regular surfaces
-    itr = ACTIVE_PROPERTIES(surface).children;
-    while (itr) {
-        vioarr_surface_t* next = itr->link;
-        __make_orphan(itr);
-        itr = next;
+    __destroy_texture(context, surface, output);
+    if (atomic_fetch_sub(&surface->cleanup_refs, 1) > 1) {
+        return;
+    }
+
+    // if we have children, go through them and promote them to regular surfaces, this includes
+    // the children that were added but not yet committed
+    for (i = 0; i < 3; i++) {
+        itr = surface->properties[i].children;
+        while (itr) {
+            vioarr_surface_t* next = itr->link;
+            __make_orphan(itr);
+            itr = next;
+        }
+        __cleanup_surface_properties(&surface->properties[i]);
     }
 
-    __cleanup_surface_properties(&surface->properties[0]);
-    __cleanup_surface_properties(&surface->properties[1]);
-    __cleanup_surface_backbuffer(context, &surface->backbuffers[0]);
-    __cleanup_surface_backbuffer(context, &surface->backbuffers[1]);
+    if (surface->backbuffer.content) {
+        vioarr_buffer_destroy(surface->backbuffer.content);
+    }
+    for (i = 0; i < surface->pending_count; i++) {
+        vioarr_buffer_destroy(surface->pending[i]);
+    }
+    if (surface->sync.buffer) {
+        vioarr_buffer_destroy(surface->sync.buffer);
+    }
+    if (surface->sync.cached_buffer) {
+        vioarr_buffer_destroy(surface->sync.cached_buffer);
+    }
 
-    free(surface->dirt);
-    free(surface->dimensions);
-    free(surface);
+    vioarr_region_destroy(surface->dimensions);
+    vioarr_slab_free(&g_surfaceCache, surface);
 }
 
 void vioarr_surface_destroy(vioarr_surface_t* surface)
@@ -202,15 +358,20 @@ void vioarr_surface_destroy(vioarr_surface_t* surface)
     // restore any changes to dimension
     __restore_region(surface);
 
-    // if this surface is a child, remove it from the parent
+    // if this surface is a child, remove it from the parent. What it cached for the parent to
+    // commit is dropped rather than staged, as it is unregistered already
     if (surface->parent) {
         __remove_child(surface->parent, surface);
+        vioarr_rwlock_w_lock(&surface->lock);
+        surface->sync.enabled = 0;
+        vioarr_rwlock_w_unlock(&surface->lock);
         __make_orphan(surface);
     }
 
-    // handle freeing of resources later as the renderer thread
-    // could still be reading
-    vioarr_renderer_queue_cleanup(vioarr_screen_renderer(surface->screen), surface);
+    // handle freeing of resources later as the render threads
+    // could still be reading, each of them owns a texture of the surface
+    atomic_store(&surface->cleanup_refs, vioarr_outputs_count());
+    vioarr_outputs_queue_cleanup(surface);
 }
 
 int vioarr_surface_add_child(vioarr_surface_t* parent, vioarr_surface_t* child, int x, int y)
@@ -254,35 +415,61 @@ static void __make_orphan(vioarr_surface_t* surface)
         return;
     }
 
+    // without a parent there is nothing to synchronize with anymore
+    vioarr_surface_set_sync(surface, 0);
+
     vioarr_rwlock_w_lock(&surface->lock);
     surface->link   = NULL;
     surface->parent = NULL;
     vioarr_rwlock_w_unlock(&surface->lock);
+    vioarr_manager_on_hierarchy_change();
 }
 
 static void __remove_child(vioarr_surface_t* surface, vioarr_surface_t* child)
 {
     vioarr_surface_t* itr;
+    int               i;
 
     if (!surface || !child) {
         return;
     }
 
     // at this point we can't just remove the surface, we'll have to wait a frame
-    // after removing this as parent
+    // after removing this as parent. The child can be in any of the lists depending
+    // on whether or not its addition was committed yet
     vioarr_rwlock_w_lock(&surface->lock);
-    itr = ACTIVE_PROPERTIES(surface).children;
-    if (itr == child) {
-        ACTIVE_PROPERTIES(surface).children = child->link;
-    }
-    else if (itr) {
-        while (itr->link != child) {
+    for (i = 0; i < 3; i++) {
+        itr = surface->properties[i].children;
+        if (itr == child) {
+            surface->properties[i].children = child->link;
+            break;
+        }
+
+        while (itr && itr->link != child) {
             itr = itr->link;
         }
 
-        itr->link = child->link;
+        if (itr) {
+            itr->link = child->link;
+            break;
+        }
     }
     vioarr_rwlock_w_unlock(&surface->lock);
+    vioarr_manager_on_hierarchy_change();
+}
+
+// must be called with the write lock held, the reference of the buffer is acquired by the caller
+static void __queue_buffer(vioarr_surface_t* surface, vioarr_buffer_t* content)
+{
+    // if the queue is full the oldest buffer is dropped, it was never presented
+    // and can be handed back to the client immediately
+    if (surface->pending_count == SURFACE_MAX_PENDING_BUFFERS) {
+        __release_buffer(surface, surface->pending[0]);
+        memmove(&surface->pending[0], &surface->pending[1],
+            sizeof(vioarr_buffer_t*) * (SURFACE_MAX_PENDING_BUFFERS - 1));
+        surface->pending_count--;
+    }
+    surface->pending[surface->pending_count++] = content;
 }
 
 void vioarr_surface_set_buffer(vioarr_surface_t* surface, vioarr_buffer_t* content)
@@ -291,19 +478,95 @@ void vioarr_surface_set_buffer(vioarr_surface_t* surface, vioarr_buffer_t* conte
         return;
     }
 
+    if (content) {
+        vioarr_buffer_acquire(content);
+    }
+
     vioarr_rwlock_w_lock(&surface->lock);
-    if (PENDING_BACKBUFFER(surface).content) {
-        vioarr_buffer_destroy(PENDING_BACKBUFFER(surface).content);
+    __attach_buffer(surface, content);
+    vioarr_rwlock_w_unlock(&surface->lock);
+}
+
+/**
+ * Applies all the changes of a frame under a single lock, the flags (WM_SURFACE_UPDATE_FLAGS_*)
+ * select which of them are applied besides the damage. Equal to calling set_buffer, invalidate,
+ * set_drop_shadow, set_input_region, request_frame and commit in that order.
+ */
+void vioarr_surface_apply(vioarr_surface_t* surface, vioarr_buffer_t* content, vioarr_damage_t* damage,
+    const struct wm_rect* dropShadow, const struct wm_rect* inputRegion, unsigned int flags)
+{
+    vioarr_surface_size_t size;
+    unsigned int          serial       = 0;
+    int                   synchronized = 0;
+    int                   staged       = 0;
+
+    if (!surface) {
+        return;
     }
-    if (content) {
+
+    if ((flags & WM_SURFACE_UPDATE_FLAGS_BUFFER) && content) {
         vioarr_buffer_acquire(content);
     }
 
-    PENDING_BACKBUFFER(surface).content     = content;
-    PENDING_BACKBUFFER(surface).resource_id = -1;
+    // the buffer and damage of a commit that is staged are held back with it
+    vioarr_rwlock_w_lock(&surface->lock);
+    if (flags & WM_SURFACE_UPDATE_FLAGS_COMMIT) {
+        staged = __stages_commit(surface);
+    }
+
+    if (flags & WM_SURFACE_UPDATE_FLAGS_BUFFER) {
+        if (staged) {
+            __hold_buffer(surface, content);
+        }
+        else {
+            __attach_buffer(surface, content);
+        }
+    }
+
+    if (damage) {
+        vioarr_damage_merge(staged ? &surface->sync.dirt : __get_dirt(surface), damage);
+    }
+
+    if ((flags & WM_SURFACE_UPDATE_FLAGS_DROP_SHADOW) && dropShadow) {
+        vioarr_region_zero(PENDING_PROPERTIES(surface).drop_shadow);
+        vioarr_region_add(PENDING_PROPERTIES(surface).drop_shadow,
+            dropShadow->x, dropShadow->y, dropShadow->width, dropShadow->height);
+    }
+
+    if ((flags & WM_SURFACE_UPDATE_FLAGS_INPUT_REGION) && inputRegion) {
+        vioarr_region_zero(PENDING_PROPERTIES(surface).input_region);
+        vioarr_region_add(PENDING_PROPERTIES(surface).input_region,
+            inputRegion->x, inputRegion->y, inputRegion->width, inputRegion->height);
+    }
 
-    surface->swap_backbuffers = 1;
+    if (flags & WM_SURFACE_UPDATE_FLAGS_COMMIT) {
+        synchronized = __is_synchronized(surface);
+        if (synchronized || staged) {
+            __cache_commit(surface);
+        }
+        else {
+            __swap_properties(surface, &PENDING_PROPERTIES(surface));
+            serial = __complete_configure(surface, &size);
+        }
+    }
     vioarr_rwlock_w_unlock(&surface->lock);
+    __send_configure(surface, serial, &size);
+
+    if (flags & WM_SURFACE_UPDATE_FLAGS_FRAME) {
+        atomic_store(&surface->frame_requested, 1);
+    }
+
+    if (staged) {
+        vioarr_manager_stage_commit(surface);
+    }
+    else if ((flags & WM_SURFACE_UPDATE_FLAGS_COMMIT) && !synchronized) {
+        atomic_fetch_add(&surface->commits, 1);
+        __commit_children(surface);
+    }
+
+    if (flags & (WM_SURFACE_UPDATE_FLAGS_FRAME | WM_SURFACE_UPDATE_FLAGS_COMMIT)) {
+        vioarr_engine_request_redraw();
+    }
 }
 
 void vioarr_surface_set_position(vioarr_surface_t* surface, int x, int y)
@@ -330,6 +593,54 @@ void vioarr_surface_set_drop_shadow(vioarr_surface_t* surface, int x, int y, int
     vioarr_rwlock_w_unlock(&surface->lock);
 }
 
+int vioarr_surface_set_backdrop_blur(vioarr_surface_t* surface, int radius)
+{
+    if (!surface || radius < 0) {
+        return -1;
+    }
+
+    vioarr_rwlock_w_lock(&surface->lock);
+    PENDING_PROPERTIES(surface).backdrop_blur = radius;
+    vioarr_rwlock_w_unlock(&surface->lock);
+    return 0;
+}
+
+int vioarr_surface_set_buffer_scale(vioarr_surface_t* surface, int scale)
+{
+    if (!surface || scale < 1) {
+        return -1;
+    }
+
+    vioarr_rwlock_w_lock(&surface->lock);
+    PENDING_PROPERTIES(surface).buffer_scale = scale;
+    vioarr_rwlock_w_unlock(&surface->lock);
+    return 0;
+}
+
+/**
+ * Sets the part of the buffer that is presented and the size it is presented at. The source
+ * rectangle is in surface coordinates, so it is multiplied with the buffer scale to get the
+ * buffer pixels. A source with no width or height presents the entire buffer and a destination
+ * with no width or height presents it at the size of the surface.
+ */
+int vioarr_surface_set_viewport(vioarr_surface_t* surface, int srcX, int srcY, int srcWidth, int srcHeight,
+    int dstWidth, int dstHeight)
+{
+    if (!surface || srcX < 0 || srcY < 0 || srcWidth < 0 || srcHeight < 0 || dstWidth < 0 || dstHeight < 0) {
+        return -1;
+    }
+
+    vioarr_rwlock_w_lock(&surface->lock);
+    vioarr_region_zero(PENDING_PROPERTIES(surface).source);
+    if (srcWidth && srcHeight) {
+        vioarr_region_add(PENDING_PROPERTIES(surface).source, srcX, srcY, srcWidth, srcHeight);
+    }
+    PENDING_PROPERTIES(surface).destination_width  = dstWidth;
+    PENDING_PROPERTIES(surface).destination_height = dstHeight;
+    vioarr_rwlock_w_unlock(&surface->lock);
+    return 0;
+}
+
 void vioarr_surface_set_input_region(vioarr_surface_t* surface, int x, int y, int width, int height)
 {
     if (!surface) {
@@ -366,46 +677,53 @@ void vioarr_surface_request_frame(vioarr_surface_t* surface)
 
 void vioarr_surface_maximize(vioarr_surface_t* surface)
 {
-    vioarr_region_t* maximized;
+    vioarr_region_t*      maximized;
+    vioarr_surface_size_t size;
+    unsigned int          serial;
 
     if (!surface) {
         return;
     }
 
-    // only supported on the root surface
+    // only supported on the root surface, which is maximized on the screen
+    // under its center
     if (surface->parent) {
         maximized = surface->parent->dimensions;
     }
     else {
-        maximized = vioarr_screen_region(surface->screen);
+        vioarr_region_t* region = __get_active_region(surface);
+        maximized = vioarr_screen_region(vioarr_outputs_screen_at(
+            vioarr_region_x(region) + (vioarr_region_width(region) / 2),
+            vioarr_region_y(region) + (vioarr_region_height(region) / 2)));
     }
 
     vioarr_rwlock_w_lock(&surface->lock);
     surface->dimensions_original = surface->dimensions;
     surface->dimensions = maximized;
+    serial = __request_configure(surface, vioarr_region_width(maximized), vioarr_region_height(maximized),
+        WM_SURFACE_EDGE_NO_EDGES, 0, &size);
     vioarr_rwlock_w_unlock(&surface->lock);
 
-    wm_surface_event_resize_single(vioarr_get_server_handle(), surface->client, surface->id,
-        vioarr_region_width(maximized), 
-        vioarr_region_height(maximized),
-        WM_SURFACE_EDGE_NO_EDGES);
+    __send_configure(surface, serial, &size);
     vioarr_engine_request_redraw();
 }
 
 void vioarr_surface_restore_size(vioarr_surface_t* surface)
 {
+    vioarr_surface_size_t size;
+    unsigned int          serial;
+
     if (!surface) {
         return;
     }
 
     vioarr_rwlock_w_lock(&surface->lock);
     __restore_region(surface);
+    serial = __request_configure(surface, vioarr_region_width(surface->dimensions),
+        vioarr_region_height(surface->dimensions), WM_SURFACE_EDGE_NO_EDGES, 0, &size);
     vioarr_rwlock_w_unlock(&surface->lock);
 
-    wm_surface_event_resize_single(vioarr_get_server_handle(), surface->client, surface->id,
-        vioarr_region_width(surface->dimensions), 
-        vioarr_region_height(surface->dimensions),
-        WM_SURFACE_EDGE_NO_EDGES);
+    __send_configure(surface, serial, &size);
     vioarr_engine_request_redraw();
 }
 
@@ -442,46 +760,6 @@ exit:
     return contained;
 }
 
-vioarr_surface_t* vioarr_surface_at(vioarr_surface_t* surface, int x, int y, int* localX, int* localY)
-{
-    vioarr_surface_t* surfaceAt = NULL;
-    vioarr_region_t*  region;
-    //vioarr_utils_trace(VISTR("vioarr_surface_at(surface=%u, x=%i, y=%i)"), vioarr_surface_id(surface), x, y);
-    if (!vioarr_surface_visible(surface)) {
-        return NULL;
-    }
-
-    vioarr_rwlock_r_lock(&surface->lock);
-    region = __get_active_region(surface);
-    if (vioarr_region_contains(region, x, y)) {
-        vioarr_surface_t* itr = ACTIVE_PROPERTIES(surface).children;
-        int               xInSurface = x - vioarr_region_x(region);
-        int               yInSurface = y - vioarr_region_y(region);
-
-        while (itr) {
-            vioarr_surface_t* subAt = vioarr_surface_at(itr, 
-                xInSurface, yInSurface,
-                localX, localY);
-            if (subAt) {
-                surfaceAt = subAt;
-                break;
-            }
-            itr = itr->link;
-        }
-
-        // if we did not find a subsurface, then set this one as the innermost at
-        if (!surfaceAt) {
-            *localX = xInSurface;
-            *localY = yInSurface;
-            surfaceAt = surface;
-        }
-    }
-    vioarr_rwlock_r_unlock(&surface->lock);
-
-    //vioarr_utils_trace(VISTR("vioarr_surface_at returns=%u"), vioarr_surface_id(surfaceAt));
-    return surfaceAt;
-}
-
 vioarr_surface_t* vioarr_surface_parent(vioarr_surface_t* surface, int upperMost)
 {
     vioarr_surface_t* parent = surface;
@@ -509,22 +787,134 @@ void vioarr_surface_invalidate(vioarr_surface_t* surface, int x, int y, int widt
     }
     
     vioarr_rwlock_w_lock(&surface->lock);
-    vioarr_region_add(surface->dirt, x, y, width, height);
+    vioarr_damage_add(__get_dirt(surface), x, y, width, height);
+    vioarr_rwlock_w_unlock(&surface->lock);
+}
+
+/**
+ * Invalidates multiple areas of the content at once, see vioarr_surface_invalidate.
+ */
+void vioarr_surface_invalidate_rects(vioarr_surface_t* surface, const struct wm_rect* rects, int count)
+{
+    int i;
+
+    if (!surface || !rects) {
+        return;
+    }
+
+    vioarr_rwlock_w_lock(&surface->lock);
+    for (i = 0; i < count; i++) {
+        vioarr_damage_add(__get_dirt(surface), rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+    }
     vioarr_rwlock_w_unlock(&surface->lock);
 }
 
 void vioarr_surface_commit(vioarr_surface_t* surface)
 {
+    vioarr_surface_size_t size;
+    unsigned int          serial;
+
     if (!surface) {
         return;
     }
 
     vioarr_rwlock_w_lock(&surface->lock);
-    __swap_properties(surface);
+    if (__is_synchronized(surface)) {
+        __cache_commit(surface);
+        vioarr_rwlock_w_unlock(&surface->lock);
+        return;
+    }
+
+    if (__stages_commit(surface)) {
+        __cache_commit(surface);
+        vioarr_rwlock_w_unlock(&surface->lock);
+        vioarr_manager_stage_commit(surface);
+        vioarr_engine_request_redraw();
+        return;
+    }
+
+    __swap_properties(surface, &PENDING_PROPERTIES(surface));
+    serial = __complete_configure(surface, &size);
     vioarr_rwlock_w_unlock(&surface->lock);
+    __send_configure(surface, serial, &size);
+    atomic_fetch_add(&surface->commits, 1);
+    __commit_children(surface);
     vioarr_engine_request_redraw();
 }
 
+/**
+ * Applies the commit staged for a surface with children, and the cached commits of the synchronized
+ * children below it. Invoked by the manager at the start of a frame, while no renderer is updating
+ * the surfaces, so the tree is presented as a whole.
+ */
+void vioarr_surface_apply_staged(vioarr_surface_t* surface)
+{
+    vioarr_surface_size_t size;
+    unsigned int          serial;
+
+    if (!surface) {
+        return;
+    }
+
+    vioarr_rwlock_w_lock(&surface->lock);
+    serial = __apply_cached_commit(surface, &size);
+    if (!__is_synchronized(surface)) {
+        __flush_held(surface);
+    }
+    vioarr_rwlock_w_unlock(&surface->lock);
+    __send_configure(surface, serial, &size);
+    __commit_children(surface);
+}
+
+/**
+ * Enables or disables synchronized commits of a subsurface. Disabling it applies any state
+ * that is waiting for the parent to commit. Root surfaces are never synchronized.
+ */
+void vioarr_surface_set_sync(vioarr_surface_t* surface, int enabled)
+{
+    vioarr_surface_size_t size;
+    unsigned int          serial  = 0;
+    int                   flushed = 0;
+    int                   staged  = 0;
+
+    if (!surface) {
+        return;
+    }
+
+    vioarr_rwlock_w_lock(&surface->lock);
+    if (surface->sync.enabled && !enabled) {
+        // the cached commit of a surface with children is applied together with the children
+        if (ACTIVE_PROPERTIES(surface).children || PENDING_PROPERTIES(surface).children) {
+            staged = 1;
+        }
+        else {
+            serial  = __apply_cached_commit(surface, &size);
+            flushed = 1;
+        }
+
+        // the state that was set but not committed yet is simply applied like it would
+        // have been for a subsurface that is not synchronized, unless it must follow the
+        // staged commit
+        if (!surface->sync.cached) {
+            __flush_held(surface);
+        }
+    }
+    surface->sync.enabled = enabled;
+    vioarr_rwlock_w_unlock(&surface->lock);
+    __send_configure(surface, serial, &size);
+
+    if (staged) {
+        vioarr_manager_stage_commit(surface);
+    }
+    else if (flushed) {
+        __commit_children(surface);
+    }
+
+    if (flushed || staged) {
+        vioarr_engine_request_redraw();
+    }
+}
+
 void vioarr_surface_move(vioarr_surface_t* surface, int x, int y)
 {
     vioarr_region_t* region;
@@ -555,20 +945,64 @@ void vioarr_surface_move_absolute(vioarr_surface_t* surface, int x, int y)
     vioarr_engine_request_redraw();
 }
 
+/**
+ * Requests the client to resize the surface. Once the client acknowledges configures the surface
+ * keeps its current size and content until the client commits content of the new size.
+ */
 void vioarr_surface_resize(vioarr_surface_t* surface, int width, int height, enum wm_surface_edge edges)
 {
+    vioarr_surface_size_t size;
+    unsigned int          serial;
+
     if (!surface) {
         return;
     }
 
     vioarr_rwlock_w_lock(&surface->lock);
-    vioarr_region_set_size(__get_correct_region(surface), width, height);
+    serial = __request_configure(surface, width, height, edges, 1, &size);
     vioarr_rwlock_w_unlock(&surface->lock);
 
-    wm_surface_event_resize_single(vioarr_get_server_handle(), surface->client, surface->id, width, height, edges);
+    __send_configure(surface, serial, &size);
     vioarr_engine_request_redraw();
 }
 
+void vioarr_surface_ack_configure(vioarr_surface_t* surface, unsigned int serial)
+{
+    if (!surface) {
+        return;
+    }
+
+    vioarr_rwlock_w_lock(&surface->lock);
+    surface->configure.handshake = 1;
+    surface->configure.acked     = serial;
+    vioarr_rwlock_w_unlock(&surface->lock);
+}
+
+void vioarr_surface_configured_size(vioarr_surface_t* surface, int* widthOut, int* heightOut)
+{
+    vioarr_region_t* region;
+
+    if (!surface) {
+        return;
+    }
+
+    vioarr_rwlock_r_lock(&surface->lock);
+    if (surface->configure.queued) {
+        *widthOut  = surface->configure.next.width;
+        *heightOut = surface->configure.next.height;
+    }
+    else if (surface->configure.in_flight) {
+        *widthOut  = surface->configure.sent.width;
+        *heightOut = surface->configure.sent.height;
+    }
+    else {
+        region     = __get_correct_region(surface);
+        *widthOut  = vioarr_region_width(region);
+        *heightOut = vioarr_region_height(region);
+    }
+    vioarr_rwlock_r_unlock(&surface->lock);
+}
+
 void vioarr_surface_focus(vioarr_surface_t* surface, int focus)
 {
     if (!surface) {
@@ -594,6 +1028,18 @@ int vioarr_surface_client(vioarr_surface_t* surface)
     return surface->client;
 }
 
+/**
+ * Retrieves the number of commits of the surface, which can be compared to see if the surface
+ * was committed since.
+ */
+unsigned int vioarr_surface_commits(vioarr_surface_t* surface)
+{
+    if (!surface) {
+        return 0;
+    }
+    return atomic_load(&surface->commits);
+}
+
 vioarr_screen_t* vioarr_surface_screen(vioarr_surface_t* surface)
 {
     if (!surface) {
@@ -639,201 +1085,805 @@ int vioarr_surface_visible(vioarr_surface_t* surface)
     return visible;
 }
 
-void vioarr_surface_render(vcontext_t* context, vioarr_surface_t* surface)
+/**
+ * Returns whether the surface content covers everything beneath it, which is the case
+ * for content formats without an alpha channel.
+ */
+int vioarr_surface_opaque(vioarr_surface_t* surface)
 {
-    vioarr_region_t* region;
-
+    int opaque = 0;
     if (!surface) {
-        return;
+        return 0;
     }
 
-    //vioarr_utils_trace(VISTR("[vioarr_surface_render] %u [%i, %i]"), 
-    //    surface->id, vioarr_region_x(surface->dimensions),
-    //    vioarr_region_y(surface->dimensions));
     vioarr_rwlock_r_lock(&surface->lock);
-    if (!__swap_backbuffer(context, surface)) {
-        vioarr_rwlock_r_unlock(&surface->lock);
-        return;
-    }
-
-    __update_surface(context, surface);
-    region = __get_active_region(surface);
-#ifdef VIOARR_BACKEND_NANOVG
-    nvgSave(context);
-    nvgTranslate(context, 
-        (float)vioarr_region_x(region),
-        (float)vioarr_region_y(region)
-    );
-#endif
-
     if (ACTIVE_BACKBUFFER(surface).content) {
-        //vioarr_utils_trace(VISTR("[vioarr_surface_render] rendering content"));
-        if (!vioarr_region_is_zero(ACTIVE_PROPERTIES(surface).drop_shadow)) {
-            __render_drop_shadow(context, surface);
-        }
-        __render_content(context, surface);
-    }
-
-    if (ACTIVE_PROPERTIES(surface).children) {
-        vioarr_surface_t* child = ACTIVE_PROPERTIES(surface).children;
-        while (child) {
-            vioarr_surface_render(context, child);
-            child = child->link;
+        switch (vioarr_buffer_format(ACTIVE_BACKBUFFER(surface).content)) {
+            case WM_PIXEL_FORMAT_X8R8G8B8: opaque = 1; break;
+            case WM_PIXEL_FORMAT_X8B8G8R8: opaque = 1; break;
+            case WM_PIXEL_FORMAT_R5G6B5:   opaque = 1; break;
+            default: break;
         }
     }
     vioarr_rwlock_r_unlock(&surface->lock);
-
-#ifdef VIOARR_BACKEND_NANOVG
-    nvgRestore(context);
-#endif
+    return opaque;
 }
 
-static void __update_surface(NVGcontext* context, vioarr_surface_t* surface)
+/**
+ * Retrieves how far the visuals of the surface (the drop shadow) extend beyond its
+ * dimensions, in the order left, top, right and bottom.
+ */
+void vioarr_surface_margins(vioarr_surface_t* surface, int marginsOut[4])
 {
-    //vioarr_utils_trace(VISTR("[__update_surface]"));
-    __refresh_content(context, surface);
-    if (atomic_exchange(&surface->frame_requested, 0)) {
-        wm_surface_event_frame_single(vioarr_get_server_handle(), surface->client, surface->id);
-    }
-    //vioarr_utils_trace(VISTR("[__update_surface] is visible: %i"), surface->visible);
-}
+    vioarr_region_t* shadow;
+
+    marginsOut[0] = marginsOut[1] = marginsOut[2] = marginsOut[3] = 0;
+    if (!surface) {
+        return;
+    }
+
+    vioarr_rwlock_r_lock(&surface->lock);
+    shadow = ACTIVE_PROPERTIES(surface).drop_shadow;
+    if (!vioarr_region_is_zero(shadow)) {
+        int x = vioarr_region_x(shadow);
+        int y = vioarr_region_y(shadow);
+        marginsOut[0] = x < 0 ? -x : 0;
+        marginsOut[1] = y < 0 ? -y : 0;
+        marginsOut[2] = (x + vioarr_region_width(shadow)) > 0 ? (x + vioarr_region_width(shadow)) : 0;
+        marginsOut[3] = (y + vioarr_region_height(shadow)) > 0 ? (y + vioarr_region_height(shadow)) : 0;
+    }
+    vioarr_rwlock_r_unlock(&surface->lock);
+}
+
+int vioarr_surface_backdrop_blur(vioarr_surface_t* surface)
+{
+    int radius;
+
+    if (!surface) {
+        return 0;
+    }
+
+    vioarr_rwlock_r_lock(&surface->lock);
+    radius = ACTIVE_BACKBUFFER(surface).content ? ACTIVE_PROPERTIES(surface).backdrop_blur : 0;
+    vioarr_rwlock_r_unlock(&surface->lock);
+    return radius;
+}
+
+size_t vioarr_surface_texture_size(vioarr_surface_t* surface, int output)
+{
+    if (!surface) {
+        return 0;
+    }
+    return OUTPUT_TEXTURE(surface, output).size;
+}
+
+unsigned int vioarr_surface_last_presented(vioarr_surface_t* surface, int output)
+{
+    if (!surface) {
+        return 0;
+    }
+    return OUTPUT_TEXTURE(surface, output).last_presented;
+}
+
+void vioarr_surface_enumerate_children(vioarr_surface_t* surface, void (*callback)(vioarr_surface_t*, void*), void* context)
+{
+    vioarr_surface_t* child;
+
+    if (!surface || !callback) {
+        return;
+    }
+
+    vioarr_rwlock_r_lock(&surface->lock);
+    child = ACTIVE_PROPERTIES(surface).children;
+    while (child) {
+        callback(child, context);
+        child = child->link;
+    }
+    vioarr_rwlock_r_unlock(&surface->lock);
+}
+
+/**
+ * Applies the buffers and damage committed since the last frame and sends any requested
+ * frame event. Nothing is uploaded here, that is deferred until the surface is actually
+ * presented by vioarr_surface_render, so surfaces that are covered or off-screen do not
+ * cost any texture memory. Every output that shows the surface updates it, the first one
+ * to do so in a frame applies the changes. Returns whether or not the surface is visible.
+ */
+int vioarr_surface_update(vcontext_t* context, int output, vioarr_surface_t* surface)
+{
+    int visible;
+
+    if (!surface) {
+        return 0;
+    }
+
+    vioarr_rwlock_w_lock(&surface->lock);
+    visible = __swap_backbuffer(surface);
+    if (visible) {
+        __refresh_content(surface);
+        if (atomic_exchange(&surface->frame_requested, 0)) {
+            wm_surface_event_frame_single(vioarr_get_server_handle(), surface->client, surface->id);
+        }
+    }
+    else if (OUTPUT_TEXTURE(surface, output).size) {
+        // the content was removed, textures can only be destroyed by their own context
+        __destroy_texture(context, surface, output);
+    }
+    vioarr_rwlock_w_unlock(&surface->lock);
+    return visible;
+}
+
+/**
+ * Uploads the content of the surface into the texture of the output if it is stale. The surface
+ * must have been updated for this frame. Returns whether or not the presented content changed
+ * since the last time the surface was prepared.
+ */
+int vioarr_surface_prepare(vcontext_t* context, int output, vioarr_surface_t* surface)
+{
+    vioarr_surface_texture_t* texture;
+    int                       changed;
+
+    if (!surface) {
+        return 0;
+    }
+
+    // the texture of an output is only touched by that output, so the read lock is enough
+    vioarr_rwlock_r_lock(&surface->lock);
+    if (!ACTIVE_BACKBUFFER(surface).content) {
+        vioarr_rwlock_r_unlock(&surface->lock);
+        return 0;
+    }
+
+    texture = &OUTPUT_TEXTURE(surface, output);
+#ifdef VIOARR_BACKEND_NANOVG
+    // a changed viewport can change the filtering of the texture, released content keeps the
+    // filtering it was uploaded with as it can no longer be read
+    if (texture->size && texture->flags != __nvg_flags(surface, ACTIVE_BACKBUFFER(surface).content, output) &&
+        !atomic_load(&ACTIVE_BACKBUFFER(surface).released)) {
+        texture->serial = 0;
+    }
+#endif
+
+    // the client may already be drawing into content that was released, so a texture that was
+    // evicted or never uploaded by this output waits for the client to submit the content again
+    if (texture->serial != ACTIVE_BACKBUFFER(surface).serial && atomic_load(&ACTIVE_BACKBUFFER(surface).released)) {
+        __request_redraw(surface);
+    }
+    else if (texture->serial != ACTIVE_BACKBUFFER(surface).serial && __upload_content(context, surface, output)) {
+        vioarr_utils_error(VISTR("[vioarr_surface_prepare] failed to upload surface content"));
+        vioarr_rwlock_r_unlock(&surface->lock);
+        return 0;
+    }
+    atomic_fetch_or(&surface->presenting, 1u << output);
+    texture->last_presented = vioarr_textures_frame(output);
+    changed                 = texture->changed;
+    texture->changed        = 0;
+    vioarr_rwlock_r_unlock(&surface->lock);
+    return changed;
+}
+
+/**
+ * Retrieves the areas of the surface (in surface coordinates) that changed the last time the
+ * surface was prepared on the output and reported a change. Returns 0 if all of the surface
+ * must be considered changed, in which case damageOut is left empty.
+ */
+int vioarr_surface_damage(vioarr_surface_t* surface, int output, vioarr_damage_t* damageOut)
+{
+    vioarr_surface_texture_t* texture;
+    float                     destination[2];
+    float                     source[4];
+    float                     scaleX, scaleY;
+    int                       i;
+
+    if (!surface || !damageOut) {
+        return 0;
+    }
+
+    vioarr_damage_zero(damageOut);
+    vioarr_rwlock_r_lock(&surface->lock);
+    texture = &OUTPUT_TEXTURE(surface, output);
+    if (!ACTIVE_BACKBUFFER(surface).content || vioarr_damage_is_zero(&texture->damage)) {
+        vioarr_rwlock_r_unlock(&surface->lock);
+        return 0;
+    }
+
+    // the damage is in buffer pixels, which are mapped through the viewport and rounded outwards
+    __get_viewport(surface, &destination[0], &source[0]);
+    if (source[2] <= 0.0f || source[3] <= 0.0f) {
+        vioarr_rwlock_r_unlock(&surface->lock);
+        return 0;
+    }
+
+    scaleX = destination[0] / source[2];
+    scaleY = destination[1] / source[3];
+    for (i = 0; i < texture->damage.count; i++) {
+        vioarr_drawlist_rect_t* rect = &texture->damage.rects[i];
+        int x1 = (int)(((float)rect->x - source[0]) * scaleX);
+        int y1 = (int)(((float)rect->y - source[1]) * scaleY);
+        int x2 = (int)(((float)(rect->x + rect->width) - source[0]) * scaleX + 0.999f);
+        int y2 = (int)(((float)(rect->y + rect->height) - source[1]) * scaleY + 0.999f);
+        vioarr_damage_add(damageOut, x1, y1, x2 - x1, y2 - y1);
+    }
+    vioarr_damage_clip(damageOut, 0, 0, (int)destination[0], (int)destination[1]);
+    vioarr_rwlock_r_unlock(&surface->lock);
+    return 1;
+}
+
+/**
+ * Renders the surface content at the given desktop coordinates. The surface must have been
+ * prepared for this frame. Subsurfaces are not rendered by this, they have their own entries
+ * in the draw list.
+ */
+void vioarr_surface_render(vcontext_t* context, int output, vioarr_surface_t* surface, int x, int y)
+{
+    if (!surface) {
+        return;
+    }
+
+    //vioarr_utils_trace(VISTR("[vioarr_surface_render] %u [%i, %i]"), surface->id, x, y);
+    vioarr_rwlock_r_lock(&surface->lock);
+    if (!ACTIVE_BACKBUFFER(surface).content) {
+        vioarr_rwlock_r_unlock(&surface->lock);
+        return;
+    }
+
+#ifdef VIOARR_BACKEND_NANOVG
+    nvgSave(context);
+    nvgTranslate(context, (float)x, (float)y);
+#endif
+
+    //vioarr_utils_trace(VISTR("[vioarr_surface_render] rendering content"));
+    if (!vioarr_region_is_zero(ACTIVE_PROPERTIES(surface).drop_shadow)) {
+        __render_drop_shadow(context, surface, output);
+    }
+    __render_content(context, surface, output);
+    vioarr_rwlock_r_unlock(&surface->lock);
 
 #ifdef VIOARR_BACKEND_NANOVG
-static int __nvg_flags(vioarr_buffer_t* buffer)
+    nvgRestore(context);
+#endif
+}
+
+/**
+ * Reads the content of the surface for outputs that draw it on the cpu instead of through a
+ * texture, like the cursor plane. At most maxWidth x maxHeight pixels are read into pixels as
+ * premultiplied 0xAARRGGBB with a pitch of maxWidth, and the read counts as the upload of the
+ * output. The content is only read if it changed since the last read, unless force is set.
+ * Returns 1 if the content was read, 0 if it was not and -1 if there is no content that can be read.
+ */
+int vioarr_surface_read_pixels(vioarr_surface_t* surface, int output, int force, uint32_t* pixels,
+    int maxWidth, int maxHeight, int* widthOut, int* heightOut)
+{
+    vioarr_surface_backbuffer_t* active;
+    vioarr_surface_texture_t*    texture;
+    int                          width;
+    int                          height;
+    int                          status = 0;
+
+    if (!surface || !pixels || !widthOut || !heightOut) {
+        return -1;
+    }
+
+    vioarr_rwlock_r_lock(&surface->lock);
+    active = &ACTIVE_BACKBUFFER(surface);
+    if (!active->content) {
+        vioarr_rwlock_r_unlock(&surface->lock);
+        return -1;
+    }
+
+    // the content is presented 1:1 from the top left corner of the buffer
+    width   = vioarr_region_width(surface->dimensions);
+    height  = vioarr_region_height(surface->dimensions);
+    width   = width < vioarr_buffer_width(active->content) ? width : vioarr_buffer_width(active->content);
+    height  = height < vioarr_buffer_height(active->content) ? height : vioarr_buffer_height(active->content);
+    width   = width < maxWidth ? width : maxWidth;
+    height  = height < maxHeight ? height : maxHeight;
+    texture = &OUTPUT_TEXTURE(surface, output);
+    if ((force || texture->cpu_serial != active->serial) && atomic_load(&active->released)) {
+        // released content can't be read anymore, it is hidden until the client submits it again
+        __request_redraw(surface);
+        status = -1;
+    }
+    else if (force || texture->cpu_serial != active->serial) {
+        vioarr_buffer_read_pixels(active->content, pixels, width, height, maxWidth);
+        texture->cpu_serial = active->serial;
+        atomic_fetch_or(&surface->presenting, 1u << output);
+        __on_uploaded(surface, output);
+        status = 1;
+    }
+    vioarr_rwlock_r_unlock(&surface->lock);
+
+    *widthOut  = width;
+    *heightOut = height;
+    return status;
+}
+
+/**
+ * Releases the texture of the surface while keeping the content buffer. Content that was not
+ * released yet is uploaded again the next time the surface is presented, otherwise the client
+ * is asked to submit it again. Returns the number of texture bytes freed.
+ */
+size_t vioarr_surface_evict(vcontext_t* context, int output, vioarr_surface_t* surface)
+{
+    size_t freed;
+
+    if (!surface) {
+        return 0;
+    }
+
+    vioarr_rwlock_r_lock(&surface->lock);
+    freed = OUTPUT_TEXTURE(surface, output).size;
+    if (freed) {
+        __destroy_texture(context, surface, output);
+        vioarr_textures_on_evicted();
+    }
+    vioarr_rwlock_r_unlock(&surface->lock);
+    return freed;
+}
+
+/**
+ * Called by an output for every surface it did not present in a frame. An output that no
+ * longer shows the surface must not hold back the release of the content.
+ */
+void vioarr_surface_hide(vioarr_surface_t* surface, int output)
+{
+    vioarr_surface_backbuffer_t* backbuffer;
+    unsigned int                 bit = 1u << output;
+    unsigned int                 remaining;
+
+    if (!surface || !(atomic_load(&surface->presenting) & bit)) {
+        return;
+    }
+    atomic_fetch_and(&surface->presenting, ~bit);
+
+    vioarr_rwlock_r_lock(&surface->lock);
+    backbuffer = &ACTIVE_BACKBUFFER(surface);
+    remaining  = atomic_fetch_and(&backbuffer->pending_uploads, ~bit);
+    if ((remaining & bit) && !(remaining & ~bit) && atomic_load(&backbuffer->uploaded) &&
+        !atomic_exchange(&backbuffer->released, 1)) {
+        wm_buffer_event_release_single(vioarr_get_server_handle(), surface->client, vioarr_buffer_id(backbuffer->content));
+    }
+    vioarr_rwlock_r_unlock(&surface->lock);
+}
+
+#ifdef VIOARR_BACKEND_NANOVG
+/**
+ * The texture type describes the byte order of the content in memory, the formats are named
+ * after their 32 bit value on little endian. The content is uploaded as is and the channels
+ * are reordered when sampling, so no format is converted on the cpu.
+ */
+static int __nvg_type(vioarr_buffer_t* buffer)
+{
+    switch (vioarr_buffer_format(buffer)) {
+        case WM_PIXEL_FORMAT_A8R8G8B8: return NVG_TEXTURE_BGRA;
+        case WM_PIXEL_FORMAT_A8B8G8R8: return NVG_TEXTURE_RGBA;
+        case WM_PIXEL_FORMAT_X8R8G8B8: return NVG_TEXTURE_BRGX;
+        case WM_PIXEL_FORMAT_X8B8G8R8: return NVG_TEXTURE_RGBX;
+        case WM_PIXEL_FORMAT_R8G8B8A8: return NVG_TEXTURE_ABGR;
+        case WM_PIXEL_FORMAT_B8G8R8A8: return NVG_TEXTURE_ARGB;
+        case WM_PIXEL_FORMAT_R5G6B5:   return NVG_TEXTURE_RGB565;
+        default: return NVG_TEXTURE_RGBA;
+    }
+}
+
+static int __nvg_flags(vioarr_surface_t* surface, vioarr_buffer_t* buffer, int output)
 {
     unsigned int bufferFlags = vioarr_buffer_flags(buffer);
     int          nvgFlags = 0;
+    float        destination[2];
+    float        source[4];
 
-    if (bufferFlags & 0x1) {
+    if (bufferFlags & VIOARR_BUFFER_FLIP_Y) {
         nvgFlags |= NVG_IMAGE_FLIPY;
     }
 
-    switch (vioarr_buffer_format(buffer)) {
-        case WM_PIXEL_FORMAT_X8R8G8B8: nvgFlags |= NVG_IMAGE_PREMULTIPLIED; break;
-        case WM_PIXEL_FORMAT_X8B8G8R8: nvgFlags |= NVG_IMAGE_PREMULTIPLIED; break;
-        default: break;
+    if (bufferFlags & VIOARR_BUFFER_PREMULTIPLIED) {
+        nvgFlags |= NVG_IMAGE_PREMULTIPLIED;
+    }
+
+    // content that is presented 1:1 does not need filtering, scaled content is
+    // sampled with linear filtering unless the output is short on time
+    if (__get_viewport(surface, &destination[0], &source[0]) ||
+        vioarr_governor_level(output) >= VIOARR_GOVERNOR_NEAREST) {
+        nvgFlags |= NVG_IMAGE_NEAREST;
     }
 
     return nvgFlags;
 }
 #endif
 
+static void __release_buffer(vioarr_surface_t* surface, vioarr_buffer_t* buffer)
+{
+    if (buffer) {
+        wm_buffer_event_release_single(vioarr_get_server_handle(), surface->client, vioarr_buffer_id(buffer));
+        vioarr_buffer_destroy(buffer);
+    }
+}
+
+static void __destroy_texture(vcontext_t* context, vioarr_surface_t* surface, int output)
+{
+    vioarr_surface_texture_t* texture = &OUTPUT_TEXTURE(surface, output);
+
+    if (texture->size) {
+#ifdef VIOARR_BACKEND_NANOVG
+        nvgDeleteImage(context, texture->resource_id);
+#endif
+        vioarr_textures_on_freed(surface->client, texture->size);
+        texture->size = 0;
+    }
+    texture->resource_id = -1;
+    texture->serial      = 0;
+}
+
+/**
+ * Marks the content as changed, every output presenting the surface must upload it again
+ * before it can be released.
+ */
+static void __invalidate_content(vioarr_surface_t* surface)
+{
+    vioarr_surface_backbuffer_t* backbuffer = &ACTIVE_BACKBUFFER(surface);
+
+    backbuffer->serial++;
+    atomic_store(&backbuffer->uploaded, 0);
+    atomic_store(&backbuffer->released, 0);
+    atomic_store(&backbuffer->pending_uploads, atomic_load(&surface->presenting));
+}
+
+/**
+ * Once all outputs presenting the surface have uploaded the content the compositor no
+ * longer reads the buffer, so the client is notified that it may be reused.
+ */
+static void __on_uploaded(vioarr_surface_t* surface, int output)
+{
+    vioarr_surface_backbuffer_t* backbuffer = &ACTIVE_BACKBUFFER(surface);
+    unsigned int                 bit        = 1u << output;
+
+    atomic_store(&backbuffer->uploaded, 1);
+    if (!(atomic_fetch_and(&backbuffer->pending_uploads, ~bit) & ~bit) &&
+        !atomic_exchange(&backbuffer->released, 1)) {
+        wm_buffer_event_release_single(vioarr_get_server_handle(), surface->client, vioarr_buffer_id(backbuffer->content));
+    }
+}
+
+/**
+ * Asks the client to submit the active content again, as the compositor no longer holds a copy
+ * of it and the buffer was released. The client is only asked once for each serial.
+ */
+static void __request_redraw(vioarr_surface_t* surface)
+{
+    vioarr_surface_backbuffer_t* backbuffer = &ACTIVE_BACKBUFFER(surface);
+
+    if (atomic_exchange(&backbuffer->redraw_serial, backbuffer->serial) != backbuffer->serial) {
+        wm_surface_event_redraw_single(vioarr_get_server_handle(), surface->client, surface->id);
+    }
+}
+
+/**
+ * Uploads the active content into the texture of the output. The texture is reused when the
+ * buffer layout did not change.
+ */
+static int __upload_content(NVGcontext* context, vioarr_surface_t* surface, int output)
+{
+    vioarr_surface_backbuffer_t* active  = &ACTIVE_BACKBUFFER(surface);
+    vioarr_surface_texture_t*    texture = &OUTPUT_TEXTURE(surface, output);
+    vioarr_buffer_t*             content = active->content;
+    size_t                       size    = (size_t)vioarr_buffer_width(content) * vioarr_buffer_height(content) *
+        vioarr_buffer_bytes_per_pixel(vioarr_buffer_format(content));
+
+#ifdef VIOARR_BACKEND_NANOVG
+    int reuse = 0;
+    if (texture->size) {
+        int width, height;
+        nvgImageSize(context, texture->resource_id, &width, &height);
+        reuse = width  == vioarr_buffer_width(content)  &&
+                height == vioarr_buffer_height(content) &&
+                texture->type  == __nvg_type(content)   &&
+                texture->flags == __nvg_flags(surface, content, output);
+    }
+
+    // content that was damaged since the texture was uploaded only needs the damage uploaded,
+    // the texture holds the rest already
+    if (reuse && texture->serial + 1 == active->serial && !vioarr_damage_is_zero(&active->damage)) {
+        int i;
+
+        if (!texture->changed) {
+            vioarr_damage_zero(&texture->damage);
+        }
+
+        for (i = 0; i < active->damage.count; i++) {
+            vioarr_drawlist_rect_t* rect = &active->damage.rects[i];
+            nvgUpdateImageRegion(context, texture->resource_id, rect->x, rect->y, rect->width, rect->height,
+                (const uint8_t*)vioarr_buffer_data(content));
+
+            // a change of the entire surface that was not presented yet stays that way
+            if (!texture->changed || !vioarr_damage_is_zero(&texture->damage)) {
+                vioarr_damage_add(&texture->damage, rect->x, rect->y, rect->width, rect->height);
+            }
+        }
+    }
+    else if (reuse) {
+        nvgUpdateImage(context, texture->resource_id, (const uint8_t*)vioarr_buffer_data(content));
+        vioarr_damage_zero(&texture->damage);
+    }
+    else {
+        int resourceId = nvgCreateImageAs(context,
+            vioarr_buffer_width(content),
+            vioarr_buffer_height(content),
+            __nvg_type(content),
+            __nvg_flags(surface, content, output),
+            (const uint8_t*)vioarr_buffer_data(content));
+        if (resourceId <= 0) {
+            return -1;
+        }
+
+        __destroy_texture(context, surface, output);
+        texture->resource_id = resourceId;
+        texture->type        = __nvg_type(content);
+        texture->flags       = __nvg_flags(surface, content, output);
+        texture->size        = size;
+        vioarr_damage_zero(&texture->damage);
+        vioarr_textures_on_allocated(surface->client, size);
+    }
+#endif
+
+    texture->serial  = active->serial;
+    texture->changed = 1;
+    __on_uploaded(surface, output);
+    return 0;
+}
+
 /**
  * Returns whether or not the surface is visible
  */
-static int __swap_backbuffer(NVGcontext* context, vioarr_surface_t* surface)
+static int __swap_backbuffer(vioarr_surface_t* surface)
 {
-    int visible;
+    vioarr_surface_backbuffer_t* active = &ACTIVE_BACKBUFFER(surface);
+    vioarr_buffer_t*             content;
+    int                          visible;
+    int                          i;
 
-    if (!surface->swap_backbuffers) {
+    if (!surface->pending_count) {
         return surface->visible;
     }
-    surface->swap_backbuffers = 0;
+
+    // only the newest buffer is presented, the ones queued before it were never
+    // read and are handed straight back to the client
+    content = surface->pending[surface->pending_count - 1];
+    for (i = 0; i < surface->pending_count - 1; i++) {
+        __release_buffer(surface, surface->pending[i]);
+    }
+    surface->pending_count = 0;
 
     // store the old value of visible
     visible = surface->visible;
 
-    // initialize the new content
-    if (PENDING_BACKBUFFER(surface).content) {
-#ifdef VIOARR_BACKEND_NANOVG
-        PENDING_BACKBUFFER(surface).resource_id = nvgCreateImageRGBA(context,
-            vioarr_buffer_width(PENDING_BACKBUFFER(surface).content), 
-            vioarr_buffer_height(PENDING_BACKBUFFER(surface).content),
-            __nvg_flags(PENDING_BACKBUFFER(surface).content), 
-            (const uint8_t*)vioarr_buffer_data(PENDING_BACKBUFFER(surface).content));
-#endif
-        if (PENDING_BACKBUFFER(surface).resource_id < 0) {
-            vioarr_utils_error(VISTR("__swap_backbuffer failed to initialize new backbuffer"));
-            return surface->visible;
+    if (content) {
+        // the previous content may never have been presented, in that case the client
+        // has not been told it can reuse it yet
+        if (active->content) {
+            if (!atomic_load(&active->released)) {
+                __release_buffer(surface, active->content);
+            }
+            else {
+                vioarr_buffer_destroy(active->content);
+            }
         }
 
+        // the new content is uploaded once the surface is presented, the textures are kept
+        // until then so they can be reused. The client uses the age of the buffer to only redraw
+        // what changed, so the committed damage is also what differs from the previous content,
+        // and outputs that hold it in a texture of the same layout only upload the damage
+        active->content = content;
+        if (!vioarr_damage_is_zero(&surface->dirt)) {
+            __take_dirt(surface);
+        }
+        else {
+            vioarr_damage_zero(&active->damage);
+        }
+        __invalidate_content(surface);
         surface->visible = 1;
     }
     else {
+        __cleanup_surface_backbuffer(surface);
         surface->visible = 0;
     }
-    
-    // cleanup the old
-    if (ACTIVE_BACKBUFFER(surface).content) {
-#ifdef VIOARR_BACKEND_NANOVG
-        nvgDeleteImage(context, ACTIVE_BACKBUFFER(surface).resource_id);
-#endif
-        vioarr_buffer_destroy(ACTIVE_BACKBUFFER(surface).content);
-        ACTIVE_BACKBUFFER(surface).content = NULL;
-        ACTIVE_BACKBUFFER(surface).resource_id = -1;
-    }
+
+    // the damage has been taken over by the new content
+    vioarr_damage_zero(&surface->dirt);
 
     // notify the manager of this update
     if (!surface->parent && visible != surface->visible) {
         vioarr_manager_on_surface_visiblity_change(surface, surface->visible);
     }
-
-    surface->backbuffer_index ^= 1;
     return surface->visible;
 }
 
-static void __refresh_content(NVGcontext* context, vioarr_surface_t* surface)
+/**
+ * Damage on the active content means the client has written new data into the buffer
+ * it already submitted, so it must be uploaded again and released afterwards.
+ */
+static void __refresh_content(vioarr_surface_t* surface)
 {
-    if (!vioarr_region_is_zero(surface->dirt)) {
-        vioarr_buffer_t* buffer     = ACTIVE_BACKBUFFER(surface).content;
-        int              resourceId = ACTIVE_BACKBUFFER(surface).resource_id;
-        if (buffer) {
-#ifdef VIOARR_BACKEND_NANOVG
-            nvgUpdateImage(context, resourceId, (const uint8_t*)vioarr_buffer_data(buffer));
-#endif
-            wm_buffer_event_release_single(vioarr_get_server_handle(), surface->client, vioarr_buffer_id(buffer));
+    if (!vioarr_damage_is_zero(&surface->dirt)) {
+        if (ACTIVE_BACKBUFFER(surface).content) {
+            __take_dirt(surface);
+            __invalidate_content(surface);
         }
+        vioarr_damage_zero(&surface->dirt);
+    }
+}
+
+/**
+ * Converts the committed damage into the damage of the active content. The damage is given in
+ * surface coordinates of the unscaled buffer, outputs that hold the previous serial only upload
+ * the damaged buffer pixels.
+ */
+static void __take_dirt(vioarr_surface_t* surface)
+{
+    vioarr_surface_backbuffer_t* active = &ACTIVE_BACKBUFFER(surface);
+    int                          scale  = ACTIVE_PROPERTIES(surface).buffer_scale;
+    int                          i;
 
-        vioarr_region_zero(surface->dirt);
+    vioarr_damage_zero(&active->damage);
+    for (i = 0; i < surface->dirt.count; i++) {
+        vioarr_drawlist_rect_t* rect = &surface->dirt.rects[i];
+        vioarr_damage_add(&active->damage, rect->x * scale, rect->y * scale,
+            rect->width * scale, rect->height * scale);
+    }
+    vioarr_damage_clip(&active->damage, 0, 0,
+        vioarr_buffer_width(active->content), vioarr_buffer_height(active->content));
+
+    // damage entirely outside the buffer changes nothing, but is still treated as a new
+    // submission of the content so the buffer is released again
+    if (vioarr_damage_is_zero(&active->damage)) {
+        vioarr_damage_add(&active->damage, 0, 0, 1, 1);
     }
 }
 
-static void __swap_properties(vioarr_surface_t* surface)
+static void __swap_properties(vioarr_surface_t* surface, vioarr_surface_properties_t* source)
 {
+    int i;
+
     //vioarr_utils_trace(VISTR("[__swap_properties]"));
 
+    for (i = 0; i < VIOARR_MAX_OUTPUTS; i++) {
+        OUTPUT_TEXTURE(surface, i).changed = 1;
+        vioarr_damage_zero(&OUTPUT_TEXTURE(surface, i).damage);
+    }
+
+    if (__move_properties(&ACTIVE_PROPERTIES(surface), source)) {
+        vioarr_manager_on_hierarchy_change();
+    }
+}
+
+/**
+ * Copies the properties into the target and moves the children that were added into the children
+ * of the target. Returns whether or not any children were moved.
+ */
+static int __move_properties(vioarr_surface_properties_t* target, vioarr_surface_properties_t* source)
+{
     // handle basic properties
-    ACTIVE_PROPERTIES(surface).border_width  = PENDING_PROPERTIES(surface).border_width;
-    ACTIVE_PROPERTIES(surface).border_color  = PENDING_PROPERTIES(surface).border_color;
-    ACTIVE_PROPERTIES(surface).corner_radius = PENDING_PROPERTIES(surface).corner_radius;
-    vioarr_region_copy(ACTIVE_PROPERTIES(surface).drop_shadow,  PENDING_PROPERTIES(surface).drop_shadow);
-    vioarr_region_copy(ACTIVE_PROPERTIES(surface).input_region, PENDING_PROPERTIES(surface).input_region);
+    target->border_width       = source->border_width;
+    target->border_color       = source->border_color;
+    target->corner_radius      = source->corner_radius;
+    target->buffer_scale       = source->buffer_scale;
+    target->destination_width  = source->destination_width;
+    target->destination_height = source->destination_height;
+    target->backdrop_blur      = source->backdrop_blur;
+    vioarr_region_copy(target->source, source->source);
+    vioarr_region_copy(target->drop_shadow,  source->drop_shadow);
+    vioarr_region_copy(target->input_region, source->input_region);
     
-    if (PENDING_PROPERTIES(surface).children) {
-        // append the new children
-        if (ACTIVE_PROPERTIES(surface).children) {
-            vioarr_surface_t* itr = ACTIVE_PROPERTIES(surface).children;
-            while (itr->link) {
-                itr = itr->link;
-            }
-            itr->link = PENDING_PROPERTIES(surface).children;
-        }
-        else {
-            ACTIVE_PROPERTIES(surface).children = PENDING_PROPERTIES(surface).children;
+    if (!source->children) {
+        return 0;
+    }
+
+    // append the new children
+    if (target->children) {
+        vioarr_surface_t* itr = target->children;
+        while (itr->link) {
+            itr = itr->link;
         }
-        PENDING_PROPERTIES(surface).children = NULL;
+        itr->link = source->children;
+    }
+    else {
+        target->children = source->children;
     }
+    source->children = NULL;
+    return 1;
 }
 
-static void __render_content(vcontext_t* context, vioarr_surface_t* surface)
+/**
+ * Calculates the size the content is presented at and the part of the buffer that is sampled
+ * for it, in buffer pixels. Returns whether or not the buffer is sampled 1:1.
+ */
+static int __get_viewport(vioarr_surface_t* surface, float* dstOut, float* srcOut)
 {
-    float    width        = (float)vioarr_region_width(surface->dimensions);
-    float    height       = (float)vioarr_region_height(surface->dimensions);
+    vioarr_surface_properties_t* properties = &ACTIVE_PROPERTIES(surface);
+    vioarr_buffer_t*             content    = ACTIVE_BACKBUFFER(surface).content;
+    int                          scale      = properties->buffer_scale;
+
+    dstOut[0] = (float)(properties->destination_width ? 
+        properties->destination_width : vioarr_region_width(surface->dimensions));
+    dstOut[1] = (float)(properties->destination_height ?
+        properties->destination_height : vioarr_region_height(surface->dimensions));
+
+    if (!vioarr_region_is_zero(properties->source)) {
+        srcOut[0] = (float)(vioarr_region_x(properties->source) * scale);
+        srcOut[1] = (float)(vioarr_region_y(properties->source) * scale);
+        srcOut[2] = (float)(vioarr_region_width(properties->source) * scale);
+        srcOut[3] = (float)(vioarr_region_height(properties->source) * scale);
+    }
+    else {
+        srcOut[0] = 0.0f;
+        srcOut[1] = 0.0f;
+        srcOut[2] = (float)vioarr_buffer_width(content);
+        srcOut[3] = (float)vioarr_buffer_height(content);
+    }
+    return dstOut[0] == srcOut[2] && dstOut[1] == srcOut[3];
+}
+
+static void __render_content(vcontext_t* context, vioarr_surface_t* surface, int output)
+{
+    vioarr_buffer_t* content = ACTIVE_BACKBUFFER(surface).content;
+    float            destination[2];
+    float            source[4];
+    float            scaleX, scaleY;
+
+    __get_viewport(surface, &destination[0], &source[0]);
+    if (source[2] <= 0.0f || source[3] <= 0.0f) {
+        return;
+    }
+
+    // map the source rectangle of the buffer onto the destination, the pattern spans the
+    // entire buffer so the origin is offset by the scaled source position
+    scaleX = destination[0] / source[2];
+    scaleY = destination[1] / source[3];
 #ifdef VIOARR_BACKEND_NANOVG
-    NVGpaint stream_paint = nvgImagePattern(context, 0.0f, 0.0f, width, height, 0.0f, 
-        ACTIVE_BACKBUFFER(surface).resource_id, 1.0f);
+    // the texture was evicted and is waiting for the client to submit the content again
+    if (!OUTPUT_TEXTURE(surface, output).size) {
+        return;
+    }
+
+    NVGpaint stream_paint = nvgImagePattern(context, 
+        -source[0] * scaleX, -source[1] * scaleY,
+        (float)vioarr_buffer_width(content) * scaleX, (float)vioarr_buffer_height(content) * scaleY,
+        0.0f, OUTPUT_TEXTURE(surface, output).resource_id, 1.0f);
     nvgBeginPath(context);
-    nvgRect(context, 0.0f, 0.0f, width, height);
+    nvgRect(context, 0.0f, 0.0f, destination[0], destination[1]);
     nvgFillPaint(context, stream_paint);
     nvgFill(context);
 #endif
 }
 
-static void __render_drop_shadow(vcontext_t* context, vioarr_surface_t* surface)
+static void __render_drop_shadow(vcontext_t* context, vioarr_surface_t* surface, int output)
 {
     float    width        = (float)vioarr_region_width(surface->dimensions);
     float    height       = (float)vioarr_region_height(surface->dimensions);
 #ifdef VIOARR_BACKEND_NANOVG
+    vioarr_region_t* shadow = ACTIVE_PROPERTIES(surface).drop_shadow;
+
+    // the feathered shadow covers the entire margin, which is a lot of fill for a software
+    // renderer. The flat one only extends a few pixels, and stays within the margins.
+    if (vioarr_governor_level(output) >= VIOARR_GOVERNOR_FLAT_SHADOWS) {
+        float x1 = (float)vioarr_region_x(shadow);
+        float y1 = (float)vioarr_region_y(shadow);
+        float x2 = width + x1 + (float)vioarr_region_width(shadow);
+        float y2 = height + y1 + (float)vioarr_region_height(shadow);
+
+        x1 = x1 < -1.0f ? -1.0f : x1;
+        y1 = y1 < 0.0f ? 0.0f : y1;
+        x2 = x2 > width + 1.0f ? width + 1.0f : x2;
+        y2 = y2 > height + 2.0f ? height + 2.0f : y2;
+        if (x2 > x1 && y2 > y1) {
+            nvgBeginPath(context);
+            nvgRoundedRect(context, x1, y1, x2 - x1, y2 - y1, ACTIVE_PROPERTIES(surface).corner_radius);
+            nvgFillColor(context, nvgRGBA(0, 0, 0, 64));
+            nvgFill(context);
+        }
+        return;
+    }
+
 	NVGpaint shadow_paint = nvgBoxGradient(context, 0, 0 + 2.0f, width, height, 
 	    ACTIVE_PROPERTIES(surface).corner_radius * 2, 10, nvgRGBA(0, 0, 0, 128), nvgRGBA(0, 0, 0, 0));
 	nvgBeginPath(context);
@@ -852,28 +1902,238 @@ static void __render_drop_shadow(vcontext_t* context, vioarr_surface_t* surface)
 
 static int __initialize_surface_properties(vioarr_surface_properties_t* properties)
 {
+    properties->buffer_scale = 1;
+    properties->source       = vioarr_region_create();
     properties->drop_shadow  = vioarr_region_create();
     properties->input_region = vioarr_region_create();
-    if (!properties->drop_shadow || !properties->input_region)
+    if (!properties->source || !properties->drop_shadow || !properties->input_region)
         return -1;
     return 0;
 }
 
 static void __cleanup_surface_properties(vioarr_surface_properties_t* properties)
 {
+    if (properties->source) {
+        vioarr_region_destroy(properties->source);
+    }
+
     if (properties->input_region) {
-        free(properties->input_region);
+        vioarr_region_destroy(properties->input_region);
     }
 
     if (properties->drop_shadow) {
-        free(properties->drop_shadow);
+        vioarr_region_destroy(properties->drop_shadow);
     }
 }
 
-static void __cleanup_surface_backbuffer(vcontext_t* context, vioarr_surface_backbuffer_t* backbuffer)
+/**
+ * Releases the content of the surface, the textures are released by their outputs
+ * when they notice the surface has no content.
+ */
+static void __cleanup_surface_backbuffer(vioarr_surface_t* surface)
 {
+    vioarr_surface_backbuffer_t* backbuffer = &ACTIVE_BACKBUFFER(surface);
+
     if (backbuffer->content) {
-        nvgDeleteImage(context, backbuffer->resource_id);
-        vioarr_buffer_destroy(backbuffer->content);
+        if (!atomic_load(&backbuffer->released)) {
+            __release_buffer(surface, backbuffer->content);
+        }
+        else {
+            vioarr_buffer_destroy(backbuffer->content);
+        }
+        backbuffer->content = NULL;
     }
+    backbuffer->serial++;
+    atomic_store(&backbuffer->pending_uploads, 0);
+    atomic_store(&backbuffer->uploaded, 0);
+    atomic_store(&backbuffer->released, 0);
+}
+
+/**
+ * Returns the serial of the configure that must be sent, or 0 if the size was queued behind the
+ * configure in flight. Must be called with the surface lock held for writing.
+ */
+static unsigned int __request_configure(vioarr_surface_t* surface, int width, int height,
+    enum wm_surface_edge edges, int apply, vioarr_surface_size_t* sizeOut)
+{
+    vioarr_surface_configure_t* configure = &surface->configure;
+    vioarr_surface_size_t       size      = { width, height, edges, apply };
+
+    // clients that do not acknowledge configures are resized immediately
+    if (!configure->handshake) {
+        if (apply) {
+            vioarr_region_set_size(__get_correct_region(surface), width, height);
+        }
+        configure->sent = size;
+        *sizeOut = size;
+        return ++configure->serial;
+    }
+
+    if (configure->in_flight) {
+        configure->next   = size;
+        configure->queued = 1;
+        return 0;
+    }
+
+    configure->sent      = size;
+    configure->in_flight = 1;
+    *sizeOut = size;
+    return ++configure->serial;
+}
+
+/**
+ * Applies the configure in flight if the client acknowledged it before this commit, and returns
+ * the serial of the next configure to send, if any was queued in the meantime. Must be called
+ * with the surface lock held for writing.
+ */
+static unsigned int __complete_configure(vioarr_surface_t* surface, vioarr_surface_size_t* sizeOut)
+{
+    vioarr_surface_configure_t* configure = &surface->configure;
+
+    if (!configure->in_flight || configure->acked != configure->serial) {
+        return 0;
+    }
+
+    if (configure->sent.apply) {
+        vioarr_region_set_size(__get_correct_region(surface),
+            configure->sent.width, configure->sent.height);
+    }
+    configure->in_flight = 0;
+
+    if (!configure->queued) {
+        return 0;
+    }
+
+    configure->queued = 0;
+    if (configure->next.width == configure->sent.width &&
+        configure->next.height == configure->sent.height) {
+        return 0;
+    }
+
+    configure->sent      = configure->next;
+    configure->in_flight = 1;
+    *sizeOut = configure->sent;
+    return ++configure->serial;
+}
+
+static void __send_configure(vioarr_surface_t* surface, unsigned int serial, vioarr_surface_size_t* size)
+{
+    if (!serial) {
+        return;
+    }
+
+    wm_surface_event_configure_single(vioarr_get_server_handle(), surface->client, surface->id,
+        serial, size->width, size->height, size->edges);
+}
+
+// must be called with the write lock held, the reference of the buffer is acquired by the caller
+static void __attach_buffer(vioarr_surface_t* surface, vioarr_buffer_t* content)
+{
+    if (!__is_deferred(surface)) {
+        __queue_buffer(surface, content);
+        return;
+    }
+    __hold_buffer(surface, content);
+}
+
+// must be called with the write lock held, holds the buffer back until the surface commits
+static void __hold_buffer(vioarr_surface_t* surface, vioarr_buffer_t* content)
+{
+    // only the last buffer set before the commit is cached, the ones before it are never presented
+    if (surface->sync.has_buffer) {
+        __release_buffer(surface, surface->sync.buffer);
+    }
+    surface->sync.buffer     = content;
+    surface->sync.has_buffer = 1;
+}
+
+/**
+ * Applies the buffer and damage that were held back but not committed, once the surface no longer
+ * waits for a commit. Must be called with the write lock held.
+ */
+static void __flush_held(vioarr_surface_t* surface)
+{
+    if (surface->sync.has_buffer) {
+        __queue_buffer(surface, surface->sync.buffer);
+        surface->sync.buffer     = NULL;
+        surface->sync.has_buffer = 0;
+    }
+    vioarr_damage_merge(&surface->dirt, &surface->sync.dirt);
+    vioarr_damage_zero(&surface->sync.dirt);
+}
+
+/**
+ * Caches the commit of a synchronized subsurface until the parent commits, commits that are made
+ * before the parent commits are merged into one. Must be called with the write lock held.
+ */
+static void __cache_commit(vioarr_surface_t* surface)
+{
+    vioarr_surface_sync_t* sync = &surface->sync;
+
+    __move_properties(&CACHED_PROPERTIES(surface), &PENDING_PROPERTIES(surface));
+    if (sync->has_buffer) {
+        if (sync->cached_has_buffer) {
+            __release_buffer(surface, sync->cached_buffer);
+        }
+        sync->cached_buffer     = sync->buffer;
+        sync->cached_has_buffer = 1;
+        sync->buffer            = NULL;
+        sync->has_buffer        = 0;
+    }
+    vioarr_damage_merge(&sync->cached_dirt, &sync->dirt);
+    vioarr_damage_zero(&sync->dirt);
+    sync->cached = 1;
+}
+
+/**
+ * Applies the cached commit of a synchronized subsurface. Returns the serial of the configure
+ * to send like __complete_configure. Must be called with the write lock held.
+ */
+static unsigned int __apply_cached_commit(vioarr_surface_t* surface, vioarr_surface_size_t* sizeOut)
+{
+    vioarr_surface_sync_t* sync = &surface->sync;
+
+    if (!sync->cached) {
+        return 0;
+    }
+
+    __swap_properties(surface, &CACHED_PROPERTIES(surface));
+    if (sync->cached_has_buffer) {
+        __queue_buffer(surface, sync->cached_buffer);
+        sync->cached_buffer     = NULL;
+        sync->cached_has_buffer = 0;
+    }
+    vioarr_damage_merge(&surface->dirt, &sync->cached_dirt);
+    vioarr_damage_zero(&sync->cached_dirt);
+    sync->cached = 0;
+
+    atomic_fetch_add(&surface->commits, 1);
+    return __complete_configure(surface, sizeOut);
+}
+
+/**
+ * Applies the cached commits of all synchronized children in the tree below the surface, which
+ * is done when the surface itself commits. Children that are not synchronized apply their own
+ * commits, and so do the synchronized children below them.
+ */
+static void __commit_children(vioarr_surface_t* surface)
+{
+    vioarr_surface_size_t size;
+    vioarr_surface_t*     child;
+    unsigned int          serial;
+
+    vioarr_rwlock_r_lock(&surface->lock);
+    child = ACTIVE_PROPERTIES(surface).children;
+    while (child) {
+        if (child->sync.enabled) {
+            vioarr_rwlock_w_lock(&child->lock);
+            serial = __apply_cached_commit(child, &size);
+            vioarr_rwlock_w_unlock(&child->lock);
+            
+            __send_configure(child, serial, &size);
+            __commit_children(child);
+        }
+        child = child->link;
+    }
+    vioarr_rwlock_r_unlock(&surface->lock);
 }
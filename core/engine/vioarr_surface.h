@@ -26,46 +26,72 @@
 #define __VIOARR_SURFACE_H__
 
 #include "backend/backend.h"
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct vioarr_surface vioarr_surface_t;
 typedef struct vioarr_screen  vioarr_screen_t;
 typedef struct vioarr_buffer  vioarr_buffer_t;
 typedef struct vioarr_region  vioarr_region_t;
+typedef struct vioarr_damage  vioarr_damage_t;
 enum wm_surface_edge;
+struct wm_rect;
 
 int               vioarr_surface_create(int, uint32_t, vioarr_screen_t*, int, int, int, int, vioarr_surface_t**);
 void              vioarr_surface_destroy(vioarr_surface_t*);
-void              vioarr_surface_free(vcontext_t*, vioarr_surface_t*);
+void              vioarr_surface_free(vcontext_t*, int output, vioarr_surface_t*);
 void              vioarr_surface_set_buffer(vioarr_surface_t*, vioarr_buffer_t*);
+void              vioarr_surface_apply(vioarr_surface_t*, vioarr_buffer_t*, vioarr_damage_t* damage,
+                                       const struct wm_rect* dropShadow, const struct wm_rect* inputRegion, unsigned int flags);
 void              vioarr_surface_set_drop_shadow(vioarr_surface_t*, int x, int y, int width, int height);
+int               vioarr_surface_set_backdrop_blur(vioarr_surface_t*, int radius);
+int               vioarr_surface_set_buffer_scale(vioarr_surface_t*, int scale);
+int               vioarr_surface_set_viewport(vioarr_surface_t*, int srcX, int srcY, int srcWidth, int srcHeight, int dstWidth, int dstHeight);
 void              vioarr_surface_set_input_region(vioarr_surface_t*, int x, int y, int width, int height);
 void              vioarr_surface_set_level(vioarr_surface_t*, int);
 void              vioarr_surface_maximize(vioarr_surface_t*);
 void              vioarr_surface_restore_size(vioarr_surface_t*);
 void              vioarr_surface_resize(vioarr_surface_t*, int width, int height, enum wm_surface_edge);
+void              vioarr_surface_ack_configure(vioarr_surface_t*, unsigned int serial);
+void              vioarr_surface_configured_size(vioarr_surface_t*, int* widthOut, int* heightOut);
 void              vioarr_surface_request_frame(vioarr_surface_t*);
 int               vioarr_surface_supports_input(vioarr_surface_t*, int x, int y);
-vioarr_surface_t* vioarr_surface_at(vioarr_surface_t* surface, int x, int y, int* localX, int* localY);
 vioarr_surface_t* vioarr_surface_parent(vioarr_surface_t* surface, int upperMost);
 int               vioarr_surface_contains(vioarr_surface_t*, int x, int y);
 void              vioarr_surface_invalidate(vioarr_surface_t*, int x, int y, int width, int height);
+void              vioarr_surface_invalidate_rects(vioarr_surface_t*, const struct wm_rect* rects, int count);
 void              vioarr_surface_move(vioarr_surface_t*, int, int);
 void              vioarr_surface_move_absolute(vioarr_surface_t*, int, int);
 void              vioarr_surface_set_size(vioarr_surface_t*, vioarr_region_t*);
 void              vioarr_surface_commit(vioarr_surface_t*);
+void              vioarr_surface_apply_staged(vioarr_surface_t*);
+void              vioarr_surface_set_sync(vioarr_surface_t*, int enabled);
 void              vioarr_surface_focus(vioarr_surface_t*, int focus);
 uint32_t          vioarr_surface_id(vioarr_surface_t*);
 int               vioarr_surface_client(vioarr_surface_t*);
+unsigned int      vioarr_surface_commits(vioarr_surface_t*);
 vioarr_screen_t*  vioarr_surface_screen(vioarr_surface_t*);
 vioarr_region_t*  vioarr_surface_region(vioarr_surface_t*);
 int               vioarr_surface_maximized(vioarr_surface_t*);
 int               vioarr_surface_level(vioarr_surface_t*);
 int               vioarr_surface_visible(vioarr_surface_t*);
+size_t            vioarr_surface_texture_size(vioarr_surface_t*, int output);
+int               vioarr_surface_opaque(vioarr_surface_t*);
+void              vioarr_surface_margins(vioarr_surface_t*, int marginsOut[4]);
+int               vioarr_surface_backdrop_blur(vioarr_surface_t*);
+unsigned int      vioarr_surface_last_presented(vioarr_surface_t*, int output);
 
 int  vioarr_surface_add_child(vioarr_surface_t*, vioarr_surface_t*, int, int);
 void vioarr_surface_set_position(vioarr_surface_t*, int, int);
+void vioarr_surface_enumerate_children(vioarr_surface_t*, void (*)(vioarr_surface_t*, void*), void*);
 
-void vioarr_surface_render(vcontext_t*, vioarr_surface_t*);
+int    vioarr_surface_update(vcontext_t*, int output, vioarr_surface_t*);
+int    vioarr_surface_prepare(vcontext_t*, int output, vioarr_surface_t*);
+int    vioarr_surface_damage(vioarr_surface_t*, int output, vioarr_damage_t* damageOut);
+void   vioarr_surface_render(vcontext_t*, int output, vioarr_surface_t*, int x, int y);
+int    vioarr_surface_read_pixels(vioarr_surface_t*, int output, int force, uint32_t* pixels,
+                                  int maxWidth, int maxHeight, int* widthOut, int* heightOut);
+size_t vioarr_surface_evict(vcontext_t*, int output, vioarr_surface_t*);
+void   vioarr_surface_hide(vioarr_surface_t*, int output);
 
 #endif //!__VIOARR_SURFACE_H__
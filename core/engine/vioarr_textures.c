@@ -0,0 +1,246 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#include "vioarr_textures.h"
+#include "vioarr_utils.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct vioarr_textures {
+    mtx_t                           lock;
+    size_t                          budget;
+    size_t                          usage;
+    size_t                          peak;
+    size_t                          evictions;
+    vioarr_textures_client_usage_t* clients;
+    int                             client_count;
+    int                             client_capacity;
+    atomic_uint                     frames[VIOARR_MAX_OUTPUTS];
+} vioarr_textures_t;
+
+static vioarr_textures_t g_textures;
+
+// must be called with the lock held
+static vioarr_textures_client_usage_t* __get_client(int client, int create)
+{
+    int i;
+
+    for (i = 0; i < g_textures.client_count; i++) {
+        if (g_textures.clients[i].client == client) {
+            return &g_textures.clients[i];
+        }
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    if (g_textures.client_count == g_textures.client_capacity) {
+        int                             capacity = g_textures.client_capacity ? (g_textures.client_capacity * 2) : 16;
+        vioarr_textures_client_usage_t* clients  = realloc(g_textures.clients,
+            sizeof(vioarr_textures_client_usage_t) * capacity);
+        if (!clients) {
+            return NULL;
+        }
+        g_textures.clients         = clients;
+        g_textures.client_capacity = capacity;
+    }
+
+    g_textures.clients[g_textures.client_count].client   = client;
+    g_textures.clients[g_textures.client_count].bytes    = 0;
+    g_textures.clients[g_textures.client_count].textures = 0;
+    return &g_textures.clients[g_textures.client_count++];
+}
+
+void vioarr_textures_initialize(void)
+{
+    const char* budget = getenv("VIOARR_TEXTURE_BUDGET");
+
+    mtx_init(&g_textures.lock, mtx_plain);
+    g_textures.budget          = VIOARR_TEXTURE_BUDGET_DEFAULT;
+    g_textures.usage           = 0;
+    g_textures.peak            = 0;
+    g_textures.evictions       = 0;
+    g_textures.clients         = NULL;
+    g_textures.client_count    = 0;
+    g_textures.client_capacity = 0;
+    for (int i = 0; i < VIOARR_MAX_OUTPUTS; i++) {
+        atomic_init(&g_textures.frames[i], 0);
+    }
+
+    if (budget && atoi(budget) > 0) {
+        g_textures.budget = (size_t)atoi(budget) * 1024 * 1024;
+    }
+    vioarr_utils_trace(VISTR("[vioarr_textures_initialize] texture budget is %zu bytes"), g_textures.budget);
+}
+
+void vioarr_textures_set_budget(size_t bytes)
+{
+    mtx_lock(&g_textures.lock);
+    g_textures.budget = bytes;
+    mtx_unlock(&g_textures.lock);
+}
+
+size_t vioarr_textures_budget(void)
+{
+    size_t budget;
+
+    mtx_lock(&g_textures.lock);
+    budget = g_textures.budget;
+    mtx_unlock(&g_textures.lock);
+    return budget;
+}
+
+size_t vioarr_textures_usage(void)
+{
+    size_t usage;
+
+    mtx_lock(&g_textures.lock);
+    usage = g_textures.usage;
+    mtx_unlock(&g_textures.lock);
+    return usage;
+}
+
+int vioarr_textures_over_budget(void)
+{
+    int overBudget;
+
+    mtx_lock(&g_textures.lock);
+    overBudget = g_textures.budget && g_textures.usage > g_textures.budget;
+    mtx_unlock(&g_textures.lock);
+    return overBudget;
+}
+
+size_t vioarr_textures_client_usage(int client, int* texturesOut)
+{
+    vioarr_textures_client_usage_t* usage;
+    size_t                          bytes    = 0;
+    int                             textures = 0;
+
+    mtx_lock(&g_textures.lock);
+    usage = __get_client(client, 0);
+    if (usage) {
+        bytes    = usage->bytes;
+        textures = usage->textures;
+    }
+    mtx_unlock(&g_textures.lock);
+
+    if (texturesOut) {
+        *texturesOut = textures;
+    }
+    return bytes;
+}
+
+/**
+ * Fills in the texture usage of every client currently holding textures. Returns
+ * the number of clients, which can be larger than maxCount.
+ */
+int vioarr_textures_get_usage(vioarr_textures_client_usage_t* usageOut, int maxCount)
+{
+    int count;
+
+    mtx_lock(&g_textures.lock);
+    count = g_textures.client_count;
+    if (usageOut && maxCount > 0) {
+        memcpy(usageOut, g_textures.clients,
+            sizeof(vioarr_textures_client_usage_t) * (count < maxCount ? count : maxCount));
+    }
+    mtx_unlock(&g_textures.lock);
+    return count;
+}
+
+void vioarr_textures_trace_usage(void)
+{
+    int i;
+
+    mtx_lock(&g_textures.lock);
+    vioarr_utils_trace(VISTR("[vioarr_textures] usage=%zu, peak=%zu, budget=%zu, evictions=%zu"),
+        g_textures.usage, g_textures.peak, g_textures.budget, g_textures.evictions);
+    for (i = 0; i < g_textures.client_count; i++) {
+        vioarr_utils_trace(VISTR("[vioarr_textures] client %i: %zu bytes in %i textures"),
+            g_textures.clients[i].client, g_textures.clients[i].bytes, g_textures.clients[i].textures);
+    }
+    mtx_unlock(&g_textures.lock);
+}
+
+void vioarr_textures_on_allocated(int client, size_t bytes)
+{
+    vioarr_textures_client_usage_t* usage;
+
+    mtx_lock(&g_textures.lock);
+    g_textures.usage += bytes;
+    if (g_textures.usage > g_textures.peak) {
+        g_textures.peak = g_textures.usage;
+    }
+
+    usage = __get_client(client, 1);
+    if (usage) {
+        usage->bytes += bytes;
+        usage->textures++;
+    }
+    mtx_unlock(&g_textures.lock);
+}
+
+void vioarr_textures_on_freed(int client, size_t bytes)
+{
+    vioarr_textures_client_usage_t* usage;
+
+    mtx_lock(&g_textures.lock);
+    g_textures.usage -= bytes;
+
+    usage = __get_client(client, 0);
+    if (usage) {
+        usage->bytes -= bytes;
+        usage->textures--;
+
+        // drop clients that no longer hold any textures
+        if (!usage->textures) {
+            *usage = g_textures.clients[--g_textures.client_count];
+        }
+    }
+    mtx_unlock(&g_textures.lock);
+}
+
+void vioarr_textures_on_evicted(void)
+{
+    mtx_lock(&g_textures.lock);
+    g_textures.evictions++;
+    mtx_unlock(&g_textures.lock);
+}
+
+/**
+ * Each output presents at its own rate, so the age of textures is counted in frames
+ * of the output they are presented on.
+ */
+unsigned int vioarr_textures_next_frame(int output)
+{
+    return atomic_fetch_add(&g_textures.frames[output], 1) + 1;
+}
+
+unsigned int vioarr_textures_frame(int output)
+{
+    return atomic_load(&g_textures.frames[output]);
+}
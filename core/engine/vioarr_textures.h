@@ -0,0 +1,65 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#ifndef __VIOARR_TEXTURES_H__
+#define __VIOARR_TEXTURES_H__
+
+#include <stddef.h>
+#include "vioarr_engine.h"
+
+/**
+ * Default texture memory budget, can be overridden at startup with the
+ * VIOARR_TEXTURE_BUDGET environment variable (in megabytes) or at runtime
+ * through vioarr_textures_set_budget.
+ */
+#define VIOARR_TEXTURE_BUDGET_DEFAULT (128 * 1024 * 1024)
+
+/**
+ * The number of frames a surface must have been unseen on an output before its
+ * texture for that output can be evicted to get back under the budget.
+ */
+#define VIOARR_TEXTURE_EVICT_AGE 120
+
+typedef struct vioarr_textures_client_usage {
+    int    client;
+    size_t bytes;
+    int    textures;
+} vioarr_textures_client_usage_t;
+
+void         vioarr_textures_initialize(void);
+void         vioarr_textures_set_budget(size_t bytes);
+size_t       vioarr_textures_budget(void);
+size_t       vioarr_textures_usage(void);
+int          vioarr_textures_over_budget(void);
+size_t       vioarr_textures_client_usage(int client, int* texturesOut);
+int          vioarr_textures_get_usage(vioarr_textures_client_usage_t* usageOut, int maxCount);
+void         vioarr_textures_trace_usage(void);
+void         vioarr_textures_on_allocated(int client, size_t bytes);
+void         vioarr_textures_on_freed(int client, size_t bytes);
+void         vioarr_textures_on_evicted(void);
+unsigned int vioarr_textures_next_frame(int output);
+unsigned int vioarr_textures_frame(int output);
+
+#endif //!__VIOARR_TEXTURES_H__
@@ -23,3 +23,15 @@
  */
 
 #include "vioarr_utils.h"
+#include <time.h>
+
+uint64_t vioarr_utils_time_us(void)
+{
+#if defined(MOLLENOS)
+    return (uint64_t)clock() * 1000000 / CLOCKS_PER_SEC;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)(ts.tv_nsec / 1000);
+#endif
+}
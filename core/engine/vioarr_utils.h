@@ -99,7 +99,7 @@ static void vioarr_rwlock_r_unlock(vioarr_rwlock_t* lock)
 static void vioarr_rwlock_w_lock(vioarr_rwlock_t* lock)
 {
     mtx_lock(&lock->sync_object);
-    if (lock->readers) {
+    while (lock->readers) {
         cnd_wait(&lock->signal, &lock->sync_object);
     }
 }
@@ -111,6 +111,9 @@ static void vioarr_rwlock_w_unlock(vioarr_rwlock_t* lock)
 }
 
 
+// monotonic time in microseconds, only useful for measuring intervals
+uint64_t vioarr_utils_time_us(void);
+
 #include <gracht/server.h>
 extern gracht_server_t* vioarr_get_server_handle(void);
 
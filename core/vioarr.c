@@ -51,7 +51,12 @@ static uint16_t    g_portNo    = 55555;
 #include <sys/epoll.h>
 #include <sys/un.h>
 #include <sys/socket.h>
+#include <unistd.h>
 static const char* g_serverPath = "/tmp/vi-srv";
+#ifdef VIOARR_RING_LINK
+#include <vioarr/link_ring.h>
+static const char* g_ringPath = "/tmp/vi-ring";
+#endif
 #endif
 
 #include "wm_core_service_server.h"
@@ -62,9 +67,14 @@ static const char* g_serverPath = "/tmp/vi-srv";
 #include "wm_surface_service_server.h"
 #include "wm_pointer_service_server.h"
 #include "wm_keyboard_service_server.h"
+#include "wm_capture_service_server.h"
 
+#include "engine/vioarr_cork.h"
+#include "engine/vioarr_dispatch.h"
 #include "engine/vioarr_engine.h"
 #include "engine/vioarr_objects.h"
+#include "engine/vioarr_peer.h"
+#include "engine/vioarr_quota.h"
 #include "engine/vioarr_utils.h"
 
 static gracht_server_t* g_valiServer = NULL;
@@ -77,6 +87,11 @@ gracht_server_t* vioarr_get_server_handle(void)
 static void __gracht_handle_disconnect(int client)
 {
     vioarr_objects_remove_by_client(client);
+    vioarr_quota_remove_client(client);
+    vioarr_peer_remove(client);
+#if !defined(MOLLENOS) && !defined(_WIN32)
+    vioarr_dispatch_disconnect(client);
+#endif
 }
 
 #ifdef MOLLENOS
@@ -138,6 +153,31 @@ static int __create_platform_link(void)
     gracht_link_socket_set_domain(link, AF_LOCAL);
     gracht_link_socket_set_listen(link, 1);
 
+    // events are written to the socket in batches at the end of each frame or dispatch cycle
+    vioarr_cork_wrap((struct gracht_link*)link);
+
+    // messages are counted against the rate each client is allowed
+    vioarr_quota_wrap((struct gracht_link*)link);
+
+    // the process of each client is what privileged requests and memory handoffs are checked against
+    vioarr_peer_wrap((struct gracht_link*)link, vioarr_peer_socket_pid);
+
+#ifdef VIOARR_RING_LINK
+    // clients that support it exchange messages through shared memory, the socket link
+    // is kept for everyone else
+    struct link_ring* ringLink;
+    if (link_ring_create(&ringLink)) {
+        return -1;
+    }
+
+    link_ring_set_address(ringLink, g_ringPath);
+    link_ring_set_listen(ringLink, 1);
+    vioarr_quota_wrap((struct gracht_link*)ringLink);
+    vioarr_peer_wrap((struct gracht_link*)ringLink, link_ring_client_pid);
+    if (gracht_server_add_link(g_valiServer, (struct gracht_link*)ringLink)) {
+        return -1;
+    }
+#endif
     return gracht_server_add_link(g_valiServer, (struct gracht_link*)link);
 }
 #endif
@@ -255,6 +295,7 @@ int server_run(int eventIod)
     // Server main loop
     while (serverRunning) {
         int num_events = ioset_wait(eventIod, &events[0], 32, 0);
+        vioarr_cork_begin();
         for (int i = 0; i < num_events; i++) {
             if (events[i].data.iod == clientIod) {
                 gracht_client_wait_message(g_valiClient, NULL, 0);
@@ -263,6 +304,7 @@ int server_run(int eventIod)
                 gracht_server_handle_event(g_valiServer, events[i].data.iod, events[i].events);
             }
         }
+        vioarr_cork_end();
     }
     return 0;
 }
@@ -306,6 +348,7 @@ int main(int argc, char **argv)
     gracht_server_register_protocol(g_valiServer, &wm_surface_server_protocol);
     gracht_server_register_protocol(g_valiServer, &wm_pointer_server_protocol);
     gracht_server_register_protocol(g_valiServer, &wm_keyboard_server_protocol);
+    gracht_server_register_protocol(g_valiServer, &wm_capture_server_protocol);
 
     return server_run(eventIod);
 }
@@ -372,12 +415,13 @@ int main(int argc, char **argv)
     gracht_server_register_protocol(g_valiServer, &wm_surface_server_protocol);
     gracht_server_register_protocol(g_valiServer, &wm_pointer_server_protocol);
     gracht_server_register_protocol(g_valiServer, &wm_keyboard_server_protocol);
+    gracht_server_register_protocol(g_valiServer, &wm_capture_server_protocol);
 
     return server_run(eventIod);
 }
 #else
 
-int server_initialize(void)
+int server_initialize(int* eventIodOut)
 {
     struct gracht_server_configuration config;
     int                                status;
@@ -406,15 +450,48 @@ int server_initialize(void)
         vioarr_utils_error(VISTR("error initializing server link %i\n"), errno);
         close(config.set_descriptor);
     }
+
+    *eventIodOut = config.set_descriptor;
     return status;
 }
 
+static void __handle_event(int iod, unsigned int events)
+{
+    gracht_server_handle_event(g_valiServer, iod, events);
+}
+
+int server_run(int eventIod)
+{
+    struct epoll_event events[32];
+
+    // the requests of each client are handled by the workers, this thread only waits for
+    // events and accepts new clients
+    if (vioarr_dispatch_initialize(eventIod, __handle_event)) {
+        return -1;
+    }
+
+    while (1) {
+        int num_events = epoll_wait(eventIod, &events[0], 32, -1);
+        if (num_events < 0 && errno != EINTR) {
+            vioarr_utils_error(VISTR("error waiting for events %i\n"), errno);
+            return -1;
+        }
+
+        for (int i = 0; i < num_events; i++) {
+            vioarr_dispatch_event(events[i].data.fd, events[i].events);
+        }
+    }
+    return 0;
+}
+
 /*******************************************
  * Entry Point
  *******************************************/
 int main(int argc, char **argv)
 {
-    int status = server_initialize();
+    int eventIod;
+
+    int status = server_initialize(&eventIod);
     if (status) {
         return status;
     }
@@ -437,6 +514,7 @@ int main(int argc, char **argv)
     gracht_server_register_protocol(g_valiServer, &wm_surface_server_protocol);
     gracht_server_register_protocol(g_valiServer, &wm_pointer_server_protocol);
     gracht_server_register_protocol(g_valiServer, &wm_keyboard_server_protocol);
+    gracht_server_register_protocol(g_valiServer, &wm_capture_server_protocol);
 
 #ifdef VIOARR_LAUNCHER
     pid_t childPid = fork();
@@ -445,9 +523,14 @@ int main(int argc, char **argv)
         int   resultCode = execv(VIOARR_LAUNCHER, argv);
         exit(resultCode);
     }
+
+    // the launcher is the shell, which may capture surfaces of other clients
+    if (childPid > 0) {
+        vioarr_peer_set_shell((int)childPid);
+    }
 #endif //VIOARR_LAUNCHER
 
-    return gracht_server_main_loop(g_valiServer);
+    return server_run(eventIod);
 }
 
 #endif
@@ -0,0 +1,152 @@
+/* MollenOS
+ *
+ * Copyright 2020, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Vioarr - Vali Compositor
+ * - Implements the default system compositor for Vali. It utilizies the gracht library
+ *   for communication between compositor clients and the server. The server renders
+ *   using Mesa3D with either the soft-renderer or llvmpipe render for improved performance.
+ */
+
+
+#include "wm_core_service_server.h"
+#include "wm_capture_service_server.h"
+#include "engine/vioarr_buffer.h"
+#include "engine/vioarr_capture.h"
+#include "engine/vioarr_objects.h"
+#include "engine/vioarr_peer.h"
+#include "engine/vioarr_quota.h"
+#include "engine/vioarr_screen.h"
+#include "engine/vioarr_surface.h"
+#include "engine/vioarr_utils.h"
+#include <errno.h>
+
+void wm_capture_create_invocation(struct gracht_message* message, const uint32_t screenId, const uint32_t captureId, const int interval)
+{
+    vioarr_utils_trace(VISTR("[wm_capture_create_invocation] client %i, screen %u, capture %u"), message->client, screenId, captureId);
+    vioarr_screen_t*  screen = vioarr_objects_get_object(-1, screenId);
+    vioarr_capture_t* capture;
+    uint32_t          globalId;
+    if (!screen) {
+        vioarr_utils_error(VISTR("wm_capture_create_invocation: screen was not found"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, screenId, ENOENT, "wm_capture: object does not exist");
+        return;
+    }
+
+    // the screen shows the surfaces of every client, so only the shell may capture it
+    if (!vioarr_peer_is_shell(message->client)) {
+        vioarr_utils_error(VISTR("wm_capture_create_invocation: client %i is not allowed to capture screens"), message->client);
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, captureId, EPERM, "wm_capture: permission denied");
+        return;
+    }
+
+    if (vioarr_quota_check(message->client, VIOARR_QUOTA_OBJECTS, 1)) {
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, captureId, EDQUOT, "wm_capture: object quota exceeded");
+        return;
+    }
+
+    if (vioarr_capture_create(message->client, captureId, screen, interval, &capture)) {
+        vioarr_utils_error(VISTR("wm_capture_create_invocation: failed to create capture"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, captureId, EINVAL, "wm_capture: failed to create capture");
+        return;
+    }
+
+    globalId = vioarr_objects_create_client_object(message->client, captureId, capture, WM_OBJECT_TYPE_CAPTURE);
+    wm_core_event_object_single(vioarr_get_server_handle(), message->client,
+        captureId,
+        globalId,
+        0,
+        WM_OBJECT_TYPE_CAPTURE
+    );
+}
+
+void wm_capture_create_thumbnail_invocation(struct gracht_message* message, const uint32_t surfaceId, const uint32_t captureId, const int interval)
+{
+    vioarr_utils_trace(VISTR("[wm_capture_create_thumbnail_invocation] client %i, surface %u, capture %u"), message->client, surfaceId, captureId);
+    vioarr_surface_t* surface;
+    vioarr_capture_t* capture;
+    uint32_t          globalId;
+
+    // only the shell may capture surfaces of other clients
+    if (vioarr_peer_is_shell(message->client)) {
+        surface = vioarr_objects_get_global_object(message->client, surfaceId, WM_OBJECT_TYPE_SURFACE);
+    }
+    else {
+        surface = vioarr_objects_get_object(message->client, surfaceId);
+    }
+
+    if (!surface) {
+        vioarr_utils_error(VISTR("wm_capture_create_thumbnail_invocation: surface was not found"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, surfaceId, ENOENT, "wm_capture: object does not exist");
+        return;
+    }
+
+    if (vioarr_quota_check(message->client, VIOARR_QUOTA_OBJECTS, 1)) {
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, captureId, EDQUOT, "wm_capture: object quota exceeded");
+        return;
+    }
+
+    if (vioarr_capture_create_thumbnail(message->client, captureId, surface, interval, &capture)) {
+        vioarr_utils_error(VISTR("wm_capture_create_thumbnail_invocation: failed to create capture"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, captureId, EINVAL, "wm_capture: failed to create capture");
+        return;
+    }
+
+    globalId = vioarr_objects_create_client_object(message->client, captureId, capture, WM_OBJECT_TYPE_CAPTURE);
+    wm_core_event_object_single(vioarr_get_server_handle(), message->client,
+        captureId,
+        globalId,
+        0,
+        WM_OBJECT_TYPE_CAPTURE
+    );
+}
+
+void wm_capture_queue_buffer_invocation(struct gracht_message* message, const uint32_t id, const uint32_t bufferId)
+{
+    vioarr_capture_t* capture = vioarr_objects_get_object(message->client, id);
+    vioarr_buffer_t*  buffer  = vioarr_objects_get_object(message->client, bufferId);
+    if (!capture) {
+        vioarr_utils_error(VISTR("wm_capture_queue_buffer_invocation: capture was not found"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, ENOENT, "wm_capture: object does not exist");
+        return;
+    }
+
+    if (!buffer) {
+        vioarr_utils_error(VISTR("wm_capture_queue_buffer_invocation: buffer was not found"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, bufferId, ENOENT, "wm_capture: buffer does not exist");
+        return;
+    }
+
+    if (vioarr_capture_queue_buffer(capture, buffer)) {
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, bufferId, EINVAL,
+            "wm_capture: unsupported buffer format or too many buffers");
+    }
+}
+
+void wm_capture_destroy_invocation(struct gracht_message* message, const uint32_t id)
+{
+    vioarr_utils_trace(VISTR("[wm_capture_destroy_invocation] client %i"), message->client);
+    vioarr_capture_t* capture = vioarr_objects_get_object(message->client, id);
+    if (!capture) {
+        vioarr_utils_error(VISTR("wm_capture_destroy_invocation: capture did not exist"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, ENOENT, "wm_capture: object does not exist");
+        return;
+    }
+
+    vioarr_objects_remove_object(message->client, id);
+    vioarr_capture_destroy(capture);
+}
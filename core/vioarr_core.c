@@ -24,6 +24,7 @@
 
 #include "wm_core_service_server.h"
 #include "engine/vioarr_objects.h"
+#include "engine/vioarr_quota.h"
 #include "engine/vioarr_utils.h"
 
 void wm_core_sync_invocation(struct gracht_message* message, const uint32_t serial)
@@ -37,3 +38,17 @@ void wm_core_get_objects_invocation(struct gracht_message* message)
     vioarr_utils_trace(VISTR("[wm_core_get_objects_callback] client %i"), message->client);
     vioarr_objects_publish(message->client);
 }
+
+void wm_core_get_usage_invocation(struct gracht_message* message)
+{
+    vioarr_quota_usage_t usage;
+    vioarr_utils_trace(VISTR("[wm_core_get_usage_callback] client %i"), message->client);
+
+    vioarr_quota_get_usage(message->client, &usage);
+    wm_core_event_usage_single(vioarr_get_server_handle(), message->client,
+        usage.usage[VIOARR_QUOTA_MEMORY], usage.limits[VIOARR_QUOTA_MEMORY],
+        usage.usage[VIOARR_QUOTA_TEXTURES], usage.limits[VIOARR_QUOTA_TEXTURES],
+        (uint32_t)usage.usage[VIOARR_QUOTA_OBJECTS], (uint32_t)usage.limits[VIOARR_QUOTA_OBJECTS],
+        (uint32_t)usage.usage[VIOARR_QUOTA_MESSAGES], (uint32_t)usage.limits[VIOARR_QUOTA_MESSAGES]
+    );
+}
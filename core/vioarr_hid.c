@@ -40,7 +40,7 @@ void ctt_input_event_button_event_invocation(gracht_client_t* client, const UUId
 {
     uint8_t pressed = (modifiers & VK_MODIFIER_RELEASED) ? 0 : 1;
     vioarr_utils_trace(VISTR("[ctt_input_event_button_callback] %u"), keyCode);
-    vioarr_input_button_event(deviceId, (uint32_t)keyCode, (uint32_t)modifiers, pressed);
+    vioarr_input_button_event(deviceId, (uint32_t)keyCode, (uint32_t)modifiers, pressed, vioarr_utils_time_us());
 }
 
 void ctt_input_event_cursor_event_invocation(gracht_client_t* client, const UUId_t deviceId, 
@@ -48,6 +48,6 @@ void ctt_input_event_cursor_event_invocation(gracht_client_t* client, const UUId
 {
     vioarr_utils_trace(VISTR("[ctt_input_event_button_callback] %i, %i, %i"),
         relX, relY, relZ);
-    vioarr_input_axis_event(deviceId, relX, relY);
+    vioarr_input_axis_event(deviceId, relX, relY, vioarr_utils_time_us());
 }
  
\ No newline at end of file
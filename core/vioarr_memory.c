@@ -28,60 +28,81 @@
 #include "wm_buffer_service_server.h"
 #include "engine/vioarr_memory.h"
 #include "engine/vioarr_buffer.h"
+#include "engine/vioarr_dispatch.h"
 #include "engine/vioarr_objects.h"
+#include "engine/vioarr_quota.h"
 #include "engine/vioarr_utils.h"
 #include <errno.h>
 
 void wm_memory_create_pool_invocation(struct gracht_message* message, const uint32_t poolId, const size_t handle, const int size)
 {
     vioarr_utils_trace(VISTR("[wm_memory_create_pool_callback] client %i"), message->client);
+    int                   client = message->client;
     vioarr_memory_pool_t* pool;
     int                   status;
     uint32_t              globalId;
+
+    if (vioarr_quota_check(client, VIOARR_QUOTA_OBJECTS, 1)) {
+        wm_core_event_error_single(vioarr_get_server_handle(), client, poolId, EDQUOT, "wm_memory: object quota exceeded");
+        return;
+    }
     
-    status = vioarr_memory_create_pool(message->client, poolId, handle, size, &pool);
+    // mapping the pool does not need the message
+    vioarr_dispatch_parallel_begin();
+    status = vioarr_memory_create_pool(client, poolId, handle, size, &pool);
     if (status) {
-        wm_core_event_error_single(vioarr_get_server_handle(), message->client, poolId, status, "wm_memory: failed to create memory pool");
+        wm_core_event_error_single(vioarr_get_server_handle(), client, poolId, errno, "wm_memory: failed to create memory pool");
+        vioarr_dispatch_parallel_end();
         return;
     }
     
-    globalId = vioarr_objects_create_client_object(message->client, poolId, pool, WM_OBJECT_TYPE_MEMORY_POOL);
-    wm_core_event_object_single(vioarr_get_server_handle(), message->client, 
+    globalId = vioarr_objects_create_client_object(client, poolId, pool, WM_OBJECT_TYPE_MEMORY_POOL);
+    wm_core_event_object_single(vioarr_get_server_handle(), client, 
         poolId,
         globalId,
         vioarr_memory_pool_handle(pool), 
         WM_OBJECT_TYPE_MEMORY_POOL
     );
+    vioarr_dispatch_parallel_end();
 }
 
 void wm_memory_pool_create_buffer_invocation(struct gracht_message* message, const uint32_t poolId, const uint32_t bufferId, const int offset, const int width, const int height, const int stride, const enum wm_pixel_format format, const unsigned int flags)
 {
     vioarr_utils_trace(VISTR("[wm_memory_pool_create_buffer_callback] client %i, pool %u, buffer %u"), message->client, poolId, bufferId);
-    vioarr_memory_pool_t* pool = vioarr_objects_get_object(message->client, poolId);
+    int                   client = message->client;
+    vioarr_memory_pool_t* pool   = vioarr_objects_get_object(client, poolId);
     vioarr_buffer_t*      buffer;
     int                   status;
     uint32_t              globalId;
     if (!pool) {
         vioarr_utils_error(VISTR("wm_memory_pool_create_buffer_callback: pool not found"));
-        wm_core_event_error_single(vioarr_get_server_handle(), message->client, poolId, ENOENT, "wm_memory: object does not exist");
+        wm_core_event_error_single(vioarr_get_server_handle(), client, poolId, ENOENT, "wm_memory: object does not exist");
+        return;
+    }
+
+    if (vioarr_quota_check(client, VIOARR_QUOTA_OBJECTS, 1)) {
+        wm_core_event_error_single(vioarr_get_server_handle(), client, bufferId, EDQUOT, "wm_memory: object quota exceeded");
         return;
     }
     
+    vioarr_dispatch_parallel_begin();
     status = vioarr_buffer_create(bufferId, pool, offset, 
         width, height, stride, format, flags, &buffer);
     if (status) {
         vioarr_utils_error(VISTR("wm_memory_pool_create_buffer_callback: failed to create memory buffer"));
-        wm_core_event_error_single(vioarr_get_server_handle(), message->client, poolId, status, "wm_memory: failed to create memory buffer");
+        wm_core_event_error_single(vioarr_get_server_handle(), client, poolId, status, "wm_memory: failed to create memory buffer");
+        vioarr_dispatch_parallel_end();
         return;
     }
     
-    globalId = vioarr_objects_create_client_object(message->client, bufferId, buffer, WM_OBJECT_TYPE_BUFFER);
-    wm_core_event_object_single(vioarr_get_server_handle(), message->client, 
+    globalId = vioarr_objects_create_client_object(client, bufferId, buffer, WM_OBJECT_TYPE_BUFFER);
+    wm_core_event_object_single(vioarr_get_server_handle(), client, 
         bufferId, 
         globalId,
         0,
         WM_OBJECT_TYPE_BUFFER
     );
+    vioarr_dispatch_parallel_end();
 }
 
 void wm_memory_pool_destroy_invocation(struct gracht_message* message, const uint32_t id)
@@ -97,6 +118,25 @@ void wm_memory_pool_destroy_invocation(struct gracht_message* message, const uin
     vioarr_memory_destroy_pool(pool);
 }
 
+void wm_memory_pool_resize_invocation(struct gracht_message* message, const uint32_t id, const int size)
+{
+    vioarr_utils_trace(VISTR("[wm_memory_pool_resize_callback] client %i, pool %u, size %i"), message->client, id, size);
+    int                   client = message->client;
+    vioarr_memory_pool_t* pool   = vioarr_objects_get_object(client, id);
+    if (!pool) {
+        vioarr_utils_error(VISTR("wm_memory_pool_resize_callback: pool did not exist"));
+        wm_core_event_error_single(vioarr_get_server_handle(), client, id, ENOENT, "wm_memory: object does not exist");
+        return;
+    }
+
+    vioarr_dispatch_parallel_begin();
+    if (size <= 0 || vioarr_memory_pool_resize(pool, (size_t)size)) {
+        vioarr_utils_error(VISTR("wm_memory_pool_resize_callback: failed to resize pool"));
+        wm_core_event_error_single(vioarr_get_server_handle(), client, id, errno, "wm_memory: failed to resize memory pool");
+    }
+    vioarr_dispatch_parallel_end();
+}
+
 void wm_buffer_destroy_invocation(struct gracht_message* message, const uint32_t id)
 {
     vioarr_utils_trace(VISTR("[wm_buffer_destroy_callback] client %i"), message->client);
@@ -107,5 +147,7 @@ void wm_buffer_destroy_invocation(struct gracht_message* message, const uint32_t
         return;
     }
     
+    // the buffer stays alive while surfaces reference it, but the client can no longer use it
+    vioarr_objects_remove_object(message->client, id);
     vioarr_buffer_destroy(buffer);
 }
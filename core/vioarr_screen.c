@@ -24,19 +24,22 @@
 
 #include "wm_screen_service_server.h"
 #include "wm_core_service_server.h"
+#include "engine/vioarr_governor.h"
 #include "engine/vioarr_renderer.h"
 #include "engine/vioarr_screen.h"
 #include "engine/vioarr_surface.h"
 #include "engine/vioarr_objects.h"
+#include "engine/vioarr_quota.h"
 #include "engine/vioarr_manager.h"
 #include "engine/vioarr_utils.h"
 #include <gracht/server.h>
 #include <errno.h>
+#include <stdatomic.h>
 
 #define SPAWN_COORDINATES_COUNT 6
 static int g_spawnCoordinateX[SPAWN_COORDINATES_COUNT] = { 100, 200, 300, 100, 200, 300 };
 static int g_spawnCoordinateY[SPAWN_COORDINATES_COUNT] = { 100, 100, 100, 200, 200, 200 };
-static int g_spawnIndex = 0;
+static atomic_int g_spawnIndex = 0;
 
 void wm_screen_get_properties_invocation(struct gracht_message* message, const uint32_t id)
 {
@@ -74,6 +77,23 @@ void wm_screen_get_modes_invocation(struct gracht_message* message, const uint32
     }
 }
 
+void wm_screen_get_governor_invocation(struct gracht_message* message, const uint32_t id)
+{
+    vioarr_utils_trace(VISTR("[wm_screen_get_governor_callback] client %i"), message->client);
+    vioarr_screen_t*        screen = vioarr_objects_get_object(-1, id);
+    vioarr_governor_state_t state;
+
+    if (!screen) {
+        vioarr_utils_error(VISTR("wm_screen_get_governor_callback: screen was not found"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, ENOENT, "wm_screen: object does not exist");
+        return;
+    }
+
+    vioarr_governor_state(vioarr_renderer_output(vioarr_screen_renderer(screen)), &state);
+    wm_screen_event_governor_single(vioarr_get_server_handle(), message->client, id,
+        state.level, state.budget, state.render_time, state.present_time, state.steps_down, state.steps_up);
+}
+
 void wm_screen_set_scale_invocation(struct gracht_message* message, const uint32_t id, const int scale)
 {
     vioarr_utils_trace(VISTR("[wm_screen_set_scale_callback] client %i"), message->client);
@@ -112,17 +132,25 @@ void wm_screen_create_surface_invocation(struct gracht_message* message,
     int                spawnX = x;
     int                spawnY = y;
     uint32_t           globalId;
+    int                spawnIndex;
     if (!screen) {
         vioarr_utils_error(VISTR("wm_screen_create_surface_callback: screen was not found"));
         wm_core_event_error_single(vioarr_get_server_handle(), message->client, screenId, ENOENT, "wm_screen: object does not exist");
         return;
     }
 
+    if (vioarr_quota_check(message->client, VIOARR_QUOTA_OBJECTS, 1)) {
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, surfaceId, EDQUOT, "wm_screen: object quota exceeded");
+        return;
+    }
+
+    // the spawn coordinates are relative to the screen the surface is created on
+    spawnIndex = atomic_load(&g_spawnIndex) % SPAWN_COORDINATES_COUNT;
     if (spawnX == -1) {
-        spawnX = g_spawnCoordinateX[g_spawnIndex % SPAWN_COORDINATES_COUNT];
+        spawnX = vioarr_region_x(vioarr_screen_region(screen)) + g_spawnCoordinateX[spawnIndex];
     }
     if (spawnY == -1) {
-        spawnY = g_spawnCoordinateY[g_spawnIndex % SPAWN_COORDINATES_COUNT];
+        spawnY = vioarr_region_y(vioarr_screen_region(screen)) + g_spawnCoordinateY[spawnIndex];
     }
     
     status = vioarr_surface_create(message->client, surfaceId, screen,
@@ -134,7 +162,7 @@ void wm_screen_create_surface_invocation(struct gracht_message* message,
     }
 
     // go to next spawn
-    g_spawnIndex++;
+    atomic_fetch_add(&g_spawnIndex, 1);
 
     // notify of new surface
     vioarr_manager_register_surface(surface);
@@ -26,25 +26,56 @@
 
 #include "wm_surface_service_server.h"
 #include "wm_core_service_server.h"
+#include "engine/vioarr_buffer.h"
+#include "engine/vioarr_damage.h"
+#include "engine/vioarr_dispatch.h"
 #include "engine/vioarr_input.h"
 #include "engine/vioarr_surface.h"
 #include "engine/vioarr_screen.h"
 #include "engine/vioarr_objects.h"
+#include "engine/vioarr_quota.h"
 #include "engine/vioarr_manager.h"
 #include "engine/vioarr_utils.h"
 #include <errno.h>
 
+/**
+ * Textures are created by the outputs when the content is presented, so the texture quota of the
+ * client is checked when the buffer is attached. Only growth over the current texture counts.
+ */
+static int __check_texture_quota(int client, vioarr_surface_t* surface, vioarr_buffer_t* buffer)
+{
+    size_t bytes;
+    size_t current;
+
+    if (!buffer) {
+        return 0;
+    }
+
+    bytes   = (size_t)vioarr_buffer_width(buffer) * (size_t)vioarr_buffer_height(buffer) * 4;
+    current = vioarr_surface_texture_size(surface, 0);
+    if (bytes <= current) {
+        return 0;
+    }
+    return vioarr_quota_check(client, VIOARR_QUOTA_TEXTURES, bytes - current);
+}
+
 void wm_surface_get_formats_invocation(struct gracht_message* message, const uint32_t id)
 {
     ENTRY(VISTR("wm_surface_get_formats_callback(client=%i, surface=%u)"), message->client, id);
-    vioarr_surface_t* surface = vioarr_objects_get_object(message->client, id);
+    vioarr_surface_t*           surface = vioarr_objects_get_object(message->client, id);
+    const enum wm_pixel_format* formats;
+    int                         count;
+    int                         i;
     if (!surface) {
         vioarr_utils_error(VISTR("wm_surface_get_formats_callback: failed to find surface"));
         wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, ENOENT, "wm_surface: object does not exist");
         goto exit;
     }
     
-    vioarr_utils_error(VISTR("[wm_surface_get_formats_callback] FIXME: STUB FUNCTION"));
+    count = vioarr_buffer_supported_formats(&formats);
+    for (i = 0; i < count; i++) {
+        wm_surface_event_format_single(vioarr_get_server_handle(), message->client, id, formats[i]);
+    }
 
 exit:
     EXIT("wm_surface_get_formats_callback");
@@ -60,6 +91,11 @@ void wm_surface_set_buffer_invocation(struct gracht_message* message, const uint
         wm_core_event_error_single(vioarr_get_server_handle(), message->client, surfaceId, ENOENT, "wm_surface: object does not exist");
         goto exit;
     }
+
+    if (__check_texture_quota(message->client, surface, buffer)) {
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, bufferId, EDQUOT, "wm_surface: texture quota exceeded");
+        goto exit;
+    }
     
     vioarr_surface_set_buffer(surface, buffer);
 
@@ -67,6 +103,62 @@ exit:
     EXIT("wm_surface_set_buffer_callback");
 }
 
+void wm_surface_update_invocation(struct gracht_message* message, const uint32_t id, const uint32_t bufferId,
+    const struct wm_rect* damage, const uint32_t damage_count, const struct wm_rect* dropShadow,
+    const struct wm_rect* inputRegion, const enum wm_surface_update_flags flags)
+{
+    ENTRY(VISTR("wm_surface_update_invocation(client=%i, surface=%u, flags=0x%x)"), message->client, id, flags);
+    int               client  = message->client;
+    vioarr_surface_t* surface = vioarr_objects_get_object(client, id);
+    vioarr_buffer_t*  buffer  = NULL;
+    unsigned int      changes = (unsigned int)flags;
+    vioarr_damage_t   dirt;
+    struct wm_rect    shadow = { 0 };
+    struct wm_rect    region = { 0 };
+    uint32_t          i;
+    if (!surface) {
+        vioarr_utils_error(VISTR("wm_surface_update_invocation: failed to find surface"));
+        wm_core_event_error_single(vioarr_get_server_handle(), client, id, ENOENT, "wm_surface: object does not exist");
+        goto exit;
+    }
+
+    // the rectangles point into the message, so they are copied before other requests are handled
+    vioarr_damage_zero(&dirt);
+    for (i = 0; damage && i < damage_count; i++) {
+        vioarr_damage_add(&dirt, damage[i].x, damage[i].y, damage[i].width, damage[i].height);
+    }
+    if (dropShadow) {
+        shadow = *dropShadow;
+    }
+    if (inputRegion) {
+        region = *inputRegion;
+    }
+
+    vioarr_dispatch_parallel_begin();
+
+    // the rest of the frame is still applied, the previous buffer stays attached
+    if ((changes & WM_SURFACE_UPDATE_FLAGS_BUFFER) && bufferId) {
+        buffer = vioarr_objects_get_object(client, bufferId);
+        if (!buffer) {
+            vioarr_utils_error(VISTR("wm_surface_update_invocation: failed to find buffer"));
+            wm_core_event_error_single(vioarr_get_server_handle(), client, bufferId, ENOENT, "wm_surface: buffer does not exist");
+            changes &= ~(unsigned int)WM_SURFACE_UPDATE_FLAGS_BUFFER;
+        }
+        else if (__check_texture_quota(client, surface, buffer)) {
+            wm_core_event_error_single(vioarr_get_server_handle(), client, bufferId, EDQUOT, "wm_surface: texture quota exceeded");
+            changes &= ~(unsigned int)WM_SURFACE_UPDATE_FLAGS_BUFFER;
+            buffer   = NULL;
+        }
+    }
+
+    vioarr_surface_apply(surface, buffer, &dirt, dropShadow ? &shadow : NULL,
+        inputRegion ? &region : NULL, changes);
+    vioarr_dispatch_parallel_end();
+
+exit:
+    EXIT("wm_surface_update_invocation");
+}
+
 void wm_surface_set_input_region_invocation(struct gracht_message* message, const uint32_t id, const int x, const int y, const int width, const int height)
 {
     ENTRY(VISTR("wm_surface_set_input_region_callback(client=%i, surface=%u)"), message->client, id);
@@ -159,7 +251,7 @@ exit:
 void wm_surface_request_focus_invocation(struct gracht_message* message, const uint32_t id)
 {
     ENTRY(VISTR("wm_surface_request_focus_invocation(client %i, surface %u)"), message->client, id);
-    vioarr_surface_t* surface = vioarr_objects_get_object(message->client, id);
+    vioarr_surface_t* surface = vioarr_objects_get_global_object(message->client, id, WM_OBJECT_TYPE_SURFACE);
     if (!surface) {
         vioarr_utils_error(VISTR("wm_surface_request_focus_invocation: failed to find surface"));
         wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, ENOENT, "wm_surface: object does not exist");
@@ -188,6 +280,54 @@ exit:
     EXIT("wm_surface_invalidate_callback");
 }
 
+void wm_surface_invalidate_rects_invocation(struct gracht_message* message, const uint32_t id, const struct wm_rect* rects, const uint32_t rects_count)
+{
+    ENTRY(VISTR("wm_surface_invalidate_rects_invocation(client %i, surface %u, count %u)"), message->client, id, rects_count);
+    vioarr_surface_t* surface = vioarr_objects_get_object(message->client, id);
+    if (!surface) {
+        vioarr_utils_error(VISTR("wm_surface_invalidate_rects_invocation failed to find surface"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, ENOENT, "wm_surface: object does not exist");
+        goto exit;
+    }
+    
+    vioarr_surface_invalidate_rects(surface, rects, (int)rects_count);
+
+exit:
+    EXIT("wm_surface_invalidate_rects_invocation");
+}
+
+void wm_surface_set_sync_invocation(struct gracht_message* message, const uint32_t id, const uint8_t sync)
+{
+    ENTRY(VISTR("wm_surface_set_sync_invocation(client %i, surface %u, sync %u)"), message->client, id, sync);
+    vioarr_surface_t* surface = vioarr_objects_get_object(message->client, id);
+    if (!surface) {
+        vioarr_utils_error(VISTR("wm_surface_set_sync_invocation failed to find surface"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, ENOENT, "wm_surface: object does not exist");
+        goto exit;
+    }
+    
+    vioarr_surface_set_sync(surface, (int)sync);
+
+exit:
+    EXIT("wm_surface_set_sync_invocation");
+}
+
+void wm_surface_ack_configure_invocation(struct gracht_message* message, const uint32_t id, const uint32_t serial)
+{
+    ENTRY(VISTR("wm_surface_ack_configure_invocation(client %i, surface %u, serial %u)"), message->client, id, serial);
+    vioarr_surface_t* surface = vioarr_objects_get_object(message->client, id);
+    if (!surface) {
+        vioarr_utils_error(VISTR("wm_surface_ack_configure_invocation failed to find surface"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, ENOENT, "wm_surface: object does not exist");
+        goto exit;
+    }
+    
+    vioarr_surface_ack_configure(surface, serial);
+
+exit:
+    EXIT("wm_surface_ack_configure_invocation");
+}
+
 void wm_surface_set_drop_shadow_invocation(struct gracht_message* message, const uint32_t id, const int x, const int y, const int width, const int height)
 {
     ENTRY(VISTR("wm_surface_set_drop_shadow_callback(client %i, surface %u)"), message->client, id);
@@ -204,6 +344,61 @@ exit:
     EXIT("wm_surface_set_drop_shadow_callback");
 }
 
+void wm_surface_set_buffer_scale_invocation(struct gracht_message* message, const uint32_t id, const int scale)
+{
+    ENTRY(VISTR("wm_surface_set_buffer_scale_invocation(client %i, surface %u, scale %i)"), message->client, id, scale);
+    vioarr_surface_t* surface = vioarr_objects_get_object(message->client, id);
+    if (!surface) {
+        vioarr_utils_error(VISTR("wm_surface_set_buffer_scale_invocation: failed to find surface"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, ENOENT, "wm_surface: object does not exist");
+        goto exit;
+    }
+
+    if (vioarr_surface_set_buffer_scale(surface, scale)) {
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, EINVAL, "wm_surface: invalid buffer scale");
+    }
+
+exit:
+    EXIT("wm_surface_set_buffer_scale_invocation");
+}
+
+void wm_surface_set_viewport_invocation(struct gracht_message* message, const uint32_t id, const int srcX, const int srcY,
+    const int srcWidth, const int srcHeight, const int dstWidth, const int dstHeight)
+{
+    ENTRY(VISTR("wm_surface_set_viewport_invocation(client %i, surface %u)"), message->client, id);
+    vioarr_surface_t* surface = vioarr_objects_get_object(message->client, id);
+    if (!surface) {
+        vioarr_utils_error(VISTR("wm_surface_set_viewport_invocation: failed to find surface"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, ENOENT, "wm_surface: object does not exist");
+        goto exit;
+    }
+
+    if (vioarr_surface_set_viewport(surface, srcX, srcY, srcWidth, srcHeight, dstWidth, dstHeight)) {
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, EINVAL, "wm_surface: invalid viewport");
+    }
+
+exit:
+    EXIT("wm_surface_set_viewport_invocation");
+}
+
+void wm_surface_set_backdrop_blur_invocation(struct gracht_message* message, const uint32_t id, const int radius)
+{
+    ENTRY(VISTR("wm_surface_set_backdrop_blur_invocation(client %i, surface %u, radius %i)"), message->client, id, radius);
+    vioarr_surface_t* surface = vioarr_objects_get_object(message->client, id);
+    if (!surface) {
+        vioarr_utils_error(VISTR("wm_surface_set_backdrop_blur_invocation: failed to find surface"));
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, ENOENT, "wm_surface: object does not exist");
+        goto exit;
+    }
+
+    if (vioarr_surface_set_backdrop_blur(surface, radius)) {
+        wm_core_event_error_single(vioarr_get_server_handle(), message->client, id, EINVAL, "wm_surface: invalid blur radius");
+    }
+
+exit:
+    EXIT("wm_surface_set_backdrop_blur_invocation");
+}
+
 void wm_surface_add_subsurface_invocation(struct gracht_message* message, const uint32_t parentId, const uint32_t childId, const int x, const int y)
 {
     ENTRY(VISTR("wm_surface_add_subsurface_callback(client %i, surface %u)"), message->client, parentId);
@@ -338,6 +533,7 @@ void wm_surface_destroy_invocation(struct gracht_message* message, const uint32_
         goto exit;
     }
     
+    vioarr_objects_remove_object(message->client, id);
     vioarr_surface_destroy(surface);
 
 exit:
@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <cstring>
 #include <errno.h>
+#include <map>
 #include <type_traits>
 #include <gracht/client.h>
 #include <asgaard/application.hpp>
@@ -39,6 +40,7 @@
 #include <asgaard/events/object_event.hpp>
 #include <asgaard/events/screen_properties_event.hpp>
 #include <asgaard/events/screen_mode_event.hpp>
+#include <asgaard/events/screen_governor_event.hpp>
 #include <asgaard/events/surface_format_event.hpp>
 #include <asgaard/events/surface_resize_event.hpp>
 #include <asgaard/events/surface_focus_event.hpp>
@@ -47,7 +49,10 @@
 #include <asgaard/events/pointer_move_event.hpp>
 #include <asgaard/events/pointer_click_event.hpp>
 #include <asgaard/events/pointer_scroll_event.hpp>
+#include <asgaard/events/pointer_frame_event.hpp>
 #include <asgaard/events/key_event.hpp>
+#include <asgaard/events/usage_event.hpp>
+#include <asgaard/notifications/usage_notification.hpp>
 #include "environment_private.hpp"
 
 #include "wm_core_service_client.h"
@@ -246,6 +251,11 @@ namespace Asgaard {
         return (*entry).second.data.iValue;
     }
 
+    void Application::RequestUsage()
+    {
+        wm_core_get_usage(m_vClient, nullptr);
+    }
+
     std::shared_ptr<Keyboard> Application::GetKeyboard() const
     {
         auto entry = std::find_if(
@@ -310,6 +320,11 @@ namespace Asgaard {
             case Event::Type::SYNC: {
                 m_syncRecieved = true;
             } break;
+
+            case Event::Type::USAGE: {
+                const auto& usage = static_cast<const UsageEvent&>(event);
+                Notify(UsageNotification(Id(), usage));
+            } break;
             
             default:
                 break;
@@ -337,6 +352,19 @@ namespace Asgaard {
     }
 }
 
+namespace {
+    // pointer events are held back per surface until the frame event that ends the input report
+    std::map<uint32_t, std::vector<std::shared_ptr<Asgaard::Event>>> g_pointerFrames;
+
+    void QueuePointerEvent(const uint32_t surfaceId, std::shared_ptr<Asgaard::Event> event)
+    {
+        if (!Asgaard::OM[surfaceId]) {
+            return;
+        }
+        g_pointerFrames[surfaceId].push_back(std::move(event));
+    }
+}
+
 // Protocol callbacks
 extern "C"
 {
@@ -398,6 +426,14 @@ extern "C"
         }
     }
     
+    void wm_core_event_usage_invocation(gracht_client_t* client, const size_t memory, const size_t memoryLimit,
+        const size_t textures, const size_t texturesLimit, const uint32_t objects, const uint32_t objectsLimit,
+        const uint32_t messages, const uint32_t messagesLimit)
+    {
+        Asgaard::APP.ExternalEvent(Asgaard::UsageEvent(memory, memoryLimit, textures, texturesLimit,
+            objects, objectsLimit, messages, messagesLimit));
+    }
+    
     void wm_core_event_destroy_invocation(gracht_client_t* client, const uint32_t id)
     {
         auto object = Asgaard::OM[id];
@@ -429,6 +465,18 @@ extern "C"
         
         object->ExternalEvent(Asgaard::ScreenModeEvent(attributes, resolutionX, resolutionY, refreshRate));
     }
+
+    void wm_screen_event_governor_invocation(gracht_client_t* client, const uint32_t id, const int level, const uint32_t budget,
+        const uint32_t renderTime, const uint32_t presentTime, const uint32_t stepsDown, const uint32_t stepsUp)
+    {
+        auto object = Asgaard::OM[id];
+        if (!object) {
+            // log
+            return;
+        }
+        
+        object->ExternalEvent(Asgaard::ScreenGovernorEvent(level, budget, renderTime, presentTime, stepsDown, stepsUp));
+    }
     
     // SURFACE PROTOCOL EVENTS
     void wm_surface_event_format_invocation(gracht_client_t* client, const uint32_t id, const enum wm_pixel_format format)
@@ -453,7 +501,7 @@ extern "C"
         object->ExternalEvent(Asgaard::Event(Asgaard::Event::Type::SURFACE_FRAME));
     }
     
-    void wm_surface_event_resize_invocation(gracht_client_t* client, const uint32_t id, const int width, const int height, const enum wm_surface_edge edges)
+    void wm_surface_event_redraw_invocation(gracht_client_t* client, const uint32_t id)
     {
         auto object = Asgaard::OM[id];
         if (!object) {
@@ -461,7 +509,18 @@ extern "C"
             return;
         }
         
-        object->ExternalEvent(Asgaard::SurfaceResizeEvent(width, height, edges));
+        object->ExternalEvent(Asgaard::Event(Asgaard::Event::Type::SURFACE_REDRAW));
+    }
+    
+    void wm_surface_event_configure_invocation(gracht_client_t* client, const uint32_t id, const uint32_t serial, const int width, const int height, const enum wm_surface_edge edges)
+    {
+        auto object = Asgaard::OM[id];
+        if (!object) {
+            // log
+            return;
+        }
+        
+        object->ExternalEvent(Asgaard::SurfaceResizeEvent(serial, width, height, edges));
     }
 
     void wm_surface_event_focus_invocation(gracht_client_t* client, const uint32_t id, const uint8_t focus)
@@ -490,58 +549,50 @@ extern "C"
     // POINTER PROTOCOL EVENTS
     void wm_pointer_event_enter_invocation(gracht_client_t* client, const uint32_t pointerId, const uint32_t surfaceId, const int surfaceX, const int surfaceY)
     {
-        auto object = Asgaard::OM[surfaceId];
-        if (!object) {
-            return;
-        }
-        
-        object->ExternalEvent(Asgaard::PointerEnterEvent(pointerId, surfaceX, surfaceY));
+        QueuePointerEvent(surfaceId, std::make_shared<Asgaard::PointerEnterEvent>(pointerId, surfaceX, surfaceY));
     }
 
     void wm_pointer_event_leave_invocation(gracht_client_t* client, const uint32_t pointerId, const uint32_t surfaceId)
     {
-        auto object = Asgaard::OM[surfaceId];
-        if (!object) {
-            return;
-        }
-        
-        object->ExternalEvent(Asgaard::PointerLeaveEvent(pointerId));
+        QueuePointerEvent(surfaceId, std::make_shared<Asgaard::PointerLeaveEvent>(pointerId));
     }
 
-    void wm_pointer_event_move_invocation(gracht_client_t* client, const uint32_t pointerId, const uint32_t surfaceId, const int surfaceX, const int surfaceY)
+    void wm_pointer_event_move_invocation(gracht_client_t* client, const uint32_t pointerId, const uint32_t surfaceId, const int surfaceX, const int surfaceY, const uint64_t timestamp)
     {
-        auto object = Asgaard::OM[surfaceId];
-        if (!object) {
-            // log
-            return;
-        }
-        
-        object->ExternalEvent(Asgaard::PointerMoveEvent(pointerId, surfaceX, surfaceY));
+        QueuePointerEvent(surfaceId, std::make_shared<Asgaard::PointerMoveEvent>(pointerId, surfaceX, surfaceY, timestamp));
     }
 
-    void wm_pointer_event_click_invocation(gracht_client_t* client, const uint32_t pointerId, const uint32_t surfaceId, const enum wm_pointer_button button, const uint8_t pressed)
+    void wm_pointer_event_click_invocation(gracht_client_t* client, const uint32_t pointerId, const uint32_t surfaceId, const enum wm_pointer_button button, const uint8_t pressed, const uint64_t timestamp)
     {
-        auto object = Asgaard::OM[surfaceId];
-        if (!object) {
-            return;
-        }
-        
-        object->ExternalEvent(Asgaard::PointerClickEvent(pointerId, button, static_cast<bool>(pressed)));
+        QueuePointerEvent(surfaceId, std::make_shared<Asgaard::PointerClickEvent>(pointerId, button, static_cast<bool>(pressed), timestamp));
     }
 
-    void wm_pointer_event_scroll_invocation(gracht_client_t* client, const uint32_t pointerId, const uint32_t surfaceId, const int horz, const int vert)
+    void wm_pointer_event_scroll_invocation(gracht_client_t* client, const uint32_t pointerId, const uint32_t surfaceId, const int horz, const int vert, const uint64_t timestamp)
     {
+        QueuePointerEvent(surfaceId, std::make_shared<Asgaard::PointerScrollEvent>(pointerId, horz, vert, timestamp));
+    }
+
+    void wm_pointer_event_frame_invocation(gracht_client_t* client, const uint32_t pointerId, const uint32_t surfaceId, const uint64_t timestamp)
+    {
+        auto events = g_pointerFrames.find(surfaceId);
+        if (events == g_pointerFrames.end()) {
+            return;
+        }
+
+        auto frame = Asgaard::PointerFrameEvent(pointerId, timestamp, std::move(events->second));
+        g_pointerFrames.erase(events);
+
         auto object = Asgaard::OM[surfaceId];
         if (!object) {
             // log
             return;
         }
         
-        object->ExternalEvent(Asgaard::PointerScrollEvent(pointerId, horz, vert));
+        object->ExternalEvent(frame);
     }
 
     // KEYBOARD PROTOCOL EVENTS
-    void wm_keyboard_event_key_invocation(gracht_client_t* client, const uint32_t surfaceId, const uint32_t keycode, const uint16_t modifiers, const uint8_t pressed)
+    void wm_keyboard_event_key_invocation(gracht_client_t* client, const uint32_t surfaceId, const uint32_t keycode, const uint16_t modifiers, const uint8_t pressed, const uint64_t timestamp)
     {
         auto object = Asgaard::OM[surfaceId];
         if (!object) {
@@ -549,6 +600,6 @@ extern "C"
             return;
         }
 
-        object->ExternalEvent(Asgaard::KeyEvent(keycode, modifiers, static_cast<bool>(pressed)));
+        object->ExternalEvent(Asgaard::KeyEvent(keycode, modifiers, static_cast<bool>(pressed), timestamp));
     }
 }
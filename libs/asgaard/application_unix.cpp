@@ -43,6 +43,10 @@
 #include <sys/socket.h>
 static const char* g_vioarrPath = "/tmp/vi-srv";
 static const char* g_heimdallPath = "/tmp/hd-srv";
+#ifdef VIOARR_RING_LINK
+#include <vioarr/link_ring.h>
+static const char* g_vioarrRingPath = "/tmp/vi-ring";
+#endif
 
 #include "wm_core_service_client.h"
 #include "wm_screen_service_client.h"
@@ -79,6 +83,33 @@ namespace
             throw Asgaard::ApplicationException("failed to initialize gracht client", status);
         }
     }
+
+#ifdef VIOARR_RING_LINK
+    /**
+     * Traffic with the compositor is mostly small, high-rate messages (pointer moves, frame
+     * events and commits), which goes through shared memory rings instead of the socket.
+     */
+    void InitializeRingClient(const char* address, gracht_client_t** clientOut)
+    {
+        struct gracht_client_configuration clientConfiguration;
+        struct link_ring*                  link;
+        int                                status;
+
+        status = link_ring_create(&link);
+        if (status) {
+            throw Asgaard::ApplicationException("failed to create the ring link", errno);
+        }
+        link_ring_set_address(link, address);
+
+        gracht_client_configuration_init(&clientConfiguration);
+        gracht_client_configuration_set_link(&clientConfiguration, (struct gracht_link*)link);
+        
+        status = gracht_client_create(&clientConfiguration, clientOut);
+        if (status) {
+            throw Asgaard::ApplicationException("failed to initialize gracht client", status);
+        }
+    }
+#endif
 }
 
 namespace Asgaard
@@ -91,7 +122,12 @@ namespace Asgaard
         gracht_client_register_protocol(m_hClient, &hd_core_client_protocol);
 
         // initialize the vioarr client
+#ifdef VIOARR_RING_LINK
+        InitializeRingClient(g_vioarrRingPath, &m_vClient);
+        (void)g_vioarrPath;
+#else
         InitializeClient(g_vioarrPath, &m_vClient);
+#endif
         
         gracht_client_register_protocol(m_vClient, &wm_core_client_protocol);
         gracht_client_register_protocol(m_vClient, &wm_screen_client_protocol);
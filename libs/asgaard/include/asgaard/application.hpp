@@ -109,6 +109,12 @@ namespace Asgaard {
         ASGAARD_API bool        GetSettingBoolean(Settings setting);
         ASGAARD_API int         GetSettingInteger(Settings setting);
 
+        /**
+         * Asks the compositor for the resources this application uses, and the limits it is held to.
+         * The reply is published as an UsageNotification to the subscribers of the application.
+         */
+        ASGAARD_API void RequestUsage();
+
         /**
          * Destroy
          * Handles application cleanup. This should not be invoked manually, will automatically be called
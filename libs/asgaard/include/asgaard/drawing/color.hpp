@@ -71,6 +71,13 @@ namespace Asgaard {
                     case PixelFormat::R8G8B8A8: return Color(colorData.components.c0, colorData.components.c3, colorData.components.c2, colorData.components.c1);
                     case PixelFormat::B8G8R8A8: return Color(colorData.components.c0, colorData.components.c1, colorData.components.c2, colorData.components.c3);
                     case PixelFormat::X8B8G8R8: return Color(colorData.components.c0, colorData.components.c1, colorData.components.c2);
+                    case PixelFormat::R5G6B5: {
+                        // expand the channels by replicating the top bits into the low bits
+                        unsigned char r = (colorData.color >> 11) & 0x1F;
+                        unsigned char g = (colorData.color >> 5) & 0x3F;
+                        unsigned char b = colorData.color & 0x1F;
+                        return Color((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+                    }
                 }
                 return Color(0, 0, 0);
             }
@@ -97,6 +104,9 @@ namespace Asgaard {
                     case PixelFormat::X8B8G8R8:
                         color = 0xFF000000 | ((unsigned int)b << 16) | ((unsigned int)g << 8) | r;
                         break;
+                    case PixelFormat::R5G6B5:
+                        color = ((unsigned int)(r >> 3) << 11) | ((unsigned int)(g >> 2) << 5) | (b >> 3);
+                        break;
                 }
                 return color;
             }
@@ -34,6 +34,7 @@ namespace Asgaard {
             SURFACE_FORMAT,
             SURFACE_RESIZE,
             SURFACE_FRAME,
+            SURFACE_REDRAW,
             SURFACE_FOCUSED,
             SURFACE_UNFOCUSED,
             BUFFER_RELEASE,
@@ -42,7 +43,10 @@ namespace Asgaard {
             POINTER_LEAVE,
             POINTER_MOVE,
             POINTER_CLICK,
-            POINTER_SCROLL
+            POINTER_SCROLL,
+            POINTER_FRAME,
+            USAGE,
+            SCREEN_GOVERNOR
         };
 
     public:
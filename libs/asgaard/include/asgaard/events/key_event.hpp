@@ -30,12 +30,13 @@
 namespace Asgaard {
     class ASGAARD_API KeyEvent : public Event {
     public:
-        KeyEvent(const uint32_t keyCode, const uint16_t modifiers, bool pressed);
+        KeyEvent(const uint32_t keyCode, const uint16_t modifiers, bool pressed, uint64_t timestamp);
         
         uint32_t      Key() const;
         enum VKeyCode KeyCode() const;
         bool          Pressed() const;
         bool          IsRepeat() const;
+        uint64_t      Timestamp() const;
 
         bool LeftControl() const;
         bool RightControl() const;
@@ -45,5 +46,6 @@ namespace Asgaard {
         uint16_t      m_modifiers;
         bool          m_pressed;
         enum VKeyCode m_keyCode;
+        uint64_t      m_timestamp;
     };
 }
@@ -30,20 +30,23 @@
 namespace Asgaard {
     class PointerClickEvent : public Event {
     public:
-        PointerClickEvent(const uint32_t pointerId, const enum wm_pointer_button button, const bool pressed) 
+        PointerClickEvent(const uint32_t pointerId, const enum wm_pointer_button button, const bool pressed, const uint64_t timestamp) 
         : Event(Event::Type::POINTER_CLICK)
         , m_pointerId(pointerId)
         , m_button(button)
         , m_pressed(pressed)
+        , m_timestamp(timestamp)
         { }
 
         uint32_t               PointerId() const { return m_pointerId; }
         enum wm_pointer_button Button() const { return m_button; }
         bool                   Pressed() const { return m_pressed; }
+        uint64_t               Timestamp() const { return m_timestamp; }
 
     private:
         uint32_t               m_pointerId;
         enum wm_pointer_button m_button;
         bool                   m_pressed;
+        uint64_t               m_timestamp;
     };
 }
@@ -0,0 +1,52 @@
+/* ValiOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ValiOS - Application Framework (Asgaard)
+ *  - Contains the implementation of the application framework used for building
+ *    graphical applications.
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "event.hpp"
+
+namespace Asgaard {
+    /**
+     * The pointer events a surface received for one input report, in the order they were sent.
+     * Contains enter, leave, move, click and scroll events.
+     */
+    class PointerFrameEvent : public Event {
+    public:
+        PointerFrameEvent(const uint32_t pointerId, const uint64_t timestamp, std::vector<std::shared_ptr<Event>> events)
+        : Event(Event::Type::POINTER_FRAME)
+        , m_pointerId(pointerId)
+        , m_timestamp(timestamp)
+        , m_events(std::move(events))
+        { }
+
+        uint32_t PointerId() const { return m_pointerId; }
+        uint64_t Timestamp() const { return m_timestamp; }
+        const std::vector<std::shared_ptr<Event>>& Events() const { return m_events; }
+
+    private:
+        uint32_t                            m_pointerId;
+        uint64_t                            m_timestamp;
+        std::vector<std::shared_ptr<Event>> m_events;
+    };
+}
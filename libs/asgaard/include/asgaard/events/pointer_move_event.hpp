@@ -28,20 +28,23 @@
 namespace Asgaard {
     class PointerMoveEvent : public Event {
     public:
-        PointerMoveEvent(const uint32_t pointerId, const int surfaceX, const int surfaceY) 
+        PointerMoveEvent(const uint32_t pointerId, const int surfaceX, const int surfaceY, const uint64_t timestamp) 
         : Event(Event::Type::POINTER_MOVE)
         , m_pointerId(pointerId)
         , m_surfaceX(surfaceX)
         , m_surfaceY(surfaceY)
+        , m_timestamp(timestamp)
         { }
 
         uint32_t PointerId() const { return m_pointerId; }
         int      LocalX() const { return m_surfaceX; }
         int      LocalY() const { return m_surfaceY; }
+        uint64_t Timestamp() const { return m_timestamp; }
 
     private:
         uint32_t m_pointerId;
         int      m_surfaceX;
         int      m_surfaceY;
+        uint64_t m_timestamp;
     };
 }
@@ -28,20 +28,23 @@
 namespace Asgaard {
     class PointerScrollEvent : public Event {
     public:
-        PointerScrollEvent(const uint32_t pointerId, const int horizontal, const int vertical) 
+        PointerScrollEvent(const uint32_t pointerId, const int horizontal, const int vertical, const uint64_t timestamp) 
         : Event(Event::Type::POINTER_SCROLL)
         , m_pointerId(pointerId)
         , m_horizontal(horizontal)
         , m_vertical(vertical)
+        , m_timestamp(timestamp)
         { }
 
         uint32_t PointerId() const { return m_pointerId; }
         int      ChangeX() const { return m_horizontal; }
         int      ChangeY() const { return m_vertical; }
+        uint64_t Timestamp() const { return m_timestamp; }
 
     private:
         uint32_t m_pointerId;
         int      m_horizontal;
         int      m_vertical;
+        uint64_t m_timestamp;
     };
 }
@@ -0,0 +1,57 @@
+/* ValiOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ValiOS - Application Framework (Asgaard)
+ *  - Contains the implementation of the application framework used for building
+ *    graphical applications.
+ */
+#pragma once
+
+#include <cstdint>
+#include "event.hpp"
+
+namespace Asgaard {
+    class ScreenGovernorEvent : public Event {
+    public:
+        ScreenGovernorEvent(const int level, const uint32_t budget, const uint32_t renderTime,
+                            const uint32_t presentTime, const uint32_t stepsDown, const uint32_t stepsUp)
+        : Event(Event::Type::SCREEN_GOVERNOR)
+        , m_level(level)
+        , m_budget(budget)
+        , m_renderTime(renderTime)
+        , m_presentTime(presentTime)
+        , m_stepsDown(stepsDown)
+        , m_stepsUp(stepsUp)
+        { }
+
+        int      Level() const { return m_level; }
+        uint32_t Budget() const { return m_budget; }
+        uint32_t RenderTime() const { return m_renderTime; }
+        uint32_t PresentTime() const { return m_presentTime; }
+        uint32_t StepsDown() const { return m_stepsDown; }
+        uint32_t StepsUp() const { return m_stepsUp; }
+
+    private:
+        int      m_level;
+        uint32_t m_budget;
+        uint32_t m_renderTime;
+        uint32_t m_presentTime;
+        uint32_t m_stepsDown;
+        uint32_t m_stepsUp;
+    };
+}
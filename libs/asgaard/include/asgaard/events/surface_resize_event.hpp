@@ -30,18 +30,21 @@
 namespace Asgaard {
     class SurfaceResizeEvent : public Event {
     public:
-        SurfaceResizeEvent(const int width, const int height, const enum wm_surface_edge edges) 
+        SurfaceResizeEvent(const uint32_t serial, const int width, const int height, const enum wm_surface_edge edges) 
         : Event(Event::Type::SURFACE_RESIZE)
+        , m_serial(serial)
         , m_width(width)
         , m_height(height)
         , m_edges(edges)
         { }
 
+        uint32_t             Serial() const { return m_serial; }
         int                  Width() const { return m_width; }
         int                  Height() const { return m_height; }
         enum wm_surface_edge Edges() const { return m_edges; }
 
     private:
+        uint32_t             m_serial;
         int                  m_width;
         int                  m_height;
         enum wm_surface_edge m_edges;
@@ -0,0 +1,64 @@
+/* ValiOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ValiOS - Application Framework (Asgaard)
+ *  - Contains the implementation of the application framework used for building
+ *    graphical applications.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "event.hpp"
+
+namespace Asgaard {
+    class UsageEvent : public Event {
+    public:
+        UsageEvent(const size_t memory, const size_t memoryLimit, const size_t textures, const size_t texturesLimit,
+                   const uint32_t objects, const uint32_t objectsLimit, const uint32_t messages, const uint32_t messagesLimit)
+        : Event(Event::Type::USAGE)
+        , m_memory(memory)
+        , m_memoryLimit(memoryLimit)
+        , m_textures(textures)
+        , m_texturesLimit(texturesLimit)
+        , m_objects(objects)
+        , m_objectsLimit(objectsLimit)
+        , m_messages(messages)
+        , m_messagesLimit(messagesLimit)
+        { }
+
+        size_t   Memory() const { return m_memory; }
+        size_t   MemoryLimit() const { return m_memoryLimit; }
+        size_t   Textures() const { return m_textures; }
+        size_t   TexturesLimit() const { return m_texturesLimit; }
+        uint32_t Objects() const { return m_objects; }
+        uint32_t ObjectsLimit() const { return m_objectsLimit; }
+        uint32_t Messages() const { return m_messages; }
+        uint32_t MessagesLimit() const { return m_messagesLimit; }
+
+    private:
+        size_t   m_memory;
+        size_t   m_memoryLimit;
+        size_t   m_textures;
+        size_t   m_texturesLimit;
+        uint32_t m_objects;
+        uint32_t m_objectsLimit;
+        uint32_t m_messages;
+        uint32_t m_messagesLimit;
+    };
+}
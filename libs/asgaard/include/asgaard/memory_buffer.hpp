@@ -34,8 +34,9 @@ namespace Asgaard {
     class MemoryBuffer final : public Object {
     public:
         enum class Flags : int {
-            NONE = 0,
-            FLIP_Y
+            NONE          = 0,
+            FLIP_Y        = 0x1,
+            PREMULTIPLIED = 0x2  // color channels are already multiplied with alpha
         };
 
     public:
@@ -50,6 +51,12 @@ namespace Asgaard {
         int         Height() const { return m_height; }
         int         Stride() const { return m_width * GetBytesPerPixel(m_format); }
         PixelFormat Format() const { return m_format; }
+
+        /**
+         * A buffer is busy from the moment it is submitted to a surface (or damaged while attached)
+         * until the window manager releases it again. Busy buffers must not be drawn into.
+         */
+        bool IsBusy() const { return m_busy; }
         
     public:
         static std::shared_ptr<MemoryBuffer> Create(Object* owner, const std::shared_ptr<MemoryPool>& memory,
@@ -66,6 +73,9 @@ namespace Asgaard {
     public:
         void ExternalEvent(const Event&) final;
         
+    private:
+        void MarkSubmitted(uint32_t surfaceId, uint64_t sequence);
+
     private:
         std::shared_ptr<MemoryPool> m_memory;
         int                         m_width;
@@ -73,6 +83,12 @@ namespace Asgaard {
         enum PixelFormat            m_format;
         enum Flags                  m_flags;
         void*                       m_buffer;
+        bool                        m_busy;
+        uint32_t                    m_surfaceId;
+        uint64_t                    m_sequence;
+
+        // allow surfaces to track submissions
+        friend class Surface;
     };
 }
 
@@ -64,6 +64,11 @@ namespace Asgaard {
         
     public:
         void* CreateBufferPointer(int memoryOffset);
+
+        /**
+         * Grows the pool in place, buffers created from the pool stay valid. Pools cannot shrink.
+         */
+        ASGAARD_API void Resize(std::size_t size);
         
     private:
         std::size_t           m_size;
@@ -74,8 +79,10 @@ namespace Asgaard {
 #elif defined(_WIN32)
 
 #else
-    key_t                     m_poolKey;
-    int                       m_shmFd;
+    std::size_t               m_handle;
+    int                       m_fd;
+    void*                     m_reservation;
+    std::size_t               m_reserved;
     void*                     m_memory;
 #endif
     };
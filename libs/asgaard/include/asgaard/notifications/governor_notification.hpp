@@ -0,0 +1,45 @@
+/* ValiOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ValiOS - Application Framework (Asgaard)
+ *  - Contains the implementation of the application framework used for building
+ *    graphical applications.
+ */
+#pragma once
+
+#include "notification.hpp"
+#include "../events/screen_governor_event.hpp"
+
+namespace Asgaard {
+    /**
+     * Published by a screen when the compositor replies to Screen::RequestGovernorState, with the
+     * quality level the screen renders at and the frame times it is governed by, in microseconds.
+     */
+    class GovernorNotification : public NotificationTemplate<NotificationType::GOVERNOR> {
+    public:
+        GovernorNotification(uint32_t sourceObjectId, const ScreenGovernorEvent& governor)
+        : NotificationTemplate(sourceObjectId)
+        , m_governor(governor)
+        { }
+
+        const ScreenGovernorEvent& Governor() const { return m_governor; }
+
+    private:
+        ScreenGovernorEvent m_governor;
+    };
+}
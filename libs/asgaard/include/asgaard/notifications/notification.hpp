@@ -39,6 +39,8 @@ namespace Asgaard {
         FOCUS_EVENT,
         FOCUS,
         TIMEOUT,
+        USAGE,
+        GOVERNOR,
 
         CUSTOM_START
     };
@@ -0,0 +1,46 @@
+/* ValiOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ValiOS - Application Framework (Asgaard)
+ *  - Contains the implementation of the application framework used for building
+ *    graphical applications.
+ */
+#pragma once
+
+#include "notification.hpp"
+#include "../events/usage_event.hpp"
+
+namespace Asgaard {
+    /**
+     * Published by the application when the compositor replies to Application::RequestUsage, with
+     * the resources the application currently uses and the limits it has. A limit of 0 means the
+     * resource is not limited.
+     */
+    class UsageNotification : public NotificationTemplate<NotificationType::USAGE> {
+    public:
+        UsageNotification(uint32_t sourceObjectId, const UsageEvent& usage)
+        : NotificationTemplate(sourceObjectId)
+        , m_usage(usage)
+        { }
+
+        const UsageEvent& Usage() const { return m_usage; }
+
+    private:
+        UsageEvent m_usage;
+    };
+}
@@ -23,13 +23,16 @@
 #pragma once
 
 namespace Asgaard {
+    // Formats are named after their 32 bit value, and are laid out in the same order as
+    // the window manager protocol so the formats it reports can be used directly.
     enum class PixelFormat {
         A8R8G8B8,
         A8B8G8R8,
         X8R8G8B8,
+        X8B8G8R8,
         R8G8B8A8,
         B8G8R8A8,
-        X8B8G8R8,
+        R5G6B5,
     };
     
     static int GetBytesPerPixel(enum PixelFormat format) {
@@ -43,6 +46,9 @@ namespace Asgaard {
             case Asgaard::PixelFormat::X8B8G8R8:
                 byteCount = 4;
                 break;
+            case Asgaard::PixelFormat::R5G6B5:
+                byteCount = 2;
+                break;
         }
         return byteCount;
     }
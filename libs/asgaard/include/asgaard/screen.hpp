@@ -77,6 +77,12 @@ namespace Asgaard {
         ASGAARD_API int GetCurrentRefreshRate() const;
 
         ASGAARD_API const std::list<std::unique_ptr<ScreenMode>>& GetModes() const;
+
+        /**
+         * Asks the compositor for the state of the frame governor of the screen. The reply is
+         * published as a GovernorNotification to the subscribers of the screen.
+         */
+        ASGAARD_API void RequestGovernorState();
         
     public:
         template<class WC, typename... Params>
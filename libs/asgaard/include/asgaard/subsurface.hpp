@@ -52,5 +52,13 @@ namespace Asgaard {
     public:
         ASGAARD_API void Resize(int width, int height);
         ASGAARD_API void Move(int parentX, int parentY);
+
+
+        /**
+         * In synchronized mode the changes applied by ApplyChanges are held back by the
+         * compositor until the parent applies its changes, so the subsurface never shows
+         * up a frame apart from its parent.
+         */
+        ASGAARD_API void SetSynchronized(bool synchronized);
     };
 }
@@ -34,6 +34,7 @@ namespace Asgaard {
     class Screen;
     class MemoryBuffer;
     class KeyEvent;
+    class PointerFrameEvent;
     class Pointer;
     class SubSurface;
     
@@ -63,18 +64,64 @@ namespace Asgaard {
         ASGAARD_API Surface(uint32_t id, const Rectangle&);
         ASGAARD_API ~Surface();
         
+        /**
+         * The buffer, damage, input region and drop shadow are collected and sent to the
+         * compositor together by the next ApplyChanges.
+         */
         ASGAARD_API void SetBuffer(const std::shared_ptr<MemoryBuffer>&);
         ASGAARD_API void MarkDamaged(const Rectangle&);
         ASGAARD_API void MarkInputRegion(const Rectangle&);
         ASGAARD_API void SetDropShadow(const Rectangle&);
+
+        /**
+         * Blurs whatever the compositor draws beneath the surface with the given radius, which
+         * shows through the transparent parts of the buffers. A radius of 0 disables it. Sent to
+         * the compositor right away, but only takes effect with the commit of the next ApplyChanges.
+         */
+        ASGAARD_API void SetBackdropBlur(int radius);
+
+        /**
+         * Sets the scale of the buffers attached to this surface relative to the surface
+         * dimensions. A scale of 2 means the buffers are twice the width and height of the
+         * surface. Sent to the compositor right away, but only takes effect with the commit of the
+         * next ApplyChanges.
+         */
+        ASGAARD_API void SetBufferScale(int scale);
+
+        /**
+         * Presents only the source part of the buffer (in surface coordinates), scaled to the
+         * given width and height. An empty source presents the entire buffer and a width or
+         * height of 0 presents it at the surface size. This allows rendering into smaller buffers
+         * and letting the compositor scale them up. Sent to the compositor right away, but only takes
+         * effect with the commit of the next ApplyChanges.
+         */
+        ASGAARD_API void SetViewport(const Rectangle& source, int width, int height);
         ASGAARD_API void RequestPriorityLevel(enum PriorityLevel);
         ASGAARD_API void RequestFullscreenMode(enum FullscreenMode);
         ASGAARD_API void RequestFocus();
         ASGAARD_API void TransferFocus(uint32_t globalId);
+
+        /**
+         * Sends the collected changes in a single update that commits them. A configure that was
+         * received since the last ApplyChanges is acknowledged by a separate message right before.
+         */
         ASGAARD_API void ApplyChanges();
         
+        /**
+         * Requests an OnFrame callback. Nothing is sent until the next ApplyChanges, so a frame
+         * requested without applying changes afterwards is never delivered.
+         */
         ASGAARD_API void RequestFrame();
 
+        /**
+         * Returns the age of the contents of the buffer in frames, counted in submissions to this
+         * surface. An age of 1 means the buffer holds the most recently submitted frame, 2 the one
+         * before that and so on. 0 means the contents are undefined and the entire buffer must be
+         * redrawn. Combined with MemoryBuffer::IsBusy this allows clients to pick a free buffer and
+         * only repaint what changed since its contents were submitted.
+         */
+        ASGAARD_API int BufferAge(const std::shared_ptr<MemoryBuffer>&) const;
+
         ASGAARD_API void GrabPointer(const std::shared_ptr<Pointer>&);
         ASGAARD_API void UngrabPointer(const std::shared_ptr<Pointer>&);
         
@@ -121,16 +168,33 @@ namespace Asgaard {
          */
         virtual void OnFrame() { }
 
+        /**
+         * OnRedraw is invoked when the window manager no longer holds the content of the surface and
+         * needs it submitted again. The default implementation submits the attached buffer again with
+         * the entire surface damaged if it is not busy and its BufferAge is 1, unless changes are
+         * pending. Surfaces that draw into released buffers outside of their event handlers must
+         * override this.
+         */
+        ASGAARD_API virtual void OnRedraw();
+
         virtual void OnMouseEnter(const std::shared_ptr<Pointer>&, int localX, int localY) { }
         virtual void OnMouseLeave(const std::shared_ptr<Pointer>&) { }
         virtual void OnMouseMove(const std::shared_ptr<Pointer>&, int localX, int localY) { }
         virtual void OnMouseScroll(const std::shared_ptr<Pointer>&, int scollX, int scrollY) { }
         virtual void OnMouseClick(const std::shared_ptr<Pointer>&, enum Pointer::Buttons button, bool pressed) { }
+
+        /**
+         * OnPointerFrame is invoked with all the pointer events of one input report at once. The default
+         * implementation invokes the OnMouse* callbacks for each event in order, surfaces that handle bursts
+         * of input (coalescing moves, kinetic scrolling using the timestamps) can override it instead.
+         */
+        ASGAARD_API virtual void OnPointerFrame(const PointerFrameEvent&);
         virtual void OnKeyEvent(const KeyEvent&) { }
         ASGAARD_API virtual void Notification(const Publisher*, const Asgaard::Notification&) override;
 
     private:
         void BindToScreen(const std::shared_ptr<Screen>&);
+        void PointerEvent(const Event&);
         ASGAARD_API void AddChild(const std::shared_ptr<Surface>&);
         
     private:
@@ -138,6 +202,17 @@ namespace Asgaard {
         std::shared_ptr<Screen>               m_screen;
         std::vector<std::shared_ptr<Surface>> m_children;
         bool                                  m_isFocused;
+        std::shared_ptr<MemoryBuffer>         m_attachedBuffer;
+        uint64_t                              m_bufferSequence;
+
+        // changes that are sent with the next ApplyChanges
+        unsigned int                          m_pendingChanges;
+        uint32_t                              m_pendingBuffer;
+        std::vector<Rectangle>                m_pendingDamage;
+        Rectangle                             m_pendingInputRegion;
+        Rectangle                             m_pendingDropShadow;
+        bool                                  m_configurePending;
+        uint32_t                              m_configureSerial;
 
         // allow certain accesses
         friend class SubSurface;
@@ -77,12 +77,13 @@ namespace {
 }
 
 namespace Asgaard {
-    KeyEvent::KeyEvent(const uint32_t keyCode, const uint16_t modifiers, bool pressed)
+    KeyEvent::KeyEvent(const uint32_t keyCode, const uint16_t modifiers, bool pressed, uint64_t timestamp)
         : Event(Event::Type::KEY_EVENT)
         , m_key(TranslateKey(static_cast<enum VKeyCode>(keyCode), modifiers))
         , m_modifiers(modifiers)
         , m_pressed(pressed)
         , m_keyCode(static_cast<enum VKeyCode>(keyCode))
+        , m_timestamp(timestamp)
     {
         
     }
@@ -107,6 +108,11 @@ namespace Asgaard {
         return (m_modifiers & VKS_MODIFIER_REPEATED) == VKS_MODIFIER_REPEATED;
     }
 
+    uint64_t KeyEvent::Timestamp() const
+    {
+        return m_timestamp;
+    }
+
     bool KeyEvent::LeftControl() const
     {
         return (m_modifiers & VKS_MODIFIER_LCTRL) != 0;
@@ -48,6 +48,7 @@ static enum wm_pixel_format GetWmPixelFormat(enum Asgaard::PixelFormat format)
         case Asgaard::PixelFormat::X8B8G8R8: return WM_PIXEL_FORMAT_X8B8G8R8;
         case Asgaard::PixelFormat::R8G8B8A8: return WM_PIXEL_FORMAT_R8G8B8A8;
         case Asgaard::PixelFormat::B8G8R8A8: return WM_PIXEL_FORMAT_B8G8R8A8;
+        case Asgaard::PixelFormat::R5G6B5:   return WM_PIXEL_FORMAT_R5G6B5;
 
         default:
             return WM_PIXEL_FORMAT_A8R8G8B8;
@@ -64,6 +65,9 @@ Asgaard::MemoryBuffer::MemoryBuffer(uint32_t id, const std::shared_ptr<MemoryPoo
     , m_format(format)
     , m_flags(flags)
     , m_buffer(memory->CreateBufferPointer(memoryOffset))
+    , m_busy(false)
+    , m_surfaceId(0)
+    , m_sequence(0)
 {
     enum wm_pixel_format wmFormat = GetWmPixelFormat(format);
     int                  stride   = CalculateStride(width, format);
@@ -109,9 +113,17 @@ void* Asgaard::MemoryBuffer::Buffer(int x, int y) {
     return pointer;
 }
 
+void Asgaard::MemoryBuffer::MarkSubmitted(uint32_t surfaceId, uint64_t sequence)
+{
+    m_busy      = true;
+    m_surfaceId = surfaceId;
+    m_sequence  = sequence;
+}
+
 void Asgaard::MemoryBuffer::ExternalEvent(const Event& event)
 {
     if (event.GetType() == Event::Type::BUFFER_RELEASE) {
+        m_busy = false;
         Notify(RefreshedNotification(Id()));
         return;
     }
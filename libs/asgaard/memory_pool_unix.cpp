@@ -30,64 +30,210 @@
 #include "wm_memory_pool_service_client.h"
 #include "wm_memory_service_client.h"
 
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <fcntl.h>
 #include <unistd.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace {
+    // must be kept in sync with the compositor, see vioarr_ram_unix.c
+    const char*       g_memoryPath  = "/tmp/vi-mem";
+    const std::size_t g_poolReserve = 256 * 1024 * 1024;
+    const std::size_t g_hugePage    = 2 * 1024 * 1024;
+
+    std::mutex g_memoryLock;
+    int        g_memorySocket = -1;
+
+    std::size_t Align(std::size_t size, std::size_t alignment)
+    {
+        return (size + (alignment - 1)) & ~(alignment - 1);
+    }
+
+    /**
+     * The protocol cannot carry descriptors, so they are sent over the memory socket of the
+     * compositor before the pool is created. The connection is shared by all pools. The compositor
+     * acknowledges the descriptor once it is stored, the pool must not be created before that.
+     */
+    void SendDescriptor(int fd, std::size_t handle)
+    {
+        std::lock_guard<std::mutex> lock(g_memoryLock);
+        uint64_t                    payload = handle;
+        char                        control[CMSG_SPACE(sizeof(int))] = { 0 };
+        struct msghdr               message = { };
+        struct iovec                iov = { &payload, sizeof(payload) };
+
+        if (g_memorySocket == -1) {
+            struct sockaddr_un addr = { };
+            
+            g_memorySocket = socket(AF_LOCAL, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+            if (g_memorySocket == -1) {
+                throw Asgaard::ApplicationException("MemoryPool failed to create the memory socket", errno);
+            }
+
+            addr.sun_family = AF_LOCAL;
+            strncpy(addr.sun_path, g_memoryPath, sizeof(addr.sun_path) - 1);
+            if (connect(g_memorySocket, (struct sockaddr*)&addr, sizeof(addr))) {
+                auto error = errno;
+                close(g_memorySocket);
+                g_memorySocket = -1;
+                throw Asgaard::ApplicationException("MemoryPool failed to connect to the memory socket", error);
+            }
+        }
+
+        message.msg_iov        = &iov;
+        message.msg_iovlen     = 1;
+        message.msg_control    = control;
+        message.msg_controllen = sizeof(control);
+
+        auto cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type  = SCM_RIGHTS;
+        cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+        if (sendmsg(g_memorySocket, &message, MSG_NOSIGNAL) != sizeof(payload)) {
+            throw Asgaard::ApplicationException("MemoryPool failed to send the memory descriptor", errno);
+        }
+
+        int32_t status;
+        if (recv(g_memorySocket, &status, sizeof(status), 0) != sizeof(status)) {
+            auto error = errno;
+            close(g_memorySocket);
+            g_memorySocket = -1;
+            throw Asgaard::ApplicationException("MemoryPool did not receive the memory descriptor status", error);
+        }
+        else if (status) {
+            throw Asgaard::ApplicationException("MemoryPool memory descriptor was rejected", status);
+        }
+    }
+
+    /**
+     * Screen-sized pools can be backed by huge pages if ASGAARD_HUGETLB is set and the system has
+     * reserved some, otherwise transparent huge pages are requested when the pool is mapped.
+     */
+    int CreateMemory(std::size_t size)
+    {
+        int fd = -1;
+
+        if (size >= g_hugePage && std::getenv("ASGAARD_HUGETLB")) {
+            fd = memfd_create("asgaard_pool", MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_HUGETLB);
+            if (fd != -1 && (ftruncate(fd, Align(size, g_hugePage)) ||
+                             fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK))) {
+                close(fd);
+                fd = -1;
+            }
+        }
+
+        if (fd == -1) {
+            fd = memfd_create("asgaard_pool", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+            if (fd == -1) {
+                throw Asgaard::ApplicationException("MemoryPool failed to create a new memory pool", errno);
+            }
+
+            // the compositor only accepts memory that cannot shrink underneath the buffers
+            if (ftruncate(fd, size) || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK)) {
+                auto error = errno;
+                close(fd);
+                throw Asgaard::ApplicationException("MemoryPool failed to create a new memory pool", error);
+            }
+        }
+        return fd;
+    }
+
+    /**
+     * Address space is reserved for the pool up front so it can grow in place, buffers keep
+     * pointers into the pool.
+     */
+    void* ReserveMemory(std::size_t size, std::size_t& reservedOut)
+    {
+        reservedOut = Align(size > (g_poolReserve / 2) ? size * 2 : g_poolReserve, g_hugePage) + g_hugePage;
+        auto reservation = mmap(nullptr, reservedOut, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (reservation == MAP_FAILED) {
+            throw Asgaard::ApplicationException("MemoryPool failed to reserve memory for the pool", errno);
+        }
+        return reservation;
+    }
+
+    void MapMemory(int fd, void* memory, std::size_t size, std::size_t available)
+    {
+        auto length = Align(size, g_hugePage);
+        if (length > available) {
+            throw Asgaard::ApplicationException("MemoryPool cannot grow beyond its reservation", ENOMEM);
+        }
+
+        if (mmap(memory, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            throw Asgaard::ApplicationException("MemoryPool failed to map the memory pool", errno);
+        }
+
+        if (length >= g_hugePage) {
+            madvise(memory, length, MADV_HUGEPAGE);
+        }
+    }
+}
 
 namespace Asgaard {
     MemoryPool::MemoryPool(uint32_t id, std::size_t handle, std::size_t size)
         : Object(id)
         , m_size(size)
         , m_inheritted(true)
-        , m_poolKey(static_cast<key_t>(handle))
+        , m_handle(handle)
+        , m_fd(-1)
+        , m_reservation(nullptr)
+        , m_memory(nullptr)
     {
         if (size == 0) {
             throw InvalidArgumentException("MemoryPool::MemoryPool 0-size provided");
         }
 
-        m_shmFd = shmget(m_poolKey, m_size, S_IRUSR | S_IWUSR);
-        if (m_shmFd == -1) {
+        // the handle names the memfd in the process that owns the pool
+        auto path = "/proc/" + std::to_string(handle >> 32) + "/fd/" + std::to_string(handle & 0xFFFFFFFF);
+        m_fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+        if (m_fd == -1) {
             throw ApplicationException("MemoryPool::MemoryPool() failed to inherit memory pool", errno);
         }
 
-        m_memory = shmat(m_shmFd, 0, 0);
-        if (m_memory == (void*)(-1)) {
-            throw ApplicationException("MemoryPool::MemoryPool() failed to inherit memory pool", errno);
-        }
+        m_reservation = ReserveMemory(size, m_reserved);
+        m_memory      = reinterpret_cast<void*>(Align(reinterpret_cast<std::size_t>(m_reservation), g_hugePage));
+        MapMemory(m_fd, m_memory, size, m_reserved - g_hugePage);
     }
 
     MemoryPool::MemoryPool(uint32_t id, std::size_t size)
         : Object(id)
         , m_size(size)
         , m_inheritted(false)
+        , m_fd(-1)
+        , m_reservation(nullptr)
+        , m_memory(nullptr)
     {
         if (size == 0) {
             throw InvalidArgumentException("MemoryPool::MemoryPool 0-size provided");
         }
 
-        // generate a new shmem key
-        m_poolKey = ((getpid() & 0xFFFF) << 16) | (id & 0xFFFF); 
-
-        m_shmFd = shmget(m_poolKey, size, IPC_CREAT | IPC_EXCL | S_IRUSR | S_IWUSR);
-        if (m_shmFd == -1) {
-            throw ApplicationException("MemoryPool::MemoryPool() failed to create a new memory pool", errno);
-        }
-
-        m_memory = shmat(m_shmFd, 0, 0);
-        if (m_memory == (void*)(-1)) {
-            throw ApplicationException("MemoryPool::MemoryPool() failed to map the new memory pool", errno);
-        }
+        m_fd          = CreateMemory(size);
+        m_handle      = (static_cast<std::size_t>(getpid()) << 32) | static_cast<std::size_t>(m_fd);
+        m_reservation = ReserveMemory(size, m_reserved);
+        m_memory      = reinterpret_cast<void*>(Align(reinterpret_cast<std::size_t>(m_reservation), g_hugePage));
+        MapMemory(m_fd, m_memory, size, m_reserved - g_hugePage);
 
-        wm_memory_create_pool(APP.VioarrClient(), nullptr, id, m_poolKey, size);
+        SendDescriptor(m_fd, m_handle);
+        wm_memory_create_pool(APP.VioarrClient(), nullptr, id, m_handle, size);
     }
     
     MemoryPool::~MemoryPool()
     {
-        if (m_memory) {
-            // destruction is handled by wm server
-            shmdt(m_memory);
+        // the compositor keeps its own descriptor of the memory
+        if (m_reservation) {
+            munmap(m_reservation, m_reserved);
+        }
+
+        if (m_fd != -1) {
+            close(m_fd);
         }
 
         if (!m_inheritted) {
@@ -97,7 +243,28 @@ namespace Asgaard {
     
     std::size_t MemoryPool::Handle() const
     {
-        return static_cast<std::size_t>(m_poolKey);
+        return m_handle;
+    }
+
+    void MemoryPool::Resize(std::size_t size)
+    {
+        if (size < m_size) {
+            throw InvalidArgumentException("MemoryPool::Resize pools cannot shrink");
+        }
+
+        if (m_inheritted) {
+            throw ApplicationException("MemoryPool::Resize inherited pools cannot be resized", EPERM);
+        }
+
+        // huge page backed memory can only grow in whole pages, regular memory is grown exactly
+        auto length = Align(size, g_hugePage);
+        if (ftruncate(m_fd, size) && ftruncate(m_fd, length)) {
+            throw ApplicationException("MemoryPool::Resize failed to grow the memory pool", errno);
+        }
+
+        MapMemory(m_fd, m_memory, size, m_reserved - g_hugePage);
+        m_size = size;
+        wm_memory_pool_resize(APP.VioarrClient(), nullptr, Id(), static_cast<int>(size));
     }
     
     void* MemoryPool::CreateBufferPointer(int memoryOffset)
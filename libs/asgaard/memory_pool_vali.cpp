@@ -94,7 +94,13 @@ namespace Asgaard {
     {
         return static_cast<std::size_t>(m_attachment.handle);
     }
-    
+
+    void MemoryPool::Resize(std::size_t)
+    {
+        // dma buffers are created with a fixed capacity
+        throw ApplicationException("MemoryPool::Resize is not supported", ENOTSUP);
+    }
+
     void* MemoryPool::CreateBufferPointer(int memoryOffset)
     {
         uint8_t* bufferPointer = static_cast<uint8_t*>(m_attachment.buffer);
@@ -27,6 +27,8 @@
 #include <asgaard/window_base.hpp>
 #include <asgaard/events/screen_properties_event.hpp>
 #include <asgaard/events/screen_mode_event.hpp>
+#include <asgaard/events/screen_governor_event.hpp>
+#include <asgaard/notifications/governor_notification.hpp>
 
 #include "wm_core_service_client.h"
 #include "wm_screen_service_client.h"
@@ -126,6 +128,11 @@ namespace Asgaard {
         return m_modes;
     }
     
+    void Screen::RequestGovernorState()
+    {
+        wm_screen_get_governor(APP.VioarrClient(), nullptr, Id());
+    }
+    
     void Screen::ExternalEvent(const Event& event)
     {
         switch (event.GetType()) {
@@ -156,6 +163,11 @@ namespace Asgaard {
                 
                 m_modes.push_back(std::move(screenMode));
             } break;
+
+            case Event::Type::SCREEN_GOVERNOR: {
+                const auto& governor = static_cast<const ScreenGovernorEvent&>(event);
+                Notify(GovernorNotification(Id(), governor));
+            } break;
             
             default:
                 break;
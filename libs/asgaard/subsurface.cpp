@@ -39,4 +39,9 @@ namespace Asgaard {
     {
         wm_surface_move_subsurface(APP.VioarrClient(), nullptr, Id(), parentX, parentY);
     }
+
+    void SubSurface::SetSynchronized(bool synchronized)
+    {
+        wm_surface_set_sync(APP.VioarrClient(), nullptr, Id(), static_cast<uint8_t>(synchronized));
+    }
 }
@@ -35,6 +35,7 @@
 #include <asgaard/events/pointer_move_event.hpp>
 #include <asgaard/events/pointer_scroll_event.hpp>
 #include <asgaard/events/pointer_click_event.hpp>
+#include <asgaard/events/pointer_frame_event.hpp>
 #include <asgaard/events/key_event.hpp>
 
 #include <asgaard/notifications/focus_notification.hpp>
@@ -57,6 +58,12 @@ namespace Asgaard {
         , m_dimensions(dimensions)
         , m_screen(nullptr)
         , m_isFocused(false)
+        , m_attachedBuffer(nullptr)
+        , m_bufferSequence(0)
+        , m_pendingChanges(WM_SURFACE_UPDATE_FLAGS_NO_UPDATES)
+        , m_pendingBuffer(0)
+        , m_configurePending(false)
+        , m_configureSerial(0)
     {
         BindToScreen(screen);
     }
@@ -114,6 +121,11 @@ namespace Asgaard {
             case Event::Type::SURFACE_RESIZE: {
                 const auto& resize = static_cast<const SurfaceResizeEvent&>(event);
                 
+                // The size is acknowledged by the next ApplyChanges, which is expected to
+                // contain the content of the new size
+                m_configurePending = true;
+                m_configureSerial  = resize.Serial();
+
                 // When we get a resize event, the event is sent only to the parent surface
                 // which equals this instance. Now we have to invoke the RESIZE event for all
                 // registered children
@@ -126,6 +138,10 @@ namespace Asgaard {
                 OnFrame();
             } break;
 
+            case Event::Type::SURFACE_REDRAW: {
+                OnRedraw();
+            } break;
+
             case Event::Type::KEY_EVENT: {
                 const auto& key = static_cast<const KeyEvent&>(event);
                 OnKeyEvent(key);
@@ -138,6 +154,30 @@ namespace Asgaard {
                 OnFocus(focus.Focus());
             } break;
 
+            case Event::Type::POINTER_ENTER:
+            case Event::Type::POINTER_LEAVE:
+            case Event::Type::POINTER_MOVE:
+            case Event::Type::POINTER_SCROLL:
+            case Event::Type::POINTER_CLICK: {
+                PointerEvent(event);
+            } break;
+
+            case Event::Type::POINTER_FRAME: {
+                const auto& frame = static_cast<const PointerFrameEvent&>(event);
+                OnPointerFrame(frame);
+            } break;
+
+            default:
+                break;
+        }
+        
+        // always call base-handler for these types
+        Object::ExternalEvent(event);
+    }
+
+    void Surface::PointerEvent(const Event& event)
+    {
+        switch (event.GetType()) {
             case Event::Type::POINTER_ENTER: {
                 const auto& enter = static_cast<const PointerEnterEvent&>(event);
                 auto pointer = Asgaard::OM[enter.PointerId()];
@@ -174,9 +214,13 @@ namespace Asgaard {
             default:
                 break;
         }
-        
-        // always call base-handler for these types
-        Object::ExternalEvent(event);
+    }
+
+    void Surface::OnPointerFrame(const PointerFrameEvent& frame)
+    {
+        for (const auto& event : frame.Events()) {
+            PointerEvent(*event);
+        }
     }
 
     void Surface::Notification(const Publisher* source, const Asgaard::Notification& notification)
@@ -239,29 +283,50 @@ namespace Asgaard {
         uint32_t id = 0;
         if (buffer) { 
             id = buffer->Id();
+            buffer->MarkSubmitted(Id(), ++m_bufferSequence);
         }
 
-        wm_surface_set_buffer(APP.VioarrClient(), nullptr, Id(), id);
+        m_attachedBuffer = buffer;
+        m_pendingBuffer  = id;
+        m_pendingChanges |= WM_SURFACE_UPDATE_FLAGS_BUFFER;
     }
     
     void Surface::MarkDamaged(const Rectangle& dimensions)
     {
-        wm_surface_invalidate(APP.VioarrClient(), nullptr, Id(),
-            dimensions.X(), dimensions.Y(),
-            dimensions.Width(), dimensions.Height());
+        // damaging a released buffer that is still attached submits its contents again
+        if (m_attachedBuffer && !m_attachedBuffer->IsBusy()) {
+            m_attachedBuffer->MarkSubmitted(Id(), ++m_bufferSequence);
+        }
+
+        m_pendingDamage.push_back(dimensions);
     }
     
     void Surface::MarkInputRegion(const Rectangle& dimensions)
     {
-        wm_surface_set_input_region(APP.VioarrClient(), nullptr, Id(),
-            dimensions.X(), dimensions.Y(),
-            dimensions.Width(), dimensions.Height());
+        m_pendingInputRegion = dimensions;
+        m_pendingChanges |= WM_SURFACE_UPDATE_FLAGS_INPUT_REGION;
     }
 
     void Surface::SetDropShadow(const Rectangle& dimensions)
     {
-        wm_surface_set_drop_shadow(APP.VioarrClient(), nullptr, Id(),
-            dimensions.X(), dimensions.Y(), dimensions.Width(), dimensions.Height());
+        m_pendingDropShadow = dimensions;
+        m_pendingChanges |= WM_SURFACE_UPDATE_FLAGS_DROP_SHADOW;
+    }
+
+    void Surface::SetBackdropBlur(int radius)
+    {
+        wm_surface_set_backdrop_blur(APP.VioarrClient(), nullptr, Id(), radius);
+    }
+
+    void Surface::SetBufferScale(int scale)
+    {
+        wm_surface_set_buffer_scale(APP.VioarrClient(), nullptr, Id(), scale);
+    }
+
+    void Surface::SetViewport(const Rectangle& source, int width, int height)
+    {
+        wm_surface_set_viewport(APP.VioarrClient(), nullptr, Id(),
+            source.X(), source.Y(), source.Width(), source.Height(), width, height);
     }
 
     void Surface::RequestPriorityLevel(enum PriorityLevel level)
@@ -288,12 +353,57 @@ namespace Asgaard {
     
     void Surface::ApplyChanges()
     {
-        wm_surface_commit(APP.VioarrClient(), nullptr, Id());
+        std::vector<struct wm_rect> damage;
+        struct wm_rect              dropShadow  = { m_pendingDropShadow.X(), m_pendingDropShadow.Y(),
+                                                    m_pendingDropShadow.Width(), m_pendingDropShadow.Height() };
+        struct wm_rect              inputRegion = { m_pendingInputRegion.X(), m_pendingInputRegion.Y(),
+                                                    m_pendingInputRegion.Width(), m_pendingInputRegion.Height() };
+
+        damage.reserve(m_pendingDamage.size());
+        for (const auto& rect : m_pendingDamage) {
+            damage.push_back({ rect.X(), rect.Y(), rect.Width(), rect.Height() });
+        }
+
+        if (m_configurePending) {
+            wm_surface_ack_configure(APP.VioarrClient(), nullptr, Id(), m_configureSerial);
+            m_configurePending = false;
+        }
+
+        // everything the frame changed is applied by the compositor in one go
+        wm_surface_update(APP.VioarrClient(), nullptr, Id(), m_pendingBuffer,
+            damage.data(), static_cast<uint32_t>(damage.size()), &dropShadow, &inputRegion,
+            static_cast<enum wm_surface_update_flags>(m_pendingChanges | WM_SURFACE_UPDATE_FLAGS_COMMIT));
+
+        m_pendingChanges = WM_SURFACE_UPDATE_FLAGS_NO_UPDATES;
+        m_pendingBuffer  = 0;
+        m_pendingDamage.clear();
     }
     
+    void Surface::OnRedraw()
+    {
+        // only a released buffer that still holds the newest frame of this surface can be submitted
+        // again, a busy one was submitted again already and a frame that is being prepared submits
+        // its own content with the next ApplyChanges
+        if (!m_attachedBuffer || m_attachedBuffer->IsBusy() || BufferAge(m_attachedBuffer) != 1 ||
+            m_pendingBuffer || !m_pendingDamage.empty()) {
+            return;
+        }
+
+        MarkDamaged(Rectangle(0, 0, m_dimensions.Width(), m_dimensions.Height()));
+        ApplyChanges();
+    }
+
     void Surface::RequestFrame()
     {
-        wm_surface_request_frame(APP.VioarrClient(), nullptr, Id());
+        m_pendingChanges |= WM_SURFACE_UPDATE_FLAGS_FRAME;
+    }
+
+    int Surface::BufferAge(const std::shared_ptr<MemoryBuffer>& buffer) const
+    {
+        if (!buffer || buffer->m_surfaceId != Id() || !buffer->m_sequence) {
+            return 0;
+        }
+        return static_cast<int>(m_bufferSequence - buffer->m_sequence) + 1;
     }
 
     void Surface::GrabPointer(const std::shared_ptr<Pointer>& pointer)
@@ -0,0 +1,49 @@
+/**
+ * MollenOS
+ *
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Ring Link
+ *  - Implements a gracht link that exchanges messages through a pair of shared memory
+ *    rings. The rings and their doorbells are handed to the server over a local socket
+ *    when connecting, the socket is then only kept to detect when the peer goes away.
+ */
+
+#ifndef __COMMON_LINK_RING_H__
+#define __COMMON_LINK_RING_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct link_ring;
+struct gracht_server_client;
+
+int  link_ring_create(struct link_ring** linkOut);
+void link_ring_set_address(struct link_ring* link, const char* path);
+void link_ring_set_listen(struct link_ring* link, int listen);
+
+/**
+ * link_ring_client_pid
+ * * Returns the process id of the peer of a client accepted by a ring link, or -1.
+ */
+int link_ring_client_pid(struct gracht_server_client* client);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //!__COMMON_LINK_RING_H__
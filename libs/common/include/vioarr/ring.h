@@ -0,0 +1,95 @@
+/**
+ * MollenOS
+ *
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Shared Memory Ring Implementation
+ *  - Implements a pair of single-producer single-consumer message rings in shared memory,
+ *    one for each direction. Readers only have to be woken up through their doorbell when
+ *    they are actually sleeping, so a busy connection exchanges messages without syscalls.
+ */
+
+#ifndef __COMMON_RING_H__
+#define __COMMON_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RING_DEFAULT_CAPACITY (256 * 1024)
+
+// descriptors that make up a ring pair, these are passed to the other end
+#define RING_DESCRIPTOR_MEMORY 0
+#define RING_DESCRIPTOR_FORWARD 1 // doorbell of the creator-to-peer ring
+#define RING_DESCRIPTOR_REVERSE 2 // doorbell of the peer-to-creator ring
+#define RING_DESCRIPTOR_COUNT   3
+
+struct ring_header;
+
+typedef struct ring {
+    struct ring_header* header;
+    uint8_t*            data;
+    uint32_t            capacity;
+    int                 doorbell; // eventfd the reader of this ring waits on
+    int                 notify;   // eventfd the writer of this ring waits on, rung when room is made
+} ring_t;
+
+typedef struct ring_pair {
+    void*  memory;
+    size_t length;
+    ring_t rx;
+    ring_t tx;
+    int    descriptors[RING_DESCRIPTOR_COUNT];
+} ring_pair_t;
+
+/**
+ * ring_pair_create
+ * * Creates a new pair of rings, each able to hold capacity bytes of messages. The descriptors
+ * * of the pair must be sent to the peer, which attaches to them with ring_pair_attach.
+ * @param pair     [In] The pair that should be initialized.
+ * @param capacity [In] Capacity of each ring, must be a power of two.
+ */
+int  ring_pair_create(ring_pair_t* pair, uint32_t capacity);
+int  ring_pair_attach(ring_pair_t* pair, const int descriptors[RING_DESCRIPTOR_COUNT]);
+void ring_pair_destroy(ring_pair_t* pair);
+
+/**
+ * ring_write
+ * * Writes a message consisting of count fragments to the ring and rings the doorbell if the
+ * * reader is sleeping. If the ring is full the writer waits up to timeout milliseconds for
+ * * the reader to make room, a negative timeout waits indefinitely. A timeout of 0 never waits,
+ * * instead the reader rings the doorbell of the writer once it has made room.
+ * @return 0 on success, -1 with errno set to EMSGSIZE, ETIMEDOUT or EAGAIN for a timeout of 0.
+ */
+int ring_write(ring_t* ring, const void* const* fragments, const uint32_t* lengths, int count, int timeout);
+
+/**
+ * ring_read
+ * * Reads the next message into the provided buffer.
+ * @return 0 on success, -1 with errno set to EAGAIN if the ring is empty or EMSGSIZE if the
+ *         next message does not fit the buffer.
+ */
+int ring_read(ring_t* ring, void* buffer, uint32_t length, uint32_t* lengthOut);
+
+/**
+ * ring_sleep
+ * * Must be called by the reader after ring_read returned EAGAIN and before it waits on the
+ * * doorbell descriptor. The doorbell is reset, and if a message arrived while preparing to
+ * * sleep -1 is returned with errno set to EAGAIN, in which case the reader must not wait.
+ */
+int ring_sleep(ring_t* ring);
+
+#endif //!__COMMON_RING_H__
@@ -0,0 +1,507 @@
+/**
+ * MollenOS
+ *
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Ring Link
+ *  - Implements a gracht link that exchanges messages through a pair of shared memory
+ *    rings. The rings and their doorbells are handed to the server over a local socket
+ *    when connecting, the socket is then only kept to detect when the peer goes away.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <gracht/link/link.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <threads.h>
+#include <unistd.h>
+#include <vioarr/link_ring.h>
+#include <vioarr/ring.h>
+
+#ifdef GRACHT_MAX_MESSAGE_SIZE
+#define LINK_RING_MAX_MESSAGE GRACHT_MAX_MESSAGE_SIZE
+#else
+#define LINK_RING_MAX_MESSAGE 4096
+#endif
+
+// the server never waits for a client to make room, messages are held back instead, and a
+// client that leaves this much unread is not going to catch up
+#define LINK_RING_MAX_BACKLOG (1024 * 1024)
+
+struct link_ring {
+    struct gracht_link base;
+    struct sockaddr_un address;
+    int                listen;
+    int                socket;
+    int                set;
+    ring_pair_t        rings;
+};
+
+struct link_ring_client {
+    struct gracht_server_client base;
+    int                         socket;
+    ring_pair_t                 rings;
+    mtx_t                       lock;     // messages are sent to the client from several threads
+    uint8_t*                    backlog;  // messages the ring had no room for, each prefixed by its length
+    size_t                      length;
+    size_t                      capacity;
+};
+
+/**
+ * The connection descriptor handed to gracht is an epoll set containing both the doorbell
+ * of the receiving ring and the socket, so the owner wakes up for new messages as well as for
+ * the peer disconnecting while only having to watch a single descriptor.
+ */
+static int __create_set(int socket, int doorbell)
+{
+    struct epoll_event event = { 0 };
+    int                set;
+
+    set = epoll_create1(EPOLL_CLOEXEC);
+    if (set < 0) {
+        return -1;
+    }
+
+    event.events  = EPOLLIN | EPOLLRDHUP;
+    event.data.fd = socket;
+    if (epoll_ctl(set, EPOLL_CTL_ADD, socket, &event)) {
+        goto error;
+    }
+
+    event.events  = EPOLLIN;
+    event.data.fd = doorbell;
+    if (epoll_ctl(set, EPOLL_CTL_ADD, doorbell, &event)) {
+        goto error;
+    }
+    return set;
+
+error:
+    close(set);
+    return -1;
+}
+
+static int __peer_connected(int socket)
+{
+    char    data;
+    ssize_t status = recv(socket, &data, sizeof(char), MSG_PEEK | MSG_DONTWAIT);
+    if (status == 0 || (status < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        return 0;
+    }
+    return 1;
+}
+
+static int __recv_message(int socket, ring_pair_t* rings, struct gracht_buffer* message, unsigned int flags, int set)
+{
+    uint32_t length;
+
+    while (1) {
+        if (!ring_read(&rings->rx, message->data, LINK_RING_MAX_MESSAGE, &length)) {
+            message->index = length;
+            return 0;
+        }
+        else if (errno != EAGAIN) {
+            return -1;
+        }
+
+        if (!__peer_connected(socket)) {
+            errno = ENODEV;
+            return -1;
+        }
+
+        // a message might have arrived while we prepared to sleep
+        if (ring_sleep(&rings->rx)) {
+            continue;
+        }
+
+        if (!(flags & GRACHT_MESSAGE_BLOCK)) {
+            errno = ENODATA;
+            return -1;
+        }
+
+        struct pollfd pfd = { .fd = set, .events = POLLIN };
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+static int __send_descriptors(int socket, const int descriptors[RING_DESCRIPTOR_COUNT])
+{
+    char           control[CMSG_SPACE(sizeof(int) * RING_DESCRIPTOR_COUNT)] = { 0 };
+    uint32_t       magic = 0x52494E47; // RING
+    struct iovec   iov = { &magic, sizeof(magic) };
+    struct msghdr  message = { 0 };
+    struct cmsghdr* cmsg;
+
+    message.msg_iov        = &iov;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control;
+    message.msg_controllen = sizeof(control);
+
+    cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * RING_DESCRIPTOR_COUNT);
+    memcpy(CMSG_DATA(cmsg), descriptors, sizeof(int) * RING_DESCRIPTOR_COUNT);
+
+    return sendmsg(socket, &message, MSG_NOSIGNAL) == sizeof(magic) ? 0 : -1;
+}
+
+static int __recv_descriptors(int socket, int descriptors[RING_DESCRIPTOR_COUNT])
+{
+    char            control[CMSG_SPACE(sizeof(int) * RING_DESCRIPTOR_COUNT)] = { 0 };
+    uint32_t        magic = 0;
+    struct iovec    iov = { &magic, sizeof(magic) };
+    struct msghdr   message = { 0 };
+    struct cmsghdr* cmsg;
+    int             count;
+    int             i;
+
+    message.msg_iov        = &iov;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control;
+    message.msg_controllen = sizeof(control);
+
+    if (recvmsg(socket, &message, MSG_CMSG_CLOEXEC) != sizeof(magic)) {
+        return -1;
+    }
+
+    cmsg = CMSG_FIRSTHDR(&message);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+    memcpy(descriptors, CMSG_DATA(cmsg), sizeof(int) * (count < RING_DESCRIPTOR_COUNT ? count : RING_DESCRIPTOR_COUNT));
+    if (magic != 0x52494E47 || count != RING_DESCRIPTOR_COUNT || (message.msg_flags & MSG_CTRUNC)) {
+        for (i = 0; i < count && i < RING_DESCRIPTOR_COUNT; i++) {
+            close(descriptors[i]);
+        }
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+/*******************************************
+ * Client Operations
+ *******************************************/
+static gracht_conn_t ring_link_connect(struct link_ring* link)
+{
+    link->socket = socket(AF_LOCAL, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (link->socket < 0) {
+        return -1;
+    }
+
+    if (connect(link->socket, (struct sockaddr*)&link->address, sizeof(struct sockaddr_un))) {
+        goto error;
+    }
+
+    if (ring_pair_create(&link->rings, RING_DEFAULT_CAPACITY)) {
+        goto error;
+    }
+
+    if (__send_descriptors(link->socket, link->rings.descriptors)) {
+        goto error;
+    }
+
+    // start out sleeping, so the first event from the server wakes us up
+    ring_sleep(&link->rings.rx);
+    link->set = __create_set(link->socket, link->rings.rx.doorbell);
+    if (link->set < 0) {
+        goto error;
+    }
+
+    link->base.connection = link->set;
+    return link->set;
+
+error:
+    ring_pair_destroy(&link->rings);
+    close(link->socket);
+    link->socket = -1;
+    return -1;
+}
+
+static int ring_link_recv(struct link_ring* link, struct gracht_buffer* message, unsigned int flags)
+{
+    return __recv_message(link->socket, &link->rings, message, flags, link->set);
+}
+
+static int ring_link_send(struct link_ring* link, struct gracht_buffer* message, void* messageContext)
+{
+    const void* fragments[1] = { message->data };
+    uint32_t    lengths[1]   = { message->index };
+    (void)messageContext;
+
+    return ring_write(&link->rings.tx, fragments, lengths, 1, -1);
+}
+
+static void ring_link_destroy(struct link_ring* link)
+{
+    if (link->set >= 0) {
+        close(link->set);
+    }
+
+    if (link->socket >= 0) {
+        close(link->socket);
+    }
+
+    if (link->listen) {
+        unlink(link->address.sun_path);
+    }
+
+    ring_pair_destroy(&link->rings);
+    free(link);
+}
+
+/*******************************************
+ * Server Operations
+ *******************************************/
+static gracht_conn_t ring_link_listen(struct link_ring* link, int mode)
+{
+    (void)mode;
+
+    // delete any preexisting file
+    unlink(link->address.sun_path);
+
+    link->socket = socket(AF_LOCAL, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (link->socket < 0) {
+        return -1;
+    }
+
+    if (bind(link->socket, (struct sockaddr*)&link->address, sizeof(struct sockaddr_un)) ||
+        listen(link->socket, 16)) {
+        close(link->socket);
+        link->socket = -1;
+        return -1;
+    }
+
+    link->base.connection = link->socket;
+    return link->socket;
+}
+
+static int ring_link_accept(struct link_ring* link, struct gracht_server_client** clientOut)
+{
+    struct link_ring_client* client;
+    int                      descriptors[RING_DESCRIPTOR_COUNT];
+    int                      i;
+
+    client = calloc(1, sizeof(struct link_ring_client));
+    if (!client) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    client->socket = accept4(link->socket, NULL, NULL, SOCK_CLOEXEC);
+    if (client->socket < 0) {
+        free(client);
+        return -1;
+    }
+
+    if (__recv_descriptors(client->socket, descriptors)) {
+        goto error;
+    }
+
+    if (ring_pair_attach(&client->rings, descriptors)) {
+        for (i = 0; i < RING_DESCRIPTOR_COUNT; i++) {
+            close(descriptors[i]);
+        }
+        goto error;
+    }
+
+    ring_sleep(&client->rings.rx);
+    client->base.handle = __create_set(client->socket, client->rings.rx.doorbell);
+    if (client->base.handle < 0) {
+        ring_pair_destroy(&client->rings);
+        goto error;
+    }
+
+    mtx_init(&client->lock, mtx_plain);
+    *clientOut = &client->base;
+    return 0;
+
+error:
+    close(client->socket);
+    free(client);
+    return -1;
+}
+
+/**
+ * Writes the held back messages of the client in order for as long as the ring has room.
+ * @return 0 if nothing is held back anymore, -1 with errno set to EAGAIN otherwise.
+ */
+static int __flush_backlog(struct link_ring_client* client)
+{
+    size_t offset = 0;
+
+    while (offset < client->length) {
+        const void* fragments[1] = { &client->backlog[offset + sizeof(uint32_t)] };
+        uint32_t    lengths[1];
+
+        memcpy(&lengths[0], &client->backlog[offset], sizeof(uint32_t));
+        if (ring_write(&client->rings.tx, fragments, lengths, 1, 0) && errno == EAGAIN) {
+            break;
+        }
+        offset += sizeof(uint32_t) + lengths[0];
+    }
+
+    if (offset) {
+        memmove(client->backlog, &client->backlog[offset], client->length - offset);
+        client->length -= offset;
+    }
+
+    if (client->length) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * The ring had no room for the message, so it is held back until the client has read enough,
+ * the reader rings our doorbell once it has made room. A client that does not catch up has its
+ * connection shut down, so it is disconnected like any other client that went away.
+ */
+static int __hold_message(struct link_ring_client* client, struct gracht_buffer* message)
+{
+    uint32_t length   = message->index;
+    size_t   required = client->length + sizeof(uint32_t) + length;
+
+    if (required > LINK_RING_MAX_BACKLOG) {
+        shutdown(client->socket, SHUT_RDWR);
+        client->length = 0;
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    if (required > client->capacity) {
+        size_t   capacity = required > client->capacity * 2 ? required : client->capacity * 2;
+        uint8_t* backlog  = realloc(client->backlog, capacity);
+        if (!backlog) {
+            errno = ENOMEM;
+            return -1;
+        }
+        client->backlog  = backlog;
+        client->capacity = capacity;
+    }
+
+    memcpy(&client->backlog[client->length], &length, sizeof(uint32_t));
+    memcpy(&client->backlog[client->length + sizeof(uint32_t)], message->data, length);
+    client->length = required;
+    return 0;
+}
+
+static int ring_link_recv_client(struct link_ring_client* client, struct gracht_buffer* message, unsigned int flags)
+{
+    // the client rings the doorbell when it has made room for held back messages
+    mtx_lock(&client->lock);
+    (void)__flush_backlog(client);
+    mtx_unlock(&client->lock);
+    return __recv_message(client->socket, &client->rings, message, flags, client->base.handle);
+}
+
+static int ring_link_send_client(struct link_ring_client* client, struct gracht_buffer* message, unsigned int flags)
+{
+    const void* fragments[1] = { message->data };
+    uint32_t    lengths[1]   = { message->index };
+    int         status;
+    (void)flags;
+
+    mtx_lock(&client->lock);
+    status = __flush_backlog(client);
+    if (!status) {
+        status = ring_write(&client->rings.tx, fragments, lengths, 1, 0);
+    }
+
+    if (status && errno == EAGAIN) {
+        status = __hold_message(client, message);
+    }
+    mtx_unlock(&client->lock);
+    return status;
+}
+
+static void ring_link_destroy_client(struct link_ring_client* client)
+{
+    close(client->base.handle);
+    close(client->socket);
+    ring_pair_destroy(&client->rings);
+    mtx_destroy(&client->lock);
+    free(client->backlog);
+    free(client);
+}
+
+int link_ring_client_pid(struct gracht_server_client* client)
+{
+    struct link_ring_client* ringClient = (struct link_ring_client*)client;
+    struct ucred             credentials;
+    socklen_t                length = sizeof(credentials);
+
+    if (!client || getsockopt(ringClient->socket, SOL_SOCKET, SO_PEERCRED, &credentials, &length)) {
+        return -1;
+    }
+    return (int)credentials.pid;
+}
+
+int link_ring_create(struct link_ring** linkOut)
+{
+    struct link_ring* link;
+
+    link = calloc(1, sizeof(struct link_ring));
+    if (!link) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    link->socket = -1;
+    link->set    = -1;
+    memset(link->rings.descriptors, 0xFF, sizeof(link->rings.descriptors));
+
+    link->base.type       = gracht_link_stream_based;
+    link->base.connection = -1;
+
+    link->base.ops.connect = (link_connect_fn)ring_link_connect;
+    link->base.ops.recv    = (link_recv_fn)ring_link_recv;
+    link->base.ops.send    = (link_send_fn)ring_link_send;
+    link->base.ops.destroy = (link_destroy_fn)ring_link_destroy;
+
+    link->base.ops.listen         = (link_listen_fn)ring_link_listen;
+    link->base.ops.accept         = (link_accept_fn)ring_link_accept;
+    link->base.ops.recv_client    = (link_recv_client_fn)ring_link_recv_client;
+    link->base.ops.send_client    = (link_send_client_fn)ring_link_send_client;
+    link->base.ops.destroy_client = (link_destroy_client_fn)ring_link_destroy_client;
+
+    *linkOut = link;
+    return 0;
+}
+
+void link_ring_set_address(struct link_ring* link, const char* path)
+{
+    link->address.sun_family = AF_LOCAL;
+    strncpy(link->address.sun_path, path, sizeof(link->address.sun_path) - 1);
+}
+
+void link_ring_set_listen(struct link_ring* link, int listen)
+{
+    link->listen = listen;
+}
@@ -0,0 +1,403 @@
+/**
+ * MollenOS
+ *
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Shared Memory Ring Implementation
+ *  - Implements a pair of single-producer single-consumer message rings in shared memory,
+ *    one for each direction. Readers only have to be woken up through their doorbell when
+ *    they are actually sleeping, so a busy connection exchanges messages without syscalls.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <vioarr/ring.h>
+
+#define RING_ALIGN(size) (((size) + 3) & ~3U)
+
+// the positions are free-running, and each of the shared words lives on its own cache line
+// so the producer and consumer do not keep stealing the line from each other
+struct ring_header {
+    _Atomic(uint32_t) head;     // written by the producer
+    uint8_t           reserved0[60];
+    _Atomic(uint32_t) tail;     // written by the consumer, the producer waits on this when full
+    uint8_t           reserved1[60];
+    _Atomic(uint32_t) sleeping; // consumer is waiting on the doorbell
+    _Atomic(uint32_t) blocked;  // producer is waiting for room, or wants its doorbell rung
+    uint32_t          capacity;
+    uint8_t           reserved2[52];
+};
+
+static size_t __ring_size(uint32_t capacity)
+{
+    return sizeof(struct ring_header) + capacity;
+}
+
+static int __futex_wait(_Atomic(uint32_t)* address, uint32_t value, int timeout)
+{
+    struct timespec  ts;
+    struct timespec* tsp = NULL;
+
+    if (timeout >= 0) {
+        ts.tv_sec  = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000L;
+        tsp = &ts;
+    }
+
+    // the memory is shared between processes, so the private futex ops can't be used
+    return (int)syscall(SYS_futex, address, FUTEX_WAIT, value, tsp, NULL, 0);
+}
+
+static void __futex_wake(_Atomic(uint32_t)* address)
+{
+    syscall(SYS_futex, address, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static void __copy_in(ring_t* ring, uint32_t position, const void* source, uint32_t length)
+{
+    uint32_t index = position & (ring->capacity - 1);
+    uint32_t first = ring->capacity - index;
+
+    if (first >= length) {
+        memcpy(&ring->data[index], source, length);
+    }
+    else {
+        memcpy(&ring->data[index], source, first);
+        memcpy(&ring->data[0], (const uint8_t*)source + first, length - first);
+    }
+}
+
+static void __copy_out(ring_t* ring, uint32_t position, void* target, uint32_t length)
+{
+    uint32_t index = position & (ring->capacity - 1);
+    uint32_t first = ring->capacity - index;
+
+    if (first >= length) {
+        memcpy(target, &ring->data[index], length);
+    }
+    else {
+        memcpy(target, &ring->data[index], first);
+        memcpy((uint8_t*)target + first, &ring->data[0], length - first);
+    }
+}
+
+static void __ring_init(ring_t* ring, uint8_t* memory, uint32_t capacity, int doorbell, int notify)
+{
+    ring->header   = (struct ring_header*)memory;
+    ring->data     = memory + sizeof(struct ring_header);
+    ring->capacity = capacity;
+    ring->doorbell = doorbell;
+    ring->notify   = notify;
+}
+
+static int __map_pair(ring_pair_t* pair, uint32_t capacity, int initialize)
+{
+    uint8_t* memory;
+
+    pair->length = 2 * __ring_size(capacity);
+    pair->memory = mmap(NULL, pair->length, PROT_READ | PROT_WRITE, MAP_SHARED,
+        pair->descriptors[RING_DESCRIPTOR_MEMORY], 0);
+    if (pair->memory == MAP_FAILED) {
+        pair->memory = NULL;
+        return -1;
+    }
+
+    // the creator writes into the first ring and reads from the second, the writer of a ring
+    // waits on the doorbell of the other ring
+    memory = pair->memory;
+    if (initialize) {
+        ((struct ring_header*)memory)->capacity = capacity;
+        ((struct ring_header*)(memory + __ring_size(capacity)))->capacity = capacity;
+        __ring_init(&pair->tx, memory, capacity, pair->descriptors[RING_DESCRIPTOR_FORWARD],
+            pair->descriptors[RING_DESCRIPTOR_REVERSE]);
+        __ring_init(&pair->rx, memory + __ring_size(capacity), capacity, pair->descriptors[RING_DESCRIPTOR_REVERSE],
+            pair->descriptors[RING_DESCRIPTOR_FORWARD]);
+    }
+    else {
+        __ring_init(&pair->rx, memory, capacity, pair->descriptors[RING_DESCRIPTOR_FORWARD],
+            pair->descriptors[RING_DESCRIPTOR_REVERSE]);
+        __ring_init(&pair->tx, memory + __ring_size(capacity), capacity, pair->descriptors[RING_DESCRIPTOR_REVERSE],
+            pair->descriptors[RING_DESCRIPTOR_FORWARD]);
+    }
+    return 0;
+}
+
+int ring_pair_create(ring_pair_t* pair, uint32_t capacity)
+{
+    int i;
+
+    if (!pair || !capacity || (capacity & (capacity - 1))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(pair, 0, sizeof(ring_pair_t));
+    pair->descriptors[RING_DESCRIPTOR_MEMORY] = memfd_create("vioarr_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    pair->descriptors[RING_DESCRIPTOR_FORWARD] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    pair->descriptors[RING_DESCRIPTOR_REVERSE] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    for (i = 0; i < RING_DESCRIPTOR_COUNT; i++) {
+        if (pair->descriptors[i] < 0) {
+            goto error;
+        }
+    }
+
+    // the peer must never be able to pull the memory away from underneath us
+    if (ftruncate(pair->descriptors[RING_DESCRIPTOR_MEMORY], 2 * __ring_size(capacity)) ||
+        fcntl(pair->descriptors[RING_DESCRIPTOR_MEMORY], F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+        goto error;
+    }
+
+    if (__map_pair(pair, capacity, 1)) {
+        goto error;
+    }
+    return 0;
+
+error:
+    ring_pair_destroy(pair);
+    return -1;
+}
+
+int ring_pair_attach(ring_pair_t* pair, const int descriptors[RING_DESCRIPTOR_COUNT])
+{
+    struct ring_header header;
+    struct stat        stats;
+    ssize_t            bytesRead;
+    int                seals;
+    int                i;
+
+    if (!pair || !descriptors) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(pair, 0, sizeof(ring_pair_t));
+    for (i = 0; i < RING_DESCRIPTOR_COUNT; i++) {
+        pair->descriptors[i] = descriptors[i];
+    }
+
+    // the capacity is provided by the peer, so it is validated against the size of the memory
+    // and the memory must be sealed against shrinking
+    seals = fcntl(descriptors[RING_DESCRIPTOR_MEMORY], F_GET_SEALS);
+    if (seals < 0 || !(seals & F_SEAL_SHRINK) || fstat(descriptors[RING_DESCRIPTOR_MEMORY], &stats)) {
+        errno = EPERM;
+        goto error;
+    }
+
+    bytesRead = pread(descriptors[RING_DESCRIPTOR_MEMORY], &header, sizeof(header), 0);
+    if (bytesRead != sizeof(header) || !header.capacity || (header.capacity & (header.capacity - 1)) ||
+        (size_t)stats.st_size < 2 * __ring_size(header.capacity)) {
+        errno = EINVAL;
+        goto error;
+    }
+
+    if (__map_pair(pair, header.capacity, 0)) {
+        goto error;
+    }
+    return 0;
+
+error:
+    memset(pair->descriptors, 0xFF, sizeof(pair->descriptors));
+    return -1;
+}
+
+void ring_pair_destroy(ring_pair_t* pair)
+{
+    int i;
+
+    if (!pair) {
+        return;
+    }
+
+    if (pair->memory) {
+        munmap(pair->memory, pair->length);
+        pair->memory = NULL;
+    }
+
+    for (i = 0; i < RING_DESCRIPTOR_COUNT; i++) {
+        if (pair->descriptors[i] >= 0) {
+            close(pair->descriptors[i]);
+        }
+        pair->descriptors[i] = -1;
+    }
+}
+
+static int __wait_for_room(ring_t* ring, uint32_t tail, int timeout)
+{
+    struct ring_header* header = ring->header;
+    int                 status;
+
+    atomic_store_explicit(&header->blocked, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&header->tail, memory_order_relaxed) != tail) {
+        return 0;
+    }
+
+    // the reader sees the flag after making room and rings our doorbell instead
+    if (!timeout) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    status = __futex_wait(&header->tail, tail, timeout);
+    if (status && errno == ETIMEDOUT) {
+        atomic_store_explicit(&header->blocked, 0, memory_order_relaxed);
+        return -1;
+    }
+    return 0;
+}
+
+int ring_write(ring_t* ring, const void* const* fragments, const uint32_t* lengths, int count, int timeout)
+{
+    struct ring_header* header;
+    uint32_t            length = 0;
+    uint32_t            required;
+    uint32_t            head;
+    uint32_t            position;
+    int                 i;
+
+    if (!ring || !ring->header) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        length += lengths[i];
+    }
+
+    header   = ring->header;
+    required = sizeof(uint32_t) + RING_ALIGN(length);
+    if (required > ring->capacity) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    head = atomic_load_explicit(&header->head, memory_order_relaxed);
+    while (1) {
+        uint32_t tail = atomic_load_explicit(&header->tail, memory_order_acquire);
+        if (ring->capacity - (head - tail) >= required) {
+            break;
+        }
+
+        if (__wait_for_room(ring, tail, timeout)) {
+            return -1;
+        }
+    }
+    atomic_store_explicit(&header->blocked, 0, memory_order_relaxed);
+
+    __copy_in(ring, head, &length, sizeof(uint32_t));
+    position = head + sizeof(uint32_t);
+    for (i = 0; i < count; i++) {
+        __copy_in(ring, position, fragments[i], lengths[i]);
+        position += lengths[i];
+    }
+    atomic_store_explicit(&header->head, head + required, memory_order_release);
+
+    // pairs with the fence in ring_sleep, either the reader sees the new head before it
+    // sleeps, or we see that it is sleeping
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&header->sleeping, memory_order_relaxed)) {
+        uint64_t value = 1;
+        (void)write(ring->doorbell, &value, sizeof(uint64_t));
+    }
+    return 0;
+}
+
+int ring_read(ring_t* ring, void* buffer, uint32_t length, uint32_t* lengthOut)
+{
+    struct ring_header* header;
+    uint32_t            available;
+    uint32_t            messageLength;
+    uint32_t            tail;
+
+    if (!ring || !ring->header) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    header    = ring->header;
+    tail      = atomic_load_explicit(&header->tail, memory_order_relaxed);
+    available = atomic_load_explicit(&header->head, memory_order_acquire) - tail;
+    if (!available) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    // the positions are shared with the peer, so never trust them further than the capacity
+    __copy_out(ring, tail, &messageLength, sizeof(uint32_t));
+    if (available > ring->capacity || messageLength > available - sizeof(uint32_t)) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    if (messageLength > length) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    __copy_out(ring, tail + sizeof(uint32_t), buffer, messageLength);
+    atomic_store_explicit(&header->tail, tail + sizeof(uint32_t) + RING_ALIGN(messageLength), memory_order_release);
+    if (atomic_load_explicit(&header->sleeping, memory_order_relaxed)) {
+        atomic_store_explicit(&header->sleeping, 0, memory_order_relaxed);
+    }
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_exchange_explicit(&header->blocked, 0, memory_order_relaxed)) {
+        uint64_t value = 1;
+        __futex_wake(&header->tail);
+        (void)write(ring->notify, &value, sizeof(uint64_t));
+    }
+
+    if (lengthOut) {
+        *lengthOut = messageLength;
+    }
+    return 0;
+}
+
+int ring_sleep(ring_t* ring)
+{
+    struct ring_header* header;
+    uint64_t            value;
+
+    if (!ring || !ring->header) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    header = ring->header;
+    (void)read(ring->doorbell, &value, sizeof(uint64_t));
+
+    atomic_store_explicit(&header->sleeping, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&header->head, memory_order_acquire) !=
+        atomic_load_explicit(&header->tail, memory_order_relaxed)) {
+        atomic_store_explicit(&header->sleeping, 0, memory_order_relaxed);
+        errno = EAGAIN;
+        return -1;
+    }
+    return 0;
+}